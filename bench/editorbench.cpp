@@ -0,0 +1,271 @@
+// Microbenchmarks for the editing core, driven through a headless Editor.
+//
+//   editorbench [--max-size SIZE] [--out FILE] [--baseline FILE] [--threshold PERCENT] [--fail]
+//
+// Every operation is timed on generated files from 1 KB up to --max-size
+// (default 64M, at most 1G) for each line-length distribution. Results are
+// written as JSON; with --baseline they are compared against an earlier run
+// on the same machine, and anything slower by more than the threshold is
+// listed. Only with --fail is the exit status then 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "editor.h"
+
+struct Distribution {
+    const char *name;
+    int minLength, maxLength;
+    bool indented;
+};
+
+static const Distribution DISTRIBUTIONS[] = {
+    {"short", 0, 16, false},
+    {"code", 0, 100, true},
+    {"long", 1000, 4000, false},
+    {"minified", 200000, 300000, false},
+};
+
+struct Result {
+    std::string name;
+    std::string lines;
+    long long bytes;
+    long long ops;
+    double nsPerOp;
+};
+
+// Each round runs for at least this long, in doubling batches; the
+// fastest of the rounds is reported, which is far steadier than the mean
+static const auto MIN_TIME = std::chrono::milliseconds(40);
+static const int ROUNDS = 3;
+
+static uint64_t randomState = 0x9e3779b97f4a7c15ull;
+
+static uint64_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+// Writes about bytes of words and spaces in lines drawn from distribution;
+// returns the number of lines
+static int writeFile(const std::string &path, long long bytes, const Distribution &distribution) {
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz_(){};=+";
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return 0;
+
+    std::string block;
+    long long written = 0;
+    int lines = 0;
+    while (written < bytes) {
+        int length = distribution.minLength +
+                     (int)(nextRandom() % (distribution.maxLength - distribution.minLength + 1));
+        length = (int)std::min<long long>(length, bytes - written - 1);
+        int indent = distribution.indented ? std::min(length, (int)(nextRandom() % 4) * 4) : 0;
+        block.append(indent, ' ');
+        for (int i = indent; i < length; i++) {
+            uint64_t r = nextRandom();
+            block += r % 6 == 0 ? ' ' : letters[(r >> 8) % (sizeof(letters) - 1)];
+        }
+        block += '\n';
+        written += length + 1;
+        lines++;
+        if (block.size() >= (1 << 20)) {
+            fwrite(block.data(), 1, block.size(), file);
+            block.clear();
+        }
+    }
+    fwrite(block.data(), 1, block.size(), file);
+    fclose(file);
+    return lines;
+}
+
+// Times op in rounds of doubling batches until maxOps have run in all
+template <typename Op>
+static Result measure(const char *name, const Distribution &distribution, long long bytes, long long maxOps, Op op) {
+    long long done = 0;
+    double best = 0;
+    for (int round = 0; round < ROUNDS && done < maxOps; round++) {
+        auto start = std::chrono::steady_clock::now();
+        long long count = 0, batch = 1;
+        std::chrono::nanoseconds elapsed(0);
+        while (done < maxOps) {
+            long long run = std::min(batch, maxOps - done);
+            for (long long i = 0; i < run; i++) op();
+            done += run;
+            count += run;
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed >= MIN_TIME) break;
+            batch *= 2;
+        }
+        double nsPerOp = (double)elapsed.count() / std::max(count, 1LL);
+        if (round == 0 || nsPerOp < best) best = nsPerOp;
+    }
+    return {name, distribution.name, bytes, done, best};
+}
+
+static void benchFile(const std::string &path, long long bytes, const Distribution &distribution,
+                      std::vector<Result> &results) {
+    int lineCount = writeFile(path, bytes, distribution);
+    Editor editor;
+
+    results.push_back(measure("openFile", distribution, bytes, 1 << 20, [&]() { editor.openFile(path); }));
+    results.push_back(measure("saveFile", distribution, bytes, 1 << 20, [&]() { editor.saveFile(); }));
+
+    // Down (then back up) through the file, stepping sideways on the way
+    int vertical = KEY_DOWN, line = 0;
+    long long step = 0;
+    results.push_back(measure("moveCursor", distribution, bytes, 1LL << 30, [&]() {
+        if (step++ % 2 == 0) {
+            editor.moveCursor(step % 4 == 1 ? KEY_RIGHT : KEY_LEFT);
+            return;
+        }
+        if (line == 0) vertical = KEY_DOWN;
+        if (line == lineCount - 1) vertical = KEY_UP;
+        line += vertical == KEY_DOWN ? 1 : -1;
+        editor.moveCursor(vertical);
+    }));
+
+    // Typing goes into the middle of the file
+    editor.openFile(path);
+    for (int i = 0; i < lineCount / 2; i++) editor.moveCursor(KEY_DOWN);
+    for (int i = 0; i < 8; i++) editor.moveCursor(KEY_RIGHT);
+    Result typed = measure("insertChar", distribution, bytes, 1 << 20, [&]() { editor.insertText("x"); });
+    results.push_back(typed);
+    // Deletes the typing, then on into the text and lines before it
+    results.push_back(measure("deleteChar", distribution, bytes, typed.ops + bytes / 2, [&]() { editor.deleteChar(); }));
+    results.push_back(measure("insertNewline", distribution, bytes, 100000, [&]() { editor.insertNewline(); }));
+
+    unlink(path.c_str());
+}
+
+static long long parseSize(const char *text) {
+    char *end = nullptr;
+    long long size = strtoll(text, &end, 10);
+    if (*end == 'K' || *end == 'k') size <<= 10;
+    if (*end == 'M' || *end == 'm') size <<= 20;
+    if (*end == 'G' || *end == 'g') size <<= 30;
+    return size;
+}
+
+static std::string sizeLabel(long long bytes) {
+    if (bytes >= (1LL << 30)) return std::to_string(bytes >> 30) + "G";
+    if (bytes >= (1LL << 20)) return std::to_string(bytes >> 20) + "M";
+    return std::to_string(bytes >> 10) + "K";
+}
+
+static std::string resultKey(const std::string &name, const std::string &lines, long long bytes) {
+    return name + "/" + lines + "/" + std::to_string(bytes);
+}
+
+static void writeJson(FILE *out, const std::vector<Result> &results) {
+    fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &result = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"lines\": \"%s\", \"bytes\": %lld, \"ops\": %lld, \"ns_per_op\": %.1f}%s\n",
+                result.name.c_str(), result.lines.c_str(), result.bytes, result.ops, result.nsPerOp,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Value of "key": in one line of our own JSON output
+static std::string jsonField(const std::string &line, const std::string &key) {
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos) return std::string();
+    pos += key.size() + 3;
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '"')) pos++;
+    size_t end = line.find_first_of("\",}", pos);
+    return line.substr(pos, end - pos);
+}
+
+static bool readBaseline(const std::string &path, std::map<std::string, double> &baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string name = jsonField(line, "name");
+        if (name.empty()) continue;
+        baseline[resultKey(name, jsonField(line, "lines"), atoll(jsonField(line, "bytes").c_str()))] =
+            atof(jsonField(line, "ns_per_op").c_str());
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    long long maxSize = 64LL << 20;
+    std::string outPath, baselinePath;
+    double threshold = 25;
+    bool failOnRegression = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--max-size") {
+            maxSize = std::min(parseSize(argv[++i]), 1LL << 30);
+        } else if (i + 1 < argc && arg == "--out") {
+            outPath = argv[++i];
+        } else if (i + 1 < argc && arg == "--baseline") {
+            baselinePath = argv[++i];
+        } else if (i + 1 < argc && arg == "--threshold") {
+            threshold = atof(argv[++i]);
+        } else if (arg == "--fail") {
+            failOnRegression = true;
+        } else {
+            fprintf(stderr, "usage: editorbench [--max-size SIZE] [--out FILE] [--baseline FILE] [--threshold PERCENT] "
+                            "[--fail]\n");
+            return 2;
+        }
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    std::string path = std::string(tmp ? tmp : "/tmp") + "/leditor-bench-" + std::to_string(getpid()) + ".txt";
+
+    std::vector<Result> results;
+    for (long long bytes = 1 << 10; bytes <= maxSize; bytes *= 16) {
+        for (const Distribution &distribution : DISTRIBUTIONS) {
+            size_t first = results.size();
+            benchFile(path, bytes, distribution, results);
+            for (size_t i = first; i < results.size(); i++) {
+                fprintf(stderr, "%-14s %-9s %5s %14.1f ns/op  (%lld ops)\n", results[i].name.c_str(),
+                        results[i].lines.c_str(), sizeLabel(bytes).c_str(), results[i].nsPerOp, results[i].ops);
+            }
+        }
+    }
+
+    FILE *out = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "editorbench: cannot write %s\n", outPath.c_str());
+        return 2;
+    }
+    writeJson(out, results);
+    if (out != stdout) fclose(out);
+
+    if (baselinePath.empty()) return 0;
+    std::map<std::string, double> baseline;
+    if (!readBaseline(baselinePath, baseline)) {
+        fprintf(stderr, "editorbench: no baseline at %s\n", baselinePath.c_str());
+        return 2;
+    }
+
+    int regressions = 0;
+    fprintf(stderr, "\n%-14s %-9s %5s %14s %14s %8s\n", "benchmark", "lines", "size", "baseline ns", "now ns", "change");
+    for (const Result &result : results) {
+        auto found = baseline.find(resultKey(result.name, result.lines, result.bytes));
+        if (found == baseline.end() || found->second <= 0) continue;
+        double change = (result.nsPerOp / found->second - 1) * 100;
+        bool slower = change > threshold;
+        if (slower) regressions++;
+        fprintf(stderr, "%-14s %-9s %5s %14.1f %14.1f %+7.1f%%%s\n", result.name.c_str(), result.lines.c_str(),
+                sizeLabel(result.bytes).c_str(), found->second, result.nsPerOp, change, slower ? "  SLOWER" : "");
+    }
+    fprintf(stderr, "%d regression%s over %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    return failOnRegression && regressions ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+// Replays an edit trace (recorded with LEDITOR_TRACE=FILE) against the
+// editing core, as fast as it will go, and reports how long each kind of
+// operation took and how much memory the replay needed.
+//
+//   trace-replay TRACE [DOCUMENT] [--json FILE]
+//
+// DOCUMENT is the file the session started from. Without it each Load in
+// the trace becomes a generated document with the same number of lines.
+// Positions are clamped to the document, so a trace still replays when
+// the text differs from the one it was recorded on.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "edittrace.h"
+#include "textbuffer.h"
+#include "textcodec.h"
+#include "columncache.h"
+
+static const char *OP_NAMES[] = {"load", "insert", "deleteBackward", "newline", "move", "undo", "redo"};
+static const int OP_COUNT = 7;
+
+static long peakMemoryKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()));
+    return sorted[index];
+}
+
+// The buffer operations the front ends run for each traced edit
+class Replayer {
+public:
+    explicit Replayer(const std::string &document) : documentPath(document), run(TraceOp::Load) {}
+
+    void apply(const TraceEvent &event) {
+        if (event.op == TraceOp::Load) {
+            load(event.position.line);
+            return;
+        }
+
+        // Typing and deleting in a row are one undo step, as in the editor
+        TextPosition at = clamp(event.position);
+        bool continues = event.op == run && (run == TraceOp::Insert || run == TraceOp::DeleteBackward);
+        if (!continues) buffer.closeUndoStep(at);
+        buffer.beginUndoStep(at);
+        run = event.op;
+
+        switch (event.op) {
+            case TraceOp::Insert: {
+                size_t start = 0;
+                while (true) {
+                    size_t end = event.text.find('\n', start);
+                    std::string_view part = std::string_view(event.text).substr(start, end - start);
+                    buffer.insertText(at.line, at.column, part);
+                    at.column += (int)part.size();
+                    if (end == std::string::npos) break;
+                    buffer.splitLine(at.line, at.column);
+                    at = {at.line + 1, 0};
+                    start = end + 1;
+                }
+                break;
+            }
+            case TraceOp::DeleteBackward:
+                if (at.column > 0) {
+                    int start = columns.previousOffset(buffer, at.line, at.column);
+                    buffer.eraseText(at.line, start, at.column - start);
+                } else if (at.line > 0) {
+                    buffer.joinLines(at.line - 1);
+                }
+                break;
+            case TraceOp::Newline:
+                buffer.splitLine(at.line, at.column);
+                break;
+            case TraceOp::Move:
+                // What landing on a position costs: its display column
+                columns.column(buffer, at.line, at.column);
+                break;
+            case TraceOp::Undo:
+                buffer.undo(at);
+                break;
+            case TraceOp::Redo:
+                buffer.redo(at);
+                break;
+            case TraceOp::Load:
+                break;
+        }
+    }
+
+    int lineCount() const { return buffer.lineCount(); }
+
+private:
+    void load(int lineCount) {
+        LineArena lines;
+        FileFormat format;
+        if (documentPath.empty() || !readTextFile(documentPath, lines, format)) {
+            lines = LineArena();
+            for (int i = 0; i < std::max(lineCount, 1); i++) lines.append(std::string(60, 'x'));
+        }
+        buffer.setLines(std::move(lines));
+        run = TraceOp::Load;
+    }
+
+    TextPosition clamp(TextPosition position) const {
+        int line = std::clamp(position.line, 0, buffer.lineCount() - 1);
+        return {line, std::clamp(position.column, 0, buffer.lineLength(line))};
+    }
+
+    std::string documentPath;
+    TextBuffer buffer;
+    ColumnCache columns;
+    TraceOp run;
+};
+
+int main(int argc, char *argv[]) {
+    std::string tracePath, documentPath, jsonPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (tracePath.empty()) {
+            tracePath = arg;
+        } else if (documentPath.empty()) {
+            documentPath = arg;
+        } else {
+            tracePath.clear();
+            break;
+        }
+    }
+    if (tracePath.empty()) {
+        fprintf(stderr, "usage: trace-replay TRACE [DOCUMENT] [--json FILE]\n");
+        return 2;
+    }
+
+    EditTraceReader reader(tracePath);
+    if (!reader.isOpen()) {
+        fprintf(stderr, "trace-replay: %s is not an edit trace\n", tracePath.c_str());
+        return 1;
+    }
+
+    Replayer replayer(documentPath);
+    std::vector<double> latencies[OP_COUNT];
+    TraceEvent event;
+    uint64_t sessionTime = 0;
+    long startMemory = peakMemoryKB();
+    while (reader.next(event)) {
+        auto start = std::chrono::steady_clock::now();
+        replayer.apply(event);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        latencies[(int)event.op].push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        sessionTime = event.time;
+    }
+    long endMemory = peakMemoryKB();
+
+    FILE *json = jsonPath.empty() ? nullptr : fopen(jsonPath.c_str(), "w");
+    if (json) fprintf(json, "{\n  \"peak_memory_kb\": %ld,\n  \"operations\": [\n", endMemory);
+
+    printf("%-15s %9s %11s %11s %11s %11s\n", "operation", "count", "p50 us", "p99 us", "p99.9 us", "max us");
+    bool first = true;
+    for (int op = 0; op < OP_COUNT; op++) {
+        std::vector<double> &sorted = latencies[op];
+        if (sorted.empty()) continue;
+        std::sort(sorted.begin(), sorted.end());
+        double p50 = percentile(sorted, 0.5), p99 = percentile(sorted, 0.99), p999 = percentile(sorted, 0.999);
+        printf("%-15s %9zu %11.2f %11.2f %11.2f %11.2f\n", OP_NAMES[op], sorted.size(), p50, p99, p999, sorted.back());
+        if (json) {
+            fprintf(json, "%s    {\"name\": \"%s\", \"count\": %zu, \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"max_us\": %.2f}",
+                    first ? "" : ",\n", OP_NAMES[op], sorted.size(), p50, p99, p999, sorted.back());
+            first = false;
+        }
+    }
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+
+    printf("\nsession %.1f s, %d lines at the end\n", sessionTime / 1e6, replayer.lineCount());
+    printf("peak memory %.1f MB (%.1f MB before replay)\n", endMemory / 1024.0, startMemory / 1024.0);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include "clipmimedata.h"
+
+static const QString PLAIN_TEXT = QStringLiteral("text/plain");
+
+ClipMimeData::ClipMimeData(const TextClip &clip)
+    : clip(clip)
+{
+}
+
+QStringList ClipMimeData::formats() const
+{
+    return {PLAIN_TEXT};
+}
+
+bool ClipMimeData::hasFormat(const QString &mimeType) const
+{
+    return mimeType == PLAIN_TEXT;
+}
+
+QVariant ClipMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    Q_UNUSED(type);
+    if (mimeType != PLAIN_TEXT) return QVariant();
+    return QString::fromStdString(clip.toString());
+}
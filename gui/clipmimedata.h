@@ -0,0 +1,29 @@
+#ifndef CLIPMIMEDATA_H
+#define CLIPMIMEDATA_H
+
+#include <QMimeData>
+#include "textclip.h"
+
+// Clipboard data backed by a TextClip that shares its lines with the
+// buffer. The text is only built if another application asks for it;
+// pasting back into the editor takes the clip as it is.
+class ClipMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit ClipMimeData(const TextClip &clip);
+
+    const TextClip &textClip() const { return clip; }
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+private:
+    TextClip clip;
+};
+
+#endif // CLIPMIMEDATA_H
@@ -0,0 +1,76 @@
+# The shared editing core, for every Qt target
+INCLUDEPATH += $$PWD/../src
+
+SOURCES += \
+    $$PWD/../src/textbuffer.cpp \
+    $$PWD/../src/linearena.cpp \
+    $$PWD/../src/search.cpp \
+    $$PWD/../src/regex.cpp \
+    $$PWD/../src/regexsearch.cpp \
+    $$PWD/../src/threadpool.cpp \
+    $$PWD/../src/dirreader.cpp \
+    $$PWD/../src/ignorerules.cpp \
+    $$PWD/../src/workspacesearch.cpp \
+    $$PWD/../src/workspacewalker.cpp \
+    $$PWD/../src/filewatcher.cpp \
+    $$PWD/../src/pathindex.cpp \
+    $$PWD/../src/trigramindex.cpp \
+    $$PWD/../src/workspaceindex.cpp \
+    $$PWD/../src/filetree.cpp \
+    $$PWD/../src/linediff.cpp \
+    $$PWD/../src/filereloader.cpp \
+    $$PWD/../src/documentwatcher.cpp \
+    $$PWD/../src/highlighter.cpp \
+    $$PWD/../src/highlightjob.cpp \
+    $$PWD/../src/bracketindex.cpp \
+    $$PWD/../src/foldset.cpp \
+    $$PWD/../src/wraplayout.cpp \
+    $$PWD/../src/utf8.cpp \
+    $$PWD/../src/columncache.cpp \
+    $$PWD/../src/textcodec.cpp \
+    $$PWD/../src/cursorset.cpp \
+    $$PWD/../src/textclip.cpp \
+    $$PWD/../src/replaceall.cpp \
+    $$PWD/../src/macroreplay.cpp \
+    $$PWD/../src/edittrace.cpp \
+    $$PWD/../src/perfstats.cpp \
+    $$PWD/../src/traceevents.cpp \
+    $$PWD/../src/memorybudget.cpp \
+    $$PWD/../src/blockcodec.cpp
+
+HEADERS += \
+    $$PWD/../src/textbuffer.h \
+    $$PWD/../src/linearena.h \
+    $$PWD/../src/search.h \
+    $$PWD/../src/regex.h \
+    $$PWD/../src/regexsearch.h \
+    $$PWD/../src/threadpool.h \
+    $$PWD/../src/dirreader.h \
+    $$PWD/../src/ignorerules.h \
+    $$PWD/../src/workspacesearch.h \
+    $$PWD/../src/workspacewalker.h \
+    $$PWD/../src/filewatcher.h \
+    $$PWD/../src/pathindex.h \
+    $$PWD/../src/trigramindex.h \
+    $$PWD/../src/workspaceindex.h \
+    $$PWD/../src/filetree.h \
+    $$PWD/../src/linediff.h \
+    $$PWD/../src/filereloader.h \
+    $$PWD/../src/documentwatcher.h \
+    $$PWD/../src/highlighter.h \
+    $$PWD/../src/highlightjob.h \
+    $$PWD/../src/bracketindex.h \
+    $$PWD/../src/foldset.h \
+    $$PWD/../src/wraplayout.h \
+    $$PWD/../src/utf8.h \
+    $$PWD/../src/columncache.h \
+    $$PWD/../src/textcodec.h \
+    $$PWD/../src/cursorset.h \
+    $$PWD/../src/textclip.h \
+    $$PWD/../src/replaceall.h \
+    $$PWD/../src/macroreplay.h \
+    $$PWD/../src/edittrace.h \
+    $$PWD/../src/perfstats.h \
+    $$PWD/../src/traceevents.h \
+    $$PWD/../src/memorybudget.h \
+    $$PWD/../src/blockcodec.h
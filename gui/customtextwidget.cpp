@@ -1,24 +1,87 @@
 #include "customtextwidget.h"
 #include <QPaintEvent>
 #include <QApplication>
+#include <QClipboard>
 #include <QTextStream>
+#include <QInputDialog>
+#include <QDateTime>
+#include <QMessageBox>
 #include <algorithm>
+#include "regex.h"
+#include "clipmimedata.h"
+#include "traceevents.h"
+
+static QString toQString(std::string_view text)
+{
+    return QString::fromUtf8(text.data(), (int)text.size());
+}
+
+// Lines a paint may lex itself; anything more goes to a background job
+static const int PAINT_LEX_LINES = 2000;
+static const int HIGHLIGHT_IDLE_MS = 30;
+// Stands for "measure again" in measuredVersion
+static const quint64 UNMEASURED = ~quint64(0);
+// Compression done in one idle slice, a few tens of milliseconds
+static const size_t IDLE_COMPRESS_BYTES = 8 << 20;
+// Long lines wrapped exactly per idle slice once the screen is done
+static const int WRAP_MEASURE_LINES = 5000;
+// Bigger copies go on the clipboard as a clip, turned into text only if
+// another application pastes it
+static const size_t LAZY_CLIPBOARD_BYTES = 1 << 20;
+
+static QColor styleColor(TokenStyle style)
+{
+    switch (style) {
+        case TokenStyle::Keyword: return QColor("#569cd6");
+        case TokenStyle::Type: return QColor("#4ec9b0");
+        case TokenStyle::String: return QColor("#ce9178");
+        case TokenStyle::Number: return QColor("#b5cea8");
+        case TokenStyle::Comment: return QColor("#6a9955");
+        case TokenStyle::Preprocessor: return QColor("#c586c0");
+        default: return Qt::white;
+    }
+}
+
+bool CustomTextWidget::perfOverlayShown = false;
 
 CustomTextWidget::CustomTextWidget(QWidget *parent)
     : QWidget(parent)
     , cursorX(0)
     , cursorY(0)
+    , searchOriginX(0)
+    , searchOriginY(0)
+    , regexMode(false)
+    , regexCaseSensitive(false)
+    , regexFinished(true)
+    , regexStale(false)
+    , regexJumpPending(false)
+    , regexGeneration(0)
+    , replaceCaseSensitive(false)
+    , replaceGeneration(0)
+    , editRun(EditRun::None)
+    , recordingMacro(false)
+    , replayingMacro(false)
+    , trace(EditTraceWriter::fromEnvironment())
+    , keyPending(false)
+    , measuredVersion(UNMEASURED)
+    , unloaded(false)
+    , reloadWarned(false)
+    , unloadedX(0)
+    , unloadedY(0)
+    , unloadedScroll(0.0f)
+    , lastUsedTime(QDateTime::currentMSecsSinceEpoch())
     , isDirty(false)
+    , highlightGeneration(0)
+    , highlightScheduledVersion(0)
+    , highlightViewportFirst(0)
+    , highlightViewportLast(0)
     , textFont("Monaco", 12)
     , fontMetrics(nullptr)
-    , scrollOffsetX(0)
     , scrollOffsetY(0.0f)
     , targetScrollY(0.0f)
     , cursorVisible(true)
 {
 
-    buffer.push_back("");
-
     textFont.setFixedPitch(true);
     setFont(textFont);
     updateFontMetrics();
@@ -27,6 +90,20 @@ CustomTextWidget::CustomTextWidget(QWidget *parent)
     connect(cursorTimer, &QTimer::timeout, this, &CustomTextWidget::blinkCursor);
     cursorTimer->start(500);
 
+    highlightTimer = new QTimer(this);
+    highlightTimer->setSingleShot(true);
+    highlightTimer->setInterval(HIGHLIGHT_IDLE_MS);
+    connect(highlightTimer, &QTimer::timeout, this, &CustomTextWidget::startHighlightJob);
+
+    replaceTimer = new QTimer(this);
+    replaceTimer->setInterval(50);
+    connect(replaceTimer, &QTimer::timeout, this, &CustomTextWidget::reportReplaceProgress);
+
+    wrapTimer = new QTimer(this);
+    wrapTimer->setSingleShot(true);
+    wrapTimer->setInterval(0);
+    connect(wrapTimer, &QTimer::timeout, this, &CustomTextWidget::measureWrapping);
+
     scrollAnimation = new QPropertyAnimation(this, "scrollOffsetY");
     scrollAnimation->setDuration(200); 
     scrollAnimation->setEasingCurve(QEasingCurve::OutQuad); 
@@ -52,23 +129,46 @@ void CustomTextWidget::updateFontMetrics()
 
 void CustomTextWidget::loadText(const QString &text)
 {
-    buffer.clear();
+    TRACE_SCOPE("loadText");
+    LineArena lines;
     QTextStream stream(const_cast<QString*>(&text));
 
     while (!stream.atEnd()) {
         QString line = stream.readLine();
-        buffer.push_back(line.toStdString());
+        lines.append(line.toStdString());
     }
+    resetLines(std::move(lines));
+}
 
-    if (buffer.empty()) {
-        buffer.push_back("");
-    }
+bool CustomTextWidget::loadFile(const QString &filePath)
+{
+    TRACE_SCOPE("openFile");
+    LineArena lines;
+    if (!readTextFile(filePath.toStdString(), lines, format)) return false;
+    resetLines(std::move(lines));
+    return true;
+}
+
+bool CustomTextWidget::saveFile(const QString &filePath)
+{
+    TRACE_SCOPE("saveFile");
+    // An unloaded tab that could not be read back has no text to write
+    if (!ensureLoaded()) return false;
+    return writeTextFile(filePath.toStdString(), buffer, format);
+}
+
+void CustomTextWidget::resetLines(LineArena lines)
+{
+    buffer.setLines(std::move(lines));
+    if (trace) trace->record(TraceOp::Load, {buffer.lineCount(), 0});
+    cursors.reset({0, 0});
+    invalidateSearch();
+    cancelReplace();
 
     cursorX = 0;
     cursorY = 0;
     scrollOffsetY = 0.0f;
     targetScrollY = 0.0f;
-    scrollOffsetX = 0;
     isDirty = false;
 
     update();
@@ -78,9 +178,9 @@ void CustomTextWidget::loadText(const QString &text)
 QString CustomTextWidget::getText() const
 {
     QString result;
-    for (size_t i = 0; i < buffer.size(); ++i) {
-        result += QString::fromStdString(buffer[i]);
-        if (i < buffer.size() - 1) {
+    for (int i = 0; i < buffer.lineCount(); ++i) {
+        result += toQString(buffer.line(i));
+        if (i < buffer.lineCount() - 1) {
             result += '\n';
         }
     }
@@ -90,12 +190,13 @@ QString CustomTextWidget::getText() const
 void CustomTextWidget::clear()
 {
     buffer.clear();
-    buffer.push_back("");
+    cursors.reset({0, 0});
+    invalidateSearch();
+    cancelReplace();
     cursorX = 0;
     cursorY = 0;
     scrollOffsetY = 0.0f;
     targetScrollY = 0.0f;
-    scrollOffsetX = 0;
     isDirty = false;
     update();
     emitSignals();
@@ -103,32 +204,164 @@ void CustomTextWidget::clear()
 
 void CustomTextWidget::paintEvent(QPaintEvent *event)
 {
+    TRACE_SCOPE("paintEvent");
+    QElapsedTimer frameTimer;
+    frameTimer.start();
     QPainter painter(this);
     painter.setFont(textFont);
 
     painter.fillRect(rect(), Qt::black);
 
-    int startLine = std::max(0, (int)scrollOffsetY);
-    int endLine = std::min((int)buffer.size(), (int)scrollOffsetY + height() / lineHeight + 1);
+    // Wrap the lines on screen exactly before placing anything
+    syncLayout();
+    int screenRows = height() / lineHeight + 1;
+    int startRow = std::max(0, (int)scrollOffsetY);
+    int subRow = 0;
+    int startLine = layout.rowToLine(startRow, &subRow);
+    layout.measure(buffer, startLine, layout.rowToLine(startRow + screenRows));
+    startLine = layout.rowToLine(startRow, &subRow);
+    int endRow = std::min(layout.rowCount(), startRow + screenRows);
+    int endLine = endRow > startRow ? layout.rowToLine(endRow - 1) + 1 : startLine;
+
+    const std::vector<SearchMatch> &matches = search.matches();
+    bool highlightMatches = !regexMode && !search.query().empty() && !search.isStale();
+    bool highlightRegex = regexMode && !regexStale;
+    int queryLength = (int)search.query().size();
+    auto regexIt = std::lower_bound(regexMatches.begin(), regexMatches.end(), startLine,
+                                    [](const RegexMatch &m, int line) { return m.line < line; });
+
+    // Never stall on a big file: lex a little here, leave the rest to the worker
+    highlighter.prepare(buffer, endLine - 1, PAINT_LEX_LINES);
+    scheduleHighlighting(startLine, endLine - 1);
+
+    // Bracket at or just before the cursor and its partner get a box
+    std::vector<BracketPosition> bracketBoxes;
+    std::string_view cursorText = buffer.line(cursorY);
+    for (int x : {cursorX, cursorX - 1}) {
+        BracketPosition match;
+        if (x >= 0 && x < (int)cursorText.size() && BracketIndex::bracketKind(cursorText[x]) >= 0 &&
+            brackets.findMatch(buffer, cursorY, x, match)) {
+            bracketBoxes = {{cursorY, x}, match};
+            break;
+        }
+    }
 
-    for (int i = startLine; i < endLine; ++i) {
-        int y = (int)((i - scrollOffsetY) * lineHeight) + fontMetrics->ascent() + 5;
+    // Each row shows one wrapped segment; lines hidden by folds are skipped
+    int i = startLine;
+    if (i < buffer.lineCount()) {
+        WrapLayout::wrapLine(buffer.line(i), layout.width(), wrapStarts);
+    }
+    for (int row = startRow; row < endRow; ++row) {
+        int y = (int)((row - scrollOffsetY) * lineHeight) + fontMetrics->ascent() + 5;
 
         if (y > height()) break;
 
-        QString line = QString::fromStdString(buffer[i]);
-        painter.setPen(Qt::white);
-        painter.drawText(5 - scrollOffsetX, y, line);
+        std::string_view text = buffer.line(i);
+        bool lastRow = subRow + 1 >= (int)wrapStarts.size();
+        int first = wrapStarts[subRow];
+        int end = lastRow ? (int)text.size() : wrapStarts[subRow + 1];
+
+        auto columnX = [&](int column) {
+            return 5 + fontMetrics->horizontalAdvance(toQString(text.substr(first, column - first)));
+        };
+        auto highlightRange = [&](int column, int length) {
+            if (column + length < first || column > end) return;
+            int startX = columnX(std::max(column, first));
+            int endX = columnX(std::min(column + length, end));
+            bool current = i == cursorY && column == cursorX;
+            painter.fillRect(startX, y - fontMetrics->ascent(), endX - startX, lineHeight,
+                             current ? QColor("#9e6a03") : QColor("#613214"));
+        };
+
+        // Selections behind the text, and a caret for each extra cursor
+        if (cursors.isActive()) {
+            const std::vector<Selection> &selections = cursors.selections();
+            for (size_t s = cursors.firstOnLine(i); s < selections.size() && selections[s].start().line <= i; ++s) {
+                const Selection &selection = selections[s];
+                int from = std::max(selection.start().line < i ? 0 : selection.start().column, first);
+                int to = std::min(selection.end().line > i ? (int)text.size() : selection.end().column, end);
+                if (from < to) {
+                    int startX = columnX(from);
+                    painter.fillRect(startX, y - fontMetrics->ascent(), columnX(to) - startX, lineHeight,
+                                     QColor("#264f78"));
+                }
+                const TextPosition &head = selection.head;
+                bool onRow = head.line == i && head.column >= first && (head.column < end || lastRow);
+                if (onRow && !(head.line == cursorY && head.column == cursorX)) {
+                    int caretX = columnX(head.column);
+                    painter.fillRect(caretX, y - fontMetrics->ascent(), 2, lineHeight - 2, QColor("#c0c0c0"));
+                }
+            }
+        }
+
+        if (highlightMatches) {
+            for (size_t m = search.firstMatchFrom(i); m < matches.size() && matches[m].line == i; ++m) {
+                highlightRange(matches[m].column, queryLength);
+            }
+        }
+        if (highlightRegex) {
+            while (regexIt != regexMatches.end() && regexIt->line < i) ++regexIt;
+            for (auto it = regexIt; it != regexMatches.end() && it->line == i; ++it) {
+                highlightRange(it->column, it->length);
+            }
+        }
+
+        // Plain text between the highlighter's runs, each run in its color
+        int x = 5;
+        int column = first;
+        auto drawSegment = [&](int stop, const QColor &color) {
+            stop = std::min(stop, end);
+            if (stop <= column) return;
+            QString segment = toQString(text.substr(column, stop - column));
+            painter.setPen(color);
+            painter.drawText(x, y, segment);
+            x += fontMetrics->horizontalAdvance(segment);
+            column = stop;
+        };
+        for (const StyleRun &run : highlighter.cachedStyles(i)) {
+            if (run.start + run.length <= first) continue;
+            drawSegment(run.start, Qt::white);
+            drawSegment(run.start + run.length, styleColor(run.style));
+        }
+        drawSegment(end, Qt::white);
+
+        if (lastRow && folds.isHeader(i)) {
+            QString marker = QStringLiteral(" ... ");
+            int markerX = x + charWidth;
+            painter.fillRect(markerX, y - fontMetrics->ascent(), fontMetrics->horizontalAdvance(marker),
+                             lineHeight, QColor("#3a3d41"));
+            painter.setPen(QColor("#a0a0a0"));
+            painter.drawText(markerX, y, marker);
+        }
+
+        for (const BracketPosition &position : bracketBoxes) {
+            if (position.line != i || position.column < first || position.column >= end) continue;
+            int startX = columnX(position.column);
+            int endX = columnX(position.column + 1);
+            painter.setPen(QColor("#888888"));
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(startX, y - fontMetrics->ascent(), endX - startX - 1, lineHeight - 1);
+        }
+
+        // Next row: the rest of this line, or the next line not folded away
+        if (lastRow) {
+            i = folds.visibleLine(i + 1, 1);
+            subRow = 0;
+            if (i < buffer.lineCount()) {
+                WrapLayout::wrapLine(buffer.line(i), layout.width(), wrapStarts);
+            }
+        } else {
+            ++subRow;
+        }
     }
 
     if (hasFocus() && cursorVisible) {
 
-        int cursorScreenX = 5 - scrollOffsetX;
-        if (cursorY < (int)buffer.size() && cursorX > 0) {
-            QString lineUpToCursor = QString::fromStdString(buffer[cursorY].substr(0, cursorX));
-            cursorScreenX += fontMetrics->horizontalAdvance(lineUpToCursor);
-        }
-        int cursorScreenY = (int)((cursorY - scrollOffsetY) * lineHeight) + 5;
+        int segmentStart = 0;
+        int cursorRow = layout.lineToRow(cursorY) + cursorSubRow(segmentStart);
+        int cursorScreenX = 5 + fontMetrics->horizontalAdvance(
+                                    toQString(buffer.line(cursorY).substr(segmentStart, cursorX - segmentStart)));
+        int cursorScreenY = (int)((cursorRow - scrollOffsetY) * lineHeight) + 5;
 
         if (cursorScreenX >= 0 && cursorScreenX < width() && 
             cursorScreenY >= 0 && cursorScreenY < height()) {
@@ -137,25 +370,145 @@ void CustomTextWidget::paintEvent(QPaintEvent *event)
                            cursorScreenX, cursorScreenY + lineHeight - 2);
         }
     }
+
+    if (perfOverlayShown) paintPerfOverlay(painter);
+    perf.recordFrame(frameTimer.nsecsElapsed() / 1000);
+    if (keyPending) perf.recordKeyToPaint(keyTimer.nsecsElapsed() / 1000);
+    keyPending = false;
+}
+
+void CustomTextWidget::paintPerfOverlay(QPainter &painter)
+{
+    QStringList rows = {
+        tr("frame %1").arg(QString::fromStdString(PerfStats::formatMicros(perf.lastFrame()))),
+        tr("key to paint p99 %1").arg(QString::fromStdString(PerfStats::formatMicros(perf.keysToPaint().percentile(0.99)))),
+        tr("last edit %1").arg(QString::fromStdString(PerfStats::formatMicros(perf.lastEdit()))),
+        tr("memory %1").arg(QString::fromStdString(PerfStats::formatBytes(perf.bufferMemory(buffer)))),
+        tr("%1 lines").arg(buffer.lineCount()),
+    };
+    int boxWidth = 0;
+    for (const QString &row : rows) boxWidth = std::max(boxWidth, fontMetrics->horizontalAdvance(row));
+    QRect box(width() - boxWidth - 24, 8, boxWidth + 16, (int)rows.size() * lineHeight + 8);
+    painter.fillRect(box, QColor(0, 0, 0, 200));
+    painter.setPen(QColor(120, 220, 120));
+    for (int i = 0; i < rows.size(); i++) {
+        painter.drawText(box.left() + 8, box.top() + 4 + i * lineHeight + fontMetrics->ascent(), rows[i]);
+    }
 }
 
 void CustomTextWidget::keyPressEvent(QKeyEvent *event)
 {
+    TRACE_SCOPE("keyPressEvent");
+    if (!ensureLoaded()) return;
+    lastUsedTime = QDateTime::currentMSecsSinceEpoch();
+    keyTimer.start();
+    keyPending = true;
+    uint64_t version = buffer.version();
+    handleKey(event);
+    if (buffer.version() != version) perf.recordEdit(keyTimer.nsecsElapsed() / 1000);
+}
+
+void CustomTextWidget::handleKey(QKeyEvent *event)
+{
+    // Ctrl+Shift+R starts and stops recording a macro, Ctrl+Shift+E plays it
+    bool control = event->modifiers() & (Qt::ControlModifier | Qt::MetaModifier);
+    if (control && (event->modifiers() & Qt::ShiftModifier) && !replayingMacro) {
+        if (event->key() == Qt::Key_R) {
+            toggleMacroRecording();
+            return;
+        }
+        if (event->key() == Qt::Key_E) {
+            playMacro();
+            return;
+        }
+    }
+    if (recordingMacro) macroKeys.push_back({event->key(), event->modifiers(), event->text()});
+
+    // Typing and deleting in a row stay one undo step; any other key ends
+    // it. A macro replay is one step of its own.
+    if (!replayingMacro) {
+        EditRun run = EditRun::None;
+        if (event->key() == Qt::Key_Backspace) {
+            run = EditRun::Deleting;
+        } else if (!control && !event->text().isEmpty() && event->text()[0].isPrint()) {
+            run = EditRun::Typing;
+        }
+        if (run == EditRun::None || run != editRun) buffer.closeUndoStep({cursorY, cursorX});
+        buffer.beginUndoStep({cursorY, cursorX});
+        editRun = run;
+    }
+
+    if (event->matches(QKeySequence::Undo) || event->matches(QKeySequence::Redo)) {
+        undoEdit(event->matches(QKeySequence::Redo));
+        ensureCursorVisible();
+        update();
+        return;
+    }
+    // Ctrl+Shift+[ / Ctrl+Shift+] fold and unfold the block at the cursor
+    if ((event->modifiers() & Qt::ControlModifier) && (event->modifiers() & Qt::ShiftModifier)) {
+        int key = event->key();
+        if (key == Qt::Key_BracketLeft || key == Qt::Key_BraceLeft) {
+            foldAtCursor();
+            return;
+        }
+        if (key == Qt::Key_BracketRight || key == Qt::Key_BraceRight) {
+            unfoldAtCursor();
+            return;
+        }
+        // Ctrl+Shift+L puts a cursor on every occurrence
+        if (key == Qt::Key_L) {
+            selectAllOccurrences();
+            return;
+        }
+    }
+
+    if (event->matches(QKeySequence::Copy) || event->matches(QKeySequence::Cut)) {
+        copySelection(event->matches(QKeySequence::Cut));
+        ensureCursorVisible();
+        update();
+        return;
+    }
+    if (event->matches(QKeySequence::Paste)) {
+        paste();
+        ensureCursorVisible();
+        update();
+        return;
+    }
+    if (event->matches(QKeySequence::SelectAll)) {
+        selectAll();
+        update();
+        return;
+    }
+
+    // Ctrl+D selects the word, then adds a cursor on its next occurrence
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_D) {
+        addNextOccurrence();
+        return;
+    }
+    if (event->key() == Qt::Key_Escape && cursors.isActive()) {
+        cursors.reset({cursorY, cursorX});
+        update();
+        return;
+    }
+
+    // Shift+arrows select
+    bool extend = event->modifiers() & Qt::ShiftModifier;
+
     switch (event->key()) {
         case Qt::Key_Left:
-            moveCursor(-1, 0);
+            moveCursor(-1, 0, extend);
             break;
 
         case Qt::Key_Right:
-            moveCursor(1, 0);
+            moveCursor(1, 0, extend);
             break;
 
         case Qt::Key_Up:
-            moveCursor(0, -1);
+            moveCursor(0, -1, extend);
             break;
 
         case Qt::Key_Down:
-            moveCursor(0, 1);
+            moveCursor(0, 1, extend);
             break;
 
         case Qt::Key_Backspace:
@@ -167,14 +520,16 @@ void CustomTextWidget::keyPressEvent(QKeyEvent *event)
             insertNewline();
             break;
 
-        default:
-            if (!event->text().isEmpty()) {
-                char c = event->text().at(0).toLatin1();
-                if (c >= 32 && c < 127) { 
-                    insertChar(c);
-                }
+        default: {
+            // Any printable text, including composed and non-Latin input
+            QString text = event->text();
+            bool printable = !text.isEmpty() &&
+                             std::all_of(text.begin(), text.end(), [](QChar ch) { return ch.isPrint() || ch.isSurrogate(); });
+            if (printable) {
+                insertText(text.toStdString());
             }
             break;
+        }
     }
 
     ensureCursorVisible();
@@ -183,38 +538,25 @@ void CustomTextWidget::keyPressEvent(QKeyEvent *event)
 
 void CustomTextWidget::mousePressEvent(QMouseEvent *event)
 {
+    if (!ensureLoaded()) return;
+    lastUsedTime = QDateTime::currentMSecsSinceEpoch();
     if (event->button() == Qt::LeftButton) {
-
-        int clickX = event->pos().x() + scrollOffsetX - 5;
-        int clickY = (int)((event->pos().y() + scrollOffsetY * lineHeight - 5) / lineHeight);
-
-        cursorY = std::max(0, std::min(clickY, (int)buffer.size() - 1));
-
-        if (cursorY < (int)buffer.size()) {
-            cursorX = 0;
-            QString line = QString::fromStdString(buffer[cursorY]);
-
-            for (int i = 0; i <= line.length(); ++i) {
-                QString lineUpToPos = line.left(i);
-                int textWidth = fontMetrics->horizontalAdvance(lineUpToPos);
-
-                if (textWidth > clickX) {
-
-                    if (i > 0) {
-                        QString lineUpToPrev = line.left(i - 1);
-                        int prevWidth = fontMetrics->horizontalAdvance(lineUpToPrev);
-                        if (clickX - prevWidth < textWidth - clickX) {
-                            cursorX = i - 1;
-                        } else {
-                            cursorX = i;
-                        }
-                    } else {
-                        cursorX = 0;
-                    }
-                    break;
-                }
-                cursorX = i;
-            }
+        buffer.closeUndoStep({cursorY, cursorX});
+        editRun = EditRun::None;
+        TextPosition previous = {cursorY, cursorX};
+        TextPosition clicked = positionAt(event->pos());
+
+        // Alt+click adds a cursor, Shift+click selects up to the click and a
+        // plain click leaves just the one
+        if (event->modifiers() & Qt::AltModifier) {
+            if (!cursors.isActive()) cursors.reset(previous);
+            cursors.add({clicked, clicked});
+            followPrimaryCursor();
+        } else if (event->modifiers() & Qt::ShiftModifier) {
+            extendSelectionTo(clicked);
+        } else {
+            cursors.reset(clicked);
+            followPrimaryCursor();
         }
 
         update();
@@ -223,6 +565,54 @@ void CustomTextWidget::mousePressEvent(QMouseEvent *event)
     setFocus();
 }
 
+void CustomTextWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    // Dragging selects
+    if (event->buttons() & Qt::LeftButton) {
+        extendSelectionTo(positionAt(event->pos()));
+        ensureCursorVisible();
+        update();
+        emitSignals();
+    }
+}
+
+TextPosition CustomTextWidget::positionAt(const QPoint &point)
+{
+    int clickX = point.x() - 5;
+    int clickRow = (int)((point.y() + scrollOffsetY * lineHeight - 5) / lineHeight);
+
+    int subRow = 0;
+    int line = layout.rowToLine(std::max(0, std::min(clickRow, visibleRowCount() - 1)), &subRow);
+    int column = 0;
+
+    if (line < buffer.lineCount()) {
+        // Only the clicked row's segment of a wrapped line is searched
+        std::string_view text = buffer.line(line);
+        WrapLayout::wrapLine(text, layout.width(), wrapStarts);
+        subRow = std::min(subRow, (int)wrapStarts.size() - 1);
+        bool lastRow = subRow + 1 == (int)wrapStarts.size();
+        int first = wrapStarts[subRow];
+        int end = lastRow ? (int)text.size() : columns.previousOffset(buffer, line, wrapStarts[subRow + 1]);
+
+        // Nearest character boundary to the click
+        column = first;
+        int previousWidth = 0;
+        for (int offset = first; offset < end;) {
+            int next = columns.nextOffset(buffer, line, offset);
+            int textWidth = fontMetrics->horizontalAdvance(toQString(text.substr(first, next - first)));
+
+            if (textWidth > clickX) {
+                column = (clickX - previousWidth < textWidth - clickX) ? offset : next;
+                break;
+            }
+            previousWidth = textWidth;
+            column = next;
+            offset = next;
+        }
+    }
+    return {line, column};
+}
+
 void CustomTextWidget::wheelEvent(QWheelEvent *event)
 {
     if (!event->pixelDelta().isNull()) {
@@ -234,7 +624,7 @@ void CustomTextWidget::wheelEvent(QWheelEvent *event)
             float linesDelta = -(float)deltaY / (lineHeight * 0.3f); 
             float targetY = scrollOffsetY + linesDelta;
 
-            float maxScrollY = std::max(0.0f, (float)buffer.size() - (float)height() / lineHeight);
+            float maxScrollY = std::max(0.0f, (float)visibleRowCount() - (float)height() / lineHeight);
             float newScrollY = std::max(0.0f, std::min(targetY, maxScrollY));
 
             setScrollOffsetY(newScrollY);
@@ -257,6 +647,8 @@ void CustomTextWidget::wheelEvent(QWheelEvent *event)
 
 void CustomTextWidget::focusInEvent(QFocusEvent *event)
 {
+    ensureLoaded();
+    lastUsedTime = QDateTime::currentMSecsSinceEpoch();
     cursorTimer->start(500);
     cursorVisible = true;
     update();
@@ -277,97 +669,336 @@ void CustomTextWidget::blinkCursor()
     update();
 }
 
-void CustomTextWidget::insertChar(char c)
+void CustomTextWidget::undoEdit(bool redo)
 {
-    if (cursorY < (int)buffer.size()) {
-        buffer[cursorY].insert(cursorX, 1, c);
-        cursorX++;
+    traceEdit(redo ? TraceOp::Redo : TraceOp::Undo);
+    TextPosition position = {cursorY, cursorX};
+    if (!(redo ? buffer.redo(position) : buffer.undo(position))) return;
+    cursorY = position.line;
+    cursorX = position.column;
+    cursors.reset(position);
+    isDirty = true;
+    invalidateSearch();
+    emitSignals();
+}
+
+// Multiple cursors are traced as the primary one
+void CustomTextWidget::traceEdit(TraceOp op, const std::string &text)
+{
+    if (trace) trace->record(op, {cursorY, cursorX}, text);
+}
+
+void CustomTextWidget::insertText(const std::string &text)
+{
+    traceEdit(TraceOp::Insert, text);
+    if (cursors.isActive()) {
+        // Every cursor types in one batch
+        cursors.insertText(buffer, text);
+        followPrimaryCursor();
+        isDirty = true;
+        invalidateSearch();
+        emitSignals();
+    } else if (cursorY < buffer.lineCount()) {
+        buffer.insertText(cursorY, cursorX, text);
+        cursorX += (int)text.size();
         isDirty = true;
+        invalidateSearch();
         emitSignals();
     }
 }
 
 void CustomTextWidget::deleteChar()
 {
-    if (cursorX > 0 && cursorY < (int)buffer.size()) {
-        buffer[cursorY].erase(cursorX - 1, 1);
-        cursorX--;
+    traceEdit(TraceOp::DeleteBackward);
+    if (cursors.isActive()) {
+        cursors.deleteBackward(buffer);
+        followPrimaryCursor();
         isDirty = true;
+        invalidateSearch();
+        emitSignals();
+    } else if (cursorX > 0 && cursorY < buffer.lineCount()) {
+        // The whole character goes, accents and all
+        int start = columns.previousOffset(buffer, cursorY, cursorX);
+        buffer.eraseText(cursorY, start, cursorX - start);
+        cursorX = start;
+        isDirty = true;
+        invalidateSearch();
         emitSignals();
     } else if (cursorX == 0 && cursorY > 0) {
 
-        cursorX = buffer[cursorY - 1].length();
-        buffer[cursorY - 1] += buffer[cursorY];
-        buffer.erase(buffer.begin() + cursorY);
+        cursorX = buffer.lineLength(cursorY - 1);
+        buffer.joinLines(cursorY - 1);
         cursorY--;
         isDirty = true;
+        invalidateSearch();
         emitSignals();
     }
 }
 
 void CustomTextWidget::insertNewline()
 {
-    if (cursorY < (int)buffer.size()) {
-        std::string currentLine = buffer[cursorY];
-        std::string newLine = currentLine.substr(cursorX);
-        buffer[cursorY] = currentLine.substr(0, cursorX);
-        buffer.insert(buffer.begin() + cursorY + 1, newLine);
+    if (cursors.isActive()) {
+        insertText("\n");
+    } else if (cursorY < buffer.lineCount()) {
+        traceEdit(TraceOp::Newline);
+        buffer.splitLine(cursorY, cursorX);
         cursorY++;
         cursorX = 0;
         isDirty = true;
+        invalidateSearch();
         emitSignals();
     }
 }
 
-void CustomTextWidget::moveCursor(int dx, int dy)
+void CustomTextWidget::moveCursor(int dx, int dy, bool extend)
+{
+    folds.sync(buffer);
+    if (extend && !cursors.isActive()) cursors.reset({cursorY, cursorX});
+    if (extend || cursors.isActive()) {
+        cursors.moveEach([&](TextPosition &position) { movePosition(dx, dy, position); }, extend);
+        followPrimaryCursor();
+    } else {
+        TextPosition position = {cursorY, cursorX};
+        movePosition(dx, dy, position);
+        cursorY = position.line;
+        cursorX = position.column;
+    }
+    traceEdit(TraceOp::Move);
+    emitSignals();
+}
+
+void CustomTextWidget::movePosition(int dx, int dy, TextPosition &position)
 {
+    int &x = position.column;
+    int &y = position.line;
+
+    // Lines hidden in folds are stepped over
+    int previous = y > 0 ? folds.visibleLine(y - 1, -1) : -1;
+    int next = folds.visibleLine(y + 1, 1);
+
     if (dx != 0) {
         if (dx < 0) { 
-            if (cursorX > 0) {
-                cursorX--;
-            } else if (cursorY > 0) {
-                cursorY--;
-                cursorX = buffer[cursorY].length();
+            if (x > 0) {
+                x = columns.previousOffset(buffer, y, x);
+            } else if (previous >= 0) {
+                y = previous;
+                x = buffer.lineLength(y);
             }
         } else { 
-            if (cursorY < (int)buffer.size() && cursorX < (int)buffer[cursorY].length()) {
-                cursorX++;
-            } else if (cursorY < (int)buffer.size() - 1) {
-                cursorY++;
-                cursorX = 0;
+            if (y < buffer.lineCount() && x < buffer.lineLength(y)) {
+                x = columns.nextOffset(buffer, y, x);
+            } else if (next < buffer.lineCount()) {
+                y = next;
+                x = 0;
             }
         }
     }
 
+    // Up and down keep the display column, landing on a whole character
     if (dy != 0) {
-        if (dy < 0 && cursorY > 0) { 
-            cursorY--;
-            cursorX = std::min(cursorX, (int)buffer[cursorY].length());
-        } else if (dy > 0 && cursorY < (int)buffer.size() - 1) { 
-            cursorY++;
-            cursorX = std::min(cursorX, (int)buffer[cursorY].length());
+        int column = columns.column(buffer, y, x);
+        if (dy < 0 && previous >= 0) { 
+            y = previous;
+            x = columns.offsetAt(buffer, y, column);
+        } else if (dy > 0 && next < buffer.lineCount()) { 
+            y = next;
+            x = columns.offsetAt(buffer, y, column);
         }
     }
+}
+
+void CustomTextWidget::addNextOccurrence()
+{
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    cursors.addNextOccurrence(buffer);
+    followPrimaryCursor();
+    ensureCursorVisible();
+    update();
+    emit cursorPositionChanged();
+}
 
+void CustomTextWidget::selectAllOccurrences()
+{
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    cursors.selectAllOccurrences(buffer);
+    followPrimaryCursor();
+    update();
+    emit cursorPositionChanged();
+}
+
+void CustomTextWidget::followPrimaryCursor()
+{
+    cursorY = cursors.primary().head.line;
+    cursorX = cursors.primary().head.column;
+}
+
+void CustomTextWidget::extendSelectionTo(TextPosition position)
+{
+    // The primary selection keeps its anchor; other cursors are dropped
+    TextPosition anchor = cursors.isActive() ? cursors.primary().anchor : TextPosition{cursorY, cursorX};
+    cursors.reset(anchor);
+    cursors.moveEach([&](TextPosition &head) { head = position; }, true);
+    followPrimaryCursor();
+}
+
+void CustomTextWidget::selectAll()
+{
+    int last = buffer.lineCount() - 1;
+    cursors.reset({0, 0});
+    cursors.moveEach([&](TextPosition &head) { head = {last, buffer.lineLength(last)}; }, true);
+    followPrimaryCursor();
     emitSignals();
 }
 
-void CustomTextWidget::ensureCursorVisible()
+void CustomTextWidget::copySelection(bool cut)
 {
+    if (!cursors.hasSelection()) return;
+    TextClip clip = cursors.copySelections(buffer);
+    QClipboard *clipboard = QApplication::clipboard();
+    if (clip.size() < LAZY_CLIPBOARD_BYTES) {
+        clipboard->setText(QString::fromStdString(clip.toString()));
+    } else {
+        clipboard->setMimeData(new ClipMimeData(clip));
+    }
+    if (cut) insertText("");
+}
 
-    int cursorScreenX = 0;
-    if (cursorY < (int)buffer.size() && cursorX > 0) {
-        QString lineUpToCursor = QString::fromStdString(buffer[cursorY].substr(0, cursorX));
-        cursorScreenX = fontMetrics->horizontalAdvance(lineUpToCursor);
+void CustomTextWidget::paste()
+{
+    // Our own clips are spliced in without going through text
+    const QMimeData *data = QApplication::clipboard()->mimeData();
+    const ClipMimeData *own = qobject_cast<const ClipMimeData *>(data);
+    TextClip clip;
+    if (own) {
+        clip = own->textClip();
+    } else if (data && data->hasText()) {
+        QString text = data->text();
+        text.replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+        clip = TextClip::fromText(text.toStdString());
+    } else {
+        return;
     }
 
-    if (cursorScreenX < scrollOffsetX) {
-        scrollOffsetX = cursorScreenX;
-    } else if (cursorScreenX >= scrollOffsetX + width() - 50) {
-        scrollOffsetX = cursorScreenX - width() + 50;
+    if (trace) traceEdit(TraceOp::Insert, clip.toString());
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    cursors.paste(buffer, clip);
+    followPrimaryCursor();
+    isDirty = true;
+    invalidateSearch();
+    emitSignals();
+}
+
+void CustomTextWidget::foldAtCursor()
+{
+    folds.sync(buffer);
+    BracketPosition open, close;
+    if (!brackets.foldableBlock(buffer, cursorY, open, close) || close.line - open.line < 2) return;
+
+    // The brace lines stay, everything between them is hidden
+    folds.fold(open.line + 1, close.line - 1);
+    if (folds.isHidden(cursorY)) {
+        cursorY = open.line;
+        cursorX = std::min(cursorX, buffer.lineLength(cursorY));
     }
+    cursors.reset({cursorY, cursorX});
+    smoothScrollTo(scrollOffsetY);
+    ensureCursorVisible();
+    update();
+    emitSignals();
+}
+
+void CustomTextWidget::unfoldAtCursor()
+{
+    folds.sync(buffer);
+    if (folds.unfold(cursorY)) {
+        update();
+    }
+}
+
+void CustomTextWidget::revealCursor()
+{
+    folds.sync(buffer);
+    while (folds.isHidden(cursorY)) {
+        folds.unfold(cursorY);
+    }
+}
+
+int CustomTextWidget::wrapColumns() const
+{
+    // Leave a column free for the cursor at the end of a full row
+    return std::max(1, (width() - 10) / charWidth - 1);
+}
+
+void CustomTextWidget::syncLayout()
+{
+    revealCursor();
+    layout.sync(buffer, folds);
+
+    int columns = wrapColumns();
+    if (columns != layout.width()) {
+        // Rewrap keeping the top line in view; only it is wrapped exactly
+        // here, paint does the rest of the screen and the timer the file
+        int subRow = 0;
+        float fraction = scrollOffsetY - (int)scrollOffsetY;
+        int topLine = std::min(layout.rowToLine((int)scrollOffsetY, &subRow), buffer.lineCount() - 1);
+        layout.setWidth(columns);
+        layout.sync(buffer, folds);
+        layout.measure(buffer, topLine, topLine);
+        subRow = std::min(subRow, std::max(layout.lineRows(topLine) - 1, 0));
+        scrollOffsetY = layout.lineToRow(topLine) + subRow + fraction;
+        targetScrollY = scrollOffsetY;
+    }
+
+    if (!layout.isExact() && !wrapTimer->isActive()) {
+        wrapTimer->start();
+    }
+}
+
+void CustomTextWidget::measureWrapping()
+{
+    // Rows above the view change as lines are measured; don't fight a scroll
+    if (scrollAnimation->state() == QAbstractAnimation::Running) {
+        wrapTimer->start();
+        return;
+    }
+
+    syncLayout();
+    int subRow = 0;
+    float fraction = scrollOffsetY - (int)scrollOffsetY;
+    int topLine = layout.rowToLine((int)scrollOffsetY, &subRow);
+    bool exact = layout.measureSome(buffer, WRAP_MEASURE_LINES);
+    if (topLine < buffer.lineCount()) {
+        scrollOffsetY = layout.lineToRow(topLine) + subRow + fraction;
+        targetScrollY = scrollOffsetY;
+    }
+    if (!exact) {
+        wrapTimer->start();
+    }
+}
+
+int CustomTextWidget::cursorSubRow(int &segmentStart)
+{
+    std::vector<int> starts;
+    WrapLayout::wrapLine(buffer.line(cursorY), layout.width(), starts);
+    int subRow = (int)(std::upper_bound(starts.begin(), starts.end(), cursorX) - starts.begin()) - 1;
+    segmentStart = starts[subRow];
+    return subRow;
+}
+
+int CustomTextWidget::visibleRowCount()
+{
+    syncLayout();
+    return layout.rowCount();
+}
 
-    float cursorScreenY = cursorY;
+void CustomTextWidget::ensureCursorVisible()
+{
+    if (replayingMacro) return;
+    // Lines are wrapped to the width, so only rows ever need scrolling
+    syncLayout();
+    layout.measure(buffer, cursorY, cursorY);
+    int segmentStart = 0;
+    float cursorScreenY = layout.lineToRow(cursorY) + cursorSubRow(segmentStart);
     float viewportLines = (float)height() / lineHeight;
 
     float targetScrollY = scrollOffsetY;
@@ -397,7 +1028,7 @@ void CustomTextWidget::setScrollOffsetY(float offset)
 void CustomTextWidget::smoothScrollTo(float targetY)
 {
 
-    float maxScrollY = std::max(0.0f, (float)buffer.size() - (float)height() / lineHeight);
+    float maxScrollY = std::max(0.0f, (float)visibleRowCount() - (float)height() / lineHeight);
     targetY = std::max(0.0f, std::min(targetY, maxScrollY));
 
     if (qAbs(targetY - scrollOffsetY) < 0.1f) {
@@ -415,6 +1046,551 @@ void CustomTextWidget::smoothScrollTo(float targetY)
     targetScrollY = targetY;
 }
 
+void CustomTextWidget::beginSearch()
+{
+    searchOriginX = cursorX;
+    searchOriginY = cursorY;
+}
+
+void CustomTextWidget::setSearchQuery(const QString &query, bool caseSensitive, bool regex)
+{
+    if (regex) {
+        search.clear();
+        regexMode = true;
+        regexPattern = query.toStdString();
+        regexCaseSensitive = caseSensitive;
+        startRegexSearch();
+        return;
+    }
+
+    if (regexMode) {
+        regexMode = false;
+        regexJob.reset();
+        regexMatches.clear();
+    }
+
+    search.setQuery(buffer, query.toStdString(), caseSensitive);
+
+    // Jump to the first match at or after where the search started
+    SearchMatch match;
+    if (search.nextMatch(buffer, searchOriginY, searchOriginX - 1, match)) {
+        jumpToMatch(match);
+    } else {
+        update();
+    }
+}
+
+static bool regexMatchBefore(const RegexMatch &m, const SearchMatch &pos)
+{
+    return m.line < pos.line || (m.line == pos.line && m.column < pos.column);
+}
+
+static bool regexMatchAfter(const SearchMatch &pos, const RegexMatch &m)
+{
+    return pos.line < m.line || (pos.line == m.line && pos.column < m.column);
+}
+
+bool CustomTextWidget::findNext()
+{
+    if (regexMode) {
+        if (regexStale) {
+            // Buffer changed since the last run: search again from here
+            searchOriginX = cursorX + 1;
+            searchOriginY = cursorY;
+            startRegexSearch();
+            return true;
+        }
+        auto it = std::upper_bound(regexMatches.begin(), regexMatches.end(), SearchMatch{cursorY, cursorX},
+                                   regexMatchAfter);
+        if (it == regexMatches.end()) {
+            if (!regexFinished || regexMatches.empty()) return false;
+            it = regexMatches.begin();
+        }
+        jumpToMatch({it->line, it->column});
+        return true;
+    }
+
+    if (search.query().empty()) return false;
+
+    search.setQuery(buffer, search.query(), search.isCaseSensitive());
+
+    SearchMatch match;
+    if (!search.nextMatch(buffer, cursorY, cursorX, match)) return false;
+    jumpToMatch(match);
+    return true;
+}
+
+bool CustomTextWidget::findPrevious()
+{
+    if (regexMode) {
+        if (regexStale) {
+            searchOriginX = cursorX;
+            searchOriginY = cursorY;
+            startRegexSearch();
+            return true;
+        }
+        auto it = std::lower_bound(regexMatches.begin(), regexMatches.end(), SearchMatch{cursorY, cursorX},
+                                   regexMatchBefore);
+        if (it == regexMatches.begin()) {
+            if (!regexFinished || regexMatches.empty()) return false;
+            it = regexMatches.end();
+        }
+        --it;
+        jumpToMatch({it->line, it->column});
+        return true;
+    }
+
+    if (search.query().empty()) return false;
+
+    search.setQuery(buffer, search.query(), search.isCaseSensitive());
+
+    SearchMatch match;
+    if (!search.previousMatch(buffer, cursorY, cursorX, match)) return false;
+    jumpToMatch(match);
+    return true;
+}
+
+void CustomTextWidget::clearSearch()
+{
+    search.clear();
+    regexMode = false;
+    regexJob.reset();
+    regexMatches.clear();
+    regexError.clear();
+    update();
+}
+
+int CustomTextWidget::searchMatchCount() const
+{
+    return regexMode ? (int)regexMatches.size() : (int)search.matches().size();
+}
+
+bool CustomTextWidget::isSearchComplete() const
+{
+    return regexMode ? regexFinished : search.isComplete();
+}
+
+void CustomTextWidget::startRegexSearch()
+{
+    // Dropping the old job cancels it; late batches are ignored by generation
+    regexJob.reset();
+    regexMatches.clear();
+    regexError.clear();
+    regexStale = false;
+    regexFinished = true;
+    quint64 generation = ++regexGeneration;
+
+    std::string error;
+    Regex check;
+    if (regexPattern.empty() || !check.compile(regexPattern, regexCaseSensitive, &error)) {
+        regexError = QString::fromStdString(error);
+        update();
+        emit searchResultsChanged();
+        return;
+    }
+
+    regexFinished = false;
+    regexJumpPending = true;
+    auto snapshot = buffer.snapshot();
+    regexJob.reset(new RegexSearchJob(snapshot, regexPattern, regexCaseSensitive,
+        [this, generation](std::vector<RegexMatch> batch, bool finished, const std::string &error) {
+            auto results = std::make_shared<std::vector<RegexMatch>>(std::move(batch));
+            QString message = QString::fromStdString(error);
+            QMetaObject::invokeMethod(this, [this, generation, results, finished, message]() {
+                onRegexBatch(generation, *results, finished, message);
+            }, Qt::QueuedConnection);
+        }));
+}
+
+void CustomTextWidget::onRegexBatch(quint64 generation, const std::vector<RegexMatch> &batch, bool finished,
+                                    const QString &error)
+{
+    if (generation != regexGeneration) return;
+
+    regexError = error;
+    regexMatches.insert(regexMatches.end(), batch.begin(), batch.end());
+    regexFinished = finished;
+    // A finished job lets go of its snapshot, so the text can be compressed
+    if (finished) regexJob.reset();
+
+    // Move to the first hit after the search origin as soon as it arrives
+    if (regexJumpPending && !regexMatches.empty()) {
+        auto it = std::lower_bound(regexMatches.begin(), regexMatches.end(),
+                                   SearchMatch{searchOriginY, searchOriginX}, regexMatchBefore);
+        if (it != regexMatches.end()) {
+            regexJumpPending = false;
+            jumpToMatch({it->line, it->column});
+        } else if (finished) {
+            regexJumpPending = false;
+            jumpToMatch({regexMatches.front().line, regexMatches.front().column});
+        }
+    }
+
+    update();
+    emit searchResultsChanged();
+}
+
+void CustomTextWidget::replaceAll(const QString &query, const QString &replacement, bool caseSensitive)
+{
+    if (query.isEmpty()) return;
+    replaceQuery = query;
+    replaceText = replacement;
+    replaceCaseSensitive = caseSensitive;
+    startReplaceJob();
+}
+
+void CustomTextWidget::cancelReplace()
+{
+    if (!replaceJob) return;
+    replaceJob.reset();
+    ++replaceGeneration;
+    replaceTimer->stop();
+    emit replaceFinished(-1);
+}
+
+void CustomTextWidget::startReplaceJob()
+{
+    // Dropping the old job cancels it; a late result is ignored by generation
+    replaceJob.reset();
+    quint64 generation = ++replaceGeneration;
+    auto snapshot = buffer.snapshot();
+    replaceJob.reset(new ReplaceAllJob(snapshot, replaceQuery.toStdString(), replaceText.toStdString(),
+                                       replaceCaseSensitive,
+        [this, generation](std::vector<LineRewrite> rewrites, size_t replacements) {
+            auto results = std::make_shared<std::vector<LineRewrite>>(std::move(rewrites));
+            QMetaObject::invokeMethod(this, [this, generation, results, replacements]() {
+                onReplaceDone(generation, *results, replacements);
+            }, Qt::QueuedConnection);
+        }));
+    replaceTimer->start();
+    emit replaceProgress(0);
+}
+
+void CustomTextWidget::reportReplaceProgress()
+{
+    if (replaceJob) {
+        emit replaceProgress((int)(replaceJob->progress() * 100));
+    }
+}
+
+void CustomTextWidget::onReplaceDone(quint64 generation, std::vector<LineRewrite> &rewrites, size_t replacements)
+{
+    if (generation != replaceGeneration || !replaceJob) return;
+
+    // Edited while the job ran: its lines are stale, so run it again
+    if (replaceJob->version() != buffer.version()) {
+        startReplaceJob();
+        return;
+    }
+    replaceJob.reset();
+    replaceTimer->stop();
+
+    if (!rewrites.empty()) {
+        buffer.closeUndoStep({cursorY, cursorX});
+        buffer.beginUndoStep({cursorY, cursorX});
+        buffer.rewriteLines(std::move(rewrites));
+        cursorX = std::min(cursorX, buffer.lineLength(cursorY));
+        buffer.closeUndoStep({cursorY, cursorX});
+        cursors.reset({cursorY, cursorX});
+        isDirty = true;
+        invalidateSearch();
+        update();
+        emitSignals();
+    }
+    emit replaceFinished((int)replacements);
+}
+
+void CustomTextWidget::scheduleHighlighting(int firstLine, int lastLine)
+{
+    // A pass over an older version of the text is wasted work
+    if (highlightJob && highlightJob->version() != buffer.version()) {
+        highlightJob.reset();
+        ++highlightGeneration;
+    }
+
+    highlightViewportFirst = firstLine;
+    highlightViewportLast = lastLine;
+    if (highlightJob) {
+        highlightJob->setViewport(firstLine, lastLine);
+        return;
+    }
+
+    // Wait for a pause in typing, a new job copies the buffer
+    int line;
+    Highlighter::LexState state;
+    if (highlighter.pendingWork(buffer, line, state) &&
+        (!highlightTimer->isActive() || highlightScheduledVersion != buffer.version())) {
+        highlightScheduledVersion = buffer.version();
+        highlightTimer->start();
+    }
+}
+
+void CustomTextWidget::startHighlightJob()
+{
+    int line;
+    Highlighter::LexState state;
+    if (highlightJob || !highlighter.pendingWork(buffer, line, state)) return;
+
+    quint64 generation = ++highlightGeneration;
+    auto snapshot = buffer.snapshot();
+    highlightJob.reset(new HighlightJob(snapshot, *highlighter.syntax(), line, state,
+        highlightViewportFirst, highlightViewportLast,
+        [this, generation](HighlightBatch batch, bool finished) {
+            auto result = std::make_shared<HighlightBatch>(std::move(batch));
+            QMetaObject::invokeMethod(this, [this, generation, result, finished]() {
+                onHighlightBatch(generation, *result, finished);
+            }, Qt::QueuedConnection);
+        }));
+}
+
+void CustomTextWidget::onHighlightBatch(quint64 generation, HighlightBatch &batch, bool finished)
+{
+    if (generation != highlightGeneration) return;
+
+    int first = batch.firstLine;
+    int last = first + (int)batch.runs.size();
+    highlighter.adopt(buffer, std::move(batch));
+    if (finished) {
+        highlightJob.reset();
+    }
+
+    // Only repaint when the new styles are on screen
+    int startLine = layout.rowToLine(std::max(0, (int)scrollOffsetY));
+    int endLine = layout.rowToLine((int)scrollOffsetY + height() / lineHeight + 1);
+    if (finished || (first < endLine && last > startLine)) {
+        update();
+    }
+}
+
+void CustomTextWidget::invalidateSearch()
+{
+    search.invalidate();
+    if (regexMode) {
+        regexJob.reset();
+        regexStale = true;
+        ++regexGeneration;
+    }
+}
+
+void CustomTextWidget::setCursorPosition(int line, int column)
+{
+    cursorY = qBound(0, line, buffer.lineCount() - 1);
+    cursorX = qBound(0, column, buffer.lineLength(cursorY));
+    cursors.reset({cursorY, cursorX});
+    ensureCursorVisible();
+    update();
+    emit cursorPositionChanged();
+}
+
+void CustomTextWidget::trackFile(const QString &filePath)
+{
+    reloader.track(filePath.toStdString(), format);
+    highlightJob.reset();
+    ++highlightGeneration;
+    highlighter.setFileName(filePath.toStdString());
+    brackets.setSyntax(highlighter.syntax());
+}
+
+ReloadResult::Kind CustomTextWidget::reloadFromDisk(bool discardEdits)
+{
+    // An unloaded document is read fresh when it is shown
+    if (unloaded) return ReloadResult::Unchanged;
+    syncLayout();
+    int topLine = layout.rowToLine((int)scrollOffsetY);
+    float fraction = scrollOffsetY - (int)scrollOffsetY;
+
+    // A reload is an undo step of its own
+    buffer.closeUndoStep({cursorY, cursorX});
+    ReloadResult result = reloader.reload(buffer, discardEdits);
+    if (result.kind == ReloadResult::Unchanged || result.kind == ReloadResult::Failed) {
+        return result.kind;
+    }
+    if (result.kind == ReloadResult::Deleted) {
+        isDirty = true;
+        emit textChanged();
+        return result.kind;
+    }
+
+    // Keep the cursor and the view on the same text when lines above them changed
+    if (result.kind == ReloadResult::Patched) {
+        cursorY = mapLineThroughHunks(result.hunks, cursorY);
+        syncLayout();
+        scrollOffsetY = layout.lineToRow(mapLineThroughHunks(result.hunks, topLine)) + fraction;
+        targetScrollY = scrollOffsetY;
+    }
+    cursorY = qBound(0, cursorY, buffer.lineCount() - 1);
+    cursorX = qBound(0, cursorX, buffer.lineLength(cursorY));
+    cursors.reset({cursorY, cursorX});
+    buffer.closeUndoStep({cursorY, cursorX});
+    invalidateSearch();
+    format = reloader.format();
+
+    update();
+    emitSignals();
+    return result.kind;
+}
+
+MemoryUsage CustomTextWidget::memoryUsage()
+{
+    if (measuredVersion != buffer.version()) {
+        measuredMemory = MemoryUsage();
+        buffer.addMemoryUsage(measuredMemory);
+        measuredVersion = buffer.version();
+    }
+    // The caches change without edits, so they are always current
+    MemoryUsage usage = measuredMemory;
+    usage.layout = layout.memoryUsage() + columns.memoryUsage() + brackets.memoryUsage();
+    usage.highlighting = highlighter.memoryUsage();
+    return usage;
+}
+
+DocumentMemory CustomTextWidget::documentMemory(int undoFloor, bool idle)
+{
+    DocumentMemory document = {};
+    document.usage = memoryUsage();
+    document.caches = columns.memoryUsage() + brackets.memoryUsage() + highlighter.memoryUsage();
+    document.undoBeyondFloor = buffer.undoMemory(undoFloor);
+    document.idle = idle && !isDirty && !unloaded && !reloader.path().empty();
+    document.lastUsed = lastUsedTime;
+    return document;
+}
+
+void CustomTextWidget::dropCaches()
+{
+    // A job still lexing would put its styles back
+    highlightJob.reset();
+    ++highlightGeneration;
+    highlighter.dropCache();
+    brackets.dropCache();
+    columns.clear();
+    update();
+}
+
+void CustomTextWidget::trimUndo(int keepSteps)
+{
+    buffer.trimUndo(keepSteps);
+    measuredVersion = UNMEASURED;
+}
+
+bool CustomTextWidget::compressColdText(size_t minBytes)
+{
+    if (minBytes == 0 || buffer.loadedBytes() < minBytes) return false;
+    // Compressing changes the memory but not the text
+    measuredVersion = UNMEASURED;
+    return buffer.compressColdText(minBytes, IDLE_COMPRESS_BYTES);
+}
+
+bool CustomTextWidget::unloadDocument()
+{
+    if (unloaded || isDirty || reloader.path().empty()) return false;
+    unloadedX = cursorX;
+    unloadedY = cursorY;
+    unloadedScroll = scrollOffsetY;
+    cancelReplace();
+    invalidateSearch();
+    dropCaches();
+    buffer.clear();
+    cursors.reset({0, 0});
+    cursorX = 0;
+    cursorY = 0;
+    measuredVersion = UNMEASURED;
+    unloaded = true;
+    return true;
+}
+
+bool CustomTextWidget::ensureLoaded()
+{
+    if (!unloaded) return true;
+    QString path = QString::fromStdString(reloader.path());
+    if (!loadFile(path)) {
+        // Gone or unreadable: the tab stays unloaded, as an empty document
+        // would be saved over the file. Said once, not on every key.
+        if (!reloadWarned) {
+            reloadWarned = true;
+            QMessageBox::warning(this, tr("Leditor"), tr("Cannot read file %1.").arg(path));
+        }
+        return false;
+    }
+    unloaded = false;
+    reloadWarned = false;
+    trackFile(path);
+    cursorY = qBound(0, unloadedY, buffer.lineCount() - 1);
+    cursorX = qBound(0, unloadedX, buffer.lineLength(cursorY));
+    cursors.reset({cursorY, cursorX});
+    syncLayout();
+    scrollOffsetY = qBound(0.0f, unloadedScroll, (float)std::max(0, layout.rowCount() - 1));
+    targetScrollY = scrollOffsetY;
+    update();
+    emit cursorPositionChanged();
+    return true;
+}
+
+void CustomTextWidget::jumpToMatch(const SearchMatch &match)
+{
+    cursorY = match.line;
+    cursorX = match.column;
+    cursors.reset({cursorY, cursorX});
+    ensureCursorVisible();
+    update();
+    emit cursorPositionChanged();
+}
+
+void CustomTextWidget::toggleMacroRecording()
+{
+    recordingMacro = !recordingMacro;
+    if (recordingMacro) macroKeys.clear();
+    emit cursorPositionChanged();
+}
+
+void CustomTextWidget::playMacro()
+{
+    if (macroKeys.empty() || recordingMacro) return;
+
+    bool ok = false;
+    QString answer = QInputDialog::getText(this, tr("Play Macro"),
+                                           tr("Times to run, l for each line or m for each match of the search:"),
+                                           QLineEdit::Normal, QString(), &ok).trimmed();
+    if (!ok) return;
+    MacroScope scope = MacroScope::Times;
+    int count = 1;
+    if (answer == "l") {
+        scope = MacroScope::EachLine;
+    } else if (answer == "m") {
+        scope = MacroScope::EachMatch;
+    } else if (!answer.isEmpty()) {
+        count = answer.toInt();
+        if (count <= 0) return;
+    }
+
+    // Keys go straight to the handler with painting and signals off; the
+    // whole replay is a single undo step
+    cursors.reset({cursorY, cursorX});
+    buffer.closeUndoStep({cursorY, cursorX});
+    buffer.beginUndoStep({cursorY, cursorX});
+    replayingMacro = true;
+    blockSignals(true);
+    setUpdatesEnabled(false);
+    replayMacro(buffer, scope, count, {cursorY, cursorX}, search.query(), [this](TextPosition start) {
+        cursorY = start.line;
+        cursorX = start.column;
+        cursors.reset(start);
+        for (const MacroKey &macroKey : macroKeys) {
+            QKeyEvent event(QEvent::KeyPress, macroKey.key, macroKey.modifiers, macroKey.text);
+            handleKey(&event);
+        }
+        return TextPosition{cursorY, cursorX};
+    });
+    setUpdatesEnabled(true);
+    blockSignals(false);
+    replayingMacro = false;
+    buffer.closeUndoStep({cursorY, cursorX});
+    editRun = EditRun::None;
+
+    ensureCursorVisible();
+    update();
+    emitSignals();
+}
+
 void CustomTextWidget::emitSignals()
 {
     emit textChanged();
@@ -13,8 +13,27 @@
 #include <QTimer>
 #include <QPropertyAnimation>
 #include <QEasingCurve>
+#include <QElapsedTimer>
 #include <vector>
 #include <string>
+#include <memory>
+#include "textbuffer.h"
+#include "search.h"
+#include "regexsearch.h"
+#include "textcodec.h"
+#include "filereloader.h"
+#include "highlighter.h"
+#include "highlightjob.h"
+#include "bracketindex.h"
+#include "foldset.h"
+#include "wraplayout.h"
+#include "columncache.h"
+#include "cursorset.h"
+#include "replaceall.h"
+#include "macroreplay.h"
+#include "edittrace.h"
+#include "perfstats.h"
+#include "memorybudget.h"
 
 class CustomTextWidget : public QWidget
 {
@@ -28,37 +47,178 @@ public:
     QString getText() const;
     void clear();
 
+    // Read and written in the file's own encoding and line endings
+    bool loadFile(const QString &filePath);
+    bool saveFile(const QString &filePath);
+    const FileFormat &fileFormat() const { return format; }
+
     int getCurrentLine() const { return cursorY + 1; }
     int getCurrentColumn() const { return cursorX + 1; }
+    void setCursorPosition(int line, int column);
     bool isModified() const { return isDirty; }
     void setModified(bool modified) { isDirty = modified; }
 
+    // Remembers which file is shown and what is on disk, so later changes
+    // can be reloaded in place and the right syntax is highlighted
+    void trackFile(const QString &filePath);
+    // discardEdits replaces unsaved edits with the file as it is now
+    ReloadResult::Kind reloadFromDisk(bool discardEdits = false);
+
     float getScrollOffsetY() const { return scrollOffsetY; }
     void setScrollOffsetY(float offset);
     void smoothScrollTo(float targetY);
 
+    void beginSearch();
+    void setSearchQuery(const QString &query, bool caseSensitive, bool regex = false);
+    bool findNext();
+    bool findPrevious();
+    void clearSearch();
+    int searchMatchCount() const;
+    bool isSearchComplete() const;
+    QString searchError() const { return regexError; }
+
+    // Plain-text replace-all on a worker; the result goes in as one edit
+    // and one undo step
+    void replaceAll(const QString &query, const QString &replacement, bool caseSensitive);
+    void cancelReplace();
+
+    bool isRecordingMacro() const { return recordingMacro; }
+
+    // Overlay of frame, key-to-paint and edit timings, in every editor
+    static void setPerfOverlayShown(bool shown) { perfOverlayShown = shown; }
+    bool dumpPerfStats(const QString &path) const { return perf.dump(path.toStdString()); }
+
+    // Memory by component, measured again only after the text changes
+    MemoryUsage memoryUsage();
+    // What the memory budget weighs; whether it is idle is up to the tabs
+    DocumentMemory documentMemory(int undoFloor, bool idle);
+    void dropCaches();
+    void trimUndo(int keepSteps);
+    // A saved document can give up its text and keep just its file, cursor
+    // and scroll position; it is read back when it is needed again
+    bool unloadDocument();
+    // False while the file cannot be read back; the tab then stays unloaded
+    bool ensureLoaded();
+    bool isUnloaded() const { return unloaded; }
+    // One slice of compressing text not read lately, once there is more
+    // than minBytes of it; true while there is more to do
+    bool compressColdText(size_t minBytes);
+    qint64 lastUsed() const { return lastUsedTime; }
+
 signals:
     void textChanged();
     void cursorPositionChanged();
+    void searchResultsChanged();
+    void replaceProgress(int percent);
+    // Count of replacements made, or -1 when cancelled
+    void replaceFinished(int replacements);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
     void focusOutEvent(QFocusEvent *event) override;
 
 private slots:
     void blinkCursor();
+    void startHighlightJob();
+    void measureWrapping();
+    void reportReplaceProgress();
 
 private:
 
-    std::vector<std::string> buffer;
+    TextBuffer buffer;
 
     int cursorX, cursorY;
 
+    // Extra cursors and selections; while active, edits and moves go
+    // through them and cursorX/cursorY follow the primary one
+    CursorSet cursors;
+
+    IncrementalSearch search;
+    int searchOriginX, searchOriginY;
+
+    // Regex searches run on a worker over a snapshot and stream in
+    bool regexMode;
+    std::string regexPattern;
+    bool regexCaseSensitive;
+    std::unique_ptr<RegexSearchJob> regexJob;
+    std::vector<RegexMatch> regexMatches;
+    bool regexFinished;
+    bool regexStale;
+    bool regexJumpPending;
+    quint64 regexGeneration;
+    QString regexError;
+
+    // Replace-all runs over a snapshot; if the buffer changes before the
+    // result is in, it is started again on the new text
+    std::unique_ptr<ReplaceAllJob> replaceJob;
+    QString replaceQuery, replaceText;
+    bool replaceCaseSensitive;
+    quint64 replaceGeneration;
+    QTimer *replaceTimer;
+
+    // A run of typing (or of deleting) is one undo step
+    enum class EditRun { None, Typing, Deleting };
+    EditRun editRun;
+
+    // Keys recorded for the macro, replayed through keyPressEvent
+    struct MacroKey {
+        int key;
+        Qt::KeyboardModifiers modifiers;
+        QString text;
+    };
+    std::vector<MacroKey> macroKeys;
+    bool recordingMacro;
+    bool replayingMacro;
+
+    // Edit trace, recorded when LEDITOR_TRACE names a file
+    std::unique_ptr<EditTraceWriter> trace;
+
+    // A key is timed from keyPressEvent to the end of the paint after it
+    PerfStats perf;
+    static bool perfOverlayShown;
+    QElapsedTimer keyTimer;
+    bool keyPending;
+
+    // Memory as last measured, and where an unloaded document was left
+    MemoryUsage measuredMemory;
+    quint64 measuredVersion;
+    bool unloaded;
+    bool reloadWarned;
+    int unloadedX, unloadedY;
+    float unloadedScroll;
+    qint64 lastUsedTime;
+
     bool isDirty;
+    FileFormat format;
+    FileReloader reloader;
+
+    // Highlighting is lexed in paint only up to a budget; big files are
+    // finished by a background job, viewport first
+    Highlighter highlighter;
+    std::unique_ptr<HighlightJob> highlightJob;
+    quint64 highlightGeneration;
+    quint64 highlightScheduledVersion;
+    QTimer *highlightTimer;
+    int highlightViewportFirst, highlightViewportLast;
+
+    // Folded blocks; scrollOffsetY counts wrapped rows of unfolded lines
+    BracketIndex brackets;
+    FoldSet folds;
+
+    // Soft wrap to the widget width; rows of long lines are measured exactly
+    // on screen first and in idle slices after
+    WrapLayout layout;
+    QTimer *wrapTimer;
+    std::vector<int> wrapStarts;
+
+    // cursorX is a byte offset into the UTF-8 line; moves go by whole
+    // characters (grapheme clusters)
+    ColumnCache columns;
 
     QFont textFont;
     QFontMetrics *fontMetrics;
@@ -68,19 +228,50 @@ private:
     QTimer *cursorTimer;
     bool cursorVisible;
 
-    int scrollOffsetX;
     float scrollOffsetY;
     float targetScrollY;
     QPropertyAnimation *scrollAnimation;
 
-    void insertChar(char c);
+    void startReplaceJob();
+    void onReplaceDone(quint64 generation, std::vector<LineRewrite> &rewrites, size_t replacements);
+    void undoEdit(bool redo);
+    void traceEdit(TraceOp op, const std::string &text = std::string());
+    void handleKey(QKeyEvent *event);
+    void paintPerfOverlay(QPainter &painter);
+    void toggleMacroRecording();
+    void playMacro();
+    void insertText(const std::string &text);
     void deleteChar();
     void insertNewline();
-    void moveCursor(int dx, int dy);
+    void moveCursor(int dx, int dy, bool extend = false);
+    void movePosition(int dx, int dy, TextPosition &position);
+    void addNextOccurrence();
+    void selectAllOccurrences();
+    void followPrimaryCursor();
+    TextPosition positionAt(const QPoint &point);
+    void extendSelectionTo(TextPosition position);
+    void selectAll();
+    void copySelection(bool cut);
+    void paste();
+    void foldAtCursor();
+    void unfoldAtCursor();
+    void revealCursor();
+    int visibleRowCount();
+    int wrapColumns() const;
+    void syncLayout();
+    int cursorSubRow(int &segmentStart);
 
+    void startRegexSearch();
+    void onRegexBatch(quint64 generation, const std::vector<RegexMatch> &batch, bool finished,
+                      const QString &error);
+    void scheduleHighlighting(int firstLine, int lastLine);
+    void onHighlightBatch(quint64 generation, HighlightBatch &batch, bool finished);
+    void invalidateSearch();
+    void jumpToMatch(const SearchMatch &match);
     void ensureCursorVisible();
     void updateFontMetrics();
     void emitSignals();
+    void resetLines(LineArena lines);
 };
 
 #endif 
\ No newline at end of file
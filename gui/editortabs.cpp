@@ -1,21 +1,51 @@
 #include "editortabs.h"
-#include <QFile>
-#include <QTextStream>
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QPushButton>
+#include "traceevents.h"
+
+// How often documents are checked for text to compress when none is left
+static const int COLD_CHECK_MS = 2000;
 
 EditorTabs::EditorTabs(QWidget *parent)
     : QTabWidget(parent)
     , untitledCounter(1)
+    , askingToReload(false)
+    , memoryBudget(MemoryBudget::fromEnvironment())
 {
     setupUI();
 
+    // Measuring every document is cheap once nothing changes, but not free
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(5000);
+    connect(memoryTimer, &QTimer::timeout, this, &EditorTabs::enforceMemoryBudget);
+    if (memoryBudget.limit() > 0) memoryTimer->start();
+
+    // Text of big documents that is not being read gets compressed in short
+    // slices between events
+    coldTimer = new QTimer(this);
+    coldTimer->setSingleShot(true);
+    connect(coldTimer, &QTimer::timeout, this, &EditorTabs::compressColdText);
+    coldTimer->start(COLD_CHECK_MS);
+
+    // Change notifications arrive on the watcher thread
+    documentWatcher.reset(new DocumentWatcher([this](const std::string &path) {
+        QString filePath = QString::fromStdString(path);
+        QMetaObject::invokeMethod(this, [this, filePath]() {
+            onFileChangedOnDisk(filePath);
+        }, Qt::QueuedConnection);
+    }));
+
     connect(this, &QTabWidget::tabCloseRequested, this, &EditorTabs::onTabCloseRequested);
     connect(this, &QTabWidget::currentChanged, this, &EditorTabs::onCurrentChanged);
 }
 
+EditorTabs::~EditorTabs()
+{
+    documentWatcher.reset();
+}
+
 void EditorTabs::setupUI()
 {
     setTabsClosable(false);  
@@ -60,12 +90,9 @@ void EditorTabs::openFile(const QString &filePath)
 
     CustomTextWidget *editor = new CustomTextWidget(this);
 
-    QFile file(filePath);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&file);
-        QString content = in.readAll();
-        editor->loadText(content);
-        file.close();
+    if (editor->loadFile(filePath)) {
+        editor->trackFile(filePath);
+        documentWatcher->watch(filePath.toStdString());
     }
 
     int tabIndex = addTab(editor, getDisplayName(filePath));
@@ -77,6 +104,15 @@ void EditorTabs::openFile(const QString &filePath)
     connect(editor, &CustomTextWidget::cursorPositionChanged, [this, editor]() {
         emit editorFocusChanged(editor);
     });
+    connect(editor, &CustomTextWidget::searchResultsChanged, [this, editor]() {
+        emit searchResultsChanged(editor);
+    });
+    connect(editor, &CustomTextWidget::replaceProgress, [this, editor](int percent) {
+        emit replaceProgress(editor, percent);
+    });
+    connect(editor, &CustomTextWidget::replaceFinished, [this, editor](int replacements) {
+        emit replaceFinished(editor, replacements);
+    });
 
     emit fileOpened(filePath);
 }
@@ -95,6 +131,15 @@ void EditorTabs::newFile()
     connect(editor, &CustomTextWidget::cursorPositionChanged, [this, editor]() {
         emit editorFocusChanged(editor);
     });
+    connect(editor, &CustomTextWidget::searchResultsChanged, [this, editor]() {
+        emit searchResultsChanged(editor);
+    });
+    connect(editor, &CustomTextWidget::replaceProgress, [this, editor](int percent) {
+        emit replaceProgress(editor, percent);
+    });
+    connect(editor, &CustomTextWidget::replaceFinished, [this, editor](int replacements) {
+        emit replaceFinished(editor, replacements);
+    });
 }
 
 bool EditorTabs::closeFile(int index)
@@ -130,6 +175,7 @@ bool EditorTabs::closeFile(int index)
     removeTab(index);
 
     if (!filePath.isEmpty()) {
+        documentWatcher->unwatch(filePath.toStdString());
         emit fileClosed(filePath);
     }
 
@@ -147,6 +193,7 @@ bool EditorTabs::closeCurrentFile()
 
 bool EditorTabs::saveCurrentFile()
 {
+    TRACE_SCOPE("saveCurrentFile");
     int index = currentIndex();
     if (index < 0) return false;
 
@@ -158,13 +205,9 @@ bool EditorTabs::saveCurrentFile()
     CustomTextWidget *editor = getEditorAt(index);
     if (!editor) return false;
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << editor->getText();
-        file.close();
-
+    if (editor->saveFile(filePath)) {
         editor->setModified(false);
+        editor->trackFile(filePath);
         updateTabTitle(index);
         return true;
     }
@@ -188,12 +231,13 @@ bool EditorTabs::saveFileAs(int index)
     CustomTextWidget *editor = getEditorAt(index);
     if (!editor) return false;
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << editor->getText();
-        file.close();
-
+    if (editor->saveFile(filePath)) {
+        QString previousPath = tabFilePaths.value(index);
+        if (previousPath != filePath) {
+            if (!previousPath.isEmpty()) documentWatcher->unwatch(previousPath.toStdString());
+            documentWatcher->watch(filePath.toStdString());
+        }
+        editor->trackFile(filePath);
         tabFilePaths[index] = filePath;
         setTabText(index, getDisplayName(filePath));
         editor->setModified(false);
@@ -249,6 +293,7 @@ void EditorTabs::onCurrentChanged(int index)
 
         CustomTextWidget *editor = getEditorAt(index);
         if (editor) {
+            editor->ensureLoaded();
             emit editorFocusChanged(editor);
         }
     }
@@ -268,6 +313,90 @@ void EditorTabs::onTextChanged()
     }
 }
 
+void EditorTabs::setMemoryBudget(size_t bytes)
+{
+    memoryBudget.setLimit(bytes);
+    if (bytes > 0) {
+        memoryTimer->start();
+        enforceMemoryBudget();
+    } else {
+        memoryTimer->stop();
+    }
+}
+
+void EditorTabs::enforceMemoryBudget()
+{
+    TRACE_SCOPE("enforceMemoryBudget");
+    std::vector<CustomTextWidget*> editors;
+    std::vector<DocumentMemory> documents;
+    for (int i = 0; i < count(); ++i) {
+        CustomTextWidget *editor = getEditorAt(i);
+        if (!editor) continue;
+        editors.push_back(editor);
+        documents.push_back(editor->documentMemory(memoryBudget.undoFloor(), i != currentIndex()));
+    }
+    for (const MemoryStep &step : memoryBudget.plan(documents)) {
+        CustomTextWidget *editor = editors[step.document];
+        switch (step.action) {
+            case MemoryAction::DropCaches: editor->dropCaches(); break;
+            case MemoryAction::TrimUndo: editor->trimUndo(memoryBudget.undoFloor()); break;
+            case MemoryAction::Unload: editor->unloadDocument(); break;
+        }
+    }
+}
+
+void EditorTabs::compressColdText()
+{
+    bool more = false;
+    for (int i = 0; i < count(); ++i) {
+        if (CustomTextWidget *editor = getEditorAt(i)) {
+            more |= editor->compressColdText(memoryBudget.compressAbove());
+        }
+    }
+    // Slices follow each other until everything cold is compressed
+    coldTimer->start(more ? 0 : COLD_CHECK_MS);
+}
+
+void EditorTabs::onFileChangedOnDisk(const QString &filePath)
+{
+    for (auto it = tabFilePaths.begin(); it != tabFilePaths.end(); ++it) {
+        if (it.value() != filePath) continue;
+
+        int index = it.key();
+        CustomTextWidget *editor = getEditorAt(index);
+        if (!editor) return;
+
+        bool discardEdits = editor->isModified();
+        if (discardEdits) {
+            // Unsaved edits are only replaced when the user says so; one
+            // save shows up as several events, so ask once
+            if (askingToReload) return;
+            askingToReload = true;
+            QMessageBox::StandardButton reply = QMessageBox::question(
+                this,
+                "File Changed",
+                QString("'%1' has changed on disk. Reload it and lose your changes?").arg(getDisplayName(filePath)),
+                QMessageBox::Yes | QMessageBox::No
+            );
+            askingToReload = false;
+            if (reply != QMessageBox::Yes) {
+                // Skip this version; the next change on disk asks again
+                editor->trackFile(filePath);
+                return;
+            }
+        }
+
+        // Edits are replaced by a full read; the file growing must not
+        // just add its new end to them
+        ReloadResult::Kind kind = editor->reloadFromDisk(discardEdits);
+        if (discardEdits && kind != ReloadResult::Failed && kind != ReloadResult::Deleted) {
+            editor->setModified(false);
+        }
+        updateTabTitle(index);
+        return;
+    }
+}
+
 void EditorTabs::updateTabTitle(int index)
 {
     CustomTextWidget *editor = getEditorAt(index);
@@ -5,7 +5,10 @@
 #include <QTabBar>
 #include <QMap>
 #include <QString>
+#include <QTimer>
+#include <memory>
 #include "customtextwidget.h"
+#include "documentwatcher.h"
 
 class EditorTabs : public QTabWidget
 {
@@ -13,6 +16,7 @@ class EditorTabs : public QTabWidget
 
 public:
     explicit EditorTabs(QWidget *parent = nullptr);
+    ~EditorTabs();
 
     void openFile(const QString &filePath);
     void newFile();
@@ -27,25 +31,41 @@ public:
     QString getCurrentFilePath();
     bool hasUnsavedChanges();
 
+    // Shared by all open documents; see MemoryBudget for what gives way first
+    void setMemoryBudget(size_t bytes);
+    const MemoryBudget &getMemoryBudget() const { return memoryBudget; }
+
 signals:
     void fileOpened(const QString &filePath);
     void fileClosed(const QString &filePath);
     void activeFileChanged(const QString &filePath);
     void editorFocusChanged(CustomTextWidget *editor);
+    void searchResultsChanged(CustomTextWidget *editor);
+    void replaceProgress(CustomTextWidget *editor, int percent);
+    void replaceFinished(CustomTextWidget *editor, int replacements);
 
 private slots:
     void onTabCloseRequested(int index);
     void onCurrentChanged(int index);
     void onTextChanged();
+    void enforceMemoryBudget();
+    void compressColdText();
 
 private:
     void setupUI();
     void updateTabTitle(int index);
     QString getDisplayName(const QString &filePath);
     void addCustomCloseButton(int tabIndex);
+    void onFileChangedOnDisk(const QString &filePath);
+    void fileSaved(int index, const QString &filePath);
 
     QMap<int, QString> tabFilePaths;
     int untitledCounter;
+    std::unique_ptr<DocumentWatcher> documentWatcher;
+    bool askingToReload;
+    MemoryBudget memoryBudget;
+    QTimer *memoryTimer;
+    QTimer *coldTimer;
 };
 
 #endif 
\ No newline at end of file
@@ -111,16 +111,14 @@ void FileExplorer::setupUI()
 
 void FileExplorer::setupFileSystemModel()
 {
-    fileSystemModel = new QFileSystemModel(this);
-    fileSystemModel->setRootPath("");
-
-    fileSystemModel->setFilter(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+    // Nothing is listed until a workspace is opened, and then only the
+    // directories the user expands
+    fileSystemModel = new LazyFileModel(this);
 
     fileTreeView->setModel(fileSystemModel);
 
-    fileTreeView->hideColumn(1);
-    fileTreeView->hideColumn(2);
-    fileTreeView->hideColumn(3);
+    connect(fileTreeView, &QTreeView::expanded, fileSystemModel, &LazyFileModel::watchDirectory);
+    connect(fileTreeView, &QTreeView::collapsed, fileSystemModel, &LazyFileModel::unwatchDirectory);
 }
 
 void FileExplorer::setWorkspaceRoot(const QString &path)
@@ -131,14 +129,13 @@ void FileExplorer::setWorkspaceRoot(const QString &path)
         QDir dir(path);
         workspaceLabel->setText(dir.dirName());
 
-        QModelIndex rootIndex = fileSystemModel->setRootPath(path);
-        fileTreeView->setRootIndex(rootIndex);
-        fileTreeView->expandToDepth(0); 
+        fileSystemModel->setRootPath(path);
+        fileTreeView->setRootIndex(QModelIndex());
 
         emit workspaceChanged(path);
     } else {
         workspaceLabel->setText("No Workspace");
-        fileTreeView->setRootIndex(QModelIndex());
+        fileSystemModel->setRootPath(QString());
     }
 }
 
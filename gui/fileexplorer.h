@@ -3,13 +3,13 @@
 
 #include <QWidget>
 #include <QTreeView>
-#include <QFileSystemModel>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QPushButton>
 #include <QFileDialog>
 #include <QDir>
+#include "lazyfilemodel.h"
 
 class FileExplorer : public QWidget
 {
@@ -39,7 +39,7 @@ private:
     QLabel *workspaceLabel;
     QPushButton *openWorkspaceBtn;
     QTreeView *fileTreeView;
-    QFileSystemModel *fileSystemModel;
+    LazyFileModel *fileSystemModel;
     
     QString workspacePath;
 };
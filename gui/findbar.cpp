@@ -0,0 +1,168 @@
+#include "findbar.h"
+#include <QApplication>
+
+FindBar::FindBar(QWidget *parent)
+    : QWidget(parent)
+    , replacing(false)
+{
+    setupUI();
+
+    setStyleSheet(R"(
+        QWidget {
+            background-color: #252526;
+            color: #ffffff;
+        }
+        QLineEdit {
+            background-color: #3c3c3c;
+            color: #ffffff;
+            border: 1px solid #555555;
+            padding: 4px;
+            font-size: 12px;
+        }
+        QLineEdit:focus {
+            border-color: #0078d4;
+        }
+        QPushButton {
+            background-color: transparent;
+            color: #cccccc;
+            border: none;
+            padding: 4px 8px;
+        }
+        QPushButton:hover {
+            background-color: #3e3e42;
+        }
+        QLabel {
+            color: #969696;
+            padding: 0px 8px;
+        }
+    )");
+
+    hide();
+}
+
+void FindBar::setupUI()
+{
+    mainLayout = new QHBoxLayout(this);
+    mainLayout->setContentsMargins(8, 4, 8, 4);
+    mainLayout->setSpacing(4);
+
+    queryEdit = new QLineEdit();
+    queryEdit->setPlaceholderText("Find");
+
+    replaceEdit = new QLineEdit();
+    replaceEdit->setPlaceholderText("Replace");
+
+    caseCheckBox = new QCheckBox("Aa");
+    caseCheckBox->setToolTip("Match case");
+
+    regexCheckBox = new QCheckBox(".*");
+    regexCheckBox->setToolTip("Regular expression");
+
+    matchLabel = new QLabel();
+    matchLabel->setMinimumWidth(80);
+
+    prevBtn = new QPushButton("↑");
+    prevBtn->setToolTip("Previous match (Shift+Enter)");
+    nextBtn = new QPushButton("↓");
+    nextBtn->setToolTip("Next match (Enter)");
+    replaceAllBtn = new QPushButton("Replace All");
+    replaceAllBtn->setToolTip("Replace every match (plain text)");
+    closeBtn = new QPushButton("×");
+    closeBtn->setToolTip("Close (Escape)");
+
+    mainLayout->addWidget(queryEdit, 1);
+    mainLayout->addWidget(replaceEdit, 1);
+    mainLayout->addWidget(caseCheckBox);
+    mainLayout->addWidget(regexCheckBox);
+    mainLayout->addWidget(matchLabel);
+    mainLayout->addWidget(prevBtn);
+    mainLayout->addWidget(nextBtn);
+    mainLayout->addWidget(replaceAllBtn);
+    mainLayout->addWidget(closeBtn);
+
+    connect(queryEdit, &QLineEdit::textChanged, this, &FindBar::onQueryEdited);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &FindBar::onReturnPressed);
+    connect(caseCheckBox, &QCheckBox::toggled, this, &FindBar::onQueryEdited);
+    connect(regexCheckBox, &QCheckBox::toggled, this, &FindBar::onQueryEdited);
+    connect(prevBtn, &QPushButton::clicked, this, &FindBar::findPrevious);
+    connect(nextBtn, &QPushButton::clicked, this, &FindBar::findNext);
+    connect(replaceAllBtn, &QPushButton::clicked, this, &FindBar::onReplaceClicked);
+    connect(replaceEdit, &QLineEdit::returnPressed, this, &FindBar::onReplaceClicked);
+    connect(closeBtn, &QPushButton::clicked, [this]() {
+        hide();
+        emit closed();
+    });
+}
+
+void FindBar::activate()
+{
+    show();
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+}
+
+void FindBar::setMatchCount(int count, bool complete)
+{
+    if (queryEdit->text().isEmpty()) {
+        matchLabel->clear();
+    } else if (count == 0) {
+        matchLabel->setText("No results");
+    } else {
+        matchLabel->setText(QString("%1%2 matches").arg(count).arg(complete ? "" : "+"));
+    }
+}
+
+void FindBar::setError(const QString &message)
+{
+    matchLabel->setText(message);
+}
+
+void FindBar::setReplaceProgress(int percent)
+{
+    replacing = true;
+    replaceAllBtn->setText(QString("Cancel (%1%)").arg(percent));
+}
+
+void FindBar::setReplaceFinished(int replacements)
+{
+    replacing = false;
+    replaceAllBtn->setText("Replace All");
+    if (replacements < 0) {
+        matchLabel->setText("Cancelled");
+    } else {
+        matchLabel->setText(QString("%1 replaced").arg(replacements));
+    }
+}
+
+void FindBar::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape) {
+        hide();
+        emit closed();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void FindBar::onQueryEdited()
+{
+    emit queryChanged(queryEdit->text(), caseCheckBox->isChecked(), regexCheckBox->isChecked());
+}
+
+void FindBar::onReplaceClicked()
+{
+    if (replacing) {
+        emit replaceCancelled();
+    } else if (!queryEdit->text().isEmpty()) {
+        emit replaceAll(queryEdit->text(), replaceEdit->text(), caseCheckBox->isChecked());
+    }
+}
+
+void FindBar::onReturnPressed()
+{
+    if (QApplication::keyboardModifiers() & Qt::ShiftModifier) {
+        emit findPrevious();
+    } else {
+        emit findNext();
+    }
+}
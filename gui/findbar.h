@@ -0,0 +1,61 @@
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+
+class FindBar : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindBar(QWidget *parent = nullptr);
+
+    void activate();
+    QString getQuery() const { return queryEdit->text(); }
+    bool isCaseSensitive() const { return caseCheckBox->isChecked(); }
+    bool isRegex() const { return regexCheckBox->isChecked(); }
+    void setMatchCount(int count, bool complete);
+    void setError(const QString &message);
+    // While a replace-all runs its button cancels it
+    void setReplaceProgress(int percent);
+    void setReplaceFinished(int replacements);
+
+signals:
+    void queryChanged(const QString &query, bool caseSensitive, bool regex);
+    void findNext();
+    void findPrevious();
+    void replaceAll(const QString &query, const QString &replacement, bool caseSensitive);
+    void replaceCancelled();
+    void closed();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void onQueryEdited();
+    void onReturnPressed();
+    void onReplaceClicked();
+
+private:
+    void setupUI();
+
+    QHBoxLayout *mainLayout;
+    QLineEdit *queryEdit;
+    QLineEdit *replaceEdit;
+    QCheckBox *caseCheckBox;
+    QCheckBox *regexCheckBox;
+    QLabel *matchLabel;
+    QPushButton *prevBtn;
+    QPushButton *nextBtn;
+    QPushButton *replaceAllBtn;
+    QPushButton *closeBtn;
+    bool replacing;
+};
+
+#endif // FINDBAR_H
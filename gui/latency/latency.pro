@@ -0,0 +1,22 @@
+QT += core widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core.pri)
+
+INCLUDEPATH += ..
+
+TARGET = leditor-latency
+TEMPLATE = app
+
+SOURCES += \
+    latencyharness.cpp \
+    ../customtextwidget.cpp \
+    ../editortabs.cpp \
+    ../clipmimedata.cpp
+
+HEADERS += \
+    ../customtextwidget.h \
+    ../editortabs.h \
+    ../clipmimedata.h
@@ -0,0 +1,200 @@
+// Input-to-paint latency of CustomTextWidget, on the offscreen platform so
+// it runs without a display.
+//
+//   leditor-latency [--json FILE]
+//
+// Each event is sent to the widget the way the event loop delivers it and
+// the widget is then repainted; the latency is the time from sending the
+// event until paintEvent has returned. Pending timers and posted events
+// (wrapping, highlighting) run between samples, untimed, as they would
+// while the user is idle.
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QTemporaryDir>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "customtextwidget.h"
+#include "editortabs.h"
+
+struct Scenario {
+    const char *name;
+    std::vector<double> latencies;   // milliseconds
+};
+
+static const int TYPED_KEYS = 2000;
+static const int SCROLL_STEPS = 1000;
+static const int CLICKS = 500;
+static const int TAB_COUNT = 100;
+
+// lines lines of lineLength code-like characters
+static bool writeFile(const QString &path, int lines, int lineLength) {
+    static const char pattern[] = "    int value = compute(first, second) + 42; // note ";
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    std::string block;
+    for (int i = 0; i < lines; i++) {
+        for (int x = 0; x < lineLength; x++) block += pattern[(i + x) % (sizeof(pattern) - 1)];
+        block += '\n';
+        if (block.size() >= (1 << 20)) {
+            file.write(block.data(), block.size());
+            block.clear();
+        }
+    }
+    file.write(block.data(), block.size());
+    return true;
+}
+
+template <typename Deliver>
+static void sample(Scenario &scenario, QWidget *painted, Deliver deliver) {
+    QElapsedTimer timer;
+    timer.start();
+    deliver();
+    painted->repaint();
+    scenario.latencies.push_back(timer.nsecsElapsed() / 1e6);
+    QCoreApplication::processEvents();
+}
+
+// Letters, with Enter every 60 keys
+static void typeKey(QWidget *target, int i) {
+    if (i % 60 == 59) {
+        QKeyEvent event(QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier, QStringLiteral("\r"));
+        QApplication::sendEvent(target, &event);
+    } else {
+        QChar letter('a' + i % 26);
+        QKeyEvent event(QEvent::KeyPress, Qt::Key_A + i % 26, Qt::NoModifier, QString(letter));
+        QApplication::sendEvent(target, &event);
+    }
+}
+
+static void prepare(QWidget *widget) {
+    widget->resize(1200, 800);
+    widget->show();
+    widget->setFocus();
+    QCoreApplication::processEvents();
+}
+
+static double percentile(const std::vector<double> &sorted, double fraction) {
+    size_t index = std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()));
+    return sorted[index];
+}
+
+int main(int argc, char *argv[]) {
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QString jsonPath;
+    QStringList arguments = app.arguments();
+    int jsonIndex = arguments.indexOf("--json");
+    if (jsonIndex > 0 && jsonIndex + 1 < arguments.size()) jsonPath = arguments[jsonIndex + 1];
+
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        fprintf(stderr, "leditor-latency: no temporary directory\n");
+        return 1;
+    }
+    QString bigFile = directory.filePath("million.cpp");
+    QString longFile = directory.filePath("long.txt");
+    writeFile(bigFile, 1000000, 40);
+    writeFile(longFile, 2000, 10000);
+
+    std::vector<Scenario> scenarios;
+
+    // Typing at the end of a 1M-line file, then clicking around its middle
+    {
+        CustomTextWidget editor;
+        prepare(&editor);
+        editor.loadFile(bigFile);
+        editor.trackFile(bigFile);
+        editor.setCursorPosition(1000000, 0);
+        QCoreApplication::processEvents();
+
+        Scenario typing = {"typing at end of 1M lines", {}};
+        for (int i = 0; i < TYPED_KEYS; i++) sample(typing, &editor, [&]() { typeKey(&editor, i); });
+        scenarios.push_back(typing);
+
+        editor.setCursorPosition(500000, 0);
+        QCoreApplication::processEvents();
+        Scenario clicks = {"clicks in 1M lines", {}};
+        for (int i = 0; i < CLICKS; i++) {
+            QPointF point(20 + (i * 37) % 1000, 10 + (i * 53) % 760);
+            sample(clicks, &editor, [&]() {
+                QMouseEvent press(QEvent::MouseButtonPress, point, editor.mapToGlobal(point), Qt::LeftButton,
+                                  Qt::LeftButton, Qt::NoModifier);
+                QApplication::sendEvent(&editor, &press);
+                QMouseEvent release(QEvent::MouseButtonRelease, point, editor.mapToGlobal(point), Qt::LeftButton,
+                                    Qt::NoButton, Qt::NoModifier);
+                QApplication::sendEvent(&editor, &release);
+            });
+        }
+        scenarios.push_back(clicks);
+    }
+
+    // Scrolling down through wrapped 10,000-character lines
+    {
+        CustomTextWidget editor;
+        prepare(&editor);
+        editor.loadFile(longFile);
+        editor.trackFile(longFile);
+        QCoreApplication::processEvents();
+
+        Scenario scrolling = {"scrolling long lines", {}};
+        QPointF point(600, 400);
+        for (int i = 0; i < SCROLL_STEPS; i++) {
+            sample(scrolling, &editor, [&]() {
+                QWheelEvent wheel(point, editor.mapToGlobal(point), QPoint(0, -120), QPoint(0, -120), Qt::NoButton,
+                                  Qt::NoModifier, Qt::NoScrollPhase, false);
+                QApplication::sendEvent(&editor, &wheel);
+            });
+        }
+        scenarios.push_back(scrolling);
+    }
+
+    // 100 open tabs: switching between them and typing in each
+    {
+        EditorTabs tabs;
+        prepare(&tabs);
+        for (int i = 0; i < TAB_COUNT; i++) {
+            QString path = directory.filePath(QString("tab%1.cpp").arg(i));
+            writeFile(path, 10000, 60);
+            tabs.openFile(path);
+        }
+        QCoreApplication::processEvents();
+
+        Scenario switching = {"switching among 100 tabs", {}};
+        Scenario typing = {"typing with 100 tabs open", {}};
+        for (int i = 0; i < TAB_COUNT * 5; i++) {
+            sample(switching, &tabs, [&]() { tabs.setCurrentIndex((i * 7) % TAB_COUNT); });
+            CustomTextWidget *editor = tabs.getCurrentEditor();
+            editor->setFocus();
+            for (int k = 0; k < 4; k++) sample(typing, editor, [&]() { typeKey(editor, i * 4 + k); });
+        }
+        scenarios.push_back(switching);
+        scenarios.push_back(typing);
+    }
+
+    FILE *json = jsonPath.isEmpty() ? nullptr : fopen(QFile::encodeName(jsonPath).constData(), "w");
+    if (json) fprintf(json, "{\n  \"scenarios\": [\n");
+    printf("%-28s %7s %9s %9s %9s %9s\n", "scenario", "events", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        std::vector<double> &sorted = scenarios[i].latencies;
+        std::sort(sorted.begin(), sorted.end());
+        double p50 = percentile(sorted, 0.5), p90 = percentile(sorted, 0.9), p99 = percentile(sorted, 0.99);
+        printf("%-28s %7zu %9.2f %9.2f %9.2f %9.2f\n", scenarios[i].name, sorted.size(), p50, p90, p99, sorted.back());
+        if (json) {
+            fprintf(json, "    {\"name\": \"%s\", \"events\": %zu, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+                    scenarios[i].name, sorted.size(), p50, p90, p99, sorted.back(), i + 1 < scenarios.size() ? "," : "");
+        }
+    }
+    if (json) {
+        fprintf(json, "  ]\n}\n");
+        fclose(json);
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "lazyfilemodel.h"
+
+static const size_t FETCH_BATCH = 1000;
+
+LazyFileModel::LazyFileModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , treeGeneration(0)
+{
+    // Events arrive on the watcher's thread
+    watcher.reset(new FileWatcher([this](const std::vector<FileEvent> &events) {
+        quint64 generation = treeGeneration;
+        std::vector<FileEvent> copy = events;
+        QMetaObject::invokeMethod(this, [this, generation, copy]() {
+            if (generation == treeGeneration) {
+                applyEvents(copy);
+            }
+        }, Qt::QueuedConnection);
+    }));
+}
+
+LazyFileModel::~LazyFileModel()
+{
+    watcher.reset();
+}
+
+void LazyFileModel::setRootPath(const QString &path)
+{
+    beginResetModel();
+    for (const std::string &watched : watchedPaths) {
+        watcher->removeWatch(watched);
+    }
+    watchedPaths.clear();
+    treeGeneration++;
+    tree.reset(path.isEmpty() ? nullptr : new FileTree(path.toStdString()));
+    endResetModel();
+
+    if (tree) {
+        watcher->addWatch(tree->rootPath());
+        watchedPaths.insert(tree->rootPath());
+    }
+}
+
+FileTree::Node *LazyFileModel::nodeFor(const QModelIndex &index) const
+{
+    if (!tree) return nullptr;
+    if (!index.isValid()) return tree->root();
+    return static_cast<FileTree::Node *>(index.internalPointer());
+}
+
+QModelIndex LazyFileModel::indexFor(FileTree::Node *node) const
+{
+    if (!node || !node->parent) return QModelIndex();
+    return createIndex(node->row, 0, node);
+}
+
+QString LazyFileModel::filePath(const QModelIndex &index) const
+{
+    FileTree::Node *node = nodeFor(index);
+    return node ? QString::fromStdString(tree->absolutePath(node)) : QString();
+}
+
+bool LazyFileModel::isDir(const QModelIndex &index) const
+{
+    FileTree::Node *node = nodeFor(index);
+    return node && node->isDir;
+}
+
+QModelIndex LazyFileModel::index(int row, int column, const QModelIndex &parent) const
+{
+    FileTree::Node *node = nodeFor(parent);
+    if (!node || column != 0 || row < 0 || row >= (int)node->children.size()) return QModelIndex();
+    return createIndex(row, column, node->children[row].get());
+}
+
+QModelIndex LazyFileModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexFor(nodeFor(child)->parent);
+}
+
+int LazyFileModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return 0;
+    FileTree::Node *node = nodeFor(parent);
+    return node ? (int)node->children.size() : 0;
+}
+
+int LazyFileModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+QVariant LazyFileModel::data(const QModelIndex &index, int role) const
+{
+    FileTree::Node *node = index.isValid() ? nodeFor(index) : nullptr;
+    if (!node) return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString::fromStdString(node->name);
+    case Qt::DecorationRole:
+        return iconProvider.icon(node->isDir ? QFileIconProvider::Folder : QFileIconProvider::File);
+    case Qt::ToolTipRole:
+        return filePath(index);
+    default:
+        return QVariant();
+    }
+}
+
+bool LazyFileModel::hasChildren(const QModelIndex &parent) const
+{
+    FileTree::Node *node = nodeFor(parent);
+    if (!node || !node->isDir) return false;
+    // Unlisted directories claim children so the view offers to expand them
+    return !node->listed || !node->children.empty() || !node->pending.empty();
+}
+
+bool LazyFileModel::canFetchMore(const QModelIndex &parent) const
+{
+    FileTree::Node *node = nodeFor(parent);
+    return node && node->isDir && (!node->listed || !node->pending.empty());
+}
+
+void LazyFileModel::fetchMore(const QModelIndex &parent)
+{
+    FileTree::Node *node = nodeFor(parent);
+    if (!node || !node->isDir) return;
+
+    if (!node->listed) {
+        tree->list(node);
+    }
+    size_t count = std::min(FETCH_BATCH, node->pending.size());
+    if (count == 0) return;
+
+    int first = (int)node->children.size();
+    beginInsertRows(parent, first, first + (int)count - 1);
+    tree->expose(node, count);
+    endInsertRows();
+}
+
+void LazyFileModel::watchDirectory(const QModelIndex &index)
+{
+    FileTree::Node *node = nodeFor(index);
+    if (!node || !node->isDir) return;
+
+    std::string path = tree->absolutePath(node);
+    if (watchedPaths.insert(path).second) {
+        watcher->addWatch(path);
+    }
+}
+
+void LazyFileModel::unwatchTree(FileTree::Node *node)
+{
+    if (!node->isDir) return;
+
+    auto it = watchedPaths.find(tree->absolutePath(node));
+    if (it != watchedPaths.end()) {
+        watcher->removeWatch(*it);
+        watchedPaths.erase(it);
+    }
+    for (auto &child : node->children) {
+        unwatchTree(child.get());
+    }
+}
+
+void LazyFileModel::unwatchDirectory(const QModelIndex &index)
+{
+    FileTree::Node *node = nodeFor(index);
+    if (!node || !node->parent || !node->isDir) return;
+
+    unwatchTree(node);
+    if (!node->children.empty()) {
+        beginRemoveRows(index, 0, (int)node->children.size() - 1);
+        tree->forget(node);
+        endRemoveRows();
+    } else {
+        tree->forget(node);
+    }
+}
+
+void LazyFileModel::applyEvents(const std::vector<FileEvent> &events)
+{
+    if (!tree) return;
+    std::string prefix = tree->rootPath() + "/";
+
+    for (const FileEvent &event : events) {
+        if (event.type == FileEvent::Overflow) {
+            // Events were lost; start over from a fresh listing
+            setRootPath(QString::fromStdString(tree->rootPath()));
+            return;
+        }
+        if (event.type == FileEvent::Modified) continue;
+        if (event.path.compare(0, prefix.size(), prefix) != 0) continue;
+
+        std::string relative = event.path.substr(prefix.size());
+        size_t slash = relative.rfind('/');
+        std::string parentPath = slash == std::string::npos ? "" : relative.substr(0, slash);
+        std::string name = slash == std::string::npos ? relative : relative.substr(slash + 1);
+
+        FileTree::Node *parent = tree->find(parentPath);
+        if (!parent || !parent->listed) continue;
+        QModelIndex parentIndex = indexFor(parent);
+
+        if (event.type == FileEvent::Created) {
+            if (tree->childRow(parent, name) >= 0 || tree->isIgnored(parent, name, event.isDirectory)) continue;
+
+            int row = tree->insertionRow(parent, name, event.isDirectory);
+            if (row < 0) {
+                tree->addPending(parent, name, event.isDirectory);
+            } else {
+                beginInsertRows(parentIndex, row, row);
+                tree->insertChild(parent, row, name, event.isDirectory);
+                endInsertRows();
+            }
+        } else {
+            int row = tree->childRow(parent, name);
+            if (row < 0) {
+                tree->removePending(parent, name);
+                continue;
+            }
+            unwatchTree(parent->children[row].get());
+            beginRemoveRows(parentIndex, row, row);
+            tree->removeChild(parent, row);
+            endRemoveRows();
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef LAZYFILEMODEL_H
+#define LAZYFILEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QFileIconProvider>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "filetree.h"
+#include "filewatcher.h"
+
+// Item model over a FileTree: directories are listed when the view expands
+// them, rows are handed out in batches through fetchMore, and only expanded
+// directories are watched for changes.
+class LazyFileModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit LazyFileModel(QObject *parent = nullptr);
+    ~LazyFileModel();
+
+    void setRootPath(const QString &path);
+    QString filePath(const QModelIndex &index) const;
+    bool isDir(const QModelIndex &index) const;
+
+    // Called as the view expands and collapses directories. Collapsing drops
+    // the listing, so the next expansion reads the directory fresh.
+    void watchDirectory(const QModelIndex &index);
+    void unwatchDirectory(const QModelIndex &index);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    FileTree::Node *nodeFor(const QModelIndex &index) const;
+    QModelIndex indexFor(FileTree::Node *node) const;
+    void applyEvents(const std::vector<FileEvent> &events);
+    void unwatchTree(FileTree::Node *node);
+
+    std::unique_ptr<FileTree> tree;
+    std::unique_ptr<FileWatcher> watcher;
+    std::set<std::string> watchedPaths;
+    std::atomic<quint64> treeGeneration;
+    QFileIconProvider iconProvider;
+};
+
+#endif // LAZYFILEMODEL_H
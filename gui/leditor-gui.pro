@@ -2,6 +2,8 @@ QT += core widgets
 
 CONFIG += c++17
 
+include(core.pri)
+
 TARGET = leditor-gui
 TEMPLATE = app
 
@@ -10,13 +12,23 @@ SOURCES += \
     mainwindow.cpp \
     customtextwidget.cpp \
     fileexplorer.cpp \
-    editortabs.cpp
+    editortabs.cpp \
+    findbar.cpp \
+    workspacesearchpanel.cpp \
+    quickopen.cpp \
+    lazyfilemodel.cpp \
+    clipmimedata.cpp
 
 HEADERS += \
     mainwindow.h \
     customtextwidget.h \
     fileexplorer.h \
-    editortabs.h
+    editortabs.h \
+    findbar.h \
+    workspacesearchpanel.h \
+    quickopen.h \
+    lazyfilemodel.h \
+    clipmimedata.h
 
 # macOS specific settings
 macx {
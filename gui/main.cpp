@@ -1,7 +1,9 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QFile>
 #include "mainwindow.h"
+#include "traceevents.h"
 
 int main(int argc, char *argv[])
 {
@@ -15,8 +17,16 @@ int main(int argc, char *argv[])
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument("file", "The file to open.");
+    QCommandLineOption traceOption("trace-events", "Write a Chrome trace-event timeline to <file>.", "file");
+    parser.addOption(traceOption);
     parser.process(app);
 
+    setTraceThreadName("main");
+    startTraceEventsFromEnvironment();
+    if (parser.isSet(traceOption)) {
+        startTraceEvents(QFile::encodeName(parser.value(traceOption)).toStdString());
+    }
+
     MainWindow mainWin;
     
     // If a file was specified, open it
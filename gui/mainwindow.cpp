@@ -6,6 +6,7 @@
 #include <QSplitter>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
+#include <QInputDialog>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -21,6 +22,22 @@ MainWindow::MainWindow(QWidget *parent)
             this, &MainWindow::onActiveFileChanged);
     connect(editorTabs, &EditorTabs::editorFocusChanged,
             this, &MainWindow::onEditorFocusChanged);
+    connect(findBar, &FindBar::queryChanged,
+            this, &MainWindow::onFindQueryChanged);
+    connect(editorTabs, &EditorTabs::searchResultsChanged,
+            this, &MainWindow::onSearchResultsChanged);
+    connect(findBar, &FindBar::findNext, this, &MainWindow::findNext);
+    connect(findBar, &FindBar::findPrevious, this, &MainWindow::findPrevious);
+    connect(findBar, &FindBar::closed, this, &MainWindow::onFindBarClosed);
+    connect(findBar, &FindBar::replaceAll, this, &MainWindow::replaceAll);
+    connect(findBar, &FindBar::replaceCancelled, this, &MainWindow::cancelReplace);
+    connect(editorTabs, &EditorTabs::replaceProgress, this, &MainWindow::onReplaceProgress);
+    connect(editorTabs, &EditorTabs::replaceFinished, this, &MainWindow::onReplaceFinished);
+    connect(fileExplorer, &FileExplorer::workspaceChanged,
+            this, &MainWindow::onWorkspaceChanged);
+    connect(workspaceSearchPanel, &WorkspaceSearchPanel::resultActivated,
+            this, &MainWindow::onWorkspaceResultActivated);
+    connect(quickOpen, &QuickOpen::fileChosen, this, &MainWindow::onFileSelected);
 
     setUnifiedTitleAndToolBarOnMac(true);
 
@@ -64,6 +81,10 @@ MainWindow::MainWindow(QWidget *parent)
         QSplitter::handle:horizontal:hover {
             background-color: #007acc;
         }
+        QSplitter::handle:vertical {
+            height: 1px;
+            background-color: #2d2d30;
+        }
     )");
 
     updateStatusBar();
@@ -71,6 +92,9 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    workspaceSearchPanel->setWorkspaceIndex(nullptr);
+    quickOpen->setWorkspaceIndex(nullptr);
+    workspaceIndex.reset();
 }
 
 void MainWindow::setupUI()
@@ -83,10 +107,28 @@ void MainWindow::setupUI()
     fileExplorer->setMinimumWidth(120);  
     fileExplorer->setMaximumWidth(800);  
 
-    editorTabs = new EditorTabs(this);
+    QWidget *editorArea = new QWidget(this);
+    QVBoxLayout *editorLayout = new QVBoxLayout(editorArea);
+    editorLayout->setContentsMargins(0, 0, 0, 0);
+    editorLayout->setSpacing(0);
+
+    editorTabs = new EditorTabs(editorArea);
+    findBar = new FindBar(editorArea);
+
+    editorLayout->addWidget(editorTabs, 1);
+    editorLayout->addWidget(findBar);
+
+    editorSplitter = new QSplitter(Qt::Vertical, this);
+    workspaceSearchPanel = new WorkspaceSearchPanel(editorSplitter);
+    editorSplitter->addWidget(editorArea);
+    editorSplitter->addWidget(workspaceSearchPanel);
+    editorSplitter->setStretchFactor(0, 1);
+    editorSplitter->setStretchFactor(1, 0);
+    editorSplitter->setCollapsible(0, false);
+    editorSplitter->setHandleWidth(1);
 
     mainSplitter->addWidget(fileExplorer);
-    mainSplitter->addWidget(editorTabs);
+    mainSplitter->addWidget(editorSplitter);
 
     mainSplitter->setSizes({250, 800});
     mainSplitter->setCollapsible(0, true);  
@@ -97,6 +139,8 @@ void MainWindow::setupUI()
 
     mainSplitter->setChildrenCollapsible(true);
     mainSplitter->setHandleWidth(1);
+
+    quickOpen = new QuickOpen(this);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -177,6 +221,140 @@ void MainWindow::toggleSidebar()
     }
 }
 
+void MainWindow::showFindBar()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->beginSearch();
+    }
+    findBar->activate();
+}
+
+void MainWindow::findNext()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->findNext();
+    }
+}
+
+void MainWindow::findPrevious()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->findPrevious();
+    }
+}
+
+void MainWindow::onFindQueryChanged(const QString &query, bool caseSensitive, bool regex)
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (!editor) return;
+
+    editor->setSearchQuery(query, caseSensitive, regex);
+    onSearchResultsChanged(editor);
+}
+
+void MainWindow::onSearchResultsChanged(CustomTextWidget *editor)
+{
+    if (editor != editorTabs->getCurrentEditor()) return;
+
+    if (!editor->searchError().isEmpty()) {
+        findBar->setError(editor->searchError());
+    } else {
+        findBar->setMatchCount(editor->searchMatchCount(), editor->isSearchComplete());
+    }
+}
+
+void MainWindow::onFindBarClosed()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->clearSearch();
+        editor->setFocus();
+    }
+}
+
+void MainWindow::replaceAll(const QString &query, const QString &replacement, bool caseSensitive)
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->replaceAll(query, replacement, caseSensitive);
+    }
+}
+
+void MainWindow::cancelReplace()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->cancelReplace();
+    }
+}
+
+void MainWindow::onReplaceProgress(CustomTextWidget *editor, int percent)
+{
+    if (editor == editorTabs->getCurrentEditor()) {
+        findBar->setReplaceProgress(percent);
+    }
+}
+
+void MainWindow::onReplaceFinished(CustomTextWidget *editor, int replacements)
+{
+    if (editor == editorTabs->getCurrentEditor()) {
+        findBar->setReplaceFinished(replacements);
+    }
+}
+
+void MainWindow::showWorkspaceSearch()
+{
+    workspaceSearchPanel->activate();
+}
+
+void MainWindow::onWorkspaceChanged(const QString &path)
+{
+    currentWorkspace = path;
+    workspaceSearchPanel->setWorkspaceRoot(path);
+    rebuildWorkspaceIndex();
+}
+
+void MainWindow::rebuildWorkspaceIndex()
+{
+    workspaceSearchPanel->setWorkspaceIndex(nullptr);
+    quickOpen->setWorkspaceIndex(nullptr);
+    workspaceIndex.reset();
+    if (currentWorkspace.isEmpty()) return;
+
+    // Index updates arrive on worker threads
+    workspaceIndex.reset(new WorkspaceIndex(QDir(currentWorkspace).absolutePath().toStdString(),
+                                            indexContentsAct->isChecked(), [this]() {
+        QMetaObject::invokeMethod(this, [this]() { quickOpen->refresh(); }, Qt::QueuedConnection);
+    }));
+    workspaceSearchPanel->setWorkspaceIndex(workspaceIndex.get());
+    quickOpen->setWorkspaceIndex(workspaceIndex.get());
+}
+
+void MainWindow::showQuickOpen()
+{
+    quickOpen->activate();
+}
+
+void MainWindow::toggleContentIndex(bool enabled)
+{
+    QSettings settings;
+    settings.setValue("indexContents", enabled);
+    rebuildWorkspaceIndex();
+}
+
+void MainWindow::onWorkspaceResultActivated(const QString &filePath, int line, int column)
+{
+    editorTabs->openFile(filePath);
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor) {
+        editor->setCursorPosition(line, column);
+        editor->setFocus();
+    }
+}
+
 void MainWindow::onFileSelected(const QString &filePath)
 {
     editorTabs->openFile(filePath);
@@ -186,6 +364,14 @@ void MainWindow::onActiveFileChanged(const QString &filePath)
 {
     QString displayName = filePath.isEmpty() ? "Untitled" : strippedName(filePath);
     setWindowTitle(QString("Leditor - %1").arg(displayName));
+
+    // Carry an open search over to the newly active tab
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (editor && findBar->isVisible()) {
+        editor->beginSearch();
+        onFindQueryChanged(findBar->getQuery(), findBar->isCaseSensitive(), findBar->isRegex());
+    }
+
     updateStatusBar();
 }
 
@@ -211,6 +397,15 @@ void MainWindow::updateStatusBar()
         status += " [Modified]";
     }
 
+    QString formatName = QString::fromStdString(formatDescription(currentEditor->fileFormat()));
+    if (!formatName.isEmpty()) {
+        status += " [" + formatName + "]";
+    }
+
+    if (currentEditor->isRecordingMacro()) {
+        status += " [Recording macro]";
+    }
+
     statusLabel->setText(status);
 
     int line = currentEditor->getCurrentLine();
@@ -218,6 +413,61 @@ void MainWindow::updateStatusBar()
     positionLabel->setText(tr("Ln %1, Col %2").arg(line).arg(col));
 }
 
+void MainWindow::togglePerfOverlay(bool shown)
+{
+    CustomTextWidget::setPerfOverlayShown(shown);
+    if (CustomTextWidget *editor = editorTabs->getCurrentEditor()) editor->update();
+}
+
+void MainWindow::savePerfStats()
+{
+    CustomTextWidget *editor = editorTabs->getCurrentEditor();
+    if (!editor) return;
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Latency Histograms"),
+                                                    QDir::homePath() + "/leditor-perf.txt");
+    if (fileName.isEmpty()) return;
+    if (!editor->dumpPerfStats(fileName)) {
+        QMessageBox::warning(this, tr("Leditor"), tr("Cannot write file %1.").arg(fileName));
+    }
+}
+
+void MainWindow::showMemoryUsage()
+{
+    MemoryUsage total;
+    QString report;
+    for (int i = 0; i < editorTabs->count(); ++i) {
+        CustomTextWidget *editor = editorTabs->getEditorAt(i);
+        if (!editor) continue;
+        MemoryUsage usage = editor->memoryUsage();
+        total.text += usage.text;
+        total.lineIndex += usage.lineIndex;
+        total.undo += usage.undo;
+        total.layout += usage.layout;
+        total.highlighting += usage.highlighting;
+        report += QString("%1%2\n  %3\n").arg(editorTabs->tabText(i),
+                                              editor->isUnloaded() ? tr(" (unloaded)") : QString(),
+                                              QString::fromStdString(usage.describe()));
+    }
+    report += tr("\nAll documents\n  %1").arg(QString::fromStdString(total.describe()));
+    size_t limit = editorTabs->getMemoryBudget().limit();
+    if (limit > 0) {
+        report += tr("\nBudget %1").arg(QString::fromStdString(PerfStats::formatBytes(limit)));
+    }
+    QMessageBox::information(this, tr("Memory Usage"), report);
+}
+
+void MainWindow::changeMemoryBudget()
+{
+    int megabytes = (int)(editorTabs->getMemoryBudget().limit() >> 20);
+    bool ok = false;
+    megabytes = QInputDialog::getInt(this, tr("Memory Budget"),
+                                     tr("Memory for all open documents, in MB (0 for no limit):"),
+                                     megabytes, 0, 1 << 20, 64, &ok);
+    if (!ok) return;
+    QSettings().setValue("memoryBudgetMB", megabytes);
+    editorTabs->setMemoryBudget((size_t)megabytes << 20);
+}
+
 void MainWindow::createMenus()
 {
 
@@ -235,6 +485,12 @@ void MainWindow::createMenus()
     connect(openAct, &QAction::triggered, this, QOverload<>::of(&MainWindow::openFile));
     fileMenu->addAction(openAct);
 
+    quickOpenAct = new QAction(tr("&Go to File..."), this);
+    quickOpenAct->setShortcut(QKeySequence(tr("Ctrl+P")));
+    quickOpenAct->setStatusTip(tr("Fuzzy search the workspace for a file"));
+    connect(quickOpenAct, &QAction::triggered, this, &MainWindow::showQuickOpen);
+    fileMenu->addAction(quickOpenAct);
+
     openWorkspaceAct = new QAction(tr("Open &Workspace..."), this);
     openWorkspaceAct->setShortcut(QKeySequence(tr("Ctrl+Shift+O")));
     openWorkspaceAct->setStatusTip(tr("Open a folder as workspace"));
@@ -263,6 +519,34 @@ void MainWindow::createMenus()
     connect(exitAct, &QAction::triggered, this, &QWidget::close);
     fileMenu->addAction(exitAct);
 
+    QMenu *editMenu = menuBar()->addMenu(tr("&Edit"));
+
+    findAct = new QAction(tr("&Find..."), this);
+    findAct->setShortcuts(QKeySequence::Find);
+    findAct->setStatusTip(tr("Search the current document"));
+    connect(findAct, &QAction::triggered, this, &MainWindow::showFindBar);
+    editMenu->addAction(findAct);
+
+    findNextAct = new QAction(tr("Find &Next"), this);
+    findNextAct->setShortcuts(QKeySequence::FindNext);
+    findNextAct->setStatusTip(tr("Go to the next match"));
+    connect(findNextAct, &QAction::triggered, this, &MainWindow::findNext);
+    editMenu->addAction(findNextAct);
+
+    findPreviousAct = new QAction(tr("Find &Previous"), this);
+    findPreviousAct->setShortcuts(QKeySequence::FindPrevious);
+    findPreviousAct->setStatusTip(tr("Go to the previous match"));
+    connect(findPreviousAct, &QAction::triggered, this, &MainWindow::findPrevious);
+    editMenu->addAction(findPreviousAct);
+
+    editMenu->addSeparator();
+
+    findInWorkspaceAct = new QAction(tr("Find in &Workspace..."), this);
+    findInWorkspaceAct->setShortcut(QKeySequence(tr("Ctrl+Shift+F")));
+    findInWorkspaceAct->setStatusTip(tr("Search every file in the workspace"));
+    connect(findInWorkspaceAct, &QAction::triggered, this, &MainWindow::showWorkspaceSearch);
+    editMenu->addAction(findInWorkspaceAct);
+
     QMenu *viewMenu = menuBar()->addMenu(tr("&View"));
 
     toggleSidebarAct = new QAction(tr("Toggle &Sidebar"), this);
@@ -271,6 +555,37 @@ void MainWindow::createMenus()
     connect(toggleSidebarAct, &QAction::triggered, this, &MainWindow::toggleSidebar);
     viewMenu->addAction(toggleSidebarAct);
 
+    indexContentsAct = new QAction(tr("&Index Workspace Contents"), this);
+    indexContentsAct->setCheckable(true);
+    indexContentsAct->setChecked(QSettings().value("indexContents", true).toBool());
+    indexContentsAct->setStatusTip(tr("Keep a trigram index of file contents to speed up workspace search"));
+    connect(indexContentsAct, &QAction::toggled, this, &MainWindow::toggleContentIndex);
+    viewMenu->addAction(indexContentsAct);
+
+    viewMenu->addSeparator();
+
+    perfOverlayAct = new QAction(tr("&Performance Overlay"), this);
+    perfOverlayAct->setCheckable(true);
+    perfOverlayAct->setShortcut(QKeySequence(tr("Ctrl+Shift+H")));
+    perfOverlayAct->setStatusTip(tr("Show frame time, key-to-paint latency, edit cost and memory in the editor"));
+    connect(perfOverlayAct, &QAction::toggled, this, &MainWindow::togglePerfOverlay);
+    viewMenu->addAction(perfOverlayAct);
+
+    savePerfStatsAct = new QAction(tr("Save &Latency Histograms..."), this);
+    savePerfStatsAct->setStatusTip(tr("Write this editor's timing histograms to a file"));
+    connect(savePerfStatsAct, &QAction::triggered, this, &MainWindow::savePerfStats);
+    viewMenu->addAction(savePerfStatsAct);
+
+    memoryUsageAct = new QAction(tr("&Memory Usage..."), this);
+    memoryUsageAct->setStatusTip(tr("Show what each open document holds in memory"));
+    connect(memoryUsageAct, &QAction::triggered, this, &MainWindow::showMemoryUsage);
+    viewMenu->addAction(memoryUsageAct);
+
+    memoryBudgetAct = new QAction(tr("Memory &Budget..."), this);
+    memoryBudgetAct->setStatusTip(tr("Limit the memory of all open documents together"));
+    connect(memoryBudgetAct, &QAction::triggered, this, &MainWindow::changeMemoryBudget);
+    viewMenu->addAction(memoryBudgetAct);
+
     QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
 
     aboutAct = new QAction(tr("&About"), this);
@@ -317,6 +632,12 @@ void MainWindow::readSettings()
     if (!splitterState.isEmpty()) {
         mainSplitter->restoreState(splitterState);
     }
+
+    // LEDITOR_MEMORY_BUDGET wins over the saved setting
+    int budgetMB = settings.value("memoryBudgetMB", 0).toInt();
+    if (budgetMB > 0 && !qEnvironmentVariableIsSet("LEDITOR_MEMORY_BUDGET")) {
+        editorTabs->setMemoryBudget((size_t)budgetMB << 20);
+    }
 }
 
 void MainWindow::writeSettings()
@@ -18,6 +18,11 @@
 #include "customtextwidget.h"
 #include "fileexplorer.h"
 #include "editortabs.h"
+#include "findbar.h"
+#include "workspacesearchpanel.h"
+#include "quickopen.h"
+#include "workspaceindex.h"
+#include <memory>
 
 class MainWindow : public QMainWindow
 {
@@ -40,6 +45,25 @@ private slots:
     bool saveAsFile();
     void about();
     void toggleSidebar();
+    void showFindBar();
+    void findNext();
+    void findPrevious();
+    void onFindQueryChanged(const QString &query, bool caseSensitive, bool regex);
+    void onSearchResultsChanged(CustomTextWidget *editor);
+    void onFindBarClosed();
+    void replaceAll(const QString &query, const QString &replacement, bool caseSensitive);
+    void cancelReplace();
+    void onReplaceProgress(CustomTextWidget *editor, int percent);
+    void onReplaceFinished(CustomTextWidget *editor, int replacements);
+    void showWorkspaceSearch();
+    void onWorkspaceChanged(const QString &path);
+    void onWorkspaceResultActivated(const QString &filePath, int line, int column);
+    void showQuickOpen();
+    void toggleContentIndex(bool enabled);
+    void togglePerfOverlay(bool shown);
+    void savePerfStats();
+    void showMemoryUsage();
+    void changeMemoryBudget();
     void onFileSelected(const QString &filePath);
     void onActiveFileChanged(const QString &filePath);
     void onEditorFocusChanged(CustomTextWidget *editor);
@@ -53,11 +77,17 @@ private:
     void writeSettings();
     bool maybeSave();
     QString strippedName(const QString &fullFileName);
+    void rebuildWorkspaceIndex();
 
     // UI Components
     QSplitter *mainSplitter;
     FileExplorer *fileExplorer;
     EditorTabs *editorTabs;
+    FindBar *findBar;
+    QSplitter *editorSplitter;
+    WorkspaceSearchPanel *workspaceSearchPanel;
+    QuickOpen *quickOpen;
+    std::unique_ptr<WorkspaceIndex> workspaceIndex;
     
     // Status bar
     QLabel *statusLabel;
@@ -75,6 +105,16 @@ private:
     QAction *exitAct;
     QAction *aboutAct;
     QAction *toggleSidebarAct;
+    QAction *findAct;
+    QAction *findNextAct;
+    QAction *findPreviousAct;
+    QAction *findInWorkspaceAct;
+    QAction *quickOpenAct;
+    QAction *indexContentsAct;
+    QAction *perfOverlayAct;
+    QAction *savePerfStatsAct;
+    QAction *memoryUsageAct;
+    QAction *memoryBudgetAct;
 };
 
 #endif // MAINWINDOW_H 
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "quickopen.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+static const int MAX_RESULTS = 50;
+
+QuickOpen::QuickOpen(QWidget *parent)
+    : QWidget(parent)
+    , workspaceIndex(nullptr)
+{
+    setupUI();
+
+    setStyleSheet(R"(
+        QWidget {
+            background-color: #252526;
+            color: #ffffff;
+        }
+        QuickOpen {
+            border: 1px solid #454545;
+        }
+        QLineEdit {
+            background-color: #3c3c3c;
+            color: #ffffff;
+            border: 1px solid #0078d4;
+            padding: 6px;
+            font-size: 13px;
+        }
+        QLabel {
+            color: #969696;
+            padding: 2px 4px;
+            font-size: 11px;
+        }
+        QListWidget {
+            background-color: #252526;
+            color: #d4d4d4;
+            border: none;
+            outline: none;
+            font-size: 12px;
+        }
+        QListWidget::item {
+            padding: 4px;
+        }
+        QListWidget::item:selected {
+            background-color: #04395e;
+        }
+    )");
+
+    hide();
+}
+
+void QuickOpen::setupUI()
+{
+    setAttribute(Qt::WA_StyledBackground, true);
+
+    mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(6, 6, 6, 6);
+    mainLayout->setSpacing(4);
+
+    queryEdit = new QLineEdit();
+    queryEdit->setPlaceholderText("Go to file");
+    queryEdit->installEventFilter(this);
+
+    statusLabel = new QLabel();
+
+    resultList = new QListWidget();
+    resultList->setUniformItemSizes(true);
+    resultList->setFocusPolicy(Qt::NoFocus);
+
+    mainLayout->addWidget(queryEdit);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(resultList, 1);
+
+    connect(queryEdit, &QLineEdit::textChanged, this, &QuickOpen::updateResults);
+    connect(resultList, &QListWidget::itemActivated, this, &QuickOpen::onItemActivated);
+    connect(resultList, &QListWidget::itemClicked, this, &QuickOpen::onItemActivated);
+}
+
+void QuickOpen::setWorkspaceIndex(WorkspaceIndex *index)
+{
+    workspaceIndex = index;
+    if (isVisible()) {
+        updateResults();
+    }
+}
+
+void QuickOpen::activate()
+{
+    placeOverParent();
+    show();
+    raise();
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+    updateResults();
+}
+
+void QuickOpen::refresh()
+{
+    if (isVisible()) {
+        updateResults();
+    }
+}
+
+void QuickOpen::placeOverParent()
+{
+    QWidget *host = parentWidget();
+    if (!host) return;
+
+    int width = qMin(600, host->width() - 40);
+    int height = qMin(420, host->height() - 80);
+    setGeometry((host->width() - width) / 2, 40, width, height);
+}
+
+void QuickOpen::dismiss()
+{
+    hide();
+    if (parentWidget()) {
+        parentWidget()->setFocus();
+    }
+}
+
+void QuickOpen::updateResults()
+{
+    resultList->clear();
+    if (!workspaceIndex) {
+        statusLabel->setText("Open a workspace to search files");
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<FileMatch> matches = workspaceIndex->findFiles(queryEdit->text().toStdString(), MAX_RESULTS);
+    qint64 micros = timer.nsecsElapsed() / 1000;
+
+    for (const FileMatch &match : matches) {
+        QString relative = QString::fromStdString(match.relativePath);
+        QFileInfo info(relative);
+        QString dir = info.path() == "." ? QString() : info.path();
+
+        QListWidgetItem *item = new QListWidgetItem(dir.isEmpty() ? info.fileName()
+                                                                  : info.fileName() + "    " + dir);
+        item->setData(Qt::UserRole, relative);
+        item->setToolTip(relative);
+        resultList->addItem(item);
+    }
+    if (resultList->count() > 0) {
+        resultList->setCurrentRow(0);
+    }
+
+    QString status = QString("%1 files").arg(workspaceIndex->pathCount());
+    if (!workspaceIndex->isPathIndexReady()) {
+        status += ", indexing...";
+    }
+    statusLabel->setText(QString("%1 · %2 ms").arg(status).arg(micros / 1000.0, 0, 'f', 1));
+}
+
+void QuickOpen::onItemActivated(QListWidgetItem *item)
+{
+    if (!item || !workspaceIndex) return;
+
+    QString relative = item->data(Qt::UserRole).toString();
+    QString root = QString::fromStdString(workspaceIndex->rootPath());
+    dismiss();
+    emit fileChosen(root + "/" + relative);
+}
+
+bool QuickOpen::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == queryEdit && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        int row = resultList->currentRow();
+        switch (keyEvent->key()) {
+        case Qt::Key_Escape:
+            dismiss();
+            return true;
+        case Qt::Key_Down:
+            if (row + 1 < resultList->count()) resultList->setCurrentRow(row + 1);
+            return true;
+        case Qt::Key_Up:
+            if (row > 0) resultList->setCurrentRow(row - 1);
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            onItemActivated(resultList->currentItem());
+            return true;
+        default:
+            break;
+        }
+    } else if (watched == queryEdit && event->type() == QEvent::FocusOut) {
+        // Clicking a result moves focus nowhere (NoFocus list), anything else closes
+        if (!resultList->underMouse()) {
+            hide();
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
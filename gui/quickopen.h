@@ -0,0 +1,46 @@
+#ifndef QUICKOPEN_H
+#define QUICKOPEN_H
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QLabel>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+#include "workspaceindex.h"
+
+class QuickOpen : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit QuickOpen(QWidget *parent = nullptr);
+
+    void setWorkspaceIndex(WorkspaceIndex *index);
+    void activate();
+    void refresh();
+
+signals:
+    void fileChosen(const QString &filePath);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void updateResults();
+    void onItemActivated(QListWidgetItem *item);
+
+private:
+    void setupUI();
+    void placeOverParent();
+    void dismiss();
+
+    QVBoxLayout *mainLayout;
+    QLineEdit *queryEdit;
+    QLabel *statusLabel;
+    QListWidget *resultList;
+
+    WorkspaceIndex *workspaceIndex;
+};
+
+#endif // QUICKOPEN_H
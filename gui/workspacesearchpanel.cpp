@@ -0,0 +1,205 @@
+#include "workspacesearchpanel.h"
+#include <QDir>
+
+static const int PathRole = Qt::UserRole;
+static const int LineRole = Qt::UserRole + 1;
+static const int ColumnRole = Qt::UserRole + 2;
+
+WorkspaceSearchPanel::WorkspaceSearchPanel(QWidget *parent)
+    : QWidget(parent)
+    , workspaceIndex(nullptr)
+    , generation(0)
+    , resultCount(0)
+{
+    setupUI();
+
+    setStyleSheet(R"(
+        QWidget {
+            background-color: #252526;
+            color: #ffffff;
+        }
+        QLineEdit {
+            background-color: #3c3c3c;
+            color: #ffffff;
+            border: 1px solid #555555;
+            padding: 4px;
+            font-size: 12px;
+        }
+        QLineEdit:focus {
+            border-color: #0078d4;
+        }
+        QLabel {
+            color: #969696;
+            padding: 0px 8px;
+        }
+        QListWidget {
+            background-color: #1e1e1e;
+            color: #d4d4d4;
+            border: none;
+            outline: none;
+            font-family: "Monaco", "Menlo", monospace;
+            font-size: 12px;
+        }
+        QListWidget::item {
+            padding: 2px 4px;
+        }
+        QListWidget::item:hover {
+            background-color: #2a2d2e;
+        }
+        QListWidget::item:selected {
+            background-color: #0078d4;
+        }
+    )");
+
+    hide();
+}
+
+WorkspaceSearchPanel::~WorkspaceSearchPanel()
+{
+    stopSearch();
+}
+
+void WorkspaceSearchPanel::setupUI()
+{
+    mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(8, 4, 8, 4);
+    mainLayout->setSpacing(4);
+
+    queryLayout = new QHBoxLayout();
+    queryLayout->setSpacing(4);
+
+    queryEdit = new QLineEdit();
+    queryEdit->setPlaceholderText("Find in workspace");
+
+    caseCheckBox = new QCheckBox("Aa");
+    caseCheckBox->setToolTip("Match case");
+
+    statusLabel = new QLabel();
+    statusLabel->setMinimumWidth(160);
+
+    queryLayout->addWidget(queryEdit, 1);
+    queryLayout->addWidget(caseCheckBox);
+    queryLayout->addWidget(statusLabel);
+
+    resultList = new QListWidget();
+    resultList->setUniformItemSizes(true);
+
+    mainLayout->addLayout(queryLayout);
+    mainLayout->addWidget(resultList, 1);
+
+    connect(queryEdit, &QLineEdit::returnPressed, this, &WorkspaceSearchPanel::startSearch);
+    connect(caseCheckBox, &QCheckBox::toggled, this, &WorkspaceSearchPanel::startSearch);
+    connect(resultList, &QListWidget::itemActivated, this, &WorkspaceSearchPanel::onItemActivated);
+}
+
+void WorkspaceSearchPanel::setWorkspaceRoot(const QString &path)
+{
+    stopSearch();
+    workspaceRoot = path;
+    resultList->clear();
+    statusLabel->clear();
+}
+
+void WorkspaceSearchPanel::activate()
+{
+    show();
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+}
+
+void WorkspaceSearchPanel::stopSearch()
+{
+    // Bumping the generation drops batches already queued from the old job
+    generation++;
+    searchJob.reset();
+}
+
+void WorkspaceSearchPanel::startSearch()
+{
+    stopSearch();
+    resultList->clear();
+    resultCount = 0;
+
+    QString query = queryEdit->text();
+    if (query.isEmpty()) {
+        statusLabel->clear();
+        return;
+    }
+    if (workspaceRoot.isEmpty()) {
+        statusLabel->setText("No workspace open");
+        return;
+    }
+
+    statusLabel->setText("Searching...");
+    elapsed.start();
+
+    quint64 current = generation;
+    auto callback = [this, current](std::vector<WorkspaceMatch> batch, bool finished) {
+        auto results = std::make_shared<std::vector<WorkspaceMatch>>(std::move(batch));
+        QMetaObject::invokeMethod(this, [this, current, results, finished]() {
+            onBatch(current, *results, finished);
+        }, Qt::QueuedConnection);
+    };
+
+    std::string root = QDir(workspaceRoot).absolutePath().toStdString();
+    std::string text = query.toStdString();
+
+    // The content index narrows the search to files containing every trigram
+    std::vector<std::string> candidates;
+    if (workspaceIndex && workspaceIndex->contentCandidates(text, candidates)) {
+        searchJob.reset(new WorkspaceSearch(root, text, caseCheckBox->isChecked(),
+                                            std::move(candidates), callback));
+    } else {
+        searchJob.reset(new WorkspaceSearch(root, text, caseCheckBox->isChecked(), callback));
+    }
+}
+
+void WorkspaceSearchPanel::onBatch(quint64 batchGeneration, const std::vector<WorkspaceMatch> &batch, bool finished)
+{
+    if (batchGeneration != generation) return;
+
+    resultList->setUpdatesEnabled(false);
+    for (const WorkspaceMatch &match : batch) {
+        QString text = QString::fromUtf8(match.lineText.data(), (int)match.lineText.size()).trimmed();
+        QListWidgetItem *item = new QListWidgetItem(
+            QString("%1:%2: %3").arg(QString::fromStdString(match.relativePath)).arg(match.line + 1).arg(text));
+        item->setData(PathRole, QString::fromStdString(match.path));
+        item->setData(LineRole, match.line);
+        item->setData(ColumnRole, match.column);
+        resultList->addItem(item);
+    }
+    resultList->setUpdatesEnabled(true);
+    resultCount += (int)batch.size();
+
+    updateStatus(finished);
+}
+
+void WorkspaceSearchPanel::updateStatus(bool finished)
+{
+    if (!finished) {
+        statusLabel->setText(QString("%1 results...").arg(resultCount));
+        return;
+    }
+
+    size_t files = searchJob ? searchJob->filesSearched() : 0;
+    statusLabel->setText(QString("%1 results in %2 files (%3 ms)")
+                             .arg(resultCount).arg(files).arg(elapsed.elapsed()));
+}
+
+void WorkspaceSearchPanel::onItemActivated(QListWidgetItem *item)
+{
+    emit resultActivated(item->data(PathRole).toString(),
+                         item->data(LineRole).toInt(),
+                         item->data(ColumnRole).toInt());
+}
+
+void WorkspaceSearchPanel::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape) {
+        stopSearch();
+        hide();
+        emit closed();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
@@ -0,0 +1,62 @@
+#ifndef WORKSPACESEARCHPANEL_H
+#define WORKSPACESEARCHPANEL_H
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QElapsedTimer>
+#include <memory>
+#include <vector>
+#include "workspacesearch.h"
+#include "workspaceindex.h"
+
+class WorkspaceSearchPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit WorkspaceSearchPanel(QWidget *parent = nullptr);
+    ~WorkspaceSearchPanel();
+
+    void setWorkspaceRoot(const QString &path);
+    void setWorkspaceIndex(WorkspaceIndex *index) { workspaceIndex = index; }
+    void activate();
+
+signals:
+    void resultActivated(const QString &filePath, int line, int column);
+    void closed();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void startSearch();
+    void onItemActivated(QListWidgetItem *item);
+
+private:
+    void setupUI();
+    void stopSearch();
+    void onBatch(quint64 generation, const std::vector<WorkspaceMatch> &batch, bool finished);
+    void updateStatus(bool finished);
+
+    QVBoxLayout *mainLayout;
+    QHBoxLayout *queryLayout;
+    QLineEdit *queryEdit;
+    QCheckBox *caseCheckBox;
+    QLabel *statusLabel;
+    QListWidget *resultList;
+
+    QString workspaceRoot;
+    WorkspaceIndex *workspaceIndex;
+    std::unique_ptr<WorkspaceSearch> searchJob;
+    quint64 generation;
+    int resultCount;
+    QElapsedTimer elapsed;
+};
+
+#endif // WORKSPACESEARCHPANEL_H
@@ -0,0 +1,249 @@
+#include "batchscript.h"
+#include "traceevents.h"
+#include "memorybudget.h"
+#include "replaceall.h"
+#include "search.h"
+#include "textcodec.h"
+#include "threadpool.h"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+// Reads a double-quoted string at pos, leaving pos after the closing quote
+static bool readQuoted(std::string_view line, size_t &pos, std::string &out) {
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) pos++;
+    if (pos >= line.size() || line[pos] != '"') return false;
+    out.clear();
+    for (pos++; pos < line.size(); pos++) {
+        char c = line[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c == '\\' && pos + 1 < line.size()) {
+            char next = line[++pos];
+            out += next == 'n' ? '\n' : next == 't' ? '\t' : next;
+        } else {
+            out += c;
+        }
+    }
+    return false;
+}
+
+static bool readWord(std::string_view line, size_t &pos, std::string &out) {
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) pos++;
+    size_t start = pos;
+    while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t') pos++;
+    out.assign(line.substr(start, pos - start));
+    return !out.empty();
+}
+
+static bool readNumber(std::string_view line, size_t &pos, int &value) {
+    std::string word;
+    if (!readWord(line, pos, word)) return false;
+    value = 0;
+    for (char c : word) {
+        if (c < '0' || c > '9' || value > 100000000) return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+static bool atEnd(std::string_view line, size_t pos) {
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r')) pos++;
+    return pos == line.size() || line[pos] == '#';
+}
+
+bool BatchScript::parse(std::string_view text, std::string &error) {
+    commands.clear();
+    std::vector<std::string> lines = TextBuffer::splitLines(text, true);
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::string_view line = lines[i];
+        size_t pos = 0;
+        std::string name;
+        if (atEnd(line, 0)) continue;
+        readWord(line, pos, name);
+
+        Command command = {Op::Save, (int)i + 1, 0, 0, 1, {}, {}};
+        bool ok = true;
+        if (name == "goto") {
+            command.op = Op::Goto;
+            size_t save = pos;
+            std::string word;
+            if (readWord(line, save, word) && word == "$") {
+                command.targetLine = -1;
+                pos = save;
+            } else {
+                ok = readNumber(line, pos, command.targetLine) && command.targetLine > 0;
+            }
+            if (ok && !atEnd(line, pos)) ok = readNumber(line, pos, command.targetColumn) && command.targetColumn > 0;
+        } else if (name == "find") {
+            command.op = Op::Find;
+            ok = readQuoted(line, pos, command.text) && !command.text.empty();
+        } else if (name == "insert") {
+            command.op = Op::Insert;
+            ok = readQuoted(line, pos, command.text);
+        } else if (name == "newline") {
+            command.op = Op::Newline;
+        } else if (name == "delete") {
+            command.op = Op::Delete;
+            if (!atEnd(line, pos)) ok = readNumber(line, pos, command.count);
+        } else if (name == "replace") {
+            command.op = Op::Replace;
+            ok = readQuoted(line, pos, command.text) && !command.text.empty() &&
+                 readQuoted(line, pos, command.replacement);
+        } else if (name == "save") {
+            command.op = Op::Save;
+        } else if (name == "memory") {
+            command.op = Op::Memory;
+        } else {
+            error = "line " + std::to_string(i + 1) + ": unknown command '" + name + "'";
+            return false;
+        }
+        if (!ok || !atEnd(line, pos)) {
+            error = "line " + std::to_string(i + 1) + ": bad arguments to " + name;
+            return false;
+        }
+        commands.push_back(std::move(command));
+    }
+    return true;
+}
+
+bool BatchScript::run(TextBuffer &buffer, CursorSet &cursors, const SaveCallback &save, std::string &output,
+                      std::string &error) const {
+    for (const Command &command : commands) {
+        TextPosition cursor = cursors.primary().head;
+        switch (command.op) {
+            case Op::Goto: {
+                int y = command.targetLine < 0 ? buffer.lineCount() - 1 : command.targetLine - 1;
+                if (y >= buffer.lineCount()) {
+                    error = "line " + std::to_string(command.line) + ": no line " + std::to_string(command.targetLine);
+                    return false;
+                }
+                int x = std::max(0, command.targetColumn - 1);
+                cursors.reset({y, std::min(x, buffer.lineLength(y))});
+                break;
+            }
+
+            case Op::Find: {
+                // Forward only: a script should stop rather than edit some
+                // earlier match
+                bool caseSensitive = hasUppercase(command.text);
+                bool found = false;
+                for (int y = cursor.line; y < buffer.lineCount() && !found; y++) {
+                    size_t from = y == cursor.line ? cursor.column : 0;
+                    size_t column = findText(buffer.line(y), command.text, from, caseSensitive);
+                    if (column != std::string_view::npos) {
+                        cursors.reset({y, (int)column});
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    error = "line " + std::to_string(command.line) + ": \"" + command.text + "\" not found";
+                    return false;
+                }
+                break;
+            }
+
+            case Op::Insert:
+                cursors.insertText(buffer, command.text);
+                break;
+
+            case Op::Newline:
+                cursors.insertText(buffer, "\n");
+                break;
+
+            case Op::Delete:
+                for (int i = 0; i < command.count; i++) cursors.deleteBackward(buffer);
+                break;
+
+            case Op::Replace: {
+                std::vector<LineRewrite> rewrites;
+                collectReplacements(buffer, 0, buffer.lineCount(), command.text, command.replacement,
+                                    hasUppercase(command.text), rewrites);
+                buffer.rewriteLines(std::move(rewrites));
+                cursors.reset({cursor.line, std::min(cursor.column, buffer.lineLength(cursor.line))});
+                break;
+            }
+
+            case Op::Save:
+                if (!save(buffer)) {
+                    error = "line " + std::to_string(command.line) + ": cannot write";
+                    return false;
+                }
+                break;
+
+            case Op::Memory: {
+                MemoryUsage usage;
+                buffer.addMemoryUsage(usage);
+                output += "line " + std::to_string(command.line) + ": " + usage.describe() + "\n";
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool BatchScript::runOnFile(const std::string &path, std::string &output, std::string &error) const {
+    LineArena lines;
+    FileFormat format;
+    if (!readTextFile(path, lines, format)) {
+        error = "cannot read";
+        return false;
+    }
+    TextBuffer buffer;
+    buffer.setLines(std::move(lines));
+    CursorSet cursors;
+
+    return run(buffer, cursors, [&](const TextBuffer &text) { return writeTextFile(path, text, format); }, output,
+               error);
+}
+
+int BatchScript::runOnFiles(const std::vector<std::string> &paths) const {
+    std::mutex reportMutex;
+    int failed = 0;
+    ThreadPool pool;
+    for (const std::string &path : paths) {
+        pool.submit([this, &path, &reportMutex, &failed]() {
+            TRACE_SCOPE("batch file");
+            std::string output, error;
+            bool ok = runOnFile(path, output, error);
+            std::lock_guard<std::mutex> lock(reportMutex);
+            for (size_t start = 0; start < output.size();) {
+                size_t end = output.find('\n', start);
+                printf("%s: %.*s\n", path.c_str(), (int)(end - start), output.data() + start);
+                start = end + 1;
+            }
+            if (ok) return;
+            fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+            failed++;
+        });
+    }
+    pool.wait();
+    return failed;
+}
+
+int runBatch(int argc, char *argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: leditor --batch SCRIPT FILE...\n");
+        return 2;
+    }
+    std::ifstream file(argv[0], std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "%s: cannot read script\n", argv[0]);
+        return 2;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    BatchScript script;
+    std::string error;
+    if (!script.parse(text.str(), error)) {
+        fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+        return 2;
+    }
+
+    std::vector<std::string> paths(argv + 1, argv + argc);
+    return script.runOnFiles(paths) > 0 ? 1 : 0;
+}
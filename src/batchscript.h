@@ -0,0 +1,64 @@
+#ifndef BATCHSCRIPT_H
+#define BATCHSCRIPT_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+#include "cursorset.h"
+
+// A small editing language for running the editor without a terminal, one
+// command per line (# starts a comment, text arguments are double quoted
+// with \n, \t, \" and \\ escapes):
+//
+//   goto LINE [COLUMN]   move the cursor; 1-based like the status bar, $ is
+//                        the last line
+//   find "TEXT"          move to the next occurrence at or after the cursor
+//   insert "TEXT"        type TEXT at the cursor, line breaks included
+//   newline              press Enter
+//   delete [N]           press Backspace N times (default 1)
+//   replace "FIND" "WITH" replace every occurrence in the file
+//   save                 write the file back in its own encoding, as it is
+//                        at that point of the script
+//   memory               print the memory the document takes, by component
+//
+// Edits go through the same CursorSet operations as the interactive
+// editors, and find and replace use the same smart case, so a script does
+// exactly what the keys would.
+class BatchScript {
+public:
+    bool parse(std::string_view text, std::string &error);
+
+    using SaveCallback = std::function<bool(const TextBuffer &buffer)>;
+
+    // Runs the commands on a buffer; false (with the reason) if a goto or
+    // find could not be carried out or a save failed. Each save calls save
+    // with the buffer as it is then; memory adds a line to output.
+    bool run(TextBuffer &buffer, CursorSet &cursors, const SaveCallback &save, std::string &output,
+             std::string &error) const;
+    // Reads the file and runs the commands, writing it back at each save
+    bool runOnFile(const std::string &path, std::string &output, std::string &error) const;
+    // Runs on every file in parallel; returns the number that failed,
+    // each reported on stderr. Output goes to stdout, a file at a time.
+    int runOnFiles(const std::vector<std::string> &paths) const;
+
+private:
+    enum class Op { Goto, Find, Insert, Newline, Delete, Replace, Save, Memory };
+    struct Command {
+        Op op;
+        int line;          // script line, for errors
+        int targetLine;    // goto; -1 for the last line
+        int targetColumn;
+        int count;         // delete
+        std::string text;
+        std::string replacement;
+    };
+
+    std::vector<Command> commands;
+};
+
+// `leditor --batch SCRIPT FILE...`
+int runBatch(int argc, char *argv[]);
+
+#endif // BATCHSCRIPT_H
@@ -0,0 +1,156 @@
+#include "blockcodec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Sequences of literals then a match (offset, length) as in LZ4: a token
+// with both lengths in 4 bits each, longer ones continued in 255 steps
+static const int HASH_BITS = 16;
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+// The format ends every block in literals: matches end at least 5 bytes
+// before the end and start at least 12 before it
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hashOf(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void putLength(std::string &out, size_t length) {
+    for (length -= 15; length >= 255; length -= 255) out += (char)255;
+    out += (char)length;
+}
+
+static void putSequence(std::string &out, const unsigned char *literals, size_t literalLength, size_t offset,
+                        size_t matchLength) {
+    size_t token = out.size();
+    out += '\0';
+    if (literalLength >= 15) putLength(out, literalLength);
+    out.append((const char *)literals, literalLength);
+    unsigned char bits = (unsigned char)(std::min<size_t>(literalLength, 15) << 4);
+    if (matchLength > 0) {
+        out += (char)(offset & 0xFF);
+        out += (char)(offset >> 8);
+        matchLength -= MIN_MATCH;
+        if (matchLength >= 15) putLength(out, matchLength);
+        bits |= (unsigned char)std::min<size_t>(matchLength, 15);
+    }
+    out[token] = (char)bits;
+}
+
+std::string compressBlock(std::string_view input) {
+    const unsigned char *base = (const unsigned char *)input.data();
+    size_t size = input.size();
+    std::string out;
+    out.reserve(size / 2 + 16);
+
+    size_t anchor = 0;
+    if (size > MATCH_LIMIT) {
+        // Last position of each hashed 4-byte sequence
+        std::vector<uint32_t> table(1 << HASH_BITS, 0);
+        size_t limit = size - MATCH_LIMIT;
+        size_t matchEndLimit = size - LAST_LITERALS;
+        size_t pos = 1;
+        while (pos < limit) {
+            uint32_t sequence = read32(base + pos);
+            uint32_t &slot = table[hashOf(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)pos;
+            if (pos - candidate > MAX_OFFSET || read32(base + candidate) != sequence) {
+                // Text that does not repeat is skipped over faster and faster
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            while (pos > anchor && candidate > 0 && base[pos - 1] == base[candidate - 1]) {
+                pos--;
+                candidate--;
+            }
+            // Eight bytes at a time, then byte by byte up to the limit
+            size_t end = pos + MIN_MATCH;
+            size_t offset = pos - candidate;
+            bool differs = false;
+            while (end + 8 <= matchEndLimit) {
+                uint64_t difference = read64(base + end) ^ read64(base + end - offset);
+                if (difference) {
+                    end += __builtin_ctzll(difference) / 8;
+                    differs = true;
+                    break;
+                }
+                end += 8;
+            }
+            while (!differs && end < matchEndLimit && base[end] == base[end - offset]) end++;
+
+            putSequence(out, base + anchor, pos - anchor, offset, end - pos);
+            anchor = pos = end;
+            if (pos < limit) table[hashOf(read32(base + pos - 2))] = (uint32_t)(pos - 2);
+        }
+    }
+    putSequence(out, base + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool decompressBlock(std::string_view packed, char *out, size_t size) {
+    const unsigned char *in = (const unsigned char *)packed.data();
+    const unsigned char *inEnd = in + packed.size();
+    char *op = out;
+    char *opEnd = out + size;
+    auto readLength = [&](size_t &length) {
+        unsigned char byte;
+        do {
+            if (in >= inEnd) return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < inEnd) {
+        unsigned token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals)) return false;
+        if (literals > (size_t)(inEnd - in) || literals > (size_t)(opEnd - op)) return false;
+        // Short runs are copied as a fixed 16 bytes where there is room
+        if (literals <= 16 && inEnd - in >= 16 && opEnd - op >= 16) {
+            memcpy(op, in, 16);
+        } else {
+            memcpy(op, in, literals);
+        }
+        op += literals;
+        in += literals;
+        // The last sequence is literals alone
+        if (in == inEnd) break;
+
+        if (inEnd - in < 2) return false;
+        size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length)) return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - out) || length > (size_t)(opEnd - op)) return false;
+        const char *match = op - offset;
+        if (offset >= 8 && (size_t)(opEnd - op) >= length + 8) {
+            // Eight bytes at a time, which also repeats runs of 8 or more
+            for (size_t i = 0; i < length; i += 8) memcpy(op + i, match + i, 8);
+        } else {
+            // Near the end, or a run repeating the last few bytes
+            for (size_t i = 0; i < length; i++) op[i] = match[i];
+        }
+        op += length;
+    }
+    return op == opEnd;
+}
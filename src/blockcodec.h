@@ -0,0 +1,18 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A fast LZ77 codec in the LZ4 block format, for keeping text that is not
+// being looked at compressed in memory. It trades ratio for speed: a
+// megabyte block of text decompresses in a millisecond or two.
+
+std::string compressBlock(std::string_view input);
+
+// Fills exactly size bytes at out; false if packed is not a block of that
+// size
+bool decompressBlock(std::string_view packed, char *out, size_t size);
+
+#endif // BLOCKCODEC_H
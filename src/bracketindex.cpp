@@ -0,0 +1,460 @@
+#include "bracketindex.h"
+#include "highlighter.h"
+#include <algorithm>
+
+static const size_t CHUNK_LINES = 256;
+static const size_t MAX_CHUNK_LINES = 512;
+static const size_t MIN_CHUNK_LINES = 64;
+
+static const int BLOCK_KIND = 2;  // { }
+
+// Summary of an empty range
+static void clearSummary(int *net, int *minPrefix, int kinds) {
+    std::fill(net, net + kinds, 0);
+    std::fill(minPrefix, minPrefix + kinds, 0);
+}
+
+BracketIndex::BracketIndex()
+    : syntax(nullptr)
+    , built(false)
+    , seenVersion(0)
+    , leaves(0)
+{
+}
+
+int BracketIndex::bracketKind(char c, bool *opening) {
+    int kind = -1;
+    bool open = false;
+    switch (c) {
+        case '(': kind = 0; open = true; break;
+        case ')': kind = 0; break;
+        case '[': kind = 1; open = true; break;
+        case ']': kind = 1; break;
+        case '{': kind = 2; open = true; break;
+        case '}': kind = 2; break;
+    }
+    if (opening) *opening = open;
+    return kind;
+}
+
+void BracketIndex::setSyntax(const SyntaxDefinition *newSyntax) {
+    if (newSyntax != syntax) {
+        syntax = newSyntax;
+        built = false;
+    }
+}
+
+size_t BracketIndex::memoryUsage() const {
+    size_t bytes = chunks.capacity() * sizeof(Chunk) + tree.capacity() * sizeof(TreeNode);
+    for (const Chunk &chunk : chunks) bytes += chunk.lines.capacity() * sizeof(Summary) + chunk.stale.capacity() / 8;
+    return bytes + dirtyChunks.capacity() * sizeof(int) + changes.capacity() * sizeof(LineChange);
+}
+
+void BracketIndex::dropCache() {
+    chunks = std::vector<Chunk>();
+    dirtyChunks = std::vector<int>();
+    tree = std::vector<TreeNode>();
+    changes = std::vector<LineChange>();
+    built = false;
+}
+
+void BracketIndex::codeMask(std::string_view text, std::vector<bool> &codeColumns) {
+    codeColumns.assign(text.size(), true);
+    if (!syntax) return;
+
+    std::vector<StyleRun> runs;
+    Highlighter::lexLine(*syntax, text, Highlighter::INITIAL_STATE, runs);
+    for (const StyleRun &run : runs) {
+        if (run.style == TokenStyle::String || run.style == TokenStyle::Comment) {
+            std::fill(codeColumns.begin() + run.start, codeColumns.begin() + run.start + run.length, false);
+        }
+    }
+}
+
+BracketIndex::Summary BracketIndex::summarizeLine(std::string_view text) {
+    Summary summary;
+    clearSummary(summary.net, summary.minPrefix, KINDS);
+
+    // Most lines have no brackets at all
+    if (text.find_first_of("()[]{}") == std::string_view::npos) return summary;
+
+    codeMask(text, mask);
+    for (size_t i = 0; i < text.size(); i++) {
+        bool opening;
+        int kind = bracketKind(text[i], &opening);
+        if (kind < 0 || !mask[i]) continue;
+
+        summary.net[kind] += opening ? 1 : -1;
+        summary.minPrefix[kind] = std::min(summary.minPrefix[kind], summary.net[kind]);
+    }
+    return summary;
+}
+
+// Summary of range a followed by range b; the output may alias a
+static void combine(const int *aNet, const int *aMin, const int *bNet, const int *bMin,
+                    int *net, int *minPrefix, int kinds) {
+    for (int k = 0; k < kinds; k++) {
+        int combinedMin = std::min(aMin[k], aNet[k] + bMin[k]);
+        net[k] = aNet[k] + bNet[k];
+        minPrefix[k] = combinedMin;
+    }
+}
+
+void BracketIndex::rebuild(const TextBuffer &buffer) {
+    chunks.clear();
+    for (int line = 0; line < buffer.lineCount(); line++) {
+        if (chunks.empty() || chunks.back().lines.size() >= CHUNK_LINES) {
+            chunks.emplace_back();
+            chunks.back().dirty = false;
+        }
+        chunks.back().lines.push_back(summarizeLine(buffer.line(line)));
+        chunks.back().stale.push_back(false);
+    }
+    for (Chunk &chunk : chunks) {
+        clearSummary(chunk.total.net, chunk.total.minPrefix, KINDS);
+        for (const Summary &summary : chunk.lines) {
+            combine(chunk.total.net, chunk.total.minPrefix, summary.net, summary.minPrefix,
+                    chunk.total.net, chunk.total.minPrefix, KINDS);
+        }
+    }
+    dirtyChunks.clear();
+    built = true;
+    seenVersion = buffer.version();
+    rebuildTree();
+}
+
+void BracketIndex::sync(const TextBuffer &buffer) {
+    if (!built) {
+        rebuild(buffer);
+        return;
+    }
+    if (buffer.version() == seenVersion) return;
+
+    changes.clear();
+    if (!buffer.changesSince(seenVersion, changes)) {
+        rebuild(buffer);
+        return;
+    }
+
+    // Replay the edits as placeholders first; the buffer only holds the
+    // final text, so changed lines are summarized afterwards
+    for (const LineChange &change : changes) {
+        applyChange(change);
+    }
+    seenVersion = buffer.version();
+    refresh(buffer);
+}
+
+void BracketIndex::markDirty(int index) {
+    if (!chunks[index].dirty) {
+        chunks[index].dirty = true;
+        dirtyChunks.push_back(index);
+    }
+    updateLeaf(index);
+}
+
+void BracketIndex::applyChange(const LineChange &change) {
+    int offset;
+    int index = locate(change.first, offset);
+
+    // Take out the removed lines, which may run over several chunks
+    int remaining = change.removed;
+    int chunk = index;
+    int position = offset;
+    while (remaining > 0 && chunk < (int)chunks.size()) {
+        Chunk &current = chunks[chunk];
+        int count = std::min(remaining, (int)current.lines.size() - position);
+        current.lines.erase(current.lines.begin() + position, current.lines.begin() + position + count);
+        current.stale.erase(current.stale.begin() + position, current.stale.begin() + position + count);
+        markDirty(chunk);
+        remaining -= count;
+        chunk++;
+        position = 0;
+    }
+
+    Summary placeholder;
+    clearSummary(placeholder.net, placeholder.minPrefix, KINDS);
+    Chunk &target = chunks[index];
+    target.lines.insert(target.lines.begin() + offset, change.added, placeholder);
+    target.stale.insert(target.stale.begin() + offset, change.added, true);
+    markDirty(index);
+}
+
+void BracketIndex::refresh(const TextBuffer &buffer) {
+    bool unbalanced = false;
+    for (int index : dirtyChunks) {
+        Chunk &chunk = chunks[index];
+        int line = chunkStart(index);
+        clearSummary(chunk.total.net, chunk.total.minPrefix, KINDS);
+        for (size_t i = 0; i < chunk.lines.size(); i++) {
+            if (chunk.stale[i]) {
+                chunk.lines[i] = summarizeLine(buffer.line(line + (int)i));
+                chunk.stale[i] = false;
+            }
+            combine(chunk.total.net, chunk.total.minPrefix, chunk.lines[i].net, chunk.lines[i].minPrefix,
+                    chunk.total.net, chunk.total.minPrefix, KINDS);
+        }
+        chunk.dirty = false;
+        updateLeaf(index);
+
+        size_t size = chunk.lines.size();
+        if (size > MAX_CHUNK_LINES || (size < MIN_CHUNK_LINES && chunks.size() > 1)) unbalanced = true;
+    }
+    dirtyChunks.clear();
+
+    if (unbalanced) {
+        rebalance();
+    }
+}
+
+// Keeps chunks between MIN and MAX lines so the tree stays shallow and each
+// chunk stays cheap to rescan. Rare, so it simply rebuilds the tree.
+void BracketIndex::rebalance() {
+    std::vector<Chunk> balanced;
+    balanced.reserve(chunks.size() + 1);
+
+    for (Chunk &chunk : chunks) {
+        if (chunk.lines.empty()) continue;
+
+        Chunk *previous = balanced.empty() ? nullptr : &balanced.back();
+        if (previous && (chunk.lines.size() < MIN_CHUNK_LINES || previous->lines.size() < MIN_CHUNK_LINES) &&
+            previous->lines.size() + chunk.lines.size() <= MAX_CHUNK_LINES) {
+            previous->lines.insert(previous->lines.end(), chunk.lines.begin(), chunk.lines.end());
+            previous->stale.insert(previous->stale.end(), chunk.stale.begin(), chunk.stale.end());
+            combine(previous->total.net, previous->total.minPrefix, chunk.total.net, chunk.total.minPrefix,
+                    previous->total.net, previous->total.minPrefix, KINDS);
+            continue;
+        }
+        if (chunk.lines.size() > MAX_CHUNK_LINES) {
+            for (size_t start = 0; start < chunk.lines.size(); start += CHUNK_LINES) {
+                size_t end = std::min(start + CHUNK_LINES, chunk.lines.size());
+                Chunk piece;
+                piece.lines.assign(chunk.lines.begin() + start, chunk.lines.begin() + end);
+                piece.stale.assign(end - start, false);
+                piece.dirty = false;
+                clearSummary(piece.total.net, piece.total.minPrefix, KINDS);
+                for (const Summary &summary : piece.lines) {
+                    combine(piece.total.net, piece.total.minPrefix, summary.net, summary.minPrefix,
+                            piece.total.net, piece.total.minPrefix, KINDS);
+                }
+                balanced.push_back(std::move(piece));
+            }
+            continue;
+        }
+        balanced.push_back(std::move(chunk));
+    }
+    chunks = std::move(balanced);
+    rebuildTree();
+}
+
+void BracketIndex::rebuildTree() {
+    leaves = 1;
+    while (leaves < (int)chunks.size()) leaves *= 2;
+
+    tree.assign(2 * leaves, TreeNode());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        tree[leaves + i].summary = chunks[i].total;
+        tree[leaves + i].lines = (int)chunks[i].lines.size();
+    }
+    for (int node = leaves - 1; node >= 1; node--) {
+        const TreeNode &left = tree[2 * node];
+        const TreeNode &right = tree[2 * node + 1];
+        combine(left.summary.net, left.summary.minPrefix, right.summary.net, right.summary.minPrefix,
+                tree[node].summary.net, tree[node].summary.minPrefix, KINDS);
+        tree[node].lines = left.lines + right.lines;
+    }
+}
+
+void BracketIndex::updateLeaf(int index) {
+    int node = leaves + index;
+    tree[node].summary = chunks[index].total;
+    tree[node].lines = (int)chunks[index].lines.size();
+    for (node /= 2; node >= 1; node /= 2) {
+        const TreeNode &left = tree[2 * node];
+        const TreeNode &right = tree[2 * node + 1];
+        combine(left.summary.net, left.summary.minPrefix, right.summary.net, right.summary.minPrefix,
+                tree[node].summary.net, tree[node].summary.minPrefix, KINDS);
+        tree[node].lines = left.lines + right.lines;
+    }
+}
+
+int BracketIndex::locate(int line, int &offset) const {
+    // A line just past the end lands at the end of the last chunk
+    if (line >= tree[1].lines) {
+        int last = (int)chunks.size() - 1;
+        offset = (int)chunks[last].lines.size();
+        return last;
+    }
+
+    int node = 1;
+    while (node < leaves) {
+        if (line < tree[2 * node].lines) {
+            node = 2 * node;
+        } else {
+            line -= tree[2 * node].lines;
+            node = 2 * node + 1;
+        }
+    }
+    offset = line;
+    return node - leaves;
+}
+
+int BracketIndex::chunkStart(int index) const {
+    int start = 0;
+    for (int node = leaves + index; node > 1; node /= 2) {
+        if (node & 1) start += tree[node - 1].lines;
+    }
+    return start;
+}
+
+// First chunk at or after from where the running depth drops below zero;
+// depth is advanced over every chunk skipped
+int BracketIndex::descendForward(int node, int low, int high, int from, int kind, int &depth) const {
+    if (high < from || low >= (int)chunks.size()) return -1;
+    if (low >= from && depth + tree[node].summary.minPrefix[kind] >= 0) {
+        depth += tree[node].summary.net[kind];
+        return -1;
+    }
+    if (low == high) return low;
+
+    int middle = (low + high) / 2;
+    int found = descendForward(2 * node, low, middle, from, kind, depth);
+    if (found >= 0) return found;
+    return descendForward(2 * node + 1, middle + 1, high, from, kind, depth);
+}
+
+// Same walking backwards from to: closers raise the depth, openers lower it
+int BracketIndex::descendBackward(int node, int low, int high, int to, int kind, int &depth) const {
+    if (low > to) return -1;
+    const Summary &summary = tree[node].summary;
+    if (high <= to && depth + summary.minPrefix[kind] - summary.net[kind] >= 0) {
+        depth -= summary.net[kind];
+        return -1;
+    }
+    if (low == high) return low;
+
+    int middle = (low + high) / 2;
+    int found = descendBackward(2 * node + 1, middle + 1, high, to, kind, depth);
+    if (found >= 0) return found;
+    return descendBackward(2 * node, low, middle, to, kind, depth);
+}
+
+bool BracketIndex::searchForward(const TextBuffer &buffer, int kind, int line, int column, BracketPosition &match) {
+    int depth = 0;
+    auto scanLine = [&](int y, int start) {
+        std::string_view text = buffer.line(y);
+        codeMask(text, mask);
+        for (int x = start; x < (int)text.size(); x++) {
+            bool opening;
+            if (bracketKind(text[x], &opening) != kind || !mask[x]) continue;
+            depth += opening ? 1 : -1;
+            if (depth < 0) {
+                match = {y, x};
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (scanLine(line, column + 1)) return true;
+
+    // The rest of this chunk line by line, then whole chunks through the tree
+    int offset;
+    int index = locate(line, offset);
+    const Chunk &chunk = chunks[index];
+    for (int i = offset + 1; i < (int)chunk.lines.size(); i++) {
+        if (depth + chunk.lines[i].minPrefix[kind] < 0) return scanLine(line - offset + i, 0);
+        depth += chunk.lines[i].net[kind];
+    }
+
+    int found = descendForward(1, 0, leaves - 1, index + 1, kind, depth);
+    if (found < 0) return false;
+    const Chunk &target = chunks[found];
+    for (int i = 0; i < (int)target.lines.size(); i++) {
+        if (depth + target.lines[i].minPrefix[kind] < 0) return scanLine(chunkStart(found) + i, 0);
+        depth += target.lines[i].net[kind];
+    }
+    return false;
+}
+
+bool BracketIndex::searchBackward(const TextBuffer &buffer, int kind, int line, int column, BracketPosition &match) {
+    int depth = 0;
+    auto scanLine = [&](int y, int start) {
+        std::string_view text = buffer.line(y);
+        codeMask(text, mask);
+        for (int x = std::min(start, (int)text.size() - 1); x >= 0; x--) {
+            bool opening;
+            if (bracketKind(text[x], &opening) != kind || !mask[x]) continue;
+            depth += opening ? -1 : 1;
+            if (depth < 0) {
+                match = {y, x};
+                return true;
+            }
+        }
+        return false;
+    };
+    auto lineBackwardMin = [&](const Summary &summary) { return summary.minPrefix[kind] - summary.net[kind]; };
+
+    if (scanLine(line, column - 1)) return true;
+
+    int offset;
+    int index = locate(line, offset);
+    const Chunk &chunk = chunks[index];
+    for (int i = offset - 1; i >= 0; i--) {
+        if (depth + lineBackwardMin(chunk.lines[i]) < 0) return scanLine(line - offset + i, INT32_MAX);
+        depth -= chunk.lines[i].net[kind];
+    }
+    if (index == 0) return false;
+
+    int found = descendBackward(1, 0, leaves - 1, index - 1, kind, depth);
+    if (found < 0) return false;
+    const Chunk &target = chunks[found];
+    for (int i = (int)target.lines.size() - 1; i >= 0; i--) {
+        if (depth + lineBackwardMin(target.lines[i]) < 0) return scanLine(chunkStart(found) + i, INT32_MAX);
+        depth -= target.lines[i].net[kind];
+    }
+    return false;
+}
+
+bool BracketIndex::findMatch(const TextBuffer &buffer, int line, int column, BracketPosition &match) {
+    if (line < 0 || line >= buffer.lineCount() || column < 0 || column >= buffer.lineLength(line)) return false;
+
+    std::string_view text = buffer.line(line);
+    bool opening;
+    int kind = bracketKind(text[column], &opening);
+    if (kind < 0) return false;
+
+    codeMask(text, mask);
+    if (!mask[column]) return false;
+
+    sync(buffer);
+    return opening ? searchForward(buffer, kind, line, column, match)
+                   : searchBackward(buffer, kind, line, column, match);
+}
+
+bool BracketIndex::enclosingBlock(const TextBuffer &buffer, int line, int column, BracketPosition &open,
+                                  BracketPosition &close) {
+    if (line < 0 || line >= buffer.lineCount()) return false;
+
+    sync(buffer);
+    column = std::min(column, buffer.lineLength(line));
+    return searchBackward(buffer, BLOCK_KIND, line, column, open) &&
+           searchForward(buffer, BLOCK_KIND, open.line, open.column, close);
+}
+
+bool BracketIndex::foldableBlock(const TextBuffer &buffer, int line, BracketPosition &open,
+                                 BracketPosition &close) {
+    if (line < 0 || line >= buffer.lineCount()) return false;
+
+    std::string_view text = buffer.line(line);
+    for (int x = (int)text.size() - 1; x >= 0; x--) {
+        if (text[x] != '{') continue;
+        BracketPosition match;
+        if (findMatch(buffer, line, x, match) && match.line > line) {
+            open = {line, x};
+            close = match;
+            return true;
+        }
+    }
+    return enclosingBlock(buffer, line, 0, open, close);
+}
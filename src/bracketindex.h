@@ -0,0 +1,97 @@
+#ifndef BRACKETINDEX_H
+#define BRACKETINDEX_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+
+struct SyntaxDefinition;
+
+struct BracketPosition {
+    int line;
+    int column;
+};
+
+// Finds matching brackets and enclosing blocks without scanning from the
+// top. Every line keeps, per bracket kind, its net depth change and the
+// lowest depth reached inside it. Lines are grouped into chunks and a
+// segment tree over the chunks combines those sums, so a search skips whole
+// subtrees that cannot hold the match and only scans the one line that
+// does: O(log n) plus the length of that line. Brackets inside strings and
+// comments on the same line are ignored.
+class BracketIndex {
+public:
+    BracketIndex();
+
+    void setSyntax(const SyntaxDefinition *syntax);
+
+    // Heap bytes of the line summaries; dropCache forgets them until the
+    // next lookup rebuilds them
+    size_t memoryUsage() const;
+    void dropCache();
+
+    // Bracket matching the one at (line, column)
+    bool findMatch(const TextBuffer &buffer, int line, int column, BracketPosition &match);
+    // Innermost {...} around (line, column)
+    bool enclosingBlock(const TextBuffer &buffer, int line, int column, BracketPosition &open,
+                        BracketPosition &close);
+    // Block to fold from line: the last { on it that closes on a later
+    // line, otherwise the innermost block around the line
+    bool foldableBlock(const TextBuffer &buffer, int line, BracketPosition &open, BracketPosition &close);
+
+    static int bracketKind(char c, bool *opening = nullptr);
+
+private:
+    static const int KINDS = 3;
+
+    struct Summary {
+        int net[KINDS];
+        int minPrefix[KINDS];  // lowest depth reached, relative to the start, <= 0
+    };
+
+    struct Chunk {
+        std::vector<Summary> lines;
+        std::vector<bool> stale;
+        bool dirty;
+        Summary total;
+    };
+
+    struct TreeNode {
+        Summary summary;
+        int lines;
+    };
+
+    void sync(const TextBuffer &buffer);
+    void rebuild(const TextBuffer &buffer);
+    void applyChange(const LineChange &change);
+    void markDirty(int index);
+    void refresh(const TextBuffer &buffer);
+    void rebalance();
+    void rebuildTree();
+    void updateLeaf(int index);
+
+    Summary summarizeLine(std::string_view text);
+    void codeMask(std::string_view text, std::vector<bool> &mask);
+    int locate(int line, int &offset) const;
+    int chunkStart(int index) const;
+
+    bool searchForward(const TextBuffer &buffer, int kind, int line, int column, BracketPosition &match);
+    bool searchBackward(const TextBuffer &buffer, int kind, int line, int column, BracketPosition &match);
+    int descendForward(int node, int low, int high, int from, int kind, int &depth) const;
+    int descendBackward(int node, int low, int high, int to, int kind, int &depth) const;
+
+    const SyntaxDefinition *syntax;
+    bool built;
+    uint64_t seenVersion;
+
+    std::vector<Chunk> chunks;
+    std::vector<int> dirtyChunks;
+    std::vector<TreeNode> tree;     // segment tree over chunks, root at 1
+    int leaves;
+
+    std::vector<LineChange> changes;
+    std::vector<bool> mask;
+};
+
+#endif // BRACKETINDEX_H
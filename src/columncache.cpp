@@ -0,0 +1,103 @@
+#include "columncache.h"
+#include <algorithm>
+#include "utf8.h"
+
+ColumnCache::ColumnCache() : entries(SLOTS), seenVersion(0), synced(false) {
+    for (Entry &entry : entries) entry.line = -1;
+}
+
+size_t ColumnCache::memoryUsage() const {
+    size_t bytes = entries.capacity() * sizeof(Entry) + changes.capacity() * sizeof(LineChange);
+    for (const Entry &entry : entries) bytes += (entry.offsets.capacity() + entry.columns.capacity()) * sizeof(int);
+    return bytes;
+}
+
+void ColumnCache::clear() {
+    for (Entry &entry : entries) {
+        entry.line = -1;
+        entry.offsets = std::vector<int>();
+        entry.columns = std::vector<int>();
+    }
+    changes = std::vector<LineChange>();
+}
+
+void ColumnCache::sync(const TextBuffer &buffer) {
+    if (synced && buffer.version() == seenVersion) return;
+
+    changes.clear();
+    bool shifted = !synced || !buffer.changesSince(seenVersion, changes);
+    for (const LineChange &change : changes) {
+        if (change.removed != change.added) {
+            shifted = true;
+            break;
+        }
+        for (int line = change.first; line < change.first + change.removed; line++) {
+            Entry &entry = entries[line % SLOTS];
+            if (entry.line == line) entry.line = -1;
+        }
+    }
+    if (shifted) {
+        // Lines moved; cheaper to forget everything than to renumber
+        for (Entry &entry : entries) entry.line = -1;
+    }
+    seenVersion = buffer.version();
+    synced = true;
+}
+
+const ColumnCache::Entry &ColumnCache::entry(const TextBuffer &buffer, int line) {
+    sync(buffer);
+    Entry &entry = entries[line % SLOTS];
+    if (entry.line == line) return entry;
+
+    std::string_view text = buffer.line(line);
+    entry.line = line;
+    entry.ascii = isAsciiText(text);
+    entry.offsets.clear();
+    entry.columns.clear();
+    if (!entry.ascii) {
+        int column = 0;
+        for (size_t offset = 0; offset < text.size();) {
+            size_t next = nextGraphemeBoundary(text, offset);
+            entry.offsets.push_back((int)offset);
+            entry.columns.push_back(column);
+            column += graphemeWidth(text, offset, next);
+            offset = next;
+        }
+        entry.offsets.push_back((int)text.size());
+        entry.columns.push_back(column);
+    }
+    return entry;
+}
+
+int ColumnCache::clusterIndex(const Entry &entry, int offset) const {
+    auto it = std::upper_bound(entry.offsets.begin(), entry.offsets.end(), offset);
+    return std::max((int)(it - entry.offsets.begin()) - 1, 0);
+}
+
+int ColumnCache::column(const TextBuffer &buffer, int line, int offset) {
+    const Entry &found = entry(buffer, line);
+    if (found.ascii) return std::min(offset, buffer.lineLength(line));
+    return found.columns[clusterIndex(found, offset)];
+}
+
+int ColumnCache::offsetAt(const TextBuffer &buffer, int line, int column) {
+    const Entry &found = entry(buffer, line);
+    if (found.ascii) return std::max(std::min(column, buffer.lineLength(line)), 0);
+    auto it = std::upper_bound(found.columns.begin(), found.columns.end(), column);
+    int index = std::max((int)(it - found.columns.begin()) - 1, 0);
+    return found.offsets[index];
+}
+
+int ColumnCache::nextOffset(const TextBuffer &buffer, int line, int offset) {
+    const Entry &found = entry(buffer, line);
+    int length = buffer.lineLength(line);
+    if (found.ascii || offset >= length) return std::min(offset + 1, length);
+    return found.offsets[clusterIndex(found, offset) + 1];
+}
+
+int ColumnCache::previousOffset(const TextBuffer &buffer, int line, int offset) {
+    const Entry &found = entry(buffer, line);
+    if (offset <= 0) return 0;
+    if (found.ascii) return offset - 1;
+    return found.offsets[clusterIndex(found, offset - 1)];
+}
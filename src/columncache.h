@@ -0,0 +1,48 @@
+#ifndef COLUMNCACHE_H
+#define COLUMNCACHE_H
+
+#include <cstdint>
+#include <vector>
+#include "textbuffer.h"
+
+// Maps byte offsets in lines to display columns and grapheme boundaries.
+// ASCII lines (almost all of them) answer from the offset itself. Other
+// lines are split into clusters once and kept in a small table of recently
+// used lines, so moving the cursor along a line does not rescan it; edits
+// from the buffer journal drop only the entries they touch.
+class ColumnCache {
+public:
+    ColumnCache();
+
+    // Column where the cluster holding offset starts
+    int column(const TextBuffer &buffer, int line, int offset);
+    // Start of the cluster covering column, or the line end past the last one
+    int offsetAt(const TextBuffer &buffer, int line, int column);
+    // Neighbouring cluster boundaries, clamped to the line
+    int nextOffset(const TextBuffer &buffer, int line, int offset);
+    int previousOffset(const TextBuffer &buffer, int line, int offset);
+
+    size_t memoryUsage() const;
+    void clear();
+
+private:
+    struct Entry {
+        int line;                   // -1 when unused
+        bool ascii;
+        std::vector<int> offsets;   // cluster starts, then the line length
+        std::vector<int> columns;   // column of each of those offsets
+    };
+
+    static const int SLOTS = 64;
+
+    const Entry &entry(const TextBuffer &buffer, int line);
+    int clusterIndex(const Entry &entry, int offset) const;
+    void sync(const TextBuffer &buffer);
+
+    std::vector<Entry> entries;
+    uint64_t seenVersion;
+    bool synced;
+    std::vector<LineChange> changes;
+};
+
+#endif // COLUMNCACHE_H
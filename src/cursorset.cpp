@@ -0,0 +1,230 @@
+#include "cursorset.h"
+#include "search.h"
+#include "utf8.h"
+#include <algorithm>
+
+static bool isWordByte(unsigned char c) {
+    return c == '_' || c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+CursorSet::CursorSet() : primaryIndex(0) {
+    cursors.push_back({{0, 0}, {0, 0}});
+}
+
+void CursorSet::reset(TextPosition position) {
+    cursors.assign(1, {position, position});
+    primaryIndex = 0;
+}
+
+void CursorSet::add(const Selection &selection) {
+    cursors.push_back(selection);
+    primaryIndex = cursors.size() - 1;
+    normalize();
+}
+
+size_t CursorSet::firstOnLine(int line) const {
+    return std::lower_bound(cursors.begin(), cursors.end(), line,
+                            [](const Selection &cursor, int y) { return cursor.end().line < y; }) -
+           cursors.begin();
+}
+
+void CursorSet::normalize() {
+    TextPosition primaryHead = cursors[primaryIndex].head;
+    std::sort(cursors.begin(), cursors.end(),
+              [](const Selection &a, const Selection &b) { return a.start() < b.start(); });
+
+    // Overlapping selections, and cursors at the same spot, become one
+    size_t kept = 0;
+    for (size_t i = 1; i < cursors.size(); i++) {
+        Selection &last = cursors[kept];
+        const Selection &next = cursors[i];
+        bool overlaps = next.start() < last.end() ||
+                        (next.start() == last.end() && (next.isEmpty() || last.isEmpty()));
+        if (!overlaps) {
+            cursors[++kept] = cursors[i];
+            continue;
+        }
+        TextPosition start = last.start();
+        TextPosition end = last.end() < next.end() ? next.end() : last.end();
+        bool backward = last.head < last.anchor;
+        last.anchor = backward ? end : start;
+        last.head = backward ? start : end;
+    }
+    cursors.resize(kept + 1);
+
+    // The primary is whichever cursor now holds its head
+    primaryIndex = 0;
+    while (primaryIndex + 1 < cursors.size() && !(primaryHead < cursors[primaryIndex + 1].start())) {
+        primaryIndex++;
+    }
+}
+
+void CursorSet::applyEdits(TextBuffer &buffer, std::vector<TextEdit> &edits) {
+    // Edits from neighbouring cursors can overlap (a selection and the
+    // character deleted just after it); those are merged
+    size_t kept = 0;
+    for (size_t i = 1; i < edits.size(); i++) {
+        if (edits[i].start < edits[kept].end) {
+            if (edits[kept].end < edits[i].end) edits[kept].end = edits[i].end;
+            edits[kept].text += edits[i].text;
+        } else if (++kept != i) {
+            edits[kept] = std::move(edits[i]);
+        }
+    }
+    if (!edits.empty()) edits.resize(kept + 1);
+
+    std::vector<TextPosition> ends;
+    buffer.applyEdits(edits, &ends);
+
+    // One sweep carries every cursor over the edits before it: a cursor in
+    // or at the end of an edit lands where its text ends, one after it
+    // moves by the lines added so far and, on the same line, the columns
+    size_t next = 0;
+    for (Selection &cursor : cursors) {
+        TextPosition position = cursor.end();
+        while (next < edits.size() && edits[next].end < position) next++;
+
+        TextPosition mapped = position;
+        if (next < edits.size() && !(position < edits[next].start)) {
+            mapped = ends[next];
+        } else if (next > 0) {
+            const TextEdit &before = edits[next - 1];
+            const TextPosition &end = ends[next - 1];
+            if (position.line == before.end.line) {
+                mapped = {end.line, end.column + position.column - before.end.column};
+            } else {
+                mapped = {position.line + end.line - before.end.line, position.column};
+            }
+        }
+        cursor.anchor = cursor.head = mapped;
+    }
+    normalize();
+}
+
+void CursorSet::insertText(TextBuffer &buffer, std::string_view text) {
+    std::vector<TextEdit> edits;
+    edits.reserve(cursors.size());
+    for (const Selection &cursor : cursors) {
+        edits.push_back({cursor.start(), cursor.end(), std::string(text)});
+    }
+    applyEdits(buffer, edits);
+}
+
+void CursorSet::deleteBackward(TextBuffer &buffer) {
+    std::vector<TextEdit> edits;
+    edits.reserve(cursors.size());
+    for (const Selection &cursor : cursors) {
+        TextPosition start = cursor.start(), end = cursor.end();
+        if (cursor.isEmpty()) {
+            if (start.column > 0) {
+                start.column = (int)previousGraphemeBoundary(buffer.line(start.line), start.column);
+            } else if (start.line > 0) {
+                start = {start.line - 1, buffer.lineLength(start.line - 1)};
+            } else {
+                continue;
+            }
+        }
+        edits.push_back({start, end, std::string()});
+    }
+    applyEdits(buffer, edits);
+}
+
+bool CursorSet::hasSelection() const {
+    return std::any_of(cursors.begin(), cursors.end(), [](const Selection &cursor) { return !cursor.isEmpty(); });
+}
+
+TextClip CursorSet::copySelections(const TextBuffer &buffer) const {
+    if (cursors.size() == 1) return buffer.copyRange(cursors[0].start(), cursors[0].end());
+
+    std::string text;
+    for (size_t i = 0; i < cursors.size(); i++) {
+        if (i > 0) text += '\n';
+        text += buffer.copyRange(cursors[i].start(), cursors[i].end()).toString();
+    }
+    return TextClip::fromText(text);
+}
+
+void CursorSet::paste(TextBuffer &buffer, const TextClip &clip) {
+    if (cursors.size() > 1) {
+        insertText(buffer, clip.toString());
+        return;
+    }
+    Selection cursor = cursors[0];
+    if (!cursor.isEmpty()) buffer.applyEdits({{cursor.start(), cursor.end(), std::string()}});
+    reset(buffer.insertClip(cursor.start(), clip));
+}
+
+void CursorSet::moveEach(const std::function<void(TextPosition &)> &step, bool extend) {
+    for (Selection &cursor : cursors) {
+        step(cursor.head);
+        if (!extend) cursor.anchor = cursor.head;
+    }
+    normalize();
+}
+
+bool CursorSet::selectWord(const TextBuffer &buffer) {
+    Selection &cursor = cursors[primaryIndex];
+    std::string_view line = buffer.line(cursor.head.line);
+    int start = cursor.head.column, end = cursor.head.column;
+    while (start > 0 && isWordByte(line[start - 1])) start--;
+    while (end < (int)line.size() && isWordByte(line[end])) end++;
+    if (start == end) return false;
+    cursor.anchor = {cursor.head.line, start};
+    cursor.head = {cursor.head.line, end};
+    normalize();
+    return true;
+}
+
+bool CursorSet::addNextOccurrence(const TextBuffer &buffer) {
+    const Selection &current = cursors[primaryIndex];
+    if (current.isEmpty()) return selectWord(buffer);
+    if (current.anchor.line != current.head.line) return false;
+
+    TextPosition start = current.start(), end = current.end();
+    std::string needle(buffer.line(start.line).substr(start.column, end.column - start.column));
+
+    // Forward from the newest cursor, wrapping once around the buffer
+    int lines = buffer.lineCount();
+    for (int step = 0; step <= lines; step++) {
+        int y = (end.line + step) % lines;
+        std::string_view line = buffer.line(y);
+        size_t from = step == 0 ? end.column : 0;
+        size_t found;
+        while ((found = findText(line, needle, from)) != std::string_view::npos) {
+            if (step == lines && (int)found >= start.column) return false;
+            TextPosition position = {y, (int)found};
+            size_t index = firstOnLine(y);
+            while (index < cursors.size() && cursors[index].end() < position) index++;
+            bool taken = index < cursors.size() && !(position < cursors[index].start());
+            if (!taken) {
+                add({position, {y, (int)(found + needle.size())}});
+                return true;
+            }
+            from = found + 1;
+        }
+    }
+    return false;
+}
+
+int CursorSet::selectAllOccurrences(const TextBuffer &buffer) {
+    if (cursors[primaryIndex].isEmpty() && !selectWord(buffer)) return 0;
+    const Selection &current = cursors[primaryIndex];
+    if (current.anchor.line != current.head.line) return count();
+
+    TextPosition start = current.start(), end = current.end();
+    std::string needle(buffer.line(start.line).substr(start.column, end.column - start.column));
+
+    std::vector<Selection> found;
+    primaryIndex = 0;
+    for (int y = 0; y < buffer.lineCount(); y++) {
+        std::string_view line = buffer.line(y);
+        size_t from = 0, offset;
+        while ((offset = findText(line, needle, from)) != std::string_view::npos) {
+            found.push_back({{y, (int)offset}, {y, (int)(offset + needle.size())}});
+            if (y == start.line && (int)offset == start.column) primaryIndex = found.size() - 1;
+            from = offset + needle.size();
+        }
+    }
+    cursors.swap(found);
+    return count();
+}
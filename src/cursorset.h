@@ -0,0 +1,73 @@
+#ifndef CURSORSET_H
+#define CURSORSET_H
+
+#include <functional>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+#include "textclip.h"
+
+// A cursor and the text it has selected: anchor is where the selection
+// started, head is where the cursor is. Empty when the two are equal.
+struct Selection {
+    TextPosition anchor;
+    TextPosition head;
+
+    bool isEmpty() const { return anchor == head; }
+    TextPosition start() const { return head < anchor ? head : anchor; }
+    TextPosition end() const { return head < anchor ? anchor : head; }
+};
+
+// Any number of cursors, kept sorted and never overlapping. Edits from all
+// of them are applied to the buffer as one sorted batch, and the cursors are
+// carried to where their text ended up by the same sweep, so typing with
+// 10k cursors costs one pass over the buffer rather than 10k edits.
+class CursorSet {
+public:
+    CursorSet();
+
+    // Back to a single cursor at position
+    void reset(TextPosition position);
+    void add(const Selection &selection);
+
+    int count() const { return (int)cursors.size(); }
+    const std::vector<Selection> &selections() const { return cursors; }
+    const Selection &primary() const { return cursors[primaryIndex]; }
+    // More than one cursor, or a selection that edits have to replace
+    bool isActive() const { return cursors.size() > 1 || !cursors[0].isEmpty(); }
+    // Index of the first cursor whose selection reaches line
+    size_t firstOnLine(int line) const;
+
+    // Replaces every selection (or inserts at every cursor) with text
+    void insertText(TextBuffer &buffer, std::string_view text);
+    // Deletes every selection, or the grapheme before each empty cursor,
+    // joining lines at column 0
+    void deleteBackward(TextBuffer &buffer);
+
+    bool hasSelection() const;
+    // Text of the selections, joined by line breaks when there are several
+    TextClip copySelections(const TextBuffer &buffer) const;
+    // Pastes at every cursor, replacing selections. With one cursor the clip
+    // is spliced in whole, sharing its lines.
+    void paste(TextBuffer &buffer, const TextClip &clip);
+
+    // Moves every head with step; without extend the selections collapse
+    // onto the new heads. Cursors that land together merge.
+    void moveEach(const std::function<void(TextPosition &)> &step, bool extend);
+
+    // Selects the word at the primary cursor, or with a selection already
+    // there adds a cursor on the next occurrence of its text
+    bool addNextOccurrence(const TextBuffer &buffer);
+    // A cursor on every occurrence of the primary selection (or word)
+    int selectAllOccurrences(const TextBuffer &buffer);
+
+private:
+    void applyEdits(TextBuffer &buffer, std::vector<TextEdit> &edits);
+    void normalize();
+    bool selectWord(const TextBuffer &buffer);
+
+    std::vector<Selection> cursors;
+    size_t primaryIndex;
+};
+
+#endif // CURSORSET_H
@@ -0,0 +1,119 @@
+#include "dirreader.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static const size_t GETDENTS_BUFFER_SIZE = 64 * 1024;
+#endif
+
+static DirEntry::Type typeFromDType(unsigned char type) {
+    switch (type) {
+        case DT_REG: return DirEntry::File;
+        case DT_DIR: return DirEntry::Directory;
+        case DT_LNK: return DirEntry::Symlink;
+        case DT_UNKNOWN: return DirEntry::Unknown;
+        default: return DirEntry::Other;
+    }
+}
+
+static bool isDotEntry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+#ifdef __linux__
+
+DirReader::DirReader(const std::string &path)
+    : bufferPos(0), bufferEnd(0), exhausted(false) {
+    fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) exhausted = true;
+}
+
+DirReader::~DirReader() {
+    if (fd >= 0) close(fd);
+}
+
+bool DirReader::isOpen() const {
+    return fd >= 0;
+}
+
+bool DirReader::readBatch(std::vector<DirEntry> &entries, size_t maxEntries) {
+    size_t added = 0;
+    while (added < maxEntries) {
+        if (bufferPos >= bufferEnd) {
+            if (exhausted) return false;
+            buffer.resize(GETDENTS_BUFFER_SIZE);
+            long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (n <= 0) {
+                exhausted = true;
+                return false;
+            }
+            bufferPos = 0;
+            bufferEnd = n;
+        }
+
+        const linux_dirent64 *d = (const linux_dirent64 *)(buffer.data() + bufferPos);
+        bufferPos += d->d_reclen;
+        if (isDotEntry(d->d_name)) continue;
+
+        entries.push_back({d->d_name, typeFromDType(d->d_type)});
+        added++;
+    }
+    return true;
+}
+
+#else
+
+DirReader::DirReader(const std::string &path)
+    : exhausted(false) {
+    dir = opendir(path.c_str());
+    if (!dir) exhausted = true;
+}
+
+DirReader::~DirReader() {
+    if (dir) closedir((DIR *)dir);
+}
+
+bool DirReader::isOpen() const {
+    return dir != nullptr;
+}
+
+bool DirReader::readBatch(std::vector<DirEntry> &entries, size_t maxEntries) {
+    size_t added = 0;
+    while (added < maxEntries) {
+        if (exhausted) return false;
+        struct dirent *d = readdir((DIR *)dir);
+        if (!d) {
+            exhausted = true;
+            return false;
+        }
+        if (isDotEntry(d->d_name)) continue;
+
+        entries.push_back({d->d_name, typeFromDType(d->d_type)});
+        added++;
+    }
+    return true;
+}
+
+#endif
+
+DirEntry::Type DirReader::resolveType(const std::string &path) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) return DirEntry::Other;
+    if (S_ISREG(st.st_mode)) return DirEntry::File;
+    if (S_ISDIR(st.st_mode)) return DirEntry::Directory;
+    if (S_ISLNK(st.st_mode)) return DirEntry::Symlink;
+    return DirEntry::Other;
+}
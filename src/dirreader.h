@@ -0,0 +1,45 @@
+#ifndef DIRREADER_H
+#define DIRREADER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct DirEntry {
+    enum Type { File, Directory, Symlink, Other, Unknown };
+
+    std::string name;
+    Type type;
+};
+
+// Streams the entries of one directory in batches without stat'ing them.
+// Uses getdents64 with a large buffer on Linux and readdir elsewhere; the
+// entry type comes from d_type and is Unknown on filesystems without it.
+class DirReader {
+public:
+    explicit DirReader(const std::string &path);
+    ~DirReader();
+
+    DirReader(const DirReader &) = delete;
+    DirReader &operator=(const DirReader &) = delete;
+
+    bool isOpen() const;
+    // Appends up to maxEntries entries ("." and ".." skipped), returns false
+    // once the directory is exhausted
+    bool readBatch(std::vector<DirEntry> &entries, size_t maxEntries = (size_t)-1);
+
+    // Resolves Unknown entries with an lstat
+    static DirEntry::Type resolveType(const std::string &path);
+
+private:
+#ifdef __linux__
+    int fd;
+    std::vector<char> buffer;
+    size_t bufferPos, bufferEnd;
+#else
+    void *dir;
+#endif
+    bool exhausted;
+};
+
+#endif // DIRREADER_H
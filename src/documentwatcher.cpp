@@ -0,0 +1,86 @@
+#include "documentwatcher.h"
+#include <climits>
+#include <cstdlib>
+#include <set>
+
+static std::string parentDirectory(const std::string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+DocumentWatcher::DocumentWatcher(Callback documentCallback)
+    : callback(std::move(documentCallback))
+{
+    watcher.reset(new FileWatcher([this](const std::vector<FileEvent> &events) { onEvents(events); }));
+}
+
+DocumentWatcher::~DocumentWatcher() {
+    // Stop the reader thread before the maps it looks at go away
+    watcher.reset();
+}
+
+std::string DocumentWatcher::canonicalPath(const std::string &path) {
+    // The file itself may not exist yet, so resolve its directory
+    std::string directory = parentDirectory(path);
+    char resolved[PATH_MAX];
+    if (!realpath(directory.c_str(), resolved)) return path;
+
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::string result(resolved);
+    if (result != "/") result += '/';
+    return result + name;
+}
+
+void DocumentWatcher::watch(const std::string &path) {
+    std::string canonical = canonicalPath(path);
+    std::string directory = parentDirectory(canonical);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    documents.emplace(canonical, path);
+    if (directories[directory]++ == 0) {
+        watcher->addWatch(directory);
+    }
+}
+
+void DocumentWatcher::unwatch(const std::string &path) {
+    std::string canonical = canonicalPath(path);
+    std::string directory = parentDirectory(canonical);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = documents.equal_range(canonical);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == path) {
+            documents.erase(it);
+            auto dir = directories.find(directory);
+            if (dir != directories.end() && --dir->second == 0) {
+                watcher->removeWatch(directory);
+                directories.erase(dir);
+            }
+            return;
+        }
+    }
+}
+
+void DocumentWatcher::onEvents(const std::vector<FileEvent> &events) {
+    // A save usually arrives as several events; report each document once
+    std::set<std::string> changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const FileEvent &event : events) {
+            if (event.type == FileEvent::Overflow) {
+                for (const auto &document : documents) changed.insert(document.second);
+                continue;
+            }
+            auto range = documents.equal_range(event.path);
+            for (auto it = range.first; it != range.second; ++it) {
+                changed.insert(it->second);
+            }
+        }
+    }
+
+    for (const std::string &path : changed) {
+        callback(path);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef DOCUMENTWATCHER_H
+#define DOCUMENTWATCHER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "filewatcher.h"
+
+// Reports when open documents change on disk. Files are watched through
+// their parent directories so editors that save by writing a new file and
+// renaming it over the old one are still noticed. The callback runs on the
+// watcher thread with the path that was passed to watch().
+class DocumentWatcher {
+public:
+    using Callback = std::function<void(const std::string &path)>;
+
+    explicit DocumentWatcher(Callback callback);
+    ~DocumentWatcher();
+
+    void watch(const std::string &path);
+    void unwatch(const std::string &path);
+
+private:
+    void onEvents(const std::vector<FileEvent> &events);
+    static std::string canonicalPath(const std::string &path);
+
+    Callback callback;
+    std::mutex mutex;
+    std::multimap<std::string, std::string> documents; // canonical -> as opened
+    std::map<std::string, int> directories;            // watched dir -> documents in it
+    std::unique_ptr<FileWatcher> watcher;
+};
+
+#endif // DOCUMENTWATCHER_H
@@ -1,27 +1,69 @@
 #include "editor.h"
-#include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <clocale>
+#include "utf8.h"
+#include "replaceall.h"
+#include "traceevents.h"
 
-Editor::Editor() : cursorX(0), cursorY(0), screenRows(0), screenCols(0), isDirty(false) {
-    initScreen();
-    
-    // one empty line if buffer is empty
-    if (buffer.empty()) {
-        buffer.push_back("");
-    }
+// ncurses color pair and attributes for each TokenStyle
+struct StyleAttributes {
+    short pair;
+    attr_t attributes;
+};
+
+static StyleAttributes styleAttributes[7];
+
+Editor::Editor() : cursorX(0), cursorY(0), rowOffset(0), colOffset(0), wrapLines(true),
+                   screenRows(0), screenCols(0), screenActive(false), isDirty(false),
+                   watcher([this](const std::string &) { externalChange = true; }),
+                   externalChange(false), editRun(EditRun::None),
+                   recordingMacro(false), replayingMacro(false), replayPosition(0),
+                   trace(EditTraceWriter::fromEnvironment()), showPerf(false), keyPending(false),
+                   memoryBudget(MemoryBudget::fromEnvironment()), memoryCheckVersion(0) {
 }
 
 Editor::~Editor() {
-    shutdownScreen();
+    if (screenActive) shutdownScreen();
 }
 
 void Editor::initScreen() {
-    // Initialize ncurses
+    // Initialize ncurses, with the user's locale so UTF-8 is drawn as text
+    setlocale(LC_ALL, "");
     initscr();
+    screenActive = true;
     raw();              // Disable line buffering
     keypad(stdscr, TRUE); // Enable special keys
     noecho();           // Don't echo key presses
+    timeout(250);       // Wake up now and then to notice changes on disk
+    
+    // Bracketed paste: pasted text arrives marked, to be inserted at once
+    printf("\033[?2004h");
+    fflush(stdout);
+    
+    // Syntax colors, or just bold and dim on terminals without color
+    if (has_colors()) {
+        start_color();
+        use_default_colors();
+        init_pair(1, COLOR_BLUE, -1);
+        init_pair(2, COLOR_CYAN, -1);
+        init_pair(3, COLOR_GREEN, -1);
+        init_pair(4, COLOR_RED, -1);
+        init_pair(5, COLOR_MAGENTA, -1);
+        init_pair(6, COLOR_YELLOW, -1);
+        styleAttributes[(int)TokenStyle::Keyword] = {1, A_BOLD};
+        styleAttributes[(int)TokenStyle::Type] = {2, A_NORMAL};
+        styleAttributes[(int)TokenStyle::String] = {3, A_NORMAL};
+        styleAttributes[(int)TokenStyle::Number] = {4, A_NORMAL};
+        styleAttributes[(int)TokenStyle::Comment] = {5, A_NORMAL};
+        styleAttributes[(int)TokenStyle::Preprocessor] = {6, A_NORMAL};
+    } else {
+        styleAttributes[(int)TokenStyle::Keyword] = {0, A_BOLD};
+        styleAttributes[(int)TokenStyle::Comment] = {0, A_DIM};
+    }
     
     // Get terminal size
     getmaxyx(stdscr, screenRows, screenCols);
@@ -31,17 +73,75 @@ void Editor::initScreen() {
 }
 
 void Editor::shutdownScreen() {
+    printf("\033[?2004l");
+    fflush(stdout);
     endwin();
 }
 
+// Compression done in one idle wake-up, a few tens of milliseconds
+static const size_t IDLE_COMPRESS_BYTES = 8 << 20;
+
+static uint64_t microsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 void Editor::run() {
+    initScreen();
     while (true) {
+        // A key counts until the frame showing it is on the terminal
+        auto frameStart = std::chrono::steady_clock::now();
         refreshScreen();
+        perf.recordFrame(microsSince(frameStart));
+        if (keyPending) perf.recordKeyToPaint(microsSince(keyTime));
+        keyPending = false;
+        
+        uint64_t version = buffer.version();
         handleKeypress();
+        if (keyPending && buffer.version() != version) perf.recordEdit(microsSince(keyTime));
+        enforceMemoryBudget();
+        // Cold text is compressed while no keys are coming in
+        if (!keyPending) buffer.compressColdText(memoryBudget.compressAbove(), IDLE_COMPRESS_BYTES);
+    }
+}
+
+void Editor::enforceMemoryBudget() {
+    // Measuring walks every line, so only after edits and not too often
+    if (memoryBudget.limit() == 0 || buffer.version() == memoryCheckVersion) return;
+    auto now = std::chrono::steady_clock::now();
+    if (now - memoryCheckTime < std::chrono::seconds(5)) return;
+    memoryCheckVersion = buffer.version();
+    memoryCheckTime = now;
+
+    DocumentMemory document = {};
+    buffer.addMemoryUsage(document.usage);
+    document.caches = columns.memoryUsage() + brackets.memoryUsage() + highlighter.memoryUsage();
+    document.usage.layout = layout.memoryUsage() + columns.memoryUsage() + brackets.memoryUsage();
+    document.usage.highlighting = highlighter.memoryUsage();
+    document.undoBeyondFloor = buffer.undoMemory(memoryBudget.undoFloor());
+    for (const MemoryStep &step : memoryBudget.plan({document})) {
+        if (step.action == MemoryAction::DropCaches) {
+            highlighter.dropCache();
+            brackets.dropCache();
+            columns.clear();
+        } else if (step.action == MemoryAction::TrimUndo) {
+            buffer.trimUndo(memoryBudget.undoFloor());
+        }
     }
 }
 
 void Editor::refreshScreen() {
+    // A macro replay draws once, when it is done
+    if (replayingMacro) return;
+    
+    // Never leave the cursor inside a fold
+    folds.sync(buffer);
+    while (folds.isHidden(cursorY)) folds.unfold(cursorY);
+    
+    // Keep the last column free for the cursor at the end of a wrapped row
+    layout.setWidth(wrapLines ? screenCols - 1 : 0);
+    layout.sync(buffer, folds);
+    
+    scrollToCursor();
     clear();
     drawRows();
     drawStatusBar();
@@ -49,23 +149,166 @@ void Editor::refreshScreen() {
     refresh();
 }
 
+int Editor::cursorSubRow(int &segmentStart) {
+    WrapLayout::wrapLine(buffer.line(cursorY), layout.width(), wrapStarts);
+    int subRow = (int)(std::upper_bound(wrapStarts.begin(), wrapStarts.end(), cursorX) - wrapStarts.begin()) - 1;
+    segmentStart = wrapStarts[subRow];
+    return subRow;
+}
+
+void Editor::scrollToCursor() {
+    // Only rows on screen are wrapped exactly; wrapping the lines above the
+    // cursor can push it down again, so repeat until the view settles
+    layout.measure(buffer, cursorY, cursorY);
+    int segmentStart = 0;
+    while (true) {
+        int top = layout.rowToLine(rowOffset);
+        layout.measure(buffer, top, layout.rowToLine(rowOffset + screenRows));
+        
+        int cursorRow = layout.lineToRow(cursorY) + cursorSubRow(segmentStart);
+        int previous = rowOffset;
+        if (cursorRow < rowOffset) {
+            rowOffset = cursorRow;
+        } else if (cursorRow >= rowOffset + screenRows) {
+            rowOffset = cursorRow - screenRows + 1;
+        }
+        if (rowOffset == previous) break;
+    }
+    
+    int cursorCol = columns.column(buffer, cursorY, cursorX) - columns.column(buffer, cursorY, segmentStart);
+    if (wrapLines) {
+        colOffset = 0;
+    } else if (cursorCol < colOffset) {
+        colOffset = cursorCol;
+    } else if (cursorCol >= colOffset + screenCols) {
+        colOffset = cursorCol - screenCols + 1;
+    }
+}
+
 void Editor::drawRows() {
+    TRACE_SCOPE("drawRows");
+    const std::vector<SearchMatch>& matches = search.matches();
+    bool highlight = !search.query().empty() && !search.isStale();
+    int queryLen = (int)search.query().length();
+    
+    // Bracket under or just before the cursor and its partner
+    BracketPosition bracket = {-1, -1}, match = {-1, -1};
+    std::string_view cursorLine = buffer.line(cursorY);
+    for (int x : {cursorX, cursorX - 1}) {
+        if (x >= 0 && x < (int)cursorLine.length() && BracketIndex::bracketKind(cursorLine[x]) >= 0 &&
+            brackets.findMatch(buffer, cursorY, x, match)) {
+            bracket = {cursorY, x};
+            break;
+        }
+    }
+    
+    int subRow = 0;
+    int fileRow = layout.rowToLine(rowOffset, &subRow);
+    if (fileRow < buffer.lineCount()) {
+        WrapLayout::wrapLine(buffer.line(fileRow), layout.width(), wrapStarts);
+    }
+    
     for (int y = 0; y < screenRows; y++) {
         move(y, 0);
         
-        if (y < (int)buffer.size()) {
-            // Draw text line
-            std::string line = buffer[y];
-            if ((int)line.length() > screenCols) {
-                line = line.substr(0, screenCols);
+        if (fileRow < buffer.lineCount()) {
+            // Draw this row's slice of the line: one wrapped segment, or the
+            // horizontally scrolled part when wrapping is off. first and end
+            // are byte offsets, screen positions are display columns.
+            std::string_view line = buffer.line(fileRow);
+            bool lastRow = subRow + 1 >= (int)wrapStarts.size();
+            int first = wrapStarts[subRow];
+            int end = lastRow ? (int)line.length() : wrapStarts[subRow + 1];
+            if (!wrapLines) {
+                int firstColumn = columns.column(buffer, fileRow, first) + colOffset;
+                first = columns.offsetAt(buffer, fileRow, firstColumn);
+                end = columns.offsetAt(buffer, fileRow, firstColumn + screenCols);
+            }
+            int firstColumn = columns.column(buffer, fileRow, first);
+            int len = std::max(end - first, 0);
+            if (len > 0) {
+                addnstr(line.data() + first, len);
+            }
+            clrtoeol();
+            
+            // Marks bytes [offset, offset + length) of the line if they are on this row
+            auto mark = [&](int offset, int length, attr_t attributes, short pair) {
+                int start = std::max(offset, first);
+                int stop = std::min(offset + length, end);
+                if (start < stop) {
+                    int x = columns.column(buffer, fileRow, start) - firstColumn;
+                    int width = columns.column(buffer, fileRow, stop) - firstColumn - x;
+                    mvchgat(y, x, width, attributes, pair, NULL);
+                }
+            };
+            
+            // Color the line's tokens
+            for (const StyleRun &run : highlighter.lineStyles(buffer, fileRow)) {
+                const StyleAttributes &style = styleAttributes[(int)run.style];
+                if (style.pair || style.attributes) {
+                    mark(run.start, run.length, style.attributes, style.pair);
+                }
+            }
+            
+            // Folded lines collapse into a marker after their header
+            if (lastRow && folds.isHeader(fileRow)) {
+                int col = columns.column(buffer, fileRow, end) - firstColumn;
+                if (col < screenCols) {
+                    attron(A_DIM);
+                    mvaddnstr(y, col, " ...", screenCols - col);
+                    attroff(A_DIM);
+                }
+            }
+            
+            for (const BracketPosition &position : {bracket, match}) {
+                if (position.line == fileRow) {
+                    mark(position.column, 1, A_BOLD | A_UNDERLINE, 0);
+                }
+            }
+            
+            // Mark search matches on this line
+            for (size_t i = highlight ? search.firstMatchFrom(fileRow) : matches.size();
+                 i < matches.size() && matches[i].line == fileRow; i++) {
+                mark(matches[i].column, queryLen, A_STANDOUT, 0);
+            }
+            
+            // Selections in reverse video, and a block for each cursor
+            // besides the terminal's own
+            if (cursors.isActive()) {
+                const std::vector<Selection> &selections = cursors.selections();
+                for (size_t i = cursors.firstOnLine(fileRow);
+                     i < selections.size() && selections[i].start().line <= fileRow; i++) {
+                    const Selection &selection = selections[i];
+                    int from = selection.start().line < fileRow ? 0 : selection.start().column;
+                    int to = selection.end().line > fileRow ? (int)line.length() : selection.end().column;
+                    mark(from, to - from, A_REVERSE, 0);
+                    
+                    const TextPosition &head = selection.head;
+                    if (head.line != fileRow || (head.line == cursorY && head.column == cursorX)) continue;
+                    if (head.column < (int)line.length()) {
+                        mark(head.column, columns.nextOffset(buffer, fileRow, head.column) - head.column, A_REVERSE, 0);
+                    } else if (lastRow) {
+                        int col = columns.column(buffer, fileRow, head.column) - firstColumn;
+                        if (col >= 0 && col < screenCols) mvaddch(y, col, ' ' | A_REVERSE);
+                    }
+                }
+            }
+            
+            // Next row: the rest of this line, or the next line not folded away
+            if (lastRow) {
+                fileRow = folds.visibleLine(fileRow + 1, 1);
+                subRow = 0;
+                if (fileRow < buffer.lineCount()) {
+                    WrapLayout::wrapLine(buffer.line(fileRow), layout.width(), wrapStarts);
+                }
+            } else {
+                subRow++;
             }
-            printw("%s", line.c_str());
         } else {
             // Draw ~ for empty lines like vim hehehe
             printw("~");
+            clrtoeol(); // Clear to end of line
         }
-        
-        clrtoeol(); // Clear to end of line
     }
 }
 
@@ -73,42 +316,180 @@ void Editor::drawStatusBar() {
     // Move to last line
     move(screenRows, 0);
     
+    // Search prompt takes over the status line
+    if (!prompt.empty()) {
+        printw("%s", prompt.c_str());
+        clrtoeol();
+        return;
+    }
+    
     // Reverse video for status bar
     attron(A_REVERSE);
     
     // Status info
     std::string status = filename.empty() ? "[No Name]" : filename;
     if (isDirty) status += " [Modified]";
+    if (cursors.count() > 1) status += " [" + std::to_string(cursors.count()) + " cursors]";
+    if (recordingMacro) status += " [rec]";
+    std::string formatName = formatDescription(format);
+    if (!formatName.empty()) status += " [" + formatName + "]";
+    if (!statusMessage.empty()) status += " - " + statusMessage;
+    
+    // Timings replace the rest while shown
+    if (showPerf) status = perf.summary(buffer);
     
     // Position info
     char posInfo[80];
     snprintf(posInfo, sizeof(posInfo), "Line %d, Col %d", cursorY + 1, cursorX + 1);
     
     // Draw status
-    printw("%-*s %s", screenCols - strlen(posInfo) - 1, status.c_str(), posInfo);
+    printw("%-*s %s", screenCols - (int)strlen(posInfo) - 1, status.c_str(), posInfo);
     
     attroff(A_REVERSE);
 }
 
 void Editor::updateCursor() {
-    move(cursorY, cursorX);
+    if (!prompt.empty()) {
+        move(screenRows, displayWidth(prompt));
+    } else {
+        int segmentStart = 0;
+        int row = layout.lineToRow(cursorY) + cursorSubRow(segmentStart);
+        int col = columns.column(buffer, cursorY, cursorX) - columns.column(buffer, cursorY, segmentStart);
+        move(row - rowOffset, col - colOffset);
+    }
 }
 
-void Editor::handleKeypress() {
+// Keys come from the terminal, or from the macro being replayed
+int Editor::readKey() {
+    if (!pushedBackKeys.empty()) {
+        int c = pushedBackKeys.back();
+        pushedBackKeys.pop_back();
+        return c;
+    }
+    if (replayingMacro) {
+        return replayPosition < macroKeys.size() ? macroKeys[replayPosition++] : ERR;
+    }
     int c = getch();
+    if (recordingMacro && c != ERR) macroKeys.push_back(c);
+    return c;
+}
+
+void Editor::unreadKey(int c) {
+    pushedBackKeys.push_back(c);
+}
+
+void Editor::handleKeypress() {
+    int c = readKey();
+    if (c == ERR) {
+        checkExternalChange();
+        return;
+    }
+    if (!replayingMacro) {
+        keyTime = std::chrono::steady_clock::now();
+        keyPending = true;
+    }
+    TRACE_SCOPE("handleKeypress");
+    statusMessage.clear();
+    
+    // Typing and deleting in a row stay one undo step; any other key ends it
+    EditRun run = (c == KEY_BACKSPACE || c == 127 || c == 8) ? EditRun::Deleting
+                : (c >= 32 && c != 127 && c <= 0xFF) ? EditRun::Typing : EditRun::None;
+    // A replay is one step however many keys it has
+    if (!replayingMacro) {
+        if (run == EditRun::None || run != editRun) buffer.closeUndoStep({cursorY, cursorX});
+        buffer.beginUndoStep({cursorY, cursorX});
+        editRun = run;
+    }
     
     switch (c) {
-        case 'q' - 'a' + 1: // Ctrl-Q to quit
-            if (!isDirty || (getch() == 'q' - 'a' + 1)) {
+        case 'q' - 'a' + 1: { // Ctrl-Q to quit
+            if (replayingMacro) break;
+            int confirm = ERR;
+            while (isDirty && confirm == ERR) confirm = getch();
+            if (!isDirty || confirm == 'q' - 'a' + 1) {
                 shutdownScreen();
                 exit(0);
             }
             break;
+        }
             
         case 's' - 'a' + 1: // Ctrl-S to save
             saveFile();
             break;
             
+        case 'f' - 'a' + 1: // Ctrl-F to search
+            find();
+            break;
+            
+        case 'r' - 'a' + 1: // Ctrl-R to replace all
+            replaceAll();
+            break;
+            
+        case 'k' - 'a' + 1: // Ctrl-K to start / stop recording a macro, Ctrl-E to play it
+            toggleMacroRecording();
+            break;
+            
+        case 'e' - 'a' + 1:
+            playMacro();
+            break;
+            
+        case 'g' - 'a' + 1: // Ctrl-G to show / hide timings in the status line
+            togglePerfStatus();
+            break;
+            
+        case 'z' - 'a' + 1: // Ctrl-Z / Ctrl-Y to undo and redo
+            undoEdit(false);
+            break;
+            
+        case 'y' - 'a' + 1:
+            undoEdit(true);
+            break;
+            
+        case 'n' - 'a' + 1: // Ctrl-N / Ctrl-P for next / previous match
+            findNext(true);
+            break;
+            
+        case 'p' - 'a' + 1:
+            findNext(false);
+            break;
+            
+        case 't' - 'a' + 1: // Ctrl-T to fold / unfold the block at the cursor
+            toggleFold();
+            break;
+            
+        case 'w' - 'a' + 1: // Ctrl-W to toggle soft wrap
+            wrapLines = !wrapLines;
+            break;
+            
+        case 'd' - 'a' + 1: // Ctrl-D to select the word, then add a cursor on its next occurrence
+            addNextOccurrence();
+            break;
+            
+        case 'a' - 'a' + 1: // Ctrl-A for a cursor on every occurrence
+            selectAllOccurrences();
+            break;
+            
+        case 'c' - 'a' + 1: // Ctrl-C / Ctrl-X / Ctrl-V to copy, cut and paste
+            copySelection(false);
+            break;
+            
+        case 'x' - 'a' + 1:
+            copySelection(true);
+            break;
+            
+        case 'v' - 'a' + 1:
+            paste(clipboard);
+            break;
+            
+        case 27: // Esc goes back to one cursor, unless it starts a paste
+            if (!readBracketedPaste()) cursors.reset({cursorY, cursorX});
+            break;
+            
+        case KEY_RESIZE:
+            getmaxyx(stdscr, screenRows, screenCols);
+            screenRows--;
+            break;
+            
         case KEY_UP:
         case KEY_DOWN:
         case KEY_LEFT:
@@ -116,6 +497,23 @@ void Editor::handleKeypress() {
             moveCursor(c);
             break;
             
+        // Shift+arrows select
+        case KEY_SR:
+            moveCursor(KEY_UP, true);
+            break;
+            
+        case KEY_SF:
+            moveCursor(KEY_DOWN, true);
+            break;
+            
+        case KEY_SLEFT:
+            moveCursor(KEY_LEFT, true);
+            break;
+            
+        case KEY_SRIGHT:
+            moveCursor(KEY_RIGHT, true);
+            break;
+            
         case KEY_BACKSPACE:
         case 127:
         case 8:
@@ -128,118 +526,564 @@ void Editor::handleKeypress() {
             insertNewline();
             break;
             
-        default:
-            if (c >= 32 && c < 127) { // Printable characters
-                insertChar(c);
+        default: {
+            std::string character = readCharacter(c);
+            if (!character.empty()) {
+                insertText(character);
             }
             break;
+        }
     }
 }
 
-void Editor::moveCursor(int key) {
+std::string Editor::readCharacter(int c) {
+    if (c >= 32 && c < 127) { // Printable ASCII
+        return std::string(1, (char)c);
+    }
+    if (c < 0xC2 || c > 0xF4) return "";
+    
+    // UTF-8 arrives a byte per getch; the lead byte says how many follow
+    std::string character(1, (char)c);
+    int following = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+    while (following-- > 0) {
+        int next = readKey();
+        if (next == ERR) break;
+        if ((next & 0xC0) != 0x80) {
+            unreadKey(next);
+            break;
+        }
+        character += (char)next;
+    }
+    return isValidUtf8(character) ? character : "";
+}
+
+void Editor::moveCursor(int key, bool extend) {
+    if (extend && !cursors.isActive()) cursors.reset({cursorY, cursorX});
+    if (extend || cursors.isActive()) {
+        cursors.moveEach([&](TextPosition &position) { movePosition(key, position); }, extend);
+        followPrimaryCursor();
+    } else {
+        TextPosition position = {cursorY, cursorX};
+        movePosition(key, position);
+        cursorY = position.line;
+        cursorX = position.column;
+    }
+    traceEdit(TraceOp::Move);
+}
+
+void Editor::movePosition(int key, TextPosition &position) {
+    int &x = position.column;
+    int &y = position.line;
+    
+    // Lines hidden in folds are skipped over
+    int previous = y > 0 ? folds.visibleLine(y - 1, -1) : -1;
+    int next = folds.visibleLine(y + 1, 1);
+    
     switch (key) {
         case KEY_LEFT:
-            if (cursorX > 0) {
-                cursorX--;
-            } else if (cursorY > 0) {
-                cursorY--;
-                cursorX = buffer[cursorY].length();
+            if (x > 0) {
+                x = columns.previousOffset(buffer, y, x);
+            } else if (previous >= 0) {
+                y = previous;
+                x = buffer.lineLength(y);
             }
             break;
             
         case KEY_RIGHT:
-            if (cursorY < (int)buffer.size() && cursorX < (int)buffer[cursorY].length()) {
-                cursorX++;
-            } else if (cursorY < (int)buffer.size() - 1) {
-                cursorY++;
-                cursorX = 0;
+            if (y < buffer.lineCount() && x < buffer.lineLength(y)) {
+                x = columns.nextOffset(buffer, y, x);
+            } else if (next < buffer.lineCount()) {
+                y = next;
+                x = 0;
             }
             break;
             
+        // Up and down keep the display column, landing on a whole character
         case KEY_UP:
-            if (cursorY > 0) {
-                cursorY--;
-                cursorX = std::min(cursorX, (int)buffer[cursorY].length());
+            if (previous >= 0) {
+                int column = columns.column(buffer, y, x);
+                y = previous;
+                x = columns.offsetAt(buffer, y, column);
             }
             break;
             
         case KEY_DOWN:
-            if (cursorY < (int)buffer.size() - 1) {
-                cursorY++;
-                cursorX = std::min(cursorX, (int)buffer[cursorY].length());
+            if (next < buffer.lineCount()) {
+                int column = columns.column(buffer, y, x);
+                y = next;
+                x = columns.offsetAt(buffer, y, column);
             }
             break;
     }
 }
 
-void Editor::insertChar(char c) {
-    if (cursorY < (int)buffer.size()) {
-        buffer[cursorY].insert(cursorX, 1, c);
-        cursorX++;
+void Editor::toggleFold() {
+    cursors.reset({cursorY, cursorX});
+    folds.sync(buffer);
+    if (folds.unfold(cursorY)) return;
+    
+    // Hide the lines between the braces, keeping both brace lines
+    BracketPosition open, close;
+    if (!brackets.foldableBlock(buffer, cursorY, open, close) || close.line - open.line < 2) {
+        statusMessage = "Nothing to fold";
+        return;
+    }
+    folds.fold(open.line + 1, close.line - 1);
+    if (folds.isHidden(cursorY)) {
+        cursorY = open.line;
+        cursorX = std::min(cursorX, buffer.lineLength(cursorY));
+    }
+}
+
+void Editor::find() {
+    cursors.reset({cursorY, cursorX});
+    int savedX = cursorX, savedY = cursorY;
+    std::string query;
+    
+    while (true) {
+        prompt = "/" + query;
+        refreshScreen();
+        
+        int c = readKey();
+        if (c == ERR && !replayingMacro) {
+            continue;
+        } else if (c == 27 || c == ERR) { // Esc cancels and goes back
+            cursorX = savedX;
+            cursorY = savedY;
+            break;
+        } else if (c == KEY_ENTER || c == '\n' || c == '\r') {
+            break;
+        } else if (c == KEY_DOWN || c == 'n' - 'a' + 1) {
+            findNext(true);
+            continue;
+        } else if (c == KEY_UP || c == 'p' - 'a' + 1) {
+            findNext(false);
+            continue;
+        } else if (c == KEY_BACKSPACE || c == 127 || c == 8) {
+            if (query.empty()) continue;
+            query.resize(previousGraphemeBoundary(query, query.size()));
+        } else {
+            std::string character = readCharacter(c);
+            if (character.empty()) continue;
+            query += character;
+        }
+        
+        search.setQuery(buffer, query, hasUppercase(query));
+        
+        // Jump to the first match at or after where the search started
+        SearchMatch match;
+        if (search.nextMatch(buffer, savedY, savedX - 1, match)) {
+            cursorY = match.line;
+            cursorX = match.column;
+        } else {
+            cursorX = savedX;
+            cursorY = savedY;
+        }
+    }
+    
+    prompt.clear();
+}
+
+void Editor::findNext(bool forward) {
+    if (search.query().empty()) return;
+    
+    // Rescans only if the buffer was edited since the last search
+    search.setQuery(buffer, search.query(), search.isCaseSensitive());
+    
+    SearchMatch match;
+    bool found = forward ? search.nextMatch(buffer, cursorY, cursorX, match)
+                         : search.previousMatch(buffer, cursorY, cursorX, match);
+    if (found) {
+        cursorY = match.line;
+        cursorX = match.column;
+        cursors.reset({cursorY, cursorX});
+    }
+}
+
+// Edits text in the status line; false if Esc cancelled it
+bool Editor::readPrompt(const std::string &label, std::string &text) {
+    while (true) {
+        prompt = label + text;
+        refreshScreen();
+        
+        int c = readKey();
+        if (c == ERR && !replayingMacro) {
+            continue;
+        } else if (c == 27 || c == ERR) {
+            prompt.clear();
+            return false;
+        } else if (c == KEY_ENTER || c == '\n' || c == '\r') {
+            prompt.clear();
+            return true;
+        } else if (c == KEY_BACKSPACE || c == 127 || c == 8) {
+            if (!text.empty()) text.resize(previousGraphemeBoundary(text, text.size()));
+        } else {
+            text += readCharacter(c);
+        }
+    }
+}
+
+void Editor::replaceAll() {
+    cursors.reset({cursorY, cursorX});
+    std::string needle = search.query();
+    std::string replacement;
+    if (!readPrompt("Replace: ", needle) || needle.empty()) return;
+    if (!readPrompt("Replace " + needle + " with: ", replacement)) return;
+    
+    // The scan runs on a snapshot across all cores while the status line
+    // shows how far it got; Esc stops it before anything changes
+    std::vector<LineRewrite> rewrites;
+    size_t replaced = 0;
+    ReplaceAllJob job(buffer.snapshot(), needle, replacement, hasUppercase(needle),
+                      [&](std::vector<LineRewrite> result, size_t count) {
+                          rewrites = std::move(result);
+                          replaced = count;
+                      });
+    bool cancelled = false;
+    timeout(50);
+    while (!job.isFinished()) {
+        statusMessage = "Replacing... " + std::to_string((int)(job.progress() * 100)) + "% (Esc to cancel)";
+        refreshScreen();
+        if (getch() == 27) {
+            job.cancel();
+            cancelled = true;
+        }
+    }
+    timeout(250);
+    
+    if (cancelled) {
+        statusMessage = "Replace cancelled";
+        return;
+    }
+    if (replaced == 0) {
+        statusMessage = "Not found";
+        return;
+    }
+    
+    // Every rewritten line goes in at once, as one undo step
+    buffer.closeUndoStep({cursorY, cursorX});
+    buffer.beginUndoStep({cursorY, cursorX});
+    buffer.rewriteLines(std::move(rewrites));
+    cursorX = std::min(cursorX, buffer.lineLength(cursorY));
+    buffer.closeUndoStep({cursorY, cursorX});
+    cursors.reset({cursorY, cursorX});
+    isDirty = true;
+    search.invalidate();
+    statusMessage = "Replaced " + std::to_string(replaced) + (replaced == 1 ? " occurrence" : " occurrences");
+}
+
+void Editor::togglePerfStatus() {
+    if (!showPerf) {
+        showPerf = true;
+        return;
+    }
+    
+    // Hiding the timings offers to save their histograms
+    std::string path = "leditor-perf.txt";
+    if (readPrompt("Save latency histograms to (Esc to skip): ", path) && !path.empty()) {
+        statusMessage = perf.dump(path) ? "Histograms saved to " + path : "Could not write " + path;
+    }
+    showPerf = false;
+}
+
+void Editor::toggleMacroRecording() {
+    if (replayingMacro) return;
+    if (!recordingMacro) {
+        macroKeys.clear();
+        recordingMacro = true;
+        statusMessage = "Recording macro (Ctrl-K to stop)";
+        return;
+    }
+    macroKeys.pop_back();   // the Ctrl-K that stopped it
+    recordingMacro = false;
+    statusMessage = "Recorded " + std::to_string(macroKeys.size()) + " keys";
+}
+
+void Editor::playMacro() {
+    if (recordingMacro) {
+        macroKeys.pop_back();   // a macro cannot play itself
+        return;
+    }
+    if (replayingMacro) return;
+    if (macroKeys.empty()) {
+        statusMessage = "No macro recorded";
+        return;
+    }
+    
+    std::string answer;
+    if (!readPrompt("Play macro: times (1), l (each line) or m (each match of the last search): ", answer)) return;
+    MacroScope scope = MacroScope::Times;
+    int count = 1;
+    if (answer.empty()) {
+        count = 1;
+    } else if (answer == "l") {
+        scope = MacroScope::EachLine;
+    } else if (answer == "m") {
+        scope = MacroScope::EachMatch;
+    } else {
+        count = std::atoi(answer.c_str());
+        if (count <= 0) return;
+    }
+    
+    // Keys go straight to the handlers with drawing off; the whole replay
+    // is a single undo step
+    cursors.reset({cursorY, cursorX});
+    buffer.closeUndoStep({cursorY, cursorX});
+    buffer.beginUndoStep({cursorY, cursorX});
+    replayingMacro = true;
+    int runs = replayMacro(buffer, scope, count, {cursorY, cursorX}, search.query(), [&](TextPosition start) {
+        cursorY = start.line;
+        cursorX = start.column;
+        cursors.reset(start);
+        replayPosition = 0;
+        while (replayPosition < macroKeys.size() || !pushedBackKeys.empty()) handleKeypress();
+        return TextPosition{cursorY, cursorX};
+    });
+    replayingMacro = false;
+    buffer.closeUndoStep({cursorY, cursorX});
+    editRun = EditRun::None;
+    statusMessage = "Macro ran " + std::to_string(runs) + (runs == 1 ? " time" : " times");
+}
+
+void Editor::addNextOccurrence() {
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    if (!cursors.addNextOccurrence(buffer)) statusMessage = "No more occurrences";
+    followPrimaryCursor();
+}
+
+void Editor::selectAllOccurrences() {
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    if (cursors.selectAllOccurrences(buffer) == 0) statusMessage = "No word at cursor";
+    followPrimaryCursor();
+}
+
+void Editor::followPrimaryCursor() {
+    cursorY = cursors.primary().head.line;
+    cursorX = cursors.primary().head.column;
+}
+
+void Editor::copySelection(bool cut) {
+    if (!cursors.hasSelection()) return;
+    clipboard = cursors.copySelections(buffer);
+    if (cut) insertText("");
+}
+
+void Editor::paste(const TextClip &clip) {
+    if (trace) traceEdit(TraceOp::Insert, clip.toString());
+    if (!cursors.isActive()) cursors.reset({cursorY, cursorX});
+    cursors.paste(buffer, clip);
+    followPrimaryCursor();
+    isDirty = true;
+    search.invalidate();
+}
+
+// After an Esc: if the terminal is starting a bracketed paste, reads the
+// pasted text up to its end marker and inserts it in one go
+bool Editor::readBracketedPaste() {
+    static const char startMarker[] = "[200~";
+    static const char endMarker[] = "\033[201~";
+    
+    timeout(0);
+    std::string seen;
+    for (const char *expected = startMarker; *expected; expected++) {
+        int c = readKey();
+        if (c != *expected) {
+            // Just Esc (or another sequence): put back what was read
+            if (c != ERR) unreadKey(c);
+            for (auto it = seen.rbegin(); it != seen.rend(); ++it) unreadKey((unsigned char)*it);
+            timeout(250);
+            return false;
+        }
+        seen += (char)c;
+    }
+    
+    std::string text;
+    size_t endLength = sizeof(endMarker) - 1;
+    timeout(1000);
+    while (text.size() < endLength || text.compare(text.size() - endLength, endLength, endMarker) != 0) {
+        int c = readKey();
+        if (c == ERR) break;  // the end marker never came
+        if (c > 0xFF) continue;
+        text += (char)c;
+    }
+    timeout(250);
+    if (text.size() >= endLength && text.compare(text.size() - endLength, endLength, endMarker) == 0) {
+        text.resize(text.size() - endLength);
+    }
+    
+    // Terminals send line breaks as \r
+    std::string normalized;
+    normalized.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\r') {
+            normalized += '\n';
+            if (i + 1 < text.size() && text[i + 1] == '\n') i++;
+        } else {
+            normalized += text[i];
+        }
+    }
+    paste(TextClip::fromText(normalized));
+    return true;
+}
+
+void Editor::undoEdit(bool redo) {
+    traceEdit(redo ? TraceOp::Redo : TraceOp::Undo);
+    TextPosition position = {cursorY, cursorX};
+    if (!(redo ? buffer.redo(position) : buffer.undo(position))) {
+        statusMessage = redo ? "Nothing to redo" : "Nothing to undo";
+        return;
+    }
+    cursorY = position.line;
+    cursorX = position.column;
+    cursors.reset(position);
+    isDirty = true;
+    search.invalidate();
+}
+
+// Multiple cursors are traced as the primary one
+void Editor::traceEdit(TraceOp op, std::string_view text) {
+    if (trace) trace->record(op, {cursorY, cursorX}, text);
+}
+
+void Editor::insertText(std::string_view text) {
+    traceEdit(TraceOp::Insert, text);
+    if (cursors.isActive()) {
+        // Every cursor types in one batch
+        cursors.insertText(buffer, text);
+        followPrimaryCursor();
+        isDirty = true;
+        search.invalidate();
+    } else if (cursorY < buffer.lineCount()) {
+        buffer.insertText(cursorY, cursorX, text);
+        cursorX += (int)text.size();
         isDirty = true;
+        search.invalidate();
     }
 }
 
 void Editor::deleteChar() {
-    if (cursorX > 0 && cursorY < (int)buffer.size()) {
-        buffer[cursorY].erase(cursorX - 1, 1);
-        cursorX--;
+    traceEdit(TraceOp::DeleteBackward);
+    if (cursors.isActive()) {
+        cursors.deleteBackward(buffer);
+        followPrimaryCursor();
+        isDirty = true;
+        search.invalidate();
+    } else if (cursorX > 0 && cursorY < buffer.lineCount()) {
+        // Removes the whole character, accents and all
+        int start = columns.previousOffset(buffer, cursorY, cursorX);
+        buffer.eraseText(cursorY, start, cursorX - start);
+        cursorX = start;
         isDirty = true;
+        search.invalidate();
     } else if (cursorX == 0 && cursorY > 0) {
         // Join with previous line
-        cursorX = buffer[cursorY - 1].length();
-        buffer[cursorY - 1] += buffer[cursorY];
-        buffer.erase(buffer.begin() + cursorY);
+        cursorX = buffer.lineLength(cursorY - 1);
+        buffer.joinLines(cursorY - 1);
         cursorY--;
         isDirty = true;
+        search.invalidate();
     }
 }
 
 void Editor::insertNewline() {
-    if (cursorY < (int)buffer.size()) {
-        std::string currentLine = buffer[cursorY];
-        std::string newLine = currentLine.substr(cursorX);
-        buffer[cursorY] = currentLine.substr(0, cursorX);
-        buffer.insert(buffer.begin() + cursorY + 1, newLine);
+    if (cursors.isActive()) {
+        insertText("\n");
+    } else if (cursorY < buffer.lineCount()) {
+        traceEdit(TraceOp::Newline);
+        buffer.splitLine(cursorY, cursorX);
         cursorY++;
         cursorX = 0;
         isDirty = true;
+        search.invalidate();
     }
 }
 
 void Editor::openFile(const std::string& fname) {
-    std::ifstream file(fname);
-    if (file.is_open()) {
-        buffer.clear();
-        std::string line;
-        while (std::getline(file, line)) {
-            buffer.push_back(line);
+    TRACE_SCOPE("openFile");
+    LineArena lines;
+    if (readTextFile(fname, lines, format)) {
+        // Stray bytes are kept as they are and shown one column each
+        if (format.encoding == TextEncoding::Utf8) {
+            bool valid = true;
+            for (int i = 0; i < lines.lineCount() && valid; i++) valid = isValidUtf8(lines.line(i));
+            if (!valid) statusMessage = "Not valid UTF-8";
         }
-        file.close();
         
-        if (buffer.empty()) {
-            buffer.push_back("");
-        }
+        buffer.setLines(std::move(lines));
+        search.invalidate();
+        if (trace) trace->record(TraceOp::Load, {buffer.lineCount(), 0});
         
         filename = fname;
+        highlighter.setFileName(filename);
+        brackets.setSyntax(highlighter.syntax());
         isDirty = false;
         cursorX = 0;
         cursorY = 0;
+        cursors.reset({0, 0});
+        watchFile();
     }
 }
 
 void Editor::saveFile() {
+    TRACE_SCOPE("saveFile");
     if (filename.empty()) {
         // save as "untitled.txt" for now ughh
         filename = "untitled.txt";
+        highlighter.setFileName(filename);
+        brackets.setSyntax(highlighter.syntax());
     }
     
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        for (const auto& line : buffer) {
-            file << line << '\n';
-        }
-        file.close();
+    TextEncoding encoding = format.encoding;
+    if (writeTextFile(filename, buffer, format)) {
+        if (format.encoding != encoding) statusMessage = "Saved as UTF-8";
         isDirty = false;
+        watchFile();
+    }
+}
+
+void Editor::watchFile() {
+    if (reloader.path() != filename) {
+        if (!reloader.path().empty()) watcher.unwatch(reloader.path());
+        watcher.watch(filename);
+    }
+    reloader.track(filename, format);
+    externalChange = false;
+}
+
+void Editor::checkExternalChange() {
+    if (!externalChange.exchange(false)) return;
+
+    if (isDirty) {
+        // Never throw away edits; the file is read again on the next change
+        // after a save
+        statusMessage = "File changed on disk";
+        return;
     }
+
+    // A reload is a step of its own
+    buffer.closeUndoStep({cursorY, cursorX});
+    ReloadResult result = reloader.reload(buffer);
+    switch (result.kind) {
+        case ReloadResult::Unchanged:
+        case ReloadResult::Failed:
+            return;
+        case ReloadResult::Deleted:
+            statusMessage = "File deleted on disk";
+            isDirty = true;
+            return;
+        case ReloadResult::Appended:
+            break;
+        case ReloadResult::Patched:
+            // Keep the cursor on the same text if lines above it changed
+            cursorY = mapLineThroughHunks(result.hunks, cursorY);
+            break;
+    }
+
+    cursorY = std::min(cursorY, buffer.lineCount() - 1);
+    cursorX = std::min(cursorX, buffer.lineLength(cursorY));
+    cursors.reset({cursorY, cursorX});
+    buffer.closeUndoStep({cursorY, cursorX});
+    search.invalidate();
+    format = reloader.format();
+    statusMessage = "Reloaded";
 } 
\ No newline at end of file
@@ -1,53 +1,175 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include <atomic>
 #include <string>
 #include <vector>
+#include "textbuffer.h"
+#include "search.h"
+#include "textcodec.h"
+#include "filereloader.h"
+#include "documentwatcher.h"
+#include "highlighter.h"
+#include "bracketindex.h"
+#include "foldset.h"
+#include "wraplayout.h"
+#include "columncache.h"
+#include "cursorset.h"
+#include "macroreplay.h"
+#include "edittrace.h"
+#include "perfstats.h"
+#include "memorybudget.h"
 #include <ncurses.h>
 
 class Editor {
 public:
     Editor();
     ~Editor();
-    
+
+    // Starts the terminal; until then the editor runs headless, which is
+    // how the benchmarks drive it
     void run();
     void openFile(const std::string& fname);
-    
+    void saveFile();
+
+    // Editing, as the keys do it
+    void insertText(std::string_view text);
+    void deleteChar();
+    void insertNewline();
+    // key is KEY_LEFT/RIGHT/UP/DOWN
+    void moveCursor(int key, bool extend = false);
+
 private:
-    // Text buffer - each string is a line
-    std::vector<std::string> buffer;
-    
+    // Text buffer - one entry per line
+    TextBuffer buffer;
+
     // Cursor position
     int cursorX, cursorY;
-    
+
+    // Extra cursors and selections; while active, edits and moves go
+    // through them and cursorX/cursorY follow the primary one
+    CursorSet cursors;
+    // Ctrl-C / Ctrl-X / Ctrl-V register; shares lines with the buffer
+    TextClip clipboard;
+
+    // First screen row (wrapped rows of the lines left after folding) and
+    // column shown; columns only scroll when wrapping is off
+    int rowOffset, colOffset;
+    bool wrapLines;
+
     // Window dimensions
     int screenRows, screenCols;
-    
+    bool screenActive;
+
     // File info
     std::string filename;
+    FileFormat format;   // encoding and line endings to save back with
     bool isDirty;
+
+    // Changes made to the file by other programs
+    FileReloader reloader;
+    DocumentWatcher watcher;
+    std::atomic<bool> externalChange;
+    std::string statusMessage;
+
+    // Syntax colors, lexed lazily as lines are drawn
+    Highlighter highlighter;
+
+    // Bracket matching and folded blocks
+    BracketIndex brackets;
+    FoldSet folds;
+    
+    // Soft-wrapped rows per line
+    WrapLayout layout;
+    std::vector<int> wrapStarts;
+    
+    // Cursor columns are byte offsets into the UTF-8 line; this maps them
+    // to character boundaries and screen columns
+    ColumnCache columns;
+
+    // Search state, the prompt replaces the status bar while active
+    IncrementalSearch search;
+    std::string prompt;
     
+    // What the last key did, so a run of typing (or of deleting) is undone
+    // as one step
+    enum class EditRun { None, Typing, Deleting };
+    EditRun editRun;
+    
+    // Keyboard macro: every key read while recording, fed back through
+    // handleKeypress with drawing switched off when replayed
+    std::vector<int> macroKeys;
+    bool recordingMacro;
+    bool replayingMacro;
+    size_t replayPosition;
+    std::vector<int> pushedBackKeys;
+
+    // Edit trace, recorded when LEDITOR_TRACE names a file
+    std::unique_ptr<EditTraceWriter> trace;
+
+    // Frame, key-to-screen and edit timings; Ctrl-G shows them in the
+    // status line
+    PerfStats perf;
+    bool showPerf;
+    bool keyPending;
+    std::chrono::steady_clock::time_point keyTime;
+
+    // LEDITOR_MEMORY_BUDGET: over it, caches and then old undo steps go
+    MemoryBudget memoryBudget;
+    uint64_t memoryCheckVersion;
+    std::chrono::steady_clock::time_point memoryCheckTime;
+
     // Initialize ncurses
     void initScreen();
     void shutdownScreen();
-    
+
     // Display functions
     void refreshScreen();
+    void scrollToCursor();
+    int cursorSubRow(int &segmentStart);
     void drawRows();
     void drawStatusBar();
     void updateCursor();
-    
+
     // Input handling
+    int readKey();
+    void unreadKey(int c);
     void handleKeypress();
-    void moveCursor(int key);
-    
+    void movePosition(int key, TextPosition &position);
+    std::string readCharacter(int c);
+    void toggleFold();
+
+    // Search
+    void find();
+    void findNext(bool forward);
+    bool readPrompt(const std::string &label, std::string &text);
+    void replaceAll();
+
     // File operations
-    void saveFile();
-    
+    void watchFile();
+    void checkExternalChange();
+
+    // Multiple cursors
+    void addNextOccurrence();
+    void selectAllOccurrences();
+    void followPrimaryCursor();
+
+    // Performance status line
+    void togglePerfStatus();
+    void enforceMemoryBudget();
+
+    // Macros
+    void toggleMacroRecording();
+    void playMacro();
+
+    // Clipboard
+    void copySelection(bool cut);
+    void paste(const TextClip &clip);
+    bool readBracketedPaste();
+
     // Editing operations
-    void insertChar(char c);
-    void deleteChar();
-    void insertNewline();
+    void undoEdit(bool redo);
+    void traceEdit(TraceOp op, std::string_view text = std::string_view());
 };
 
-#endif // EDITOR_H 
\ No newline at end of file
+#endif // EDITOR_H
@@ -0,0 +1,97 @@
+#include "edittrace.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+static const char MAGIC[] = "LTRC";
+static const char VERSION = 1;
+
+static void appendVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+EditTraceWriter::EditTraceWriter(const std::string &path)
+    : file(fopen(path.c_str(), "wb")), start(std::chrono::steady_clock::now()), lastTime(0) {
+    if (!file) return;
+    // stdio's buffer does the batching; exit() flushes it even when the
+    // editor quits without unwinding
+    setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    fwrite(MAGIC, 1, 4, file);
+    fputc(VERSION, file);
+}
+
+EditTraceWriter::~EditTraceWriter() {
+    if (file) fclose(file);
+}
+
+std::unique_ptr<EditTraceWriter> EditTraceWriter::fromEnvironment() {
+    static std::atomic<int> opened(0);
+    const char *path = getenv("LEDITOR_TRACE");
+    if (!path || !*path) return nullptr;
+    int index = ++opened;
+    std::string name = index == 1 ? std::string(path) : std::string(path) + "." + std::to_string(index);
+    auto writer = std::make_unique<EditTraceWriter>(name);
+    if (!writer->isOpen()) return nullptr;
+    return writer;
+}
+
+void EditTraceWriter::record(TraceOp op, TextPosition position, std::string_view text) {
+    if (!file) return;
+    uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    scratch.clear();
+    appendVarint(scratch, now - lastTime);
+    scratch += (char)op;
+    appendVarint(scratch, position.line);
+    appendVarint(scratch, position.column);
+    if (op == TraceOp::Insert) {
+        appendVarint(scratch, text.size());
+        scratch += text;
+    }
+    fwrite(scratch.data(), 1, scratch.size(), file);
+    lastTime = now;
+}
+
+EditTraceReader::EditTraceReader(const std::string &path) : position(5), time(0), valid(false) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return;
+    std::stringstream contents;
+    contents << in.rdbuf();
+    data = contents.str();
+    valid = data.size() >= 5 && data.compare(0, 4, MAGIC) == 0 && data[4] == VERSION;
+}
+
+bool EditTraceReader::readVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && position < data.size(); shift += 7) {
+        unsigned char byte = data[position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool EditTraceReader::next(TraceEvent &event) {
+    if (!valid) return false;
+    uint64_t delta, line, column;
+    if (!readVarint(delta) || position >= data.size()) return false;
+    unsigned char op = data[position++];
+    if (op > (unsigned char)TraceOp::Redo || !readVarint(line) || !readVarint(column)) return false;
+
+    event.text.clear();
+    if ((TraceOp)op == TraceOp::Insert) {
+        uint64_t length;
+        if (!readVarint(length) || length > data.size() - position) return false;
+        event.text.assign(data, position, length);
+        position += length;
+    }
+    time += delta;
+    event.time = time;
+    event.op = (TraceOp)op;
+    event.position = {(int)line, (int)column};
+    return true;
+}
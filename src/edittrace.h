@@ -0,0 +1,64 @@
+#ifndef EDITTRACE_H
+#define EDITTRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "textbuffer.h"
+
+// Edits as a session made them, for replaying real typing against later
+// builds. A trace file is a short header and then one record per edit:
+// microseconds since the previous record, the operation, the cursor
+// position and any text, as varints, so a keystroke costs a few bytes.
+
+enum class TraceOp : uint8_t { Load, Insert, DeleteBackward, Newline, Move, Undo, Redo };
+
+struct TraceEvent {
+    uint64_t time;          // microseconds since the trace started
+    TraceOp op;
+    TextPosition position;  // the cursor before the edit, after a Move; for
+                            // Load, line holds the document's line count
+    std::string text;       // what an Insert typed or pasted
+};
+
+class EditTraceWriter {
+public:
+    explicit EditTraceWriter(const std::string &path);
+    ~EditTraceWriter();
+
+    // A writer on the file named by LEDITOR_TRACE, or null when it is not
+    // set. Every further one (another tab) gets its own file: path.2, path.3
+    static std::unique_ptr<EditTraceWriter> fromEnvironment();
+
+    bool isOpen() const { return file != nullptr; }
+    void record(TraceOp op, TextPosition position, std::string_view text = std::string_view());
+
+private:
+    FILE *file;
+    std::chrono::steady_clock::time_point start;
+    uint64_t lastTime;
+    std::string scratch;    // one encoded record
+};
+
+class EditTraceReader {
+public:
+    // Reads the whole trace; traces are small next to the documents
+    explicit EditTraceReader(const std::string &path);
+
+    bool isOpen() const { return valid; }
+    // False at the end, or at a record cut off by a crash
+    bool next(TraceEvent &event);
+
+private:
+    bool readVarint(uint64_t &value);
+
+    std::string data;
+    size_t position;
+    uint64_t time;
+    bool valid;
+};
+
+#endif // EDITTRACE_H
@@ -0,0 +1,153 @@
+#include "filereloader.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint64_t TAIL_CHECK_SIZE = 4096;
+
+static int64_t modifiedTime(const struct stat &st) {
+#ifdef __APPLE__
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+static uint64_t fnv1a(const std::string &data) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+FileReloader::FileReloader()
+    : size(0), mtime(0), inode(0), tail(0), endsWithNewline(false) {
+}
+
+bool FileReloader::readRange(uint64_t offset, uint64_t length, std::string &out) const {
+    out.clear();
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    out.resize(length);
+    uint64_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(fd, &out[done], length - done, offset + done);
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fd);
+    out.resize(done);
+    return done == length;
+}
+
+uint64_t FileReloader::tailHash(uint64_t end) const {
+    uint64_t start = end > TAIL_CHECK_SIZE ? end - TAIL_CHECK_SIZE : 0;
+    std::string bytes;
+    readRange(start, end - start, bytes);
+    return fnv1a(bytes);
+}
+
+bool FileReloader::track(const std::string &path, const FileFormat &format) {
+    filePath = path;
+    fileFormat = format;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        size = 0;
+        mtime = 0;
+        inode = 0;
+        return false;
+    }
+    size = st.st_size;
+    mtime = modifiedTime(st);
+    inode = st.st_ino;
+    tail = tailHash(size);
+
+    // The last unit, in the file's encoding
+    std::string newline, last;
+    TextEncoding encoding = format.encoding;
+    if (encoding == TextEncoding::Utf16LE) {
+        newline = std::string("\n\0", 2);
+    } else if (encoding == TextEncoding::Utf16BE) {
+        newline = std::string("\0\n", 2);
+    } else {
+        newline = "\n";
+    }
+    endsWithNewline = size >= newline.size() && readRange(size - newline.size(), newline.size(), last) &&
+                      last == newline;
+    return true;
+}
+
+
+ReloadResult FileReloader::reload(TextBuffer &buffer, bool discardEdits) {
+    ReloadResult result;
+    result.kind = ReloadResult::Unchanged;
+    result.bytesRead = 0;
+    if (filePath.empty()) return result;
+
+    struct stat st;
+    if (stat(filePath.c_str(), &st) != 0) {
+        result.kind = ReloadResult::Deleted;
+        return result;
+    }
+    uint64_t newSize = st.st_size;
+    if (!discardEdits && newSize == size && modifiedTime(st) == mtime && (uint64_t)st.st_ino == inode) {
+        return result;
+    }
+
+    // Appended: same file, grown, and the bytes we had still end the same
+    // way. UTF-16 growth must be whole units to be decoded on its own.
+    bool wideUnits = fileFormat.encoding == TextEncoding::Utf16LE || fileFormat.encoding == TextEncoding::Utf16BE;
+    bool wholeUnits = !wideUnits || ((newSize - size) % 2 == 0 && size % 2 == 0);
+    // The tail only vouches for the file, so an edited buffer is never appended to
+    if (!discardEdits && (uint64_t)st.st_ino == inode && size > 0 && newSize > size && wholeUnits &&
+        tailHash(size) == tail) {
+        std::string added;
+        if (!readRange(size, newSize - size, added)) {
+            result.kind = ReloadResult::Failed;
+            return result;
+        }
+        result.bytesRead = added.size();
+
+        LineArena lines;
+        TextDecoder decoder(fileFormat);
+        decoder.feed(added, lines);
+        decoder.finish(lines);
+        fileFormat.finalNewline = decoder.endedWithNewline();
+        int skip = 0;
+        if (!endsWithNewline && !lines.isEmpty()) {
+            // The first new bytes continue the old last line
+            int last = buffer.lineCount() - 1;
+            buffer.insertText(last, buffer.lineLength(last), lines.line(0));
+            skip = 1;
+        }
+        buffer.replaceLines(buffer.lineCount(), 0, lines, skip, lines.lineCount() - skip);
+        result.kind = ReloadResult::Appended;
+    } else {
+        // Decoded a block at a time, the format may have changed too
+        LineArena newLines;
+        if (!readTextFile(filePath, newLines, fileFormat)) {
+            result.kind = ReloadResult::Failed;
+            return result;
+        }
+        result.bytesRead = newSize;
+
+        std::vector<std::string_view> oldViews, newViews;
+        oldViews.reserve(buffer.lineCount());
+        for (int i = 0; i < buffer.lineCount(); i++) oldViews.push_back(buffer.line(i));
+        newViews.reserve(newLines.lineCount());
+        for (int i = 0; i < newLines.lineCount(); i++) newViews.push_back(newLines.line(i));
+        result.hunks = diffLines(oldViews, newViews);
+
+        // Back to front so earlier hunk positions stay valid
+        for (auto it = result.hunks.rbegin(); it != result.hunks.rend(); ++it) {
+            buffer.replaceLines(it->oldStart, it->oldCount, newLines, it->newStart, it->newCount);
+        }
+        result.kind = result.hunks.empty() ? ReloadResult::Unchanged : ReloadResult::Patched;
+    }
+
+    track(filePath, fileFormat);
+    return result;
+}
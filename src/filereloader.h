@@ -0,0 +1,54 @@
+#ifndef FILERELOADER_H
+#define FILERELOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "linediff.h"
+#include "textbuffer.h"
+#include "textcodec.h"
+
+struct ReloadResult {
+    enum Kind { Unchanged, Appended, Patched, Deleted, Failed };
+
+    Kind kind;
+    std::vector<DiffHunk> hunks;  // for Patched, to carry the cursor over
+    size_t bytesRead;
+};
+
+// Brings a clean buffer up to date with its file after another program
+// changed it. Growth that leaves the previously loaded bytes alone (same
+// inode, unchanged tail) is read as just the new tail; anything else is
+// read in full, diffed line by line against the buffer and applied as
+// minimal replacements, so untouched lines and the cursor stay put. Both
+// paths decode through the file's own encoding.
+class FileReloader {
+public:
+    FileReloader();
+
+    // Records the file state the buffer now matches (after a load or save)
+    bool track(const std::string &path, const FileFormat &format);
+    void untrack() { filePath.clear(); }
+    const std::string &path() const { return filePath; }
+    // The format found by the last full read, for saving back
+    const FileFormat &format() const { return fileFormat; }
+
+    // With discardEdits the buffer may have been edited since it matched
+    // the file; it is then always read in full and diffed, which replaces
+    // the edits
+    ReloadResult reload(TextBuffer &buffer, bool discardEdits = false);
+
+private:
+    bool readRange(uint64_t offset, uint64_t length, std::string &out) const;
+    uint64_t tailHash(uint64_t end) const;
+
+    std::string filePath;
+    FileFormat fileFormat;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint64_t tail;
+    bool endsWithNewline;
+};
+
+#endif // FILERELOADER_H
@@ -0,0 +1,213 @@
+#include "filetree.h"
+#include <algorithm>
+#include <strings.h>
+#include <sys/stat.h>
+
+FileTree::FileTree(const std::string &root)
+    : rootDir(root) {
+    while (rootDir.size() > 1 && rootDir.back() == '/') rootDir.pop_back();
+
+    rootNode.reset(new Node());
+    rootNode->isDir = true;
+    rootNode->parent = nullptr;
+    rootNode->row = 0;
+    rootNode->listed = false;
+}
+
+std::shared_ptr<const IgnoreRules> FileTree::explorerDefaults() {
+    static std::shared_ptr<const IgnoreRules> rules = [] {
+        auto r = std::make_shared<IgnoreRules>(IgnoreRules::defaults(), "");
+        r->addPattern("node_modules/");
+        r->addPattern("__pycache__/");
+        r->addPattern("CMakeFiles/");
+        r->addPattern(".DS_Store");
+        return r;
+    }();
+    return rules;
+}
+
+std::string FileTree::relativePath(const Node *node) const {
+    std::vector<const Node *> chain;
+    for (const Node *n = node; n && n->parent; n = n->parent) {
+        chain.push_back(n);
+    }
+
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!path.empty()) path += '/';
+        path += (*it)->name;
+    }
+    return path;
+}
+
+std::string FileTree::absolutePath(const Node *node) const {
+    std::string relative = relativePath(node);
+    return relative.empty() ? rootDir : rootDir + "/" + relative;
+}
+
+bool FileTree::sortsBefore(bool aDir, const std::string &a, bool bDir, const std::string &b) {
+    if (aDir != bDir) return aDir;
+    int order = strcasecmp(a.c_str(), b.c_str());
+    if (order != 0) return order < 0;
+    return a < b;
+}
+
+void FileTree::list(Node *dir) {
+    dir->children.clear();
+    dir->pending.clear();
+
+    std::string path = absolutePath(dir);
+    std::string relative = relativePath(dir);
+    std::shared_ptr<const IgnoreRules> rules = dir->parent ? dir->parent->rules : explorerDefaults();
+    if (!rules) rules = explorerDefaults();
+
+    DirReader reader(path);
+    std::vector<DirEntry> entries;
+    while (reader.readBatch(entries, 4096)) {
+    }
+
+    for (const DirEntry &entry : entries) {
+        if (entry.name == ".gitignore" && entry.type != DirEntry::Directory) {
+            auto own = std::make_shared<IgnoreRules>(rules, relative);
+            if (own->addFile(path + "/.gitignore") && !own->isEmpty()) {
+                rules = own;
+            }
+            break;
+        }
+    }
+    dir->rules = rules;
+
+    for (DirEntry &entry : entries) {
+        std::string childPath = path + "/" + entry.name;
+        if (entry.type == DirEntry::Unknown) {
+            entry.type = DirReader::resolveType(childPath);
+        }
+        // Only symlinks pay for a stat, to show linked directories as folders
+        if (entry.type == DirEntry::Symlink) {
+            struct stat st;
+            bool isDir = stat(childPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+            entry.type = isDir ? DirEntry::Directory : DirEntry::File;
+        }
+        if (entry.type != DirEntry::Directory) {
+            entry.type = DirEntry::File;
+        }
+
+        bool isDir = entry.type == DirEntry::Directory;
+        std::string childRelative = relative.empty() ? entry.name : relative + "/" + entry.name;
+        if (!rules->isIgnored(childRelative, isDir)) {
+            dir->pending.push_back(std::move(entry));
+        }
+    }
+
+    std::sort(dir->pending.begin(), dir->pending.end(), [](const DirEntry &a, const DirEntry &b) {
+        return sortsBefore(a.type == DirEntry::Directory, a.name, b.type == DirEntry::Directory, b.name);
+    });
+    dir->listed = true;
+}
+
+size_t FileTree::expose(Node *dir, size_t maxCount) {
+    size_t count = std::min(maxCount, dir->pending.size());
+    for (size_t i = 0; i < count; i++) {
+        std::unique_ptr<Node> node(new Node());
+        node->name = std::move(dir->pending[i].name);
+        node->isDir = dir->pending[i].type == DirEntry::Directory;
+        node->parent = dir;
+        node->row = (int)dir->children.size();
+        node->listed = false;
+        dir->children.push_back(std::move(node));
+    }
+    dir->pending.erase(dir->pending.begin(), dir->pending.begin() + count);
+    return count;
+}
+
+void FileTree::forget(Node *dir) {
+    dir->children.clear();
+    dir->pending.clear();
+    dir->listed = false;
+}
+
+int FileTree::childRow(const Node *dir, const std::string &name) const {
+    for (bool isDir : {true, false}) {
+        auto it = std::lower_bound(dir->children.begin(), dir->children.end(), name,
+            [isDir](const std::unique_ptr<Node> &node, const std::string &key) {
+                return sortsBefore(node->isDir, node->name, isDir, key);
+            });
+        if (it != dir->children.end() && (*it)->isDir == isDir && (*it)->name == name) {
+            return (int)(it - dir->children.begin());
+        }
+    }
+    return -1;
+}
+
+FileTree::Node *FileTree::find(const std::string &relative) {
+    Node *node = rootNode.get();
+    size_t pos = 0;
+    while (node && pos < relative.size()) {
+        size_t slash = relative.find('/', pos);
+        if (slash == std::string::npos) slash = relative.size();
+        int row = childRow(node, relative.substr(pos, slash - pos));
+        node = row < 0 ? nullptr : node->children[row].get();
+        pos = slash + 1;
+    }
+    return node;
+}
+
+int FileTree::insertionRow(const Node *dir, const std::string &name, bool isDir) const {
+    if (!dir->pending.empty()) {
+        const DirEntry &first = dir->pending.front();
+        if (!sortsBefore(isDir, name, first.type == DirEntry::Directory, first.name)) return -1;
+    }
+    auto it = std::lower_bound(dir->children.begin(), dir->children.end(), name,
+        [isDir](const std::unique_ptr<Node> &node, const std::string &key) {
+            return sortsBefore(node->isDir, node->name, isDir, key);
+        });
+    return (int)(it - dir->children.begin());
+}
+
+FileTree::Node *FileTree::insertChild(Node *dir, int row, const std::string &name, bool isDir) {
+    std::unique_ptr<Node> node(new Node());
+    node->name = name;
+    node->isDir = isDir;
+    node->parent = dir;
+    node->listed = false;
+    Node *raw = node.get();
+    dir->children.insert(dir->children.begin() + row, std::move(node));
+    renumber(dir, row);
+    return raw;
+}
+
+void FileTree::addPending(Node *dir, const std::string &name, bool isDir) {
+    DirEntry entry = {name, isDir ? DirEntry::Directory : DirEntry::File};
+    auto it = std::lower_bound(dir->pending.begin(), dir->pending.end(), entry,
+        [](const DirEntry &a, const DirEntry &b) {
+            return sortsBefore(a.type == DirEntry::Directory, a.name, b.type == DirEntry::Directory, b.name);
+        });
+    if (it != dir->pending.end() && it->name == name) return;
+    dir->pending.insert(it, std::move(entry));
+}
+
+void FileTree::removeChild(Node *dir, int row) {
+    dir->children.erase(dir->children.begin() + row);
+    renumber(dir, row);
+}
+
+bool FileTree::removePending(Node *dir, const std::string &name) {
+    auto it = std::find_if(dir->pending.begin(), dir->pending.end(),
+                           [&name](const DirEntry &entry) { return entry.name == name; });
+    if (it == dir->pending.end()) return false;
+    dir->pending.erase(it);
+    return true;
+}
+
+bool FileTree::isIgnored(const Node *dir, const std::string &name, bool isDir) const {
+    std::string relative = relativePath(dir);
+    std::string childRelative = relative.empty() ? name : relative + "/" + name;
+    const std::shared_ptr<const IgnoreRules> &rules = dir->rules ? dir->rules : explorerDefaults();
+    return rules->isIgnored(childRelative, isDir);
+}
+
+void FileTree::renumber(Node *dir, int from) {
+    for (size_t i = from; i < dir->children.size(); i++) {
+        dir->children[i]->row = (int)i;
+    }
+}
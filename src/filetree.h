@@ -0,0 +1,66 @@
+#ifndef FILETREE_H
+#define FILETREE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "dirreader.h"
+#include "ignorerules.h"
+
+// Lazily listed directory tree for the file explorer. A directory is read
+// only when asked (getdents64 batches, no stat per entry), ignored entries
+// are dropped before nodes are built, and the sorted listing is exposed to
+// the view in chunks so huge directories don't materialize all at once.
+class FileTree {
+public:
+    struct Node {
+        std::string name;
+        bool isDir;
+        Node *parent;
+        int row;                                    // index in parent->children
+        bool listed;
+        std::vector<std::unique_ptr<Node>> children; // exposed rows
+        std::vector<DirEntry> pending;              // listed, sorted, not yet exposed
+        std::shared_ptr<const IgnoreRules> rules;   // rules in effect inside this dir
+    };
+
+    explicit FileTree(const std::string &root);
+
+    Node *root() { return rootNode.get(); }
+    std::string rootPath() const { return rootDir; }
+    std::string relativePath(const Node *node) const;
+    std::string absolutePath(const Node *node) const;
+
+    // Reads and sorts dir's entries into pending, directories first
+    void list(Node *dir);
+    // Moves up to maxCount pending entries into children, returns how many
+    size_t expose(Node *dir, size_t maxCount);
+    // Drops a directory's listing so it is read again next time
+    void forget(Node *dir);
+
+    // Finds an exposed node by path relative to the root
+    Node *find(const std::string &relative);
+
+    // Where name would go among dir's exposed children; -1 if it sorts past
+    // them (it then belongs in pending)
+    int insertionRow(const Node *dir, const std::string &name, bool isDir) const;
+    Node *insertChild(Node *dir, int row, const std::string &name, bool isDir);
+    void addPending(Node *dir, const std::string &name, bool isDir);
+    int childRow(const Node *dir, const std::string &name) const;
+    void removeChild(Node *dir, int row);
+    bool removePending(Node *dir, const std::string &name);
+
+    bool isIgnored(const Node *dir, const std::string &name, bool isDir) const;
+
+    // Directories hidden from the explorer on top of VCS metadata
+    static std::shared_ptr<const IgnoreRules> explorerDefaults();
+
+private:
+    static bool sortsBefore(bool aDir, const std::string &a, bool bDir, const std::string &b);
+    void renumber(Node *dir, int from);
+
+    std::string rootDir;
+    std::unique_ptr<Node> rootNode;
+};
+
+#endif // FILETREE_H
@@ -0,0 +1,159 @@
+#include "filewatcher.h"
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                   | IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE_SELF | IN_ONLYDIR;
+
+FileWatcher::FileWatcher(Callback eventCallback)
+    : callback(std::move(eventCallback)) {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakePipe[0] = wakePipe[1] = -1;
+    if (inotifyFd < 0) return;
+
+    if (pipe2(wakePipe, O_CLOEXEC) != 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+    reader = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher() {
+    if (reader.joinable()) {
+        char byte = 0;
+        ssize_t ignored = write(wakePipe[1], &byte, 1);
+        (void)ignored;
+        reader.join();
+    }
+    if (wakePipe[0] >= 0) close(wakePipe[0]);
+    if (wakePipe[1] >= 0) close(wakePipe[1]);
+    if (inotifyFd >= 0) close(inotifyFd);
+}
+
+bool FileWatcher::isSupported() {
+    return true;
+}
+
+bool FileWatcher::addWatch(const std::string &directory) {
+    if (inotifyFd < 0) return false;
+
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), WATCH_MASK);
+    if (wd < 0) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    watchPaths[wd] = directory;
+    watchIds[directory] = wd;
+    return true;
+}
+
+void FileWatcher::removeWatch(const std::string &directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = watchIds.find(directory);
+    if (it == watchIds.end()) return;
+
+    inotify_rm_watch(inotifyFd, it->second);
+    watchPaths.erase(it->second);
+    watchIds.erase(it);
+}
+
+size_t FileWatcher::watchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return watchIds.size();
+}
+
+void FileWatcher::run() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+
+        std::vector<FileEvent> events;
+        while (true) {
+            ssize_t n = read(inotifyFd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (char *p = buffer; p < buffer + n; ) {
+                const inotify_event *event = (const inotify_event *)p;
+                p += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    events.push_back({FileEvent::Overflow, "", false});
+                    continue;
+                }
+
+                auto it = watchPaths.find(event->wd);
+                if (it == watchPaths.end()) continue;
+
+                if (event->mask & IN_IGNORED) {
+                    // The watch is gone (directory deleted or watch removed)
+                    watchIds.erase(it->second);
+                    watchPaths.erase(it);
+                    continue;
+                }
+
+                bool isDir = (event->mask & IN_ISDIR) != 0;
+                if (event->mask & IN_DELETE_SELF) {
+                    events.push_back({FileEvent::Deleted, it->second, true});
+                    continue;
+                }
+                if (event->len == 0) continue;
+
+                std::string path = it->second + "/" + event->name;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    events.push_back({FileEvent::Created, path, isDir});
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    events.push_back({FileEvent::Deleted, path, isDir});
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MODIFY)) {
+                    // A write burst reports one Modified per read
+                    bool repeated = !events.empty() && events.back().type == FileEvent::Modified
+                                    && events.back().path == path;
+                    if (!repeated) {
+                        events.push_back({FileEvent::Modified, path, isDir});
+                    }
+                }
+            }
+        }
+
+        if (!events.empty()) {
+            callback(events);
+        }
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher(Callback eventCallback)
+    : callback(std::move(eventCallback)), inotifyFd(-1) {
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+FileWatcher::~FileWatcher() {
+}
+
+bool FileWatcher::isSupported() {
+    return false;
+}
+
+bool FileWatcher::addWatch(const std::string &) {
+    return false;
+}
+
+void FileWatcher::removeWatch(const std::string &) {
+}
+
+size_t FileWatcher::watchCount() const {
+    return 0;
+}
+
+void FileWatcher::run() {
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct FileEvent {
+    enum Type { Created, Modified, Deleted, Overflow };
+
+    Type type;
+    std::string path;   // absolute; empty for Overflow
+    bool isDirectory;
+};
+
+// Watches directories for changes to their entries (not recursive) with
+// inotify. Events are read on a background thread and delivered in batches;
+// Overflow means events were dropped and watchers should rescan. On
+// platforms without inotify isSupported() is false and nothing is reported.
+class FileWatcher {
+public:
+    using Callback = std::function<void(const std::vector<FileEvent> &events)>;
+
+    explicit FileWatcher(Callback callback);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    static bool isSupported();
+
+    bool addWatch(const std::string &directory);
+    void removeWatch(const std::string &directory);
+    size_t watchCount() const;
+
+private:
+    void run();
+
+    Callback callback;
+    int inotifyFd;
+    int wakePipe[2];
+    std::thread reader;
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, std::string> watchPaths;
+    std::unordered_map<std::string, int> watchIds;
+};
+
+#endif // FILEWATCHER_H
@@ -0,0 +1,87 @@
+#include "foldset.h"
+#include <algorithm>
+
+FoldSet::FoldSet() : seenVersion(0), synced(false) {
+}
+
+int FoldSet::foldAt(int line) const {
+    auto it = std::upper_bound(folds.begin(), folds.end(), line,
+                               [](int value, const FoldRange &range) { return value < range.first; });
+    if (it == folds.begin()) return -1;
+    --it;
+    return line <= it->last ? (int)(it - folds.begin()) : -1;
+}
+
+void FoldSet::fold(int first, int last) {
+    if (first > last) return;
+
+    // Swallow folds inside or touching the new one, so that the line
+    // next to any fold is visible
+    std::vector<FoldRange> merged;
+    for (const FoldRange &range : folds) {
+        if (range.last + 1 < first || range.first > last + 1) {
+            merged.push_back(range);
+        } else {
+            first = std::min(first, range.first);
+            last = std::max(last, range.last);
+        }
+    }
+    auto position = std::lower_bound(merged.begin(), merged.end(), first,
+                                     [](const FoldRange &range, int value) { return range.first < value; });
+    merged.insert(position, {first, last});
+    folds = std::move(merged);
+}
+
+bool FoldSet::unfold(int line) {
+    int index = foldAt(line);
+    if (index < 0) index = foldAt(line + 1);
+    if (index < 0 || (folds[index].first != line + 1 && !isHidden(line))) return false;
+
+    folds.erase(folds.begin() + index);
+    return true;
+}
+
+void FoldSet::clear() {
+    folds.clear();
+}
+
+bool FoldSet::isHidden(int line) const {
+    return foldAt(line) >= 0;
+}
+
+bool FoldSet::isHeader(int line) const {
+    int index = foldAt(line + 1);
+    return index >= 0 && folds[index].first == line + 1;
+}
+
+int FoldSet::visibleLine(int line, int direction) const {
+    int index = foldAt(line);
+    if (index < 0) return line;
+    return direction < 0 ? folds[index].first - 1 : folds[index].last + 1;
+}
+
+void FoldSet::sync(const TextBuffer &buffer) {
+    if (synced && buffer.version() == seenVersion) return;
+
+    changes.clear();
+    if (!synced || !buffer.changesSince(seenVersion, changes)) {
+        // A new document, folds from before mean nothing
+        folds.clear();
+    }
+    for (const LineChange &change : changes) {
+        int end = change.first + change.removed;   // first line after the replaced ones
+        int delta = change.added - change.removed;
+        std::vector<FoldRange> kept;
+        for (FoldRange range : folds) {
+            if (range.last < change.first) {
+                kept.push_back(range);
+            } else if (range.first >= end) {
+                kept.push_back({range.first + delta, range.last + delta});
+            }
+            // Folds whose hidden lines were edited open up
+        }
+        folds = std::move(kept);
+    }
+    seenVersion = buffer.version();
+    synced = true;
+}
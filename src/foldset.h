@@ -0,0 +1,48 @@
+#ifndef FOLDSET_H
+#define FOLDSET_H
+
+#include <cstdint>
+#include <vector>
+#include "textbuffer.h"
+
+// Hidden lines [first, last] of a folded block; the line above stays
+// visible as the fold's header
+struct FoldRange {
+    int first;
+    int last;
+};
+
+// Folded regions of a buffer (WrapLayout gives their lines no rows). Folds
+// never overlap or touch: folding next to or around existing folds absorbs
+// them. Edits that touch hidden lines open the fold.
+class FoldSet {
+public:
+    FoldSet();
+
+    bool isEmpty() const { return folds.empty(); }
+    const std::vector<FoldRange> &ranges() const { return folds; }
+
+    void fold(int first, int last);
+    // Opens the fold hiding line or headed by it; false if there is none
+    bool unfold(int line);
+    void clear();
+
+    bool isHidden(int line) const;
+    bool isHeader(int line) const;
+    // line if it is visible, else the nearest visible line after (or
+    // before, for a negative direction) the fold hiding it
+    int visibleLine(int line, int direction) const;
+
+    // Follows edits made to buffer since the last call
+    void sync(const TextBuffer &buffer);
+
+private:
+    int foldAt(int line) const;     // index of the fold containing line, or -1
+
+    std::vector<FoldRange> folds;   // sorted
+    uint64_t seenVersion;
+    bool synced;
+    std::vector<LineChange> changes;
+};
+
+#endif // FOLDSET_H
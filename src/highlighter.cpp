@@ -0,0 +1,572 @@
+#include "highlighter.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+enum : Highlighter::LexState {
+    InCode = Highlighter::INITIAL_STATE,
+    InBlockComment,
+    InString,          // a "..." string continued with a backslash
+    InTripleDouble,
+    InTripleSingle,
+    InRawString
+};
+
+struct SyntaxDefinition {
+    std::vector<std::string_view> extensions;
+    std::vector<std::string_view> fileNames;
+    std::vector<std::string_view> keywords;   // sorted
+    std::vector<std::string_view> types;      // sorted
+    bool slashComments;
+    bool hashComments;
+    bool preprocessor;
+    bool tripleQuotes;
+    bool rawStrings;
+    bool charLiterals;                        // '...' is a one-line literal with escapes
+};
+
+static std::vector<SyntaxDefinition> makeDefinitions() {
+    std::vector<SyntaxDefinition> definitions;
+
+    SyntaxDefinition cpp;
+    cpp.extensions = {"c", "h", "cc", "cpp", "cxx", "c++", "hh", "hpp", "hxx", "inl", "ino"};
+    cpp.keywords = {
+        "alignas", "alignof", "asm", "break", "case", "catch", "class", "co_await", "co_return",
+        "co_yield", "concept", "const", "const_cast", "consteval", "constexpr", "constinit",
+        "continue", "decltype", "default", "delete", "do", "dynamic_cast", "else", "enum",
+        "explicit", "export", "extern", "false", "final", "for", "friend", "goto", "if", "inline",
+        "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override", "private",
+        "protected", "public", "register", "reinterpret_cast", "requires", "return", "sizeof",
+        "static", "static_assert", "static_cast", "struct", "switch", "template", "this",
+        "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union", "using",
+        "virtual", "volatile", "while"};
+    cpp.types = {
+        "auto", "bool", "char", "char16_t", "char32_t", "char8_t", "double", "float", "int",
+        "int16_t", "int32_t", "int64_t", "int8_t", "long", "ptrdiff_t", "short", "signed",
+        "size_t", "ssize_t", "uint16_t", "uint32_t", "uint64_t", "uint8_t", "unsigned", "void",
+        "wchar_t"};
+    cpp.slashComments = true;
+    cpp.hashComments = false;
+    cpp.preprocessor = true;
+    cpp.tripleQuotes = false;
+    cpp.rawStrings = true;
+    cpp.charLiterals = true;
+    definitions.push_back(cpp);
+
+    SyntaxDefinition python;
+    python.extensions = {"py", "pyw", "pyi"};
+    python.keywords = {
+        "False", "None", "True", "and", "as", "assert", "async", "await", "break", "class",
+        "continue", "def", "del", "elif", "else", "except", "finally", "for", "from", "global",
+        "if", "import", "in", "is", "lambda", "nonlocal", "not", "or", "pass", "raise", "return",
+        "try", "while", "with", "yield"};
+    python.types = {
+        "bool", "bytes", "dict", "float", "frozenset", "int", "list", "object", "self", "set",
+        "str", "tuple"};
+    python.slashComments = false;
+    python.hashComments = true;
+    python.preprocessor = false;
+    python.tripleQuotes = true;
+    python.rawStrings = false;
+    python.charLiterals = false;
+    definitions.push_back(python);
+
+    SyntaxDefinition shell;
+    shell.extensions = {"sh", "bash", "zsh", "mk", "cmake"};
+    shell.fileNames = {"Makefile", "makefile", "GNUmakefile", "CMakeLists.txt", ".bashrc", ".zshrc",
+                       ".profile"};
+    shell.keywords = {
+        "case", "do", "done", "elif", "else", "esac", "export", "fi", "for", "function", "if", "in",
+        "local", "return", "then", "until", "while"};
+    shell.slashComments = false;
+    shell.hashComments = true;
+    shell.preprocessor = false;
+    shell.tripleQuotes = false;
+    shell.rawStrings = false;
+    shell.charLiterals = false;
+    definitions.push_back(shell);
+
+    for (SyntaxDefinition &definition : definitions) {
+        std::sort(definition.keywords.begin(), definition.keywords.end());
+        std::sort(definition.types.begin(), definition.types.end());
+    }
+    return definitions;
+}
+
+static const std::vector<SyntaxDefinition> &syntaxDefinitions() {
+    static const std::vector<SyntaxDefinition> definitions = makeDefinitions();
+    return definitions;
+}
+
+static bool isIdentifierStart(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+static bool isIdentifierChar(unsigned char c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static void addRun(std::vector<StyleRun> &runs, size_t start, size_t end, TokenStyle style) {
+    if (end <= start) return;
+    if (!runs.empty() && runs.back().style == style && runs.back().start + runs.back().length == (int)start) {
+        runs.back().length += (int)(end - start);
+        return;
+    }
+    runs.push_back({(int)start, (int)(end - start), style});
+}
+
+// Position just past the closing quote, or npos when the line ends first
+static size_t skipQuoted(std::string_view text, size_t pos, char quote, bool escapes) {
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (escapes && c == '\\') {
+            pos += 2;
+        } else if (c == quote) {
+            return pos + 1;
+        } else {
+            pos++;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// End of a raw string's )delimiter" on a continuation line; the delimiter
+// itself is not part of the line state, so any short one is accepted
+static size_t findRawStringEnd(std::string_view text, size_t pos) {
+    while ((pos = text.find(')', pos)) != std::string_view::npos) {
+        size_t end = pos + 1;
+        while (end < text.size() && end - pos <= 16 && text[end] != '"' && text[end] != ')' &&
+               text[end] != ' ' && text[end] != '\\') {
+            end++;
+        }
+        if (end < text.size() && text[end] == '"') return end + 1;
+        pos++;
+    }
+    return std::string_view::npos;
+}
+
+const SyntaxDefinition *Highlighter::syntaxForFile(const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string_view name(path);
+    if (slash != std::string::npos) name.remove_prefix(slash + 1);
+
+    size_t dot = name.rfind('.');
+    std::string extension;
+    if (dot != std::string_view::npos && dot > 0) {
+        for (char c : name.substr(dot + 1)) extension += (char)std::tolower((unsigned char)c);
+    }
+
+    for (const SyntaxDefinition &definition : syntaxDefinitions()) {
+        for (std::string_view fileName : definition.fileNames) {
+            if (name == fileName) return &definition;
+        }
+        for (std::string_view candidate : definition.extensions) {
+            if (extension == candidate) return &definition;
+        }
+    }
+    return nullptr;
+}
+
+Highlighter::LexState Highlighter::lexLine(const SyntaxDefinition &syntax, std::string_view text,
+                                           LexState state, std::vector<StyleRun> &runs) {
+    runs.clear();
+    size_t n = text.size();
+    size_t i = 0;
+
+    // Finish whatever the previous line left open
+    if (state != InCode) {
+        size_t end = std::string_view::npos;
+        TokenStyle style = TokenStyle::String;
+        switch (state) {
+            case InBlockComment:
+                end = text.find("*/");
+                if (end != std::string_view::npos) end += 2;
+                style = TokenStyle::Comment;
+                break;
+            case InString:
+                end = skipQuoted(text, 0, '"', true);
+                if (end == std::string_view::npos && (n == 0 || text[n - 1] != '\\')) end = n;
+                break;
+            case InTripleDouble:
+                end = text.find("\"\"\"");
+                if (end != std::string_view::npos) end += 3;
+                break;
+            case InTripleSingle:
+                end = text.find("'''");
+                if (end != std::string_view::npos) end += 3;
+                break;
+            case InRawString:
+                end = findRawStringEnd(text, 0);
+                break;
+            default:
+                end = 0;
+                break;
+        }
+        if (end == std::string_view::npos) {
+            addRun(runs, 0, n, style);
+            return state;
+        }
+        addRun(runs, 0, end, style);
+        i = end;
+    }
+
+    bool lineStart = i == 0;
+    while (i < n) {
+        char c = text[i];
+        char next = i + 1 < n ? text[i + 1] : '\0';
+
+        if (c == ' ' || c == '\t') {
+            i++;
+            continue;
+        }
+
+        if (syntax.preprocessor && c == '#' && lineStart) {
+            size_t end = i + 1;
+            while (end < n && (text[end] == ' ' || text[end] == '\t')) end++;
+            size_t word = end;
+            while (end < n && isIdentifierChar(text[end])) end++;
+            addRun(runs, i, end, TokenStyle::Preprocessor);
+            if (text.substr(word, end - word) == "include") {
+                while (end < n && text[end] == ' ') end++;
+                if (end < n && text[end] == '<') {
+                    size_t close = text.find('>', end);
+                    close = close == std::string_view::npos ? n : close + 1;
+                    addRun(runs, end, close, TokenStyle::String);
+                    end = close;
+                }
+            }
+            i = end;
+            lineStart = false;
+            continue;
+        }
+        lineStart = false;
+
+        if (syntax.slashComments && c == '/' && next == '/') {
+            addRun(runs, i, n, TokenStyle::Comment);
+            return InCode;
+        }
+        if (syntax.slashComments && c == '/' && next == '*') {
+            size_t end = text.find("*/", i + 2);
+            if (end == std::string_view::npos) {
+                addRun(runs, i, n, TokenStyle::Comment);
+                return InBlockComment;
+            }
+            addRun(runs, i, end + 2, TokenStyle::Comment);
+            i = end + 2;
+            continue;
+        }
+        if (syntax.hashComments && c == '#') {
+            addRun(runs, i, n, TokenStyle::Comment);
+            return InCode;
+        }
+
+        if (syntax.tripleQuotes && (c == '"' || c == '\'') && next == c && i + 2 < n && text[i + 2] == c) {
+            std::string_view delimiter = c == '"' ? "\"\"\"" : "'''";
+            size_t end = text.find(delimiter, i + 3);
+            if (end == std::string_view::npos) {
+                addRun(runs, i, n, TokenStyle::String);
+                return c == '"' ? InTripleDouble : InTripleSingle;
+            }
+            addRun(runs, i, end + 3, TokenStyle::String);
+            i = end + 3;
+            continue;
+        }
+
+        if (syntax.rawStrings && c == 'R' && next == '"') {
+            size_t open = text.find('(', i + 2);
+            if (open != std::string_view::npos) {
+                std::string closing = ")" + std::string(text.substr(i + 2, open - i - 2)) + "\"";
+                size_t end = text.find(closing, open + 1);
+                if (end == std::string_view::npos) {
+                    addRun(runs, i, n, TokenStyle::String);
+                    return InRawString;
+                }
+                addRun(runs, i, end + closing.size(), TokenStyle::String);
+                i = end + closing.size();
+                continue;
+            }
+        }
+
+        if (c == '"' || c == '\'') {
+            bool escapes = syntax.slashComments || syntax.tripleQuotes || c == '"';
+            size_t end = skipQuoted(text, i + 1, c, escapes);
+            if (end == std::string_view::npos) {
+                addRun(runs, i, n, TokenStyle::String);
+                // Only C strings carry on past a trailing backslash
+                bool continued = c == '"' && syntax.slashComments && n > 0 && text[n - 1] == '\\';
+                return continued ? InString : InCode;
+            }
+            addRun(runs, i, end, TokenStyle::String);
+            i = end;
+            continue;
+        }
+
+        if (isDigit(c) || (c == '.' && isDigit(next))) {
+            size_t end = i + 1;
+            while (end < n) {
+                char d = text[end];
+                if (isIdentifierChar(d) || d == '.' || (d == '\'' && syntax.charLiterals)) {
+                    end++;
+                } else if ((d == '+' || d == '-') && (text[end - 1] == 'e' || text[end - 1] == 'E' ||
+                                                      text[end - 1] == 'p' || text[end - 1] == 'P')) {
+                    end++;
+                } else {
+                    break;
+                }
+            }
+            addRun(runs, i, end, TokenStyle::Number);
+            i = end;
+            continue;
+        }
+
+        if (isIdentifierStart(c)) {
+            size_t end = i + 1;
+            while (end < n && isIdentifierChar(text[end])) end++;
+            std::string_view word = text.substr(i, end - i);
+            if (std::binary_search(syntax.keywords.begin(), syntax.keywords.end(), word)) {
+                addRun(runs, i, end, TokenStyle::Keyword);
+            } else if (std::binary_search(syntax.types.begin(), syntax.types.end(), word)) {
+                addRun(runs, i, end, TokenStyle::Type);
+            }
+            i = end;
+            continue;
+        }
+
+        i++;
+    }
+    return InCode;
+}
+
+Highlighter::Highlighter()
+    : definition(nullptr)
+    , seenVersion(0)
+    , frontierState(INITIAL_STATE)
+    , dirtyStart(0)
+    , dirtyEnd(0)
+{
+    guess.version = 0;
+}
+
+void Highlighter::setFileName(const std::string &path) {
+    const SyntaxDefinition *newDefinition = syntaxForFile(path);
+    if (newDefinition != definition) {
+        definition = newDefinition;
+        reset();
+    }
+}
+
+void Highlighter::reset() {
+    runs.clear();
+    startStates.clear();
+    frontierState = INITIAL_STATE;
+    dirtyStart = dirtyEnd = 0;
+    guess.version = 0;
+    guess.runs.clear();
+}
+
+size_t Highlighter::memoryUsage() const {
+    size_t bytes = runs.capacity() * sizeof(std::vector<StyleRun>) + startStates.capacity();
+    for (const std::vector<StyleRun> &line : runs) bytes += line.capacity() * sizeof(StyleRun);
+    bytes += guess.runs.capacity() * sizeof(std::vector<StyleRun>) + guess.startStates.capacity();
+    for (const std::vector<StyleRun> &line : guess.runs) bytes += line.capacity() * sizeof(StyleRun);
+    return bytes + changes.capacity() * sizeof(LineChange);
+}
+
+void Highlighter::dropCache() {
+    reset();
+    runs.shrink_to_fit();
+    startStates.shrink_to_fit();
+    guess.runs.shrink_to_fit();
+    guess.startStates = std::vector<uint8_t>();
+    changes = std::vector<LineChange>();
+}
+
+static const std::vector<StyleRun> noStyles;
+
+const std::vector<StyleRun> &Highlighter::lineStyles(const TextBuffer &buffer, int line) {
+    if (!definition || line < 0 || line >= buffer.lineCount()) return noStyles;
+
+    sync(buffer);
+    lexTo(buffer, line, INT_MAX);
+    return runs[line];
+}
+
+bool Highlighter::prepare(const TextBuffer &buffer, int lastLine, int maxLexLines) {
+    if (!definition) return true;
+
+    sync(buffer);
+    return lexTo(buffer, std::min(lastLine, buffer.lineCount() - 1), maxLexLines);
+}
+
+bool Highlighter::isExact(int line) const {
+    return line < (int)runs.size() && !(line >= dirtyStart && line < dirtyEnd);
+}
+
+const std::vector<StyleRun> &Highlighter::cachedStyles(int line) const {
+    if (!definition || line < 0) return noStyles;
+    if (isExact(line)) return runs[line];
+
+    int guessed = line - guess.firstLine;
+    if (guess.version == seenVersion && guessed >= 0 && guessed < (int)guess.runs.size()) {
+        return guess.runs[guessed];
+    }
+    return line < (int)runs.size() ? runs[line] : noStyles;
+}
+
+bool Highlighter::pendingWork(const TextBuffer &buffer, int &line, LexState &state) {
+    if (!definition) return false;
+
+    sync(buffer);
+    if (dirtyStart < dirtyEnd) {
+        line = dirtyStart;
+        state = startStates[dirtyStart];
+        return true;
+    }
+    if ((int)runs.size() < buffer.lineCount()) {
+        line = (int)runs.size();
+        state = frontierState;
+        return true;
+    }
+    return false;
+}
+
+bool Highlighter::adopt(const TextBuffer &buffer, HighlightBatch batch) {
+    if (!definition) return false;
+
+    sync(buffer);
+    if (batch.version != seenVersion) return false;
+    if (batch.guessed) {
+        guess = std::move(batch);
+        return true;
+    }
+
+    // Only a batch that starts where the exact lines end can be trusted
+    int first = batch.firstLine;
+    int last = first + (int)batch.runs.size();
+    bool dirty = dirtyStart < dirtyEnd;
+    int exactEnd = dirty ? dirtyStart : (int)runs.size();
+    LexState expected = first < (int)runs.size() ? startStates[first] : frontierState;
+    if (first > exactEnd || batch.runs.empty() || batch.startStates.front() != expected) return false;
+
+    if (last > (int)runs.size()) {
+        runs.resize(last);
+        startStates.resize(last);
+        frontierState = batch.endState;
+    }
+    for (int i = 0; i < (int)batch.runs.size(); i++) {
+        runs[first + i] = std::move(batch.runs[i]);
+        startStates[first + i] = batch.startStates[i];
+    }
+
+    // Whatever was dirty inside the batch is done; the line after it is
+    // still right only if it starts where the batch ended
+    if (dirty && dirtyEnd <= last) {
+        dirtyStart = dirtyEnd = 0;
+    } else if (dirty) {
+        dirtyStart = std::max(dirtyStart, last);
+    }
+    if (last < (int)runs.size() && startStates[last] != batch.endState) {
+        startStates[last] = batch.endState;
+        if (dirtyStart < dirtyEnd) {
+            dirtyStart = last;
+        } else {
+            dirtyStart = last;
+            dirtyEnd = last + 1;
+        }
+    }
+    return true;
+}
+
+void Highlighter::sync(const TextBuffer &buffer) {
+    if (buffer.version() == seenVersion) return;
+
+    changes.clear();
+    if (buffer.changesSince(seenVersion, changes)) {
+        for (const LineChange &change : changes) {
+            applyChange(change);
+        }
+    } else {
+        reset();
+    }
+    seenVersion = buffer.version();
+}
+
+void Highlighter::applyChange(const LineChange &change) {
+    int lexed = (int)runs.size();
+    int first = change.first;
+    if (first >= lexed) return;
+
+    // The edited line still starts where the line above ends
+    LexState firstState = startStates[first];
+
+    if (first + change.removed > lexed) {
+        // Reaches past what was lexed, so just forget from the edit on
+        runs.resize(first);
+        startStates.resize(first);
+        frontierState = firstState;
+        dirtyEnd = std::min(dirtyEnd, first);
+        if (dirtyStart >= dirtyEnd) dirtyStart = dirtyEnd = 0;
+        return;
+    }
+
+    int delta = change.added - change.removed;
+    if (delta > 0) {
+        runs.insert(runs.begin() + first, delta, std::vector<StyleRun>());
+        startStates.insert(startStates.begin() + first, delta, INITIAL_STATE);
+    } else if (delta < 0) {
+        runs.erase(runs.begin() + first, runs.begin() + first - delta);
+        startStates.erase(startStates.begin() + first, startStates.begin() + first - delta);
+    }
+    lexed += delta;
+
+    if (first >= lexed) {
+        // Only trailing lines were removed
+        frontierState = firstState;
+        dirtyEnd = std::min(dirtyEnd, lexed);
+        if (dirtyStart >= dirtyEnd) dirtyStart = dirtyEnd = 0;
+        return;
+    }
+    startStates[first] = firstState;
+
+    // A pure deletion still changes what the following line starts after
+    int editEnd = std::min(first + std::max(change.added, 1), lexed);
+    if (dirtyStart < dirtyEnd) {
+        auto shift = [&](int line) { return line >= first + change.removed ? line + delta : std::min(line, first); };
+        dirtyStart = std::min(shift(dirtyStart), first);
+        dirtyEnd = std::min(std::max(shift(dirtyEnd), editEnd), lexed);
+    } else {
+        dirtyStart = first;
+        dirtyEnd = editEnd;
+    }
+}
+
+bool Highlighter::lexTo(const TextBuffer &buffer, int line, int maxLexLines) {
+    int budget = maxLexLines;
+    while (dirtyStart < dirtyEnd && dirtyStart <= line) {
+        if (budget-- <= 0) return false;
+        int current = dirtyStart++;
+        LexState end = lexLine(*definition, buffer.line(current), startStates[current], runs[current]);
+
+        if (current + 1 < (int)runs.size()) {
+            // Lexing stops once a line ends the way the next one expects
+            if (current + 1 >= dirtyEnd && startStates[current + 1] != end) dirtyEnd = current + 2;
+            startStates[current + 1] = end;
+        } else {
+            frontierState = end;
+        }
+    }
+    if (dirtyStart >= dirtyEnd) dirtyStart = dirtyEnd = 0;
+
+    while ((int)runs.size() <= line) {
+        if (budget-- <= 0) return false;
+        int current = (int)runs.size();
+        startStates.push_back(frontierState);
+        runs.emplace_back();
+        frontierState = lexLine(*definition, buffer.line(current), frontierState, runs.back());
+    }
+    return true;
+}
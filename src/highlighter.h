@@ -0,0 +1,111 @@
+#ifndef HIGHLIGHTER_H
+#define HIGHLIGHTER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+
+enum class TokenStyle : uint8_t {
+    Plain,
+    Keyword,
+    Type,
+    String,
+    Number,
+    Comment,
+    Preprocessor
+};
+
+// Columns [start, start + length) of a line drawn in one style; text
+// between runs is Plain
+struct StyleRun {
+    int start;
+    int length;
+    TokenStyle style;
+};
+
+struct SyntaxDefinition;
+
+// Lines [firstLine, firstLine + runs.size()) of one buffer version, lexed
+// away from the Highlighter (see HighlightJob). A guessed batch was lexed
+// from an assumed state to show something quickly and may be wrong.
+struct HighlightBatch {
+    uint64_t version;
+    int firstLine;
+    std::vector<uint8_t> startStates;
+    std::vector<std::vector<StyleRun>> runs;
+    uint8_t endState;
+    bool guessed;
+};
+
+// Syntax highlighting that only lexes what an edit can have changed. The
+// lexer state at the start of every lexed line is cached; after an edit
+// lines are lexed again from the edited one until a line ends in the state
+// the next line was lexed with before, and everything after is reused.
+// Lines past the furthest one asked for are never lexed.
+class Highlighter {
+public:
+    // State a line starts in (inside a block comment, string, ...)
+    using LexState = uint8_t;
+    static constexpr LexState INITIAL_STATE = 0;
+
+    Highlighter();
+
+    // Picks the syntax from the file name; unknown files are not highlighted
+    void setFileName(const std::string &path);
+    const SyntaxDefinition *syntax() const { return definition; }
+
+    // Styles of one line of buffer, valid until the next call
+    const std::vector<StyleRun> &lineStyles(const TextBuffer &buffer, int line);
+
+    // For callers that must not stall: catches up with buffer and lexes
+    // towards lastLine, but at most maxLexLines lines. Returns true when
+    // every line up to lastLine is exact.
+    bool prepare(const TextBuffer &buffer, int lastLine, int maxLexLines);
+    // Best styles known for a line without lexing: exact, else a guessed
+    // batch, else what the line had before it was edited, else none
+    const std::vector<StyleRun> &cachedStyles(int line) const;
+
+    // First line that still needs lexing and the state it starts in, as a
+    // starting point for background work; false when all lines are done
+    bool pendingWork(const TextBuffer &buffer, int &line, LexState &state);
+    // Takes lines lexed in the background. Exact batches are merged when
+    // they continue from an exact line of the same buffer version; guessed
+    // ones are kept until the next edit. Returns false if it was stale.
+    bool adopt(const TextBuffer &buffer, HighlightBatch batch);
+
+    // Heap bytes of the cached styles and states; dropCache forgets them,
+    // to be lexed again when asked for
+    size_t memoryUsage() const;
+    void dropCache();
+
+    static const SyntaxDefinition *syntaxForFile(const std::string &path);
+    // Lexes one line starting in state and returns the state it ends in
+    static LexState lexLine(const SyntaxDefinition &syntax, std::string_view text, LexState state,
+                            std::vector<StyleRun> &runs);
+
+private:
+    void sync(const TextBuffer &buffer);
+    void applyChange(const LineChange &change);
+    bool lexTo(const TextBuffer &buffer, int line, int maxLexLines);
+    bool isExact(int line) const;
+    void reset();
+
+    const SyntaxDefinition *definition;
+    uint64_t seenVersion;
+
+    // One entry per lexed line, from the top of the buffer
+    std::vector<std::vector<StyleRun>> runs;
+    std::vector<LexState> startStates;
+    LexState frontierState;            // end state of the last lexed line
+
+    // Lines [dirtyStart, dirtyEnd) need lexing again; startStates[dirtyStart] is right
+    int dirtyStart, dirtyEnd;
+    std::vector<LineChange> changes;
+
+    // Guessed styles for a region ahead of the exact lines (version 0 when none)
+    HighlightBatch guess;
+};
+
+#endif // HIGHLIGHTER_H
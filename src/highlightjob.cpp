@@ -0,0 +1,130 @@
+#include "highlightjob.h"
+#include "traceevents.h"
+#include <algorithm>
+#include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Viewports closer than this to the pass are left to the pass itself
+static const int GUESS_DISTANCE = 2000;
+// Lines lexed above a guessed viewport so it usually starts in code
+static const int GUESS_LEAD_IN = 200;
+static const size_t BATCH_LINES = 8192;
+static const auto BATCH_INTERVAL = std::chrono::milliseconds(16);
+
+static uint64_t packViewport(int first, int last) {
+    return ((uint64_t)(uint32_t)first << 32) | (uint32_t)last;
+}
+
+HighlightJob::HighlightJob(std::shared_ptr<const TextBuffer> buffer, const SyntaxDefinition &definition,
+                           int firstLine, Highlighter::LexState firstState, int viewportFirst,
+                           int viewportLast, BatchCallback batchCallback)
+    : snapshot(std::move(buffer))
+    , syntax(definition)
+    , startLine(firstLine)
+    , startState(firstState)
+    , viewport(packViewport(viewportFirst, viewportLast))
+    , callback(std::move(batchCallback))
+    , cancelled(false)
+{
+    worker = std::thread(&HighlightJob::run, this);
+}
+
+HighlightJob::~HighlightJob() {
+    cancel();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void HighlightJob::setViewport(int first, int last) {
+    viewport = packViewport(first, last);
+}
+
+void HighlightJob::guessViewport(int first, int last) {
+    int lineCount = snapshot->lineCount();
+    last = std::min(last, lineCount - 1);
+    if (first > last) return;
+
+    HighlightBatch batch;
+    batch.version = snapshot->version();
+    batch.firstLine = first;
+    batch.guessed = true;
+
+    std::vector<StyleRun> scratch;
+    Highlighter::LexState state = Highlighter::INITIAL_STATE;
+    for (int line = std::max(startLine, first - GUESS_LEAD_IN); line < first; line++) {
+        state = Highlighter::lexLine(syntax, snapshot->line(line), state, scratch);
+    }
+    for (int line = first; line <= last; line++) {
+        batch.startStates.push_back(state);
+        batch.runs.emplace_back();
+        state = Highlighter::lexLine(syntax, snapshot->line(line), state, batch.runs.back());
+    }
+    batch.endState = state;
+    callback(std::move(batch), false);
+}
+
+void HighlightJob::run() {
+    setTraceThreadName("highlighter");
+    TRACE_SCOPE("HighlightJob");
+    uint64_t guessedViewport = viewport;
+    int first = (int)(guessedViewport >> 32);
+    int last = (int)(uint32_t)guessedViewport;
+    if (first - startLine > GUESS_DISTANCE) {
+        guessViewport(first, last);
+    }
+
+#ifdef __linux__
+    // What is off screen fills in when nothing else wants the CPU
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    HighlightBatch batch;
+    auto startBatch = [&](int line, Highlighter::LexState state) {
+        batch = HighlightBatch();
+        batch.version = snapshot->version();
+        batch.firstLine = line;
+        batch.endState = state;
+        batch.guessed = false;
+    };
+
+    int lineCount = snapshot->lineCount();
+    startBatch(startLine, startState);
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    for (int line = startLine; line < lineCount; line++) {
+        if (cancelled.load(std::memory_order_relaxed)) return;
+
+        batch.startStates.push_back(batch.endState);
+        batch.runs.emplace_back();
+        batch.endState = Highlighter::lexLine(syntax, snapshot->line(line), batch.endState, batch.runs.back());
+
+        if (batch.runs.size() < BATCH_LINES && (line & 255) != 0) continue;
+        auto now = std::chrono::steady_clock::now();
+        if (batch.runs.size() < BATCH_LINES && now - lastFlush < BATCH_INTERVAL) continue;
+
+        Highlighter::LexState state = batch.endState;
+        callback(std::move(batch), false);
+        startBatch(line + 1, state);
+        lastFlush = now;
+
+        // The user scrolled somewhere the pass is still far from
+        uint64_t current = viewport;
+        if (current != guessedViewport) {
+            guessedViewport = current;
+            first = (int)(current >> 32);
+            last = (int)(uint32_t)current;
+            if (first - line > GUESS_DISTANCE) {
+                guessViewport(first, last);
+            }
+        }
+    }
+
+    if (!cancelled) {
+        callback(std::move(batch), true);
+    }
+}
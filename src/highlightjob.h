@@ -0,0 +1,46 @@
+#ifndef HIGHLIGHTJOB_H
+#define HIGHLIGHTJOB_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "highlighter.h"
+#include "textbuffer.h"
+
+// Lexes an immutable snapshot of a buffer on a worker thread, from a line
+// whose start state is known to the end. If the viewport is far below that
+// line it is lexed first from a guessed state so something shows at once;
+// the full pass then runs at idle priority and streams exact batches. The
+// callback runs on the worker thread. Destroying the job cancels it and
+// waits for the worker.
+class HighlightJob {
+public:
+    using BatchCallback = std::function<void(HighlightBatch batch, bool finished)>;
+
+    HighlightJob(std::shared_ptr<const TextBuffer> snapshot, const SyntaxDefinition &syntax,
+                 int startLine, Highlighter::LexState startState, int viewportFirst, int viewportLast,
+                 BatchCallback callback);
+    ~HighlightJob();
+
+    void cancel() { cancelled = true; }
+    // Lines on screen now; a viewport the pass has not reached yet gets a
+    // guessed batch before the pass continues
+    void setViewport(int first, int last);
+    uint64_t version() const { return snapshot->version(); }
+
+private:
+    void run();
+    void guessViewport(int first, int last);
+
+    std::shared_ptr<const TextBuffer> snapshot;
+    const SyntaxDefinition &syntax;
+    int startLine;
+    Highlighter::LexState startState;
+    std::atomic<uint64_t> viewport;   // first << 32 | last
+    BatchCallback callback;
+    std::atomic<bool> cancelled;
+    std::thread worker;
+};
+
+#endif // HIGHLIGHTJOB_H
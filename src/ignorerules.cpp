@@ -0,0 +1,168 @@
+#include "ignorerules.h"
+#include <cstring>
+#include <fstream>
+
+IgnoreRules::IgnoreRules(std::shared_ptr<const IgnoreRules> parentRules, const std::string &baseDir)
+    : parent(std::move(parentRules)), base(baseDir) {
+}
+
+void IgnoreRules::addPattern(const std::string &line) {
+    std::string text = line;
+    if (!text.empty() && text.back() == '\r') text.pop_back();
+
+    // Trailing spaces are ignored unless escaped
+    while (!text.empty() && text.back() == ' ' && (text.size() < 2 || text[text.size() - 2] != '\\')) {
+        text.pop_back();
+    }
+    if (text.empty() || text[0] == '#') return;
+
+    Pattern pattern;
+    pattern.negate = false;
+    pattern.dirOnly = false;
+    pattern.anchored = false;
+
+    if (text[0] == '!') {
+        pattern.negate = true;
+        text.erase(0, 1);
+    } else if (text[0] == '\\' && text.size() > 1 && (text[1] == '!' || text[1] == '#')) {
+        text.erase(0, 1);
+    }
+
+    if (!text.empty() && text.back() == '/') {
+        pattern.dirOnly = true;
+        text.pop_back();
+    }
+    if (!text.empty() && text[0] == '/') {
+        pattern.anchored = true;
+        text.erase(0, 1);
+    } else if (text.find('/') != std::string::npos) {
+        pattern.anchored = true;
+    }
+    if (text.empty()) return;
+
+    pattern.glob = text;
+    patterns.push_back(std::move(pattern));
+}
+
+bool IgnoreRules::addFile(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        addPattern(line);
+    }
+    return true;
+}
+
+int IgnoreRules::match(const std::string &relativePath, bool isDir) const {
+    const char *rel = relativePath.c_str();
+    if (!base.empty()) {
+        if (relativePath.compare(0, base.size(), base) != 0 || relativePath.size() <= base.size()
+            || relativePath[base.size()] != '/') {
+            return -1;
+        }
+        rel += base.size() + 1;
+    }
+
+    const char *slash = strrchr(rel, '/');
+    const char *name = slash ? slash + 1 : rel;
+
+    for (auto it = patterns.rbegin(); it != patterns.rend(); ++it) {
+        if (it->dirOnly && !isDir) continue;
+        if (globMatch(it->glob.c_str(), it->anchored ? rel : name)) {
+            return it->negate ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+bool IgnoreRules::isIgnored(const std::string &relativePath, bool isDir) const {
+    for (const IgnoreRules *rules = this; rules; rules = rules->parent.get()) {
+        int result = rules->match(relativePath, isDir);
+        if (result >= 0) return result == 1;
+    }
+    return false;
+}
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::defaults() {
+    static std::shared_ptr<const IgnoreRules> rules = [] {
+        auto r = std::make_shared<IgnoreRules>(nullptr, "");
+        r->addPattern(".git/");
+        r->addPattern(".hg/");
+        r->addPattern(".svn/");
+        return r;
+    }();
+    return rules;
+}
+
+bool IgnoreRules::globMatch(const char *p, const char *t) {
+    while (*p) {
+        if (p[0] == '*' && p[1] == '*') {
+            p += 2;
+            if (*p == '/') {
+                // "**/" matches zero or more leading directories
+                p++;
+                for (const char *s = t; ; ) {
+                    if (globMatch(p, s)) return true;
+                    const char *next = strchr(s, '/');
+                    if (!next) return false;
+                    s = next + 1;
+                }
+            }
+            // Any other "**" matches across directories
+            for (const char *s = t; ; ++s) {
+                if (globMatch(p, s)) return true;
+                if (!*s) return false;
+            }
+        }
+
+        if (*p == '*') {
+            p++;
+            for (const char *s = t; ; ++s) {
+                if (globMatch(p, s)) return true;
+                if (!*s || *s == '/') return false;
+            }
+        }
+
+        if (!*t) return false;
+
+        if (*p == '?') {
+            if (*t == '/') return false;
+            p++;
+            t++;
+            continue;
+        }
+
+        if (*p == '[') {
+            const char *q = p + 1;
+            bool negate = (*q == '!' || *q == '^');
+            if (negate) q++;
+            bool matched = false;
+            bool first = true;
+            while (*q && (*q != ']' || first)) {
+                first = false;
+                if (q[1] == '-' && q[2] && q[2] != ']') {
+                    if (*t >= q[0] && *t <= q[2]) matched = true;
+                    q += 3;
+                } else {
+                    if (*t == *q) matched = true;
+                    q++;
+                }
+            }
+            if (*q == ']') {
+                if (matched == negate || *t == '/') return false;
+                p = q + 1;
+                t++;
+                continue;
+            }
+            // No closing bracket: treat '[' literally
+        }
+
+        if (*p == '\\' && p[1]) p++;
+        if (*p != *t) return false;
+        p++;
+        t++;
+    }
+    return *t == '\0';
+}
@@ -0,0 +1,45 @@
+#ifndef IGNORERULES_H
+#define IGNORERULES_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// .gitignore style rules for one directory level. Rules are chained to the
+// parent directory's rules; the deepest file with a matching pattern decides,
+// and within a file the last matching pattern wins, as in git.
+class IgnoreRules {
+public:
+    // base is the directory the patterns are relative to, relative to the
+    // workspace root ("" for the root itself)
+    IgnoreRules(std::shared_ptr<const IgnoreRules> parent, const std::string &base);
+
+    void addPattern(const std::string &line);
+    bool addFile(const std::string &path);
+    bool isEmpty() const { return patterns.empty(); }
+
+    // relativePath is relative to the workspace root, '/' separated
+    bool isIgnored(const std::string &relativePath, bool isDir) const;
+
+    // Rules every walk starts from (VCS metadata directories)
+    static std::shared_ptr<const IgnoreRules> defaults();
+
+    static bool globMatch(const char *pattern, const char *text);
+
+private:
+    struct Pattern {
+        std::string glob;
+        bool negate;
+        bool dirOnly;
+        bool anchored; // contains a '/', matched against the full path
+    };
+
+    // Returns 1 = ignored, 0 = explicitly not ignored, -1 = no opinion
+    int match(const std::string &relativePath, bool isDir) const;
+
+    std::shared_ptr<const IgnoreRules> parent;
+    std::string base;
+    std::vector<Pattern> patterns;
+};
+
+#endif // IGNORERULES_H
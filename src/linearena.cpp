@@ -0,0 +1,170 @@
+#include "linearena.h"
+#include "blockcodec.h"
+#include "traceevents.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// Blocks double from the first up to the largest, so small files stay small;
+// big ones are all in blocks of the largest size, the unit of compression
+static const size_t FIRST_BLOCK = 64 << 10;
+static const size_t BLOCK_SIZE = 1 << 20;
+// Blocks kept decompressed however long ago they were read
+static const size_t HOT_BLOCKS = 16;
+
+// Cooling passes so far, over every buffer; blocks remember the last one
+// they were read in
+static std::atomic<uint32_t> coolingPasses{0};
+
+// Full-size blocks, all but the first few of any document big enough to be
+// compressed, are mapped on their own, so cooling one hands its pages back
+// to the system instead of leaving a hole in the heap. Smaller blocks stay
+// on the heap, where small files are quicker to allocate.
+static char *allocateText(size_t size, bool mapped) {
+    if (!mapped) return new char[size];
+    void *pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) throw std::bad_alloc();
+    return (char *)pages;
+}
+
+static void freeText(char *text, size_t size, bool mapped) {
+    if (!mapped) {
+        delete[] text;
+    } else if (text) {
+        munmap(text, size);
+    }
+}
+
+Line::Line(std::string text) : owner(new Text{{1}, std::move(text)}), length(OWNED), offset(0) {}
+
+void Line::release() {
+    if (owner->references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete owner;
+}
+
+size_t Line::ownedBytes() const {
+    if (!isOwned()) return 0;
+    // Short strings live inside the string itself
+    size_t bytes = sizeof(Text);
+    if (owner->text.capacity() >= sizeof(std::string)) bytes += owner->text.capacity() + 1;
+    return bytes;
+}
+
+std::string &Line::edit() {
+    if (!isOwned()) {
+        // Room to type into before the string has to grow
+        std::string_view view = text();
+        std::string copy;
+        copy.reserve(length + 16);
+        copy.append(view.data(), view.size());
+        owner = new Text{{1}, std::move(copy)};
+        length = OWNED;
+        offset = 0;
+    } else if (owner->references.load(std::memory_order_acquire) > 1) {
+        *this = Line(owner->text);
+    }
+    return owner->text;
+}
+
+TextBlock::TextBlock(size_t capacity)
+    : raw(allocateText(capacity, capacity >= BLOCK_SIZE)), rawSize(capacity), capacity(capacity), length(0),
+      mapped(capacity >= BLOCK_SIZE), wasRead(false), lastRead(0), incompressible(false) {}
+
+TextBlock::~TextBlock() {
+    freeText(raw.load(std::memory_order_relaxed), rawSize, mapped);
+}
+
+size_t TextBlock::residentBytes() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return packed.capacity() + (raw.load(std::memory_order_relaxed) ? rawSize : 0);
+}
+
+char *TextBlock::thaw() {
+    TRACE_SCOPE("thawBlock");
+    // Two threads may read it at once; the second finds it thawed
+    std::lock_guard<std::mutex> guard(lock);
+    if (char *text = raw.load(std::memory_order_acquire)) return text;
+    char *text = allocateText(length, mapped);
+    decompressBlock(packed, text, length);
+    // Hot text and its compressed copy together would take more than the
+    // text did before; cooling it again compresses it again
+    std::string().swap(packed);
+    rawSize = length;
+    raw.store(text, std::memory_order_release);
+    return text;
+}
+
+size_t LineArena::Storage::residentBytes() const {
+    size_t total = 0;
+    for (const auto &block : blocks) total += block->residentBytes();
+    return total;
+}
+
+LineArena::LineArena() : storage(std::make_shared<Storage>()), current(nullptr) {}
+
+TextBlock *LineArena::addBlock(size_t capacity) {
+    storage->blocks.emplace_back(new TextBlock(capacity));
+    storage->bytes += capacity;
+    return storage->blocks.back().get();
+}
+
+void LineArena::append(std::string_view text) {
+    if (text.empty()) {
+        lines.emplace_back();
+        return;
+    }
+    if (text.size() > BLOCK_SIZE) {
+        // A line too long for a block gets one of its own
+        TextBlock *block = addBlock(text.size());
+        memcpy(block->raw.load(std::memory_order_relaxed), text.data(), text.size());
+        block->length = text.size();
+        lines.push_back(Line(block, 0, text.size()));
+        return;
+    }
+    if (!current || text.size() > current->capacity - current->length) {
+        size_t size = std::clamp(storage->bytes, FIRST_BLOCK, BLOCK_SIZE);
+        current = addBlock(std::max(size, text.size()));
+    }
+    memcpy(current->raw.load(std::memory_order_relaxed) + current->length, text.data(), text.size());
+    lines.push_back(Line(current, current->length, text.size()));
+    current->length += text.size();
+}
+
+bool LineArena::compressCold(const StorageList &arenas, size_t workBytes) {
+    TRACE_SCOPE("compressCold");
+    uint32_t pass = ++coolingPasses;
+    std::vector<TextBlock *> hot;
+    for (const auto &arena : arenas) {
+        // A snapshot may be reading it on another thread
+        if (arena->readers.load(std::memory_order_acquire) > 0) continue;
+        for (const auto &block : arena->blocks) {
+            if (block->wasRead.exchange(false, std::memory_order_relaxed)) block->lastRead = pass;
+            if (!block->incompressible && block->raw.load(std::memory_order_relaxed)) hot.push_back(block.get());
+        }
+    }
+    if (hot.size() <= HOT_BLOCKS) return false;
+
+    // Most recently read first; those past the first few are cooled from
+    // the back
+    std::stable_sort(hot.begin(), hot.end(), [](const TextBlock *a, const TextBlock *b) {
+        return a->lastRead > b->lastRead;
+    });
+    size_t work = 0;
+    for (size_t i = hot.size(); i-- > HOT_BLOCKS;) {
+        if (work >= workBytes) return true;
+        TextBlock *block = hot[i];
+        work += block->length;
+        std::string packed = compressBlock(std::string_view(block->raw.load(std::memory_order_relaxed), block->length));
+        // Not worth a decompression on every read
+        if (packed.size() > block->length / 8 * 7) {
+            block->incompressible = true;
+            continue;
+        }
+        packed.shrink_to_fit();
+        std::lock_guard<std::mutex> guard(block->lock);
+        block->packed = std::move(packed);
+        freeText(block->raw.exchange(nullptr, std::memory_order_acq_rel), block->rawSize, block->mapped);
+    }
+    return false;
+}
@@ -0,0 +1,158 @@
+#ifndef LINEARENA_H
+#define LINEARENA_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Loaded text lives packed end to end in large read-only blocks; a line is
+// just where its bytes are, 16 bytes and no allocation of its own. A line
+// gets its own string only once it is edited.
+
+// A block of loaded text. Blocks nobody has read for a while can be kept
+// compressed only (see LineArena::compressCold); reading one decompresses
+// it again, on whichever thread reads it, and drops the compressed copy.
+class TextBlock {
+public:
+    explicit TextBlock(size_t capacity);
+    ~TextBlock();
+    TextBlock(const TextBlock &) = delete;
+    TextBlock &operator=(const TextBlock &) = delete;
+
+    const char *bytes() {
+        if (!wasRead.load(std::memory_order_relaxed)) wasRead.store(true, std::memory_order_relaxed);
+        char *text = raw.load(std::memory_order_acquire);
+        return text ? text : thaw();
+    }
+    // Memory held: the text while hot, the compressed copy while cold
+    size_t residentBytes() const;
+
+private:
+    friend class LineArena;
+
+    char *thaw();
+
+    // Decompressing and compressing take the lock; reading hot text does not
+    mutable std::mutex lock;
+    std::atomic<char *> raw;       // null while cold
+    size_t rawSize;                // mapped at raw: the capacity, or length once thawed
+    std::string packed;            // compressed copy, only while cold
+    size_t capacity;               // of the block the text was read into
+    size_t length;                 // bytes of it in use
+    bool mapped;                   // text in pages of its own, not on the heap
+    std::atomic<bool> wasRead;     // since the last cooling pass
+    uint32_t lastRead;             // cooling pass it was last seen read in
+    bool incompressible;
+};
+
+// One line of text: a span of an arena, or text of its own. Copies share
+// the text; an owned line is copied before it changes only while shared.
+// Spans do not keep their arena alive, whoever holds them does.
+class Line {
+public:
+    Line() : block(nullptr), length(0), offset(0) {}
+    explicit Line(std::string text);
+    Line(const Line &other) : block(other.block), length(other.length), offset(other.offset) {
+        if (isOwned()) owner->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    Line(Line &&other) noexcept : block(other.block), length(other.length), offset(other.offset) {
+        other.length = 0;
+    }
+    Line &operator=(const Line &other) {
+        if (this != &other) *this = Line(other);
+        return *this;
+    }
+    // Moving is what shifting lines around costs, so it stays inline
+    Line &operator=(Line &&other) noexcept {
+        TextBlock *movedBlock = other.block;
+        uint32_t movedLength = other.length;
+        other.length = 0;
+        if (isOwned()) release();
+        block = movedBlock;
+        length = movedLength;
+        offset = other.offset;
+        return *this;
+    }
+    ~Line() {
+        if (isOwned()) release();
+    }
+
+    std::string_view text() const {
+        if (isOwned()) return owner->text;
+        return length ? std::string_view(block->bytes() + offset, length) : std::string_view();
+    }
+    size_t size() const { return isOwned() ? owner->text.size() : length; }
+    // Heap bytes of an owned line, 0 for a span
+    size_t ownedBytes() const;
+
+    // The text to change in place, moved out of the arena or away from
+    // other holders first
+    std::string &edit();
+
+private:
+    friend class LineArena;
+
+    struct Text {
+        std::atomic<int> references;
+        std::string text;
+    };
+    // length of a line with text of its own
+    static const uint32_t OWNED = UINT32_MAX;
+
+    Line(TextBlock *block, size_t offset, size_t size)
+        : block(block), length((uint32_t)size), offset((uint32_t)offset) {}
+    bool isOwned() const { return length == OWNED; }
+    // Drops this owned line's reference
+    void release();
+
+    union {
+        TextBlock *block;
+        Text *owner;
+    };
+    uint32_t length;
+    uint32_t offset;           // into the block
+};
+
+// Builds lines into arena blocks, then hands both to a buffer
+class LineArena {
+public:
+    struct Storage {
+        std::vector<std::unique_ptr<TextBlock>> blocks;
+        size_t bytes = 0;      // allocated, including each block's unused end
+        // Snapshots of buffers holding it, read on other threads; its
+        // blocks are only compressed while there are none
+        mutable std::atomic<int> readers{0};
+
+        size_t residentBytes() const;
+    };
+    using StorageList = std::vector<std::shared_ptr<const Storage>>;
+
+    LineArena();
+
+    void append(std::string_view text);
+    int lineCount() const { return (int)lines.size(); }
+    std::string_view line(int index) const { return lines[index].text(); }
+    bool isEmpty() const { return lines.empty(); }
+
+    // Keeps the blocks most recently read hot and compresses the rest,
+    // least recently read first, doing about workBytes of compression.
+    // Returns true while there is more to do. Views of the text taken
+    // before may dangle after, so it is only for the thread that owns the
+    // arenas, between events.
+    static bool compressCold(const StorageList &arenas, size_t workBytes);
+
+private:
+    friend class TextBuffer;
+
+    TextBlock *addBlock(size_t capacity);
+
+    std::shared_ptr<Storage> storage;
+    std::vector<Line> lines;
+    TextBlock *current;        // the block being filled
+};
+
+#endif // LINEARENA_H
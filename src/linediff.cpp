@@ -0,0 +1,120 @@
+#include "linediff.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+struct Snake {
+    int x;
+    int y;
+    int length;
+};
+}
+
+std::vector<DiffHunk> diffLines(const std::vector<std::string_view> &oldLines,
+                                const std::vector<std::string_view> &newLines,
+                                int maxEdits) {
+    std::vector<DiffHunk> hunks;
+    int oldSize = (int)oldLines.size();
+    int newSize = (int)newLines.size();
+
+    int prefix = 0;
+    while (prefix < oldSize && prefix < newSize && oldLines[prefix] == newLines[prefix]) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix
+           && oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) {
+        suffix++;
+    }
+
+    int n = oldSize - prefix - suffix;
+    int m = newSize - prefix - suffix;
+    if (n == 0 && m == 0) return hunks;
+    if (n == 0 || m == 0) {
+        hunks.push_back({prefix, n, prefix, m});
+        return hunks;
+    }
+
+    // Hashes make the inner comparisons cheap
+    std::hash<std::string_view> hasher;
+    std::vector<size_t> oldHashes(n), newHashes(m);
+    for (int i = 0; i < n; i++) oldHashes[i] = hasher(oldLines[prefix + i]);
+    for (int i = 0; i < m; i++) newHashes[i] = hasher(newLines[prefix + i]);
+    auto same = [&](int x, int y) {
+        return oldHashes[x] == newHashes[y] && oldLines[prefix + x] == newLines[prefix + y];
+    };
+
+    // trace[d][k + d] is the furthest x on diagonal k after d edits
+    int maxD = std::min(n + m, maxEdits);
+    std::vector<std::vector<int>> trace;
+    std::vector<int> v(2 * maxD + 3, 0);
+    int offset = maxD + 1;
+    int found = -1;
+
+    for (int d = 0; d <= maxD && found < 0; d++) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                        ? v[offset + k + 1]
+                        : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && same(x, y)) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) found = d;
+        }
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+    }
+
+    if (found < 0) {
+        hunks.push_back({prefix, n, prefix, m});
+        return hunks;
+    }
+
+    // Walk back through the trace collecting the diagonal runs
+    std::vector<Snake> snakes;
+    int x = n, y = m;
+    for (int d = found; d > 0; d--) {
+        const std::vector<int> &previous = trace[d - 1];
+        int k = x - y;
+        auto at = [&](int kk) { return previous[kk + d - 1]; };
+        int previousK = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        int previousX = at(previousK);
+        int previousY = previousX - previousK;
+
+        // After the edit the path runs diagonally up to (x, y)
+        int startX = previousK == k + 1 ? previousX : previousX + 1;
+        int startY = startX - k;
+        if (x > startX) snakes.push_back({startX, startY, x - startX});
+        x = previousX;
+        y = previousY;
+    }
+    if (x > 0) snakes.push_back({0, 0, x});
+    std::reverse(snakes.begin(), snakes.end());
+
+    int px = 0, py = 0;
+    for (const Snake &snake : snakes) {
+        if (snake.x > px || snake.y > py) {
+            hunks.push_back({prefix + px, snake.x - px, prefix + py, snake.y - py});
+        }
+        px = snake.x + snake.length;
+        py = snake.y + snake.length;
+    }
+    if (px < n || py < m) {
+        hunks.push_back({prefix + px, n - px, prefix + py, m - py});
+    }
+    return hunks;
+}
+
+int mapLineThroughHunks(const std::vector<DiffHunk> &hunks, int line) {
+    int shift = 0;
+    for (const DiffHunk &hunk : hunks) {
+        if (line < hunk.oldStart) break;
+        if (line < hunk.oldStart + hunk.oldCount) {
+            return hunk.newStart;
+        }
+        shift = (hunk.newStart + hunk.newCount) - (hunk.oldStart + hunk.oldCount);
+    }
+    return line + shift;
+}
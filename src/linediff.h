@@ -0,0 +1,26 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <string_view>
+#include <vector>
+
+// Lines oldStart..oldStart+oldCount of the old text became
+// newStart..newStart+newCount of the new text
+struct DiffHunk {
+    int oldStart;
+    int oldCount;
+    int newStart;
+    int newCount;
+};
+
+// Line diff (Myers, after trimming the common prefix and suffix). Hunks come
+// out in ascending order. Past maxEdits differing lines the middle is
+// reported as a single hunk instead of searching for a minimal script.
+std::vector<DiffHunk> diffLines(const std::vector<std::string_view> &oldLines,
+                                const std::vector<std::string_view> &newLines,
+                                int maxEdits = 1000);
+
+// Where an old line ended up; lines inside a replaced hunk map to its start
+int mapLineThroughHunks(const std::vector<DiffHunk> &hunks, int line);
+
+#endif // LINEDIFF_H
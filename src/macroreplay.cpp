@@ -0,0 +1,48 @@
+#include "macroreplay.h"
+#include "search.h"
+#include <algorithm>
+#include <vector>
+
+int replayMacro(const TextBuffer &buffer, MacroScope scope, int count, TextPosition cursor,
+                const std::string &query, const std::function<TextPosition(TextPosition start)> &play) {
+    int runs = 0;
+    switch (scope) {
+        case MacroScope::Times:
+            for (; runs < count; runs++) cursor = play(cursor);
+            break;
+
+        case MacroScope::EachLine: {
+            // The next original line moves by however many lines a run
+            // added or removed; each original line is visited at most once
+            int remaining = buffer.lineCount();
+            for (int y = 0; y < buffer.lineCount() && remaining > 0; remaining--, runs++) {
+                int before = buffer.lineCount();
+                play({y, 0});
+                y = std::max(y, y + 1 + buffer.lineCount() - before);
+            }
+            break;
+        }
+
+        case MacroScope::EachMatch: {
+            if (query.empty()) break;
+            bool caseSensitive = hasUppercase(query);
+            std::vector<TextPosition> matches;
+            for (int y = 0; y < buffer.lineCount(); y++) {
+                std::string_view line = buffer.line(y);
+                for (size_t x = findText(line, query, 0, caseSensitive); x != std::string_view::npos;
+                     x = findText(line, query, x + query.size(), caseSensitive)) {
+                    matches.push_back({y, (int)x});
+                }
+            }
+
+            // Bottom to top, so an edit at one match does not move the ones
+            // still to come
+            for (auto match = matches.rbegin(); match != matches.rend(); ++match, runs++) {
+                if (match->line >= buffer.lineCount() || match->column > buffer.lineLength(match->line)) continue;
+                play(*match);
+            }
+            break;
+        }
+    }
+    return runs;
+}
@@ -0,0 +1,23 @@
+#ifndef MACROREPLAY_H
+#define MACROREPLAY_H
+
+#include <functional>
+#include <string>
+#include "textbuffer.h"
+
+// Where a recorded macro is played
+enum class MacroScope {
+    Times,       // count times in a row from the cursor
+    EachLine,    // once at the start of every line
+    EachMatch    // once at every occurrence of the search query
+};
+
+// Drives a macro replay. play() puts the cursor at start, runs the
+// recorded keys and returns where the cursor ended up. Lines are visited
+// top to bottom, following lines the macro inserts or deletes; matches are
+// found up front and visited bottom to top. Returns how many times the
+// macro ran.
+int replayMacro(const TextBuffer &buffer, MacroScope scope, int count, TextPosition cursor,
+                const std::string &query, const std::function<TextPosition(TextPosition start)> &play);
+
+#endif // MACROREPLAY_H
@@ -1,7 +1,25 @@
 #include "editor.h"
+#include "batchscript.h"
+#include "traceevents.h"
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char* argv[]) {
+    // --trace-events FILE (or LEDITOR_TRACE_EVENTS) writes a timeline
+    setTraceThreadName("main");
+    startTraceEventsFromEnvironment();
+    
+    if (argc > 2 && strcmp(argv[1], "--trace-events") == 0) {
+        startTraceEvents(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    
+    // leditor --batch SCRIPT FILE... edits files without a terminal
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        return runBatch(argc - 2, argv + 2);
+    }
+    
     Editor editor;
     
     // If a filename is provided, try to open it
@@ -13,4 +31,4 @@ int main(int argc, char* argv[]) {
     editor.run();
     
     return 0;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,82 @@
+#include "memorybudget.h"
+#include "perfstats.h"
+#include <algorithm>
+#include <cstdlib>
+
+static const int DEFAULT_UNDO_FLOOR = 100;
+static const size_t DEFAULT_COMPRESS_ABOVE = 64 << 20;
+
+std::string MemoryUsage::describe() const {
+    return "text " + PerfStats::formatBytes(text) + ", line index " + PerfStats::formatBytes(lineIndex) + ", undo " +
+           PerfStats::formatBytes(undo) + ", layout " + PerfStats::formatBytes(layout) + ", highlighting " +
+           PerfStats::formatBytes(highlighting) + ", total " + PerfStats::formatBytes(total());
+}
+
+MemoryBudget::MemoryBudget()
+    : maxBytes(0), floorSteps(DEFAULT_UNDO_FLOOR), compressBytes(DEFAULT_COMPRESS_ABOVE) {}
+
+MemoryBudget MemoryBudget::fromEnvironment() {
+    MemoryBudget budget;
+    if (const char *limit = getenv("LEDITOR_MEMORY_BUDGET")) budget.setLimit(parseSize(limit));
+    if (const char *floor = getenv("LEDITOR_UNDO_FLOOR")) budget.setUndoFloor(std::max(0, atoi(floor)));
+    if (const char *above = getenv("LEDITOR_COMPRESS_ABOVE")) budget.setCompressAbove(parseSize(above));
+    return budget;
+}
+
+size_t MemoryBudget::parseSize(const std::string &text) {
+    char *end = nullptr;
+    unsigned long long size = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) return 0;
+    switch (*end) {
+        case 'K': case 'k': size <<= 10; end++; break;
+        case 'M': case 'm': size <<= 20; end++; break;
+        case 'G': case 'g': size <<= 30; end++; break;
+        default: break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    return *end == '\0' ? (size_t)size : 0;
+}
+
+std::vector<MemoryStep> MemoryBudget::plan(const std::vector<DocumentMemory> &documents) const {
+    std::vector<MemoryStep> steps;
+    if (maxBytes == 0) return steps;
+
+    size_t total = 0;
+    for (const DocumentMemory &document : documents) total += document.usage.total();
+
+    // Within a stage the documents that give back most go first, so as few
+    // as possible are touched
+    auto stage = [&](MemoryAction action, auto freed) {
+        std::vector<int> order;
+        for (int i = 0; i < (int)documents.size(); i++) {
+            if (freed(documents[i]) > 0) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b) { return freed(documents[a]) > freed(documents[b]); });
+        for (int i : order) {
+            if (total <= maxBytes) return;
+            steps.push_back({i, action});
+            total -= std::min(total, freed(documents[i]));
+        }
+    };
+    stage(MemoryAction::DropCaches, [](const DocumentMemory &document) { return document.caches; });
+    stage(MemoryAction::TrimUndo, [](const DocumentMemory &document) { return document.undoBeyondFloor; });
+    if (total <= maxBytes) return steps;
+
+    // Idle documents are unloaded least recently used first, with what the
+    // earlier stages already freed in them taken off
+    std::vector<int> idle;
+    for (int i = 0; i < (int)documents.size(); i++) {
+        if (documents[i].idle) idle.push_back(i);
+    }
+    std::stable_sort(idle.begin(), idle.end(),
+                     [&](int a, int b) { return documents[a].lastUsed < documents[b].lastUsed; });
+    for (int i : idle) {
+        if (total <= maxBytes) break;
+        const DocumentMemory &document = documents[i];
+        steps.push_back({i, MemoryAction::Unload});
+        size_t freedEarlier = std::min(document.usage.total(), document.caches + document.undoBeyondFloor);
+        total -= std::min(total, document.usage.total() - freedEarlier);
+    }
+    return steps;
+}
@@ -0,0 +1,73 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Heap bytes behind one open document, by what they are for
+struct MemoryUsage {
+    size_t text = 0;           // arenas and edited lines
+    size_t lineIndex = 0;      // a reference per line, the edit journal
+    size_t undo = 0;           // undo and redo steps
+    size_t layout = 0;         // wrapping, display columns, bracket summaries
+    size_t highlighting = 0;   // styles and lexer states
+
+    size_t total() const { return text + lineIndex + undo + layout + highlighting; }
+    // "text 1.2 MB, line index 80 KB, ..., total 1.4 MB"
+    std::string describe() const;
+};
+
+// One document as the budget sees it
+struct DocumentMemory {
+    MemoryUsage usage;
+    size_t caches;             // what dropping its caches gives back
+    size_t undoBeyondFloor;    // what trimming its undo to the floor gives back
+    bool idle;                 // hidden, saved and read back from its file on demand
+    int64_t lastUsed;          // any clock; idle documents go oldest first
+};
+
+enum class MemoryAction { DropCaches, TrimUndo, Unload };
+
+struct MemoryStep {
+    int document;              // index into the documents planned for
+    MemoryAction action;
+};
+
+// A limit on the memory of all open documents together. Over it, caches
+// are dropped first (they are rebuilt as needed), then undo history beyond
+// the newest steps, then idle documents are unloaded until they are shown
+// again, each stage only as far as it takes to get back under.
+class MemoryBudget {
+public:
+    MemoryBudget();
+
+    // LEDITOR_MEMORY_BUDGET (bytes, or with a K, M or G suffix),
+    // LEDITOR_UNDO_FLOOR (undo steps always kept) and
+    // LEDITOR_COMPRESS_ABOVE (a size, or 0 for never)
+    static MemoryBudget fromEnvironment();
+
+    // 0 means no limit
+    void setLimit(size_t bytes) { maxBytes = bytes; }
+    size_t limit() const { return maxBytes; }
+    void setUndoFloor(int steps) { floorSteps = steps; }
+    int undoFloor() const { return floorSteps; }
+    // Documents with more loaded text than this keep what has not been
+    // read lately compressed, whether or not there is a limit
+    void setCompressAbove(size_t bytes) { compressBytes = bytes; }
+    size_t compressAbove() const { return compressBytes; }
+
+    // The steps to take, in order; none while under the limit
+    std::vector<MemoryStep> plan(const std::vector<DocumentMemory> &documents) const;
+
+    // "512M" and the like; 0 if it is not a size
+    static size_t parseSize(const std::string &text);
+
+private:
+    size_t maxBytes;
+    int floorSteps;
+    size_t compressBytes;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,244 @@
+#include "pathindex.h"
+#include "traceevents.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+static const size_t PARALLEL_CHUNK = 32768;
+
+static uint64_t charBit(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return 1ULL << (c - 'a');
+    if (c >= '0' && c <= '9') return 1ULL << (26 + c - '0');
+    return 1ULL << (36 + c % 28);
+}
+
+static uint64_t charMask(std::string_view text) {
+    uint64_t mask = 0;
+    for (unsigned char c : text) {
+        mask |= charBit(c);
+    }
+    return mask;
+}
+
+PathIndex::PathIndex()
+    : liveCount(0), generation(0), cachedGeneration(0) {
+}
+
+uint32_t PathIndex::add(const std::string &path) {
+    auto it = ids.find(path);
+    if (it != ids.end()) return it->second;
+
+    uint32_t id = (uint32_t)offsets.size();
+    offsets.push_back((uint32_t)text.size());
+    lengths.push_back((uint32_t)path.size());
+    text += path;
+    for (char c : path) {
+        lowered.push_back((char)std::tolower((unsigned char)c));
+    }
+    masks.push_back(charMask(std::string_view(lowered).substr(offsets.back())));
+    ids[path] = id;
+    liveCount++;
+    generation++;
+    return id;
+}
+
+bool PathIndex::remove(const std::string &path) {
+    auto it = ids.find(path);
+    if (it == ids.end()) return false;
+
+    uint32_t id = it->second;
+    ids.erase(it);
+    lengths[id] = 0;
+    masks[id] = ~0ULL;   // the empty path still fails every subsequence check
+    liveCount--;
+    generation++;
+
+    if (offsets.size() > 1024 && liveCount < offsets.size() / 2) {
+        compact();
+    }
+    return true;
+}
+
+void PathIndex::removePrefix(const std::string &dir) {
+    std::string prefix = dir + "/";
+    std::vector<std::string> doomed;
+    for (const auto &entry : ids) {
+        if (entry.first == dir || entry.first.compare(0, prefix.size(), prefix) == 0) {
+            doomed.push_back(entry.first);
+        }
+    }
+    for (const std::string &path : doomed) {
+        remove(path);
+    }
+}
+
+void PathIndex::clear() {
+    text.clear();
+    lowered.clear();
+    offsets.clear();
+    lengths.clear();
+    masks.clear();
+    ids.clear();
+    liveCount = 0;
+    generation++;
+}
+
+void PathIndex::compact() {
+    std::vector<std::string> live;
+    live.reserve(liveCount);
+    for (uint32_t id = 0; id < offsets.size(); id++) {
+        if (lengths[id]) live.emplace_back(path(id));
+    }
+    clear();
+    for (const std::string &path : live) {
+        add(path);
+    }
+}
+
+std::string PathIndex::normalizeQuery(const std::string &query) {
+    std::string normalized;
+    for (char c : query) {
+        if (c == ' ') continue;
+        normalized.push_back(c == '\\' ? '/' : (char)std::tolower((unsigned char)c));
+    }
+    return normalized;
+}
+
+static int boundaryBonus(std::string_view path, size_t i) {
+    if (i == 0) return 10;
+    char prev = path[i - 1];
+    char c = path[i];
+    if (prev == '/') return 10;
+    if (prev == '_' || prev == '-' || prev == '.' || prev == ' ') return 8;
+    if (c >= 'A' && c <= 'Z' && prev >= 'a' && prev <= 'z') return 7;
+    return 0;
+}
+
+int PathIndex::fuzzyScore(std::string_view query, std::string_view lowerPath, std::string_view path,
+                          std::vector<int> *positions) {
+    size_t m = query.size();
+    size_t n = lowerPath.size();
+    if (m == 0 || m > n) return m == 0 ? 0 : -1;
+
+    // Earliest end of a match, then the latest start that still reaches it,
+    // which gives the tightest window containing the match
+    const char *data = lowerPath.data();
+    const char *p = data;
+    for (size_t qi = 0; qi < m; qi++) {
+        p = (const char *)memchr(p, query[qi], data + n - p);
+        if (!p) return -1;
+        p++;
+    }
+    size_t end = p - 1 - data;
+
+    size_t start = end;
+    size_t qi = m;
+    for (size_t i = end + 1; i-- > 0; ) {
+        if (lowerPath[i] == query[qi - 1] && --qi == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    size_t slash = lowerPath.rfind('/');
+    size_t nameStart = (slash == std::string_view::npos) ? 0 : slash + 1;
+
+    int score = 0;
+    int run = 0;
+    for (size_t i = start; i <= end && qi < m; i++) {
+        if (lowerPath[i] == query[qi]) {
+            int bonus = boundaryBonus(path, i);
+            score += 16 + bonus + run * 4;
+            if (i >= nameStart) score += 4;
+            if (positions) positions->push_back((int)i);
+            run++;
+            qi++;
+        } else {
+            score -= run ? 3 : 1;
+            run = 0;
+        }
+    }
+
+    // Prefer matches in shorter paths
+    return std::max(0, score - (int)(n / 8));
+}
+
+std::vector<PathMatch> PathIndex::find(const std::string &rawQuery, size_t limit) {
+    std::string query = normalizeQuery(rawQuery);
+    std::vector<PathMatch> results;
+    if (limit == 0) return results;
+
+    auto better = [this](const PathMatch &a, const PathMatch &b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (lengths[a.id] != lengths[b.id]) return lengths[a.id] < lengths[b.id];
+        return a.id < b.id;
+    };
+
+    if (query.empty()) {
+        for (uint32_t id = 0; id < offsets.size() && results.size() < limit; id++) {
+            if (lengths[id]) results.push_back({id, 0});
+        }
+        return results;
+    }
+
+    bool refine = cachedGeneration == generation && !cachedQuery.empty()
+                  && query.compare(0, cachedQuery.size(), cachedQuery) == 0;
+    size_t total = refine ? cachedSurvivors.size() : offsets.size();
+    uint64_t queryMask = charMask(query);
+
+    // Each chunk keeps its own top matches as a heap with the worst on top
+    struct Chunk {
+        std::vector<PathMatch> top;
+        std::vector<uint32_t> survivors;
+    };
+    auto scan = [&](size_t begin, size_t end, Chunk &chunk) {
+        TRACE_SCOPE("path match");
+        for (size_t i = begin; i < end; i++) {
+            uint32_t id = refine ? cachedSurvivors[i] : (uint32_t)i;
+            if ((masks[id] & queryMask) != queryMask) continue;
+            std::string_view lower(lowered.data() + offsets[id], lengths[id]);
+            int score = fuzzyScore(query, lower, path(id));
+            if (score < 0) continue;
+
+            chunk.survivors.push_back(id);
+            PathMatch match = {id, score};
+            if (chunk.top.size() < limit) {
+                chunk.top.push_back(match);
+                std::push_heap(chunk.top.begin(), chunk.top.end(), better);
+            } else if (better(match, chunk.top.front())) {
+                std::pop_heap(chunk.top.begin(), chunk.top.end(), better);
+                chunk.top.back() = match;
+                std::push_heap(chunk.top.begin(), chunk.top.end(), better);
+            }
+        }
+    };
+
+    // Large scans are split across threads
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), 8);
+    threads = std::max<size_t>(1, std::min(threads, total / PARALLEL_CHUNK));
+    std::vector<Chunk> chunks(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back(scan, total * t / threads, total * (t + 1) / threads, std::ref(chunks[t]));
+    }
+    scan(0, total / threads, chunks[0]);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<uint32_t> survivors;
+    for (Chunk &chunk : chunks) {
+        survivors.insert(survivors.end(), chunk.survivors.begin(), chunk.survivors.end());
+        results.insert(results.end(), chunk.top.begin(), chunk.top.end());
+    }
+    std::sort(results.begin(), results.end(), better);
+    if (results.size() > limit) {
+        results.resize(limit);
+    }
+
+    cachedQuery = query;
+    cachedSurvivors = std::move(survivors);
+    cachedGeneration = generation;
+    return results;
+}
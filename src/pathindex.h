@@ -0,0 +1,62 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct PathMatch {
+    uint32_t id;
+    int score;
+};
+
+// In-memory index of workspace-relative paths for fuzzy quick-open. Lowercased
+// paths live in one contiguous buffer next to a per-path character mask, so a
+// query rejects most paths with a single AND before the subsequence check and
+// fzf-style scoring. A query that extends the previous one only rescans the
+// previous survivors. Not thread-safe; callers serialize access.
+class PathIndex {
+public:
+    PathIndex();
+
+    uint32_t add(const std::string &path);
+    bool remove(const std::string &path);
+    // Removes dir itself and every path below it
+    void removePrefix(const std::string &dir);
+    bool contains(const std::string &path) const { return ids.count(path) != 0; }
+    void clear();
+
+    size_t size() const { return liveCount; }
+    std::string_view path(uint32_t id) const { return std::string_view(text.data() + offsets[id], lengths[id]); }
+
+    // Best matches first; ties go to the shorter path
+    std::vector<PathMatch> find(const std::string &query, size_t limit);
+
+    // Score of query (lowercase) against path, -1 if it is not a subsequence.
+    // positions receives the matched byte offsets for highlighting.
+    static int fuzzyScore(std::string_view query, std::string_view lowerPath, std::string_view path,
+                          std::vector<int> *positions = nullptr);
+    static std::string normalizeQuery(const std::string &query);
+
+private:
+    void compact();
+
+    // Paths back to back in original case and lowercased; a removed path
+    // keeps its bytes but gets length 0
+    std::string text;
+    std::string lowered;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint64_t> masks;
+    std::unordered_map<std::string, uint32_t> ids;
+    size_t liveCount;
+
+    uint64_t generation;
+    uint64_t cachedGeneration;
+    std::string cachedQuery;
+    std::vector<uint32_t> cachedSurvivors;
+};
+
+#endif // PATHINDEX_H
@@ -0,0 +1,128 @@
+#include "perfstats.h"
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::clear() {
+    buckets.fill(0);
+    total = 0;
+    largest = 0;
+}
+
+int LatencyHistogram::bucketOf(uint64_t micros) {
+    if (micros < EXACT) return (int)micros;
+    micros = std::min<uint64_t>(micros, (1ull << MAX_EXPONENT) - 1);
+    int exponent = 63 - __builtin_clzll(micros);
+    int sub = (int)(micros >> (exponent - 3)) - 8;
+    return EXACT + (exponent - 3) * 8 + sub;
+}
+
+uint64_t LatencyHistogram::bucketLow(int bucket) {
+    if (bucket < EXACT) return bucket;
+    int exponent = (bucket - EXACT) / 8 + 3;
+    int sub = (bucket - EXACT) % 8;
+    return (uint64_t)(8 + sub) << (exponent - 3);
+}
+
+uint64_t LatencyHistogram::bucketHigh(int bucket) {
+    if (bucket < EXACT) return bucket;
+    int exponent = (bucket - EXACT) / 8 + 3;
+    return bucketLow(bucket) + (1ull << (exponent - 3)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    buckets[bucketOf(micros)]++;
+    total++;
+    largest = std::max(largest, micros);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(fraction * total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) return std::min(bucketHigh(i), largest);
+    }
+    return largest;
+}
+
+void LatencyHistogram::write(FILE *out, const char *name) const {
+    fprintf(out, "%s: count %llu, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n", name,
+            (unsigned long long)total, (unsigned long long)percentile(0.5), (unsigned long long)percentile(0.9),
+            (unsigned long long)percentile(0.99), (unsigned long long)percentile(0.999),
+            (unsigned long long)largest);
+    for (int i = 0; i < BUCKETS; i++) {
+        if (buckets[i] == 0) continue;
+        fprintf(out, "%s %llu %llu %llu\n", name, (unsigned long long)bucketLow(i),
+                (unsigned long long)bucketHigh(i), (unsigned long long)buckets[i]);
+    }
+}
+
+PerfStats::PerfStats() : lastFrameTime(0), lastEditTime(0), memory(0), memoryVersion(0), memoryMeasured(false) {}
+
+void PerfStats::recordFrame(uint64_t micros) {
+    frameTimes.record(micros);
+    lastFrameTime = micros;
+}
+
+void PerfStats::recordKeyToPaint(uint64_t micros) {
+    keyToPaintTimes.record(micros);
+}
+
+void PerfStats::recordEdit(uint64_t micros) {
+    editTimes.record(micros);
+    lastEditTime = micros;
+}
+
+size_t PerfStats::bufferMemory(const TextBuffer &buffer) {
+    auto now = std::chrono::steady_clock::now();
+    bool stale = !memoryMeasured || buffer.version() != memoryVersion;
+    if (stale && (!memoryMeasured || now - memoryTime >= std::chrono::milliseconds(500))) {
+        memory = buffer.memoryUsage();
+        memoryVersion = buffer.version();
+        memoryMeasured = true;
+        memoryTime = now;
+    }
+    return memory;
+}
+
+std::string PerfStats::summary(const TextBuffer &buffer) {
+    return "frame " + formatMicros(lastFrameTime) + " | key p99 " + formatMicros(keyToPaintTimes.percentile(0.99)) +
+           " | edit " + formatMicros(lastEditTime) + " | " + formatBytes(bufferMemory(buffer)) + " | " +
+           std::to_string(buffer.lineCount()) + " lines";
+}
+
+bool PerfStats::dump(const std::string &path) const {
+    FILE *out = fopen(path.c_str(), "w");
+    if (!out) return false;
+    fprintf(out, "# Latency histograms in microseconds: a summary per histogram, then\n"
+                 "# one line per bucket: histogram, low, high, count\n");
+    frameTimes.write(out, "frame");
+    keyToPaintTimes.write(out, "key-to-paint");
+    editTimes.write(out, "edit");
+    return fclose(out) == 0;
+}
+
+std::string PerfStats::formatMicros(uint64_t micros) {
+    char text[32];
+    if (micros < 1000) {
+        snprintf(text, sizeof(text), "%lluus", (unsigned long long)micros);
+    } else {
+        snprintf(text, sizeof(text), "%.1fms", micros / 1000.0);
+    }
+    return text;
+}
+
+std::string PerfStats::formatBytes(size_t bytes) {
+    char text[32];
+    if (bytes < (1 << 20)) {
+        snprintf(text, sizeof(text), "%.1fKB", bytes / 1024.0);
+    } else {
+        snprintf(text, sizeof(text), "%.1fMB", bytes / (1024.0 * 1024.0));
+    }
+    return text;
+}
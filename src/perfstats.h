@@ -0,0 +1,84 @@
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "textbuffer.h"
+
+// Latencies in microseconds. Buckets are exact below 8 us and then split
+// each power of two into 8, so any value is known to within 12.5% and the
+// histogram has a fixed size however long the session runs.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+    uint64_t count() const { return total; }
+    uint64_t maximum() const { return largest; }
+    // Upper end of the bucket holding that fraction of the values
+    uint64_t percentile(double fraction) const;
+    void clear();
+
+    // A summary line and then every non-empty bucket
+    void write(FILE *out, const char *name) const;
+
+private:
+    static const int EXACT = 8;
+    static const int MAX_EXPONENT = 40;   // about 12 days
+    static const int BUCKETS = EXACT + (MAX_EXPONENT - 3) * 8;
+
+    static int bucketOf(uint64_t micros);
+    static uint64_t bucketLow(int bucket);
+    static uint64_t bucketHigh(int bucket);
+
+    std::array<uint64_t, BUCKETS> buckets;
+    uint64_t total;
+    uint64_t largest;
+};
+
+// What the performance HUD shows: how long frames take to draw, how long
+// from a key arriving to its frame being on screen, and what the edits
+// themselves cost
+class PerfStats {
+public:
+    PerfStats();
+
+    void recordFrame(uint64_t micros);
+    void recordKeyToPaint(uint64_t micros);
+    void recordEdit(uint64_t micros);
+
+    const LatencyHistogram &frames() const { return frameTimes; }
+    const LatencyHistogram &keysToPaint() const { return keyToPaintTimes; }
+    const LatencyHistogram &edits() const { return editTimes; }
+    uint64_t lastFrame() const { return lastFrameTime; }
+    uint64_t lastEdit() const { return lastEditTime; }
+
+    // Memory held by the buffer's lines, measured again at most twice a
+    // second and only after edits, since it walks every line
+    size_t bufferMemory(const TextBuffer &buffer);
+
+    // One line for a status bar: frame, key p99, edit, memory, lines
+    std::string summary(const TextBuffer &buffer);
+
+    bool dump(const std::string &path) const;
+
+    static std::string formatMicros(uint64_t micros);
+    static std::string formatBytes(size_t bytes);
+
+private:
+    LatencyHistogram frameTimes;
+    LatencyHistogram keyToPaintTimes;
+    LatencyHistogram editTimes;
+    uint64_t lastFrameTime;
+    uint64_t lastEditTime;
+
+    size_t memory;
+    uint64_t memoryVersion;
+    bool memoryMeasured;
+    std::chrono::steady_clock::time_point memoryTime;
+};
+
+#endif // PERFSTATS_H
@@ -0,0 +1,679 @@
+#include "regex.h"
+#include <algorithm>
+#include <cctype>
+
+// Upper bound on cached DFA states before the cache is thrown away
+static const size_t MAX_DFA_STATES = 4096;
+static const int MAX_REPEAT = 1000;
+// Counted repeats are expanded into copies, and nested ones multiply; this
+// bounds the copies made over the whole pattern
+static const size_t MAX_EXPANDED_NODES = 1 << 15;
+// Scanning forward from each start on its own is quadratic when the scans
+// run far past the matches they find (a|a*b over a run of a's); past this
+// much scanning per byte, the rest of the line is matched in a single pass
+static const size_t DFA_WORK_PER_BYTE = 8;
+static const size_t DFA_WORK_SLACK = 1 << 16;
+// How often a long scan looks at its cancel flag, in bytes (a power of two)
+static const size_t CANCEL_CHECK_BYTES = 1 << 16;
+
+static bool stopRequested(const std::atomic<bool> *cancelled, size_t count) {
+    return count % CANCEL_CHECK_BYTES == 0 && cancelled && cancelled->load(std::memory_order_relaxed);
+}
+
+// Nodes in the tree, counting no further than limit
+size_t Regex::countNodes(const Node &node, size_t limit) {
+    size_t count = 1;
+    for (const Node &child : node.children) {
+        if (count > limit) break;
+        count += countNodes(child, limit - count);
+    }
+    return count;
+}
+
+Regex::Regex()
+    : pos(0), expandedNodes(0), caseSensitive(true), valid(false), anchorStart(false), anchorEnd(false), markedFrom(0) {
+}
+
+bool Regex::compile(const std::string &source, bool matchCase, std::string *error) {
+    valid = false;
+    caseSensitive = matchCase;
+    parseError.clear();
+    pos = 0;
+    expandedNodes = 0;
+
+    // Anchors are only special at the very ends of the pattern
+    pattern = source;
+    anchorStart = !pattern.empty() && pattern[0] == '^';
+    if (anchorStart) pattern.erase(0, 1);
+
+    size_t backslashes = 0;
+    for (size_t i = pattern.size(); i >= 2 && pattern[i - 2] == '\\'; --i) backslashes++;
+    anchorEnd = !pattern.empty() && pattern.back() == '$' && backslashes % 2 == 0;
+    if (anchorEnd) pattern.pop_back();
+
+    Node root;
+    bool ok = parseAlternate(root);
+    if (ok && pos < pattern.size()) {
+        parseError = "Unmatched ')'";
+        ok = false;
+    }
+    if (!ok) {
+        if (error) *error = parseError;
+        return false;
+    }
+
+    markedText = std::string_view();
+    buildNfa(forwardNfa, root, false);
+    buildNfa(reverseNfa, root, true);
+    forward.reset(&forwardNfa, false);
+    // Scanning backwards finds every position where a match starts; with a
+    // trailing $ the scan must begin exactly at the end of the line.
+    reverse.reset(&reverseNfa, !anchorEnd);
+
+    valid = true;
+    return true;
+}
+
+bool Regex::parseAlternate(Node &node) {
+    Node first;
+    if (!parseConcat(first)) return false;
+    if (pos >= pattern.size() || pattern[pos] != '|') {
+        node = std::move(first);
+        return true;
+    }
+
+    node.type = Node::Alternate;
+    node.children.push_back(std::move(first));
+    while (pos < pattern.size() && pattern[pos] == '|') {
+        pos++;
+        Node next;
+        if (!parseConcat(next)) return false;
+        node.children.push_back(std::move(next));
+    }
+    return true;
+}
+
+bool Regex::parseConcat(Node &node) {
+    node.type = Node::Concat;
+    node.children.clear();
+    while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+        Node child;
+        if (!parseRepeat(child)) return false;
+        node.children.push_back(std::move(child));
+    }
+
+    if (node.children.empty()) {
+        node.type = Node::Empty;
+    } else if (node.children.size() == 1) {
+        Node only = std::move(node.children[0]);
+        node = std::move(only);
+    }
+    return true;
+}
+
+bool Regex::parseRepeat(Node &node) {
+    if (!parseAtom(node)) return false;
+
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+        Node::Type type;
+        if (c == '*') type = Node::Star;
+        else if (c == '+') type = Node::Plus;
+        else if (c == '?') type = Node::Quest;
+        else if (c == '{') {
+            // {n}, {n,} or {n,m}; anything else is a literal brace
+            size_t p = pos + 1;
+            int low = 0, high = -1;
+            size_t digits = 0;
+            while (p < pattern.size() && isdigit((unsigned char)pattern[p]) && low <= MAX_REPEAT) {
+                low = low * 10 + (pattern[p++] - '0');
+                digits++;
+            }
+            if (digits == 0 || p >= pattern.size()) break;
+            if (pattern[p] == ',') {
+                p++;
+                if (p < pattern.size() && isdigit((unsigned char)pattern[p])) {
+                    high = 0;
+                    while (p < pattern.size() && isdigit((unsigned char)pattern[p]) && high <= MAX_REPEAT) {
+                        high = high * 10 + (pattern[p++] - '0');
+                    }
+                }
+            } else {
+                high = low;
+            }
+            if (p >= pattern.size() || pattern[p] != '}') break;
+            if (low > MAX_REPEAT || high > MAX_REPEAT || (high >= 0 && high < low)) {
+                parseError = "Invalid repetition count";
+                return false;
+            }
+            pos = p + 1;
+
+            size_t copies = high < 0 ? low + 1 : high;
+            size_t budget = MAX_EXPANDED_NODES - expandedNodes;
+            size_t size = countNodes(node, budget);
+            if (copies > 0 && size > budget / copies) {
+                parseError = "Pattern too large";
+                return false;
+            }
+            expandedNodes += size * copies;
+
+            Node repeated;
+            repeated.type = Node::Concat;
+            for (int i = 0; i < low; ++i) {
+                repeated.children.push_back(node);
+            }
+            if (high < 0) {
+                Node star;
+                star.type = Node::Star;
+                star.children.push_back(node);
+                repeated.children.push_back(std::move(star));
+            } else {
+                for (int i = low; i < high; ++i) {
+                    Node quest;
+                    quest.type = Node::Quest;
+                    quest.children.push_back(node);
+                    repeated.children.push_back(std::move(quest));
+                }
+            }
+            if (repeated.children.empty()) repeated.type = Node::Empty;
+            node = std::move(repeated);
+            continue;
+        } else {
+            break;
+        }
+
+        pos++;
+        Node wrapped;
+        wrapped.type = type;
+        wrapped.children.push_back(std::move(node));
+        node = std::move(wrapped);
+    }
+    return true;
+}
+
+bool Regex::parseAtom(Node &node) {
+    char c = pattern[pos];
+    node.type = Node::Set;
+    node.set.reset();
+
+    switch (c) {
+        case '(':
+            pos++;
+            if (pattern.compare(pos, 2, "?:") == 0) pos += 2;
+            if (!parseAlternate(node)) return false;
+            if (pos >= pattern.size() || pattern[pos] != ')') {
+                parseError = "Missing ')'";
+                return false;
+            }
+            pos++;
+            return true;
+
+        case '[':
+            pos++;
+            return parseClass(node.set);
+
+        case '.':
+            pos++;
+            node.set.set();
+            return true;
+
+        case '\\':
+            pos++;
+            return parseEscape(node.set);
+
+        case '*':
+        case '+':
+        case '?':
+            parseError = "Nothing to repeat";
+            return false;
+
+        default:
+            pos++;
+            addChar(node.set, c);
+            return true;
+    }
+}
+
+bool Regex::parseClass(std::bitset<256> &set) {
+    bool negate = pos < pattern.size() && pattern[pos] == '^';
+    if (negate) pos++;
+
+    bool first = true;
+    while (pos < pattern.size() && (pattern[pos] != ']' || first)) {
+        first = false;
+        unsigned char c = pattern[pos];
+        if (c == '\\') {
+            pos++;
+            if (!parseEscape(set)) return false;
+            continue;
+        }
+        pos++;
+        if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+            unsigned char last = pattern[pos + 1];
+            pos += 2;
+            if (last < c) {
+                parseError = "Invalid range in character class";
+                return false;
+            }
+            for (int ch = c; ch <= last; ++ch) addChar(set, ch);
+        } else {
+            addChar(set, c);
+        }
+    }
+
+    if (pos >= pattern.size()) {
+        parseError = "Missing ']'";
+        return false;
+    }
+    pos++;
+
+    if (negate) set.flip();
+    return true;
+}
+
+bool Regex::parseEscape(std::bitset<256> &set) {
+    if (pos >= pattern.size()) {
+        parseError = "Trailing backslash";
+        return false;
+    }
+
+    char c = pattern[pos++];
+    std::bitset<256> cls;
+    bool negate = false;
+
+    switch (c) {
+        case 'D': negate = true; // fall through
+        case 'd':
+            for (int ch = '0'; ch <= '9'; ++ch) cls.set(ch);
+            break;
+        case 'W': negate = true; // fall through
+        case 'w':
+            for (int ch = 0; ch < 256; ++ch) {
+                if (isalnum(ch) || ch == '_') cls.set(ch);
+            }
+            break;
+        case 'S': negate = true; // fall through
+        case 's':
+            for (char ch : std::string(" \t\r\n\f\v")) cls.set((unsigned char)ch);
+            break;
+        case 'n': addChar(set, '\n'); return true;
+        case 't': addChar(set, '\t'); return true;
+        case 'r': addChar(set, '\r'); return true;
+        case 'f': addChar(set, '\f'); return true;
+        case 'v': addChar(set, '\v'); return true;
+        case 'x': {
+            if (pos + 2 > pattern.size() || !isxdigit((unsigned char)pattern[pos])
+                || !isxdigit((unsigned char)pattern[pos + 1])) {
+                parseError = "Invalid \\x escape";
+                return false;
+            }
+            int value = std::stoi(pattern.substr(pos, 2), nullptr, 16);
+            pos += 2;
+            addChar(set, (unsigned char)value);
+            return true;
+        }
+        default:
+            addChar(set, c);
+            return true;
+    }
+
+    set |= negate ? ~cls : cls;
+    return true;
+}
+
+void Regex::addChar(std::bitset<256> &set, unsigned char c) const {
+    set.set(c);
+    if (!caseSensitive && isalpha(c)) {
+        set.set(tolower(c));
+        set.set(toupper(c));
+    }
+}
+
+// Thompson construction, built back to front so each fragment already knows
+// its successor. The reverse NFA matches the reversed language.
+int Regex::compileNode(Nfa &nfa, const Node &node, int next, bool reverseOrder) {
+    switch (node.type) {
+        case Node::Empty:
+            return next;
+
+        case Node::Set:
+            nfa.sets.push_back(node.set);
+            nfa.states.push_back({NfaState::Set, next, -1, (int)nfa.sets.size() - 1});
+            return (int)nfa.states.size() - 1;
+
+        case Node::Concat:
+            if (reverseOrder) {
+                for (const Node &child : node.children) {
+                    next = compileNode(nfa, child, next, reverseOrder);
+                }
+            } else {
+                for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                    next = compileNode(nfa, *it, next, reverseOrder);
+                }
+            }
+            return next;
+
+        case Node::Alternate: {
+            int result = compileNode(nfa, node.children.back(), next, reverseOrder);
+            for (int i = (int)node.children.size() - 2; i >= 0; --i) {
+                int branch = compileNode(nfa, node.children[i], next, reverseOrder);
+                nfa.states.push_back({NfaState::Split, branch, result, -1});
+                result = (int)nfa.states.size() - 1;
+            }
+            return result;
+        }
+
+        case Node::Star: {
+            nfa.states.push_back({NfaState::Split, -1, next, -1});
+            int loop = (int)nfa.states.size() - 1;
+            int body = compileNode(nfa, node.children[0], loop, reverseOrder);
+            nfa.states[loop].out = body;
+            return loop;
+        }
+
+        case Node::Plus: {
+            nfa.states.push_back({NfaState::Split, -1, next, -1});
+            int loop = (int)nfa.states.size() - 1;
+            int body = compileNode(nfa, node.children[0], loop, reverseOrder);
+            nfa.states[loop].out = body;
+            return body;
+        }
+
+        case Node::Quest: {
+            int body = compileNode(nfa, node.children[0], next, reverseOrder);
+            nfa.states.push_back({NfaState::Split, body, next, -1});
+            return (int)nfa.states.size() - 1;
+        }
+    }
+    return next;
+}
+
+void Regex::buildNfa(Nfa &nfa, const Node &root, bool reverseOrder) {
+    nfa.states.clear();
+    nfa.sets.clear();
+    nfa.states.push_back({NfaState::Match, -1, -1, -1});
+    nfa.start = compileNode(nfa, root, 0, reverseOrder);
+}
+
+bool Regex::markStarts(std::string_view text, size_t from, const std::atomic<bool> *cancelled) {
+    markedText = text;
+    markedFrom = from;
+    size_t n = text.size();
+    startsHere.assign(n + 1, 0);
+    int state = reverse.startState();
+    if (reverse.isAccepting(state)) startsHere[n] = 1;
+    for (size_t i = n; i > from; ) {
+        if (stopRequested(cancelled, n - i + 1)) {
+            markedText = std::string_view();
+            return false;
+        }
+        --i;
+        state = reverse.step(state, text[i]);
+        if (state == Dfa::Dead) break;
+        if (reverse.isAccepting(state)) startsHere[i] = 1;
+    }
+    return true;
+}
+
+size_t Regex::longestFrom(std::string_view text, size_t start, size_t &steps, const std::atomic<bool> *cancelled) {
+    if (anchorEnd) return text.size();
+
+    size_t end = start;
+    int state = forward.startState();
+    for (size_t i = start; i < text.size(); ++i) {
+        if (stopRequested(cancelled, ++steps)) break;
+        state = forward.step(state, text[i]);
+        if (state == Dfa::Dead) break;
+        if (forward.isAccepting(state)) end = i + 1;
+    }
+    return end;
+}
+
+bool Regex::search(std::string_view text, size_t from, size_t &matchStart, size_t &matchEnd) {
+    if (!valid || from > text.size()) return false;
+    if (anchorStart && from > 0) return false;
+
+    // Backward pass marks every position where some match starts, then a
+    // forward pass from the leftmost one finds the longest end. The marks
+    // run back from the end of the line, so a walk along it keeps them.
+    if (text.data() != markedText.data() || text.size() != markedText.size() || from < markedFrom) {
+        markStarts(text, from);
+    }
+    for (size_t start = from; start <= text.size(); ++start) {
+        if (!startsHere[start]) continue;
+        if (anchorStart && start > 0) break;
+
+        size_t steps = 0;
+        size_t end = longestFrom(text, start, steps);
+        if (end > start) {
+            matchStart = start;
+            matchEnd = end;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Regex::findAll(std::string_view text, std::vector<std::pair<size_t, size_t>> &matches,
+                    const std::atomic<bool> *cancelled) {
+    if (!valid) return;
+
+    if (!markStarts(text, 0, cancelled)) return;
+    size_t budget = text.size() * DFA_WORK_PER_BYTE + DFA_WORK_SLACK;
+    size_t steps = 0;
+    for (size_t start = 0; start <= text.size(); ++start) {
+        if (!startsHere[start]) continue;
+        if (anchorStart && start > 0) break;
+        if (steps > budget) {
+            findAllInOnePass(text, start, matches, cancelled);
+            return;
+        }
+
+        size_t end = longestFrom(text, start, steps, cancelled);
+        if (stopRequested(cancelled, 0)) return;
+        if (end > start) {
+            matches.emplace_back(start, end);
+            start = end - 1;
+        }
+    }
+}
+
+// The same matches from `from` on, by simulating the forward NFA once. Each
+// thread carries the position its match would start at; of two threads in
+// one state only the earlier start is kept, as both have the same future and
+// the later one could only count if the earlier one never matched again.
+// A match found opens a search for the next one from its end, dropped again
+// if the match grows, so searches stack up and are reported in order once
+// everything before them is settled.
+void Regex::findAllInOnePass(std::string_view text, size_t from, std::vector<std::pair<size_t, size_t>> &matches,
+                             const std::atomic<bool> *cancelled) {
+    struct Thread {
+        int state;
+        size_t start;
+    };
+    struct Pending {
+        size_t from, start, end;
+    };
+    const size_t none = std::string_view::npos;
+    const Nfa &nfa = forwardNfa;
+    size_t n = text.size();
+
+    std::vector<Thread> threads, next;
+    std::vector<int> stack;
+    std::vector<unsigned> seen(nfa.states.size(), 0);
+    unsigned generation = 1;
+    size_t acceptStart = none;
+    auto nextGeneration = [&]() {
+        if (++generation == 0) {
+            std::fill(seen.begin(), seen.end(), 0);
+            generation = 1;
+        }
+        acceptStart = none;
+    };
+    // Threads go in by increasing start, so the first to reach a state wins
+    auto add = [&](std::vector<Thread> &list, int nfaState, size_t start) {
+        stack.assign(1, nfaState);
+        while (!stack.empty()) {
+            int s = stack.back();
+            stack.pop_back();
+            if (s < 0 || seen[s] == generation) continue;
+            seen[s] = generation;
+
+            const NfaState &st = nfa.states[s];
+            if (st.type == NfaState::Split) {
+                stack.push_back(st.out1);
+                stack.push_back(st.out);
+            } else if (st.type == NfaState::Match) {
+                acceptStart = start;
+            } else {
+                list.push_back({s, start});
+            }
+        }
+    };
+
+    // Threads are ordered by start, and so are the searches
+    std::vector<Pending> pending(1, {from, none, none});
+    size_t settled = 0;
+    for (size_t pos = from;; ++pos) {
+        if (acceptStart != none && acceptStart < pos && (!anchorEnd || pos == n)) {
+            auto after = std::upper_bound(pending.begin() + settled + 1, pending.end(), acceptStart,
+                                          [](size_t start, const Pending &search) { return start < search.from; });
+            size_t k = after - pending.begin() - 1;
+            Pending &search = pending[k];
+            if (search.start == none || acceptStart <= search.start) {
+                search.start = acceptStart;
+                search.end = pos;
+                while (!threads.empty() && threads.back().start > acceptStart) threads.pop_back();
+                // States held by the dropped threads are free again
+                nextGeneration();
+                for (const Thread &thread : threads) seen[thread.state] = generation;
+                pending.resize(k + 1);
+                pending.push_back({pos, none, none});
+            }
+        }
+        if (pending.back().start == none && startsHere[pos] && (!anchorStart || pos == 0)) {
+            add(threads, nfa.start, pos);
+        }
+        while (settled + 1 < pending.size() &&
+               (threads.empty() || threads.front().start >= pending[settled + 1].from)) {
+            matches.emplace_back(pending[settled].start, pending[settled].end);
+            settled++;
+        }
+        if (pos == n) break;
+        if (stopRequested(cancelled, pos - from + 1)) return;
+
+        if (threads.empty()) {
+            // Nothing in flight: on to where the next match could start
+            if (anchorStart) break;
+            size_t mark = pos + 1;
+            while (mark < n && !startsHere[mark]) mark++;
+            if (mark >= n) break;
+            pos = mark - 1;
+            nextGeneration();
+            continue;
+        }
+
+        unsigned char c = text[pos];
+        nextGeneration();
+        next.clear();
+        for (const Thread &thread : threads) {
+            const NfaState &st = nfa.states[thread.state];
+            if (nfa.sets[st.setIndex][c]) add(next, st.out, thread.start);
+        }
+        threads.swap(next);
+    }
+    for (size_t k = settled; k < pending.size(); ++k) {
+        if (pending[k].start != none) matches.emplace_back(pending[k].start, pending[k].end);
+    }
+}
+
+void Regex::Dfa::reset(const Nfa *automaton, bool unanchoredSearch) {
+    nfa = automaton;
+    unanchored = unanchoredSearch;
+    marks.assign(nfa->states.size(), 0);
+    markGeneration = 1;
+    startSet.clear();
+    addClosure(startSet, nfa->start);
+    std::sort(startSet.begin(), startSet.end());
+    flush();
+}
+
+void Regex::Dfa::flush() {
+    states.clear();
+    transitions.clear();
+    stateIds.clear();
+    start = stateFor(startSet);
+}
+
+void Regex::Dfa::addClosure(std::vector<int> &set, int nfaState) {
+    std::vector<int> stack(1, nfaState);
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        if (s < 0 || marks[s] == markGeneration) continue;
+        marks[s] = markGeneration;
+
+        const NfaState &st = nfa->states[s];
+        if (st.type == NfaState::Split) {
+            stack.push_back(st.out1);
+            stack.push_back(st.out);
+        } else {
+            set.push_back(s);
+        }
+    }
+}
+
+int Regex::Dfa::stateFor(std::vector<int> set) {
+    std::sort(set.begin(), set.end());
+    auto it = stateIds.find(set);
+    if (it != stateIds.end()) return it->second;
+
+    State state;
+    state.accepting = false;
+    for (int s : set) {
+        if (nfa->states[s].type == NfaState::Match) state.accepting = true;
+    }
+    state.nfaStates = set;
+
+    int id = (int)states.size();
+    states.push_back(std::move(state));
+    transitions.resize(states.size() * 256, -2);
+    stateIds.emplace(std::move(set), id);
+    return id;
+}
+
+int Regex::Dfa::step(int state, unsigned char c) {
+    int cached = transitions[(size_t)state * 256 + c];
+    if (cached != -2) return cached;
+
+    if (++markGeneration == 0) {
+        std::fill(marks.begin(), marks.end(), 0);
+        markGeneration = 1;
+    }
+
+    std::vector<int> next;
+    for (int s : states[state].nfaStates) {
+        const NfaState &st = nfa->states[s];
+        if (st.type == NfaState::Set && nfa->sets[st.setIndex][c]) {
+            addClosure(next, st.out);
+        }
+    }
+    if (unanchored) {
+        for (int s : startSet) addClosure(next, s);
+    }
+
+    if (next.empty()) {
+        transitions[(size_t)state * 256 + c] = Dead;
+        return Dead;
+    }
+
+    if (states.size() >= MAX_DFA_STATES) {
+        // Cache is full: start over, the current state id becomes invalid
+        flush();
+        return stateFor(std::move(next));
+    }
+
+    int target = stateFor(std::move(next));
+    transitions[(size_t)state * 256 + c] = target;
+    return target;
+}
@@ -0,0 +1,125 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <atomic>
+#include <bitset>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Regular expressions compiled to a Thompson NFA and simulated with a lazily
+// built DFA, so matching is linear in the input with no backtracking.
+//
+// Supported syntax: literals, '.', [...] and [^...] classes, \d \w \s and
+// their negations, escapes, * + ? {n} {n,} {n,m}, '|', grouping, and ^ / $
+// anchors at the start / end of the pattern. Matches are per line and
+// leftmost-longest; empty matches are skipped.
+class Regex {
+public:
+    Regex();
+    Regex(const Regex &) = delete;
+    Regex &operator=(const Regex &) = delete;
+
+    bool compile(const std::string &pattern, bool caseSensitive, std::string *error = nullptr);
+    bool isValid() const { return valid; }
+
+    // Finds the first match starting at or after from. The DFA caches are
+    // filled in as a side effect, so one Regex must not be shared by threads.
+    // Calls on the same text with increasing from share the work of the
+    // first, so the text must not change in place between them.
+    bool search(std::string_view text, size_t from, size_t &matchStart, size_t &matchEnd);
+    // All non-overlapping matches in text, with a single backward pass and
+    // time linear in its length. Setting cancelled stops it part way through.
+    void findAll(std::string_view text, std::vector<std::pair<size_t, size_t>> &matches,
+                 const std::atomic<bool> *cancelled = nullptr);
+
+private:
+    struct Node {
+        enum Type { Empty, Set, Concat, Alternate, Star, Plus, Quest };
+        Type type;
+        std::bitset<256> set;
+        std::vector<Node> children;
+    };
+
+    struct NfaState {
+        enum Type { Set, Split, Match };
+        Type type;
+        int out, out1;
+        int setIndex;
+    };
+
+    struct Nfa {
+        std::vector<NfaState> states;
+        std::vector<std::bitset<256>> sets;
+        int start;
+    };
+
+    // Lazily determinized view of an NFA. Each DFA state is a set of NFA
+    // states; transitions are computed on first use and cached.
+    class Dfa {
+    public:
+        void reset(const Nfa *nfa, bool unanchored);
+        int startState() const { return start; }
+        bool isAccepting(int state) const { return states[state].accepting; }
+        int step(int state, unsigned char c);
+
+        static const int Dead = -1;
+
+    private:
+        struct State {
+            std::vector<int> nfaStates;
+            bool accepting;
+        };
+
+        void addClosure(std::vector<int> &set, int nfaState);
+        int stateFor(std::vector<int> set);
+        void flush();
+
+        const Nfa *nfa;
+        bool unanchored;
+        std::vector<int> startSet;
+        std::vector<State> states;
+        std::vector<int> transitions; // 256 per state, -2 = not computed
+        std::map<std::vector<int>, int> stateIds;
+        std::vector<unsigned> marks;
+        unsigned markGeneration;
+        int start;
+    };
+
+    // Recursive descent parser
+    bool parseAlternate(Node &node);
+    bool parseConcat(Node &node);
+    bool parseRepeat(Node &node);
+    bool parseAtom(Node &node);
+    bool parseClass(std::bitset<256> &set);
+    bool parseEscape(std::bitset<256> &set);
+    void addChar(std::bitset<256> &set, unsigned char c) const;
+    static size_t countNodes(const Node &node, size_t limit);
+
+    // Both give up early once cancelled is set; markStarts then returns false
+    bool markStarts(std::string_view text, size_t from, const std::atomic<bool> *cancelled = nullptr);
+    size_t longestFrom(std::string_view text, size_t start, size_t &steps,
+                       const std::atomic<bool> *cancelled = nullptr);
+    void findAllInOnePass(std::string_view text, size_t from, std::vector<std::pair<size_t, size_t>> &matches,
+                          const std::atomic<bool> *cancelled);
+
+    int compileNode(Nfa &nfa, const Node &node, int next, bool reverse);
+    void buildNfa(Nfa &nfa, const Node &root, bool reverse);
+
+    std::string pattern;
+    size_t pos;
+    size_t expandedNodes;
+    std::string parseError;
+    bool caseSensitive;
+    bool valid;
+    bool anchorStart, anchorEnd;
+
+    Nfa forwardNfa, reverseNfa;
+    Dfa forward, reverse;
+    std::vector<unsigned char> startsHere; // per position of the current line
+    std::string_view markedText;
+    size_t markedFrom;
+};
+
+#endif // REGEX_H
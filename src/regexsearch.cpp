@@ -0,0 +1,68 @@
+#include "regexsearch.h"
+#include "traceevents.h"
+#include "regex.h"
+#include <chrono>
+
+static const size_t BATCH_SIZE = 4096;
+static const auto BATCH_INTERVAL = std::chrono::milliseconds(16);
+
+RegexSearchJob::RegexSearchJob(std::shared_ptr<const TextBuffer> buffer, const std::string &regexPattern,
+                               bool matchCase, BatchCallback batchCallback)
+    : snapshot(std::move(buffer))
+    , pattern(regexPattern)
+    , caseSensitive(matchCase)
+    , callback(std::move(batchCallback))
+    , cancelled(false)
+{
+    worker = std::thread(&RegexSearchJob::run, this);
+}
+
+RegexSearchJob::~RegexSearchJob() {
+    cancel();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void RegexSearchJob::run() {
+    setTraceThreadName("regex search");
+    TRACE_SCOPE("RegexSearchJob");
+    // Each job owns its regex, the lazy DFA caches are not thread safe
+    Regex regex;
+    std::string error;
+    if (!regex.compile(pattern, caseSensitive, &error)) {
+        callback({}, true, error);
+        return;
+    }
+
+    std::vector<RegexMatch> batch;
+    std::vector<std::pair<size_t, size_t>> lineMatches;
+    bool sentFirst = false;
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    for (int y = 0; y < snapshot->lineCount(); ++y) {
+        if (cancelled.load(std::memory_order_relaxed)) return;
+
+        lineMatches.clear();
+        // A long line is given up part way through when cancelled
+        regex.findAll(snapshot->line(y), lineMatches, &cancelled);
+        if (cancelled.load(std::memory_order_relaxed)) return;
+        for (const auto &m : lineMatches) {
+            batch.push_back({y, (int)m.first, (int)(m.second - m.first)});
+        }
+
+        if (batch.empty()) continue;
+
+        auto now = std::chrono::steady_clock::now();
+        if (!sentFirst || batch.size() >= BATCH_SIZE || now - lastFlush >= BATCH_INTERVAL) {
+            callback(std::move(batch), false, std::string());
+            batch.clear();
+            sentFirst = true;
+            lastFlush = now;
+        }
+    }
+
+    if (!cancelled) {
+        callback(std::move(batch), true, std::string());
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef REGEXSEARCH_H
+#define REGEXSEARCH_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "textbuffer.h"
+
+struct RegexMatch {
+    int line;
+    int column;
+    int length;
+};
+
+// Runs a regex over an immutable snapshot of a buffer on a worker thread.
+// Matches are handed to the callback in batches: the first batch goes out as
+// soon as there is a hit, later ones every few milliseconds. The callback runs
+// on the worker thread. A pattern that does not compile finishes the job at
+// once with its error. Destroying the job cancels it and waits for the worker.
+class RegexSearchJob {
+public:
+    using BatchCallback =
+        std::function<void(std::vector<RegexMatch> batch, bool finished, const std::string &error)>;
+
+    RegexSearchJob(std::shared_ptr<const TextBuffer> snapshot, const std::string &pattern,
+                   bool caseSensitive, BatchCallback callback);
+    ~RegexSearchJob();
+
+    void cancel() { cancelled = true; }
+
+private:
+    void run();
+
+    std::shared_ptr<const TextBuffer> snapshot;
+    std::string pattern;
+    bool caseSensitive;
+    BatchCallback callback;
+    std::atomic<bool> cancelled;
+    std::thread worker;
+};
+
+#endif // REGEXSEARCH_H
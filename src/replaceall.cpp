@@ -0,0 +1,122 @@
+#include "replaceall.h"
+#include "traceevents.h"
+#include "search.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <iterator>
+
+// Big enough that scheduling is noise next to the scan, small enough that
+// every core gets many chunks and progress moves smoothly
+static const size_t CHUNK_BYTES = 4 << 20;
+// Lines checked between looks at the cancel flag
+static const int CANCEL_CHECK_LINES = 4096;
+
+size_t collectReplacements(const TextBuffer &buffer, int first, int last, std::string_view needle,
+                           std::string_view replacement, bool caseSensitive, std::vector<LineRewrite> &rewrites,
+                           const std::atomic<bool> *cancelled) {
+    if (needle.empty()) return 0;
+    size_t count = 0;
+    for (int y = first; y < last; y++) {
+        if (cancelled && (y - first) % CANCEL_CHECK_LINES == 0 && cancelled->load(std::memory_order_relaxed)) {
+            break;
+        }
+        std::string_view line = buffer.line(y);
+        size_t found = findText(line, needle, 0, caseSensitive);
+        if (found == std::string_view::npos) continue;
+
+        std::string rewritten;
+        rewritten.reserve(line.size() + replacement.size());
+        size_t copied = 0;
+        while (found != std::string_view::npos) {
+            rewritten.append(line, copied, found - copied);
+            rewritten += replacement;
+            copied = found + needle.size();
+            count++;
+            found = findText(line, needle, copied, caseSensitive);
+        }
+        rewritten.append(line, copied, std::string_view::npos);
+        rewrites.push_back({y, Line(std::move(rewritten))});
+    }
+    return count;
+}
+
+ReplaceAllJob::ReplaceAllJob(std::shared_ptr<const TextBuffer> buffer, const std::string &find,
+                             const std::string &replaceWith, bool matchCase, DoneCallback doneCallback)
+    : snapshot(std::move(buffer))
+    , needle(find)
+    , replacement(replaceWith)
+    , caseSensitive(matchCase)
+    , callback(std::move(doneCallback))
+    , cancelled(false)
+    , finished(false)
+    , bytesDone(0)
+    , bytesTotal(0)
+{
+    worker = std::thread(&ReplaceAllJob::run, this);
+}
+
+ReplaceAllJob::~ReplaceAllJob() {
+    cancel();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+double ReplaceAllJob::progress() const {
+    size_t total = bytesTotal.load();
+    return total == 0 ? 0.0 : std::min(1.0, (double)bytesDone.load() / total);
+}
+
+void ReplaceAllJob::run() {
+    setTraceThreadName("replace all");
+    TRACE_SCOPE("ReplaceAllJob");
+    // Chunk boundaries fall on lines, a few megabytes apart
+    std::vector<int> starts;
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    int lineCount = snapshot->lineCount();
+    for (int y = 0; y < lineCount; y++) {
+        if (sizes.empty() || sizes.back() >= CHUNK_BYTES) {
+            starts.push_back(y);
+            sizes.push_back(0);
+        }
+        size_t length = snapshot->lineLength(y) + 1;
+        sizes.back() += length;
+        total += length;
+    }
+    starts.push_back(lineCount);
+    bytesTotal = total;
+
+    size_t chunks = starts.size() - 1;
+    std::vector<std::vector<LineRewrite>> results(chunks);
+    std::vector<size_t> counts(chunks, 0);
+    {
+        ThreadPool pool;
+        for (size_t k = 0; k < chunks; k++) {
+            pool.submit([this, k, &starts, &sizes, &results, &counts]() {
+                if (cancelled.load(std::memory_order_relaxed)) return;
+                TRACE_SCOPE("replace chunk");
+                counts[k] = collectReplacements(*snapshot, starts[k], starts[k + 1], needle, replacement,
+                                                caseSensitive, results[k], &cancelled);
+                bytesDone += sizes[k];
+            });
+        }
+        pool.wait();
+    }
+
+    if (!cancelled) {
+        std::vector<LineRewrite> rewrites;
+        size_t lines = 0, replacements = 0;
+        for (size_t k = 0; k < chunks; k++) {
+            lines += results[k].size();
+            replacements += counts[k];
+        }
+        rewrites.reserve(lines);
+        for (std::vector<LineRewrite> &part : results) {
+            std::move(part.begin(), part.end(), std::back_inserter(rewrites));
+            part = std::vector<LineRewrite>();
+        }
+        callback(std::move(rewrites), replacements);
+    }
+    finished = true;
+}
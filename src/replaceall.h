@@ -0,0 +1,56 @@
+#ifndef REPLACEALL_H
+#define REPLACEALL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "textbuffer.h"
+
+// Rewrites every line in [first, last) that contains needle, replacing each
+// occurrence left to right. Only lines with a match are built; they are
+// appended to rewrites in line order. Returns the number of replacements.
+size_t collectReplacements(const TextBuffer &buffer, int first, int last, std::string_view needle,
+                           std::string_view replacement, bool caseSensitive, std::vector<LineRewrite> &rewrites,
+                           const std::atomic<bool> *cancelled = nullptr);
+
+// Replace-all over an immutable snapshot of a buffer. The lines are cut
+// into chunks of a few megabytes that a thread pool rewrites in parallel,
+// and the rewritten lines are handed to the callback once, in order, to be
+// swapped into the buffer as one change (TextBuffer::rewriteLines). The
+// callback runs on a worker thread and is not called if the job is
+// cancelled. Destroying the job cancels it and waits for the workers.
+class ReplaceAllJob {
+public:
+    using DoneCallback = std::function<void(std::vector<LineRewrite> rewrites, size_t replacements)>;
+
+    ReplaceAllJob(std::shared_ptr<const TextBuffer> snapshot, const std::string &needle,
+                  const std::string &replacement, bool caseSensitive, DoneCallback callback);
+    ~ReplaceAllJob();
+
+    void cancel() { cancelled = true; }
+    // Share of the snapshot scanned so far, from 0 to 1
+    double progress() const;
+    // Set once the callback has returned, or the job gave up after a cancel
+    bool isFinished() const { return finished; }
+    uint64_t version() const { return snapshot->version(); }
+
+private:
+    void run();
+
+    std::shared_ptr<const TextBuffer> snapshot;
+    std::string needle;
+    std::string replacement;
+    bool caseSensitive;
+    DoneCallback callback;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> finished;
+    std::atomic<size_t> bytesDone;
+    std::atomic<size_t> bytesTotal;
+    std::thread worker;
+};
+
+#endif // REPLACEALL_H
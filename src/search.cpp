@@ -0,0 +1,242 @@
+#include "search.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Stored matches are capped so a one-letter query on a huge file stays cheap;
+// anything past the cap is found by scanning on demand.
+static const size_t MATCH_LIMIT = 1000000;
+
+static inline unsigned char lowerAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned char upperAscii(unsigned char c) {
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+static bool sameText(const char *a, const char *b, size_t n, bool caseSensitive) {
+    if (caseSensitive) {
+        return memcmp(a, b, n) == 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (lowerAscii(a[i]) != lowerAscii(b[i])) return false;
+    }
+    return true;
+}
+
+size_t findText(std::string_view haystack, std::string_view needle, size_t from, bool caseSensitive) {
+    size_t n = haystack.size();
+    size_t m = needle.size();
+    if (m == 0) return from <= n ? from : std::string_view::npos;
+    if (from >= n || n - from < m) return std::string_view::npos;
+
+    const char *h = haystack.data();
+    const char *nd = needle.data();
+    size_t last = n - m; // last valid start offset
+    size_t i = from;
+
+    if (caseSensitive && m == 1) {
+        const void *hit = memchr(h + i, nd[0], n - i);
+        return hit ? (const char *)hit - h : std::string_view::npos;
+    }
+
+    unsigned char firstLo = needle[0], firstHi = needle[0];
+    unsigned char lastLo = needle[m - 1], lastHi = needle[m - 1];
+    if (!caseSensitive) {
+        firstLo = lowerAscii(firstLo); firstHi = upperAscii(firstHi);
+        lastLo = lowerAscii(lastLo); lastHi = upperAscii(lastHi);
+    }
+
+#if defined(__SSE2__)
+    const __m128i f1 = _mm_set1_epi8((char)firstLo), f2 = _mm_set1_epi8((char)firstHi);
+    const __m128i l1 = _mm_set1_epi8((char)lastLo), l2 = _mm_set1_epi8((char)lastHi);
+    for (; i + 15 <= last; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(h + i + m - 1));
+        __m128i eqFirst = _mm_or_si128(_mm_cmpeq_epi8(a, f1), _mm_cmpeq_epi8(a, f2));
+        __m128i eqLast = _mm_or_si128(_mm_cmpeq_epi8(b, l1), _mm_cmpeq_epi8(b, l2));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (sameText(h + i + bit, nd, m, caseSensitive)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t f1 = vdupq_n_u8(firstLo), f2 = vdupq_n_u8(firstHi);
+    const uint8x16_t l1 = vdupq_n_u8(lastLo), l2 = vdupq_n_u8(lastHi);
+    for (; i + 15 <= last; i += 16) {
+        uint8x16_t a = vld1q_u8((const uint8_t *)(h + i));
+        uint8x16_t b = vld1q_u8((const uint8_t *)(h + i + m - 1));
+        uint8x16_t eq = vandq_u8(vorrq_u8(vceqq_u8(a, f1), vceqq_u8(a, f2)),
+                                 vorrq_u8(vceqq_u8(b, l1), vceqq_u8(b, l2)));
+        // Narrow to 4 bits per byte to get a scalar mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            unsigned bit = __builtin_ctzll(mask) >> 2;
+            if (sameText(h + i + bit, nd, m, caseSensitive)) return i + bit;
+            mask &= ~(0xFull << (bit * 4));
+        }
+    }
+#endif
+
+    for (; i <= last; ++i) {
+        unsigned char c = h[i];
+        if ((c == firstLo || c == firstHi) && sameText(h + i, nd, m, caseSensitive)) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+bool hasUppercase(std::string_view query) {
+    return std::any_of(query.begin(), query.end(), [](unsigned char c) { return c >= 'A' && c <= 'Z'; });
+}
+
+IncrementalSearch::IncrementalSearch()
+    : caseSensitive(false), stale(false), complete(true), scanLine(0) {
+}
+
+void IncrementalSearch::setQuery(const TextBuffer &buffer, const std::string &newQuery, bool newCaseSensitive) {
+    if (!stale && newQuery == currentQuery && newCaseSensitive == caseSensitive) {
+        return;
+    }
+
+    // A longer query can only match where the shorter one did
+    bool refine = !stale && !currentQuery.empty()
+        && newCaseSensitive == caseSensitive
+        && newQuery.size() > currentQuery.size()
+        && newQuery.compare(0, currentQuery.size(), currentQuery) == 0;
+
+    currentQuery = newQuery;
+    caseSensitive = newCaseSensitive;
+    stale = false;
+
+    if (currentQuery.empty()) {
+        found.clear();
+        complete = true;
+        return;
+    }
+
+    if (refine) {
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [&](const SearchMatch &m) { return !matchesAt(buffer, m); }),
+                    found.end());
+        if (!complete) {
+            scanFrom(buffer, scanLine);
+        }
+        return;
+    }
+
+    found.clear();
+    scanFrom(buffer, 0);
+}
+
+void IncrementalSearch::clear() {
+    currentQuery.clear();
+    found.clear();
+    complete = true;
+    stale = false;
+    scanLine = 0;
+}
+
+bool IncrementalSearch::matchesAt(const TextBuffer &buffer, const SearchMatch &match) const {
+    if (match.line >= buffer.lineCount()) return false;
+    std::string_view text = buffer.line(match.line);
+    if (match.column + currentQuery.size() > text.size()) return false;
+    return sameText(text.data() + match.column, currentQuery.data(), currentQuery.size(), caseSensitive);
+}
+
+void IncrementalSearch::scanFrom(const TextBuffer &buffer, int line) {
+    for (int y = line; y < buffer.lineCount(); ++y) {
+        std::string_view text = buffer.line(y);
+        size_t pos = findText(text, currentQuery, 0, caseSensitive);
+        while (pos != std::string_view::npos) {
+            found.push_back({y, (int)pos});
+            pos = findText(text, currentQuery, pos + 1, caseSensitive);
+        }
+        if (found.size() >= MATCH_LIMIT && y + 1 < buffer.lineCount()) {
+            complete = false;
+            scanLine = y + 1;
+            return;
+        }
+    }
+    complete = true;
+    scanLine = buffer.lineCount();
+}
+
+bool IncrementalSearch::nextMatch(const TextBuffer &buffer, int line, int column, SearchMatch &match) {
+    if (currentQuery.empty()) return false;
+
+    auto it = std::upper_bound(found.begin(), found.end(), SearchMatch{line, column});
+    if (it != found.end()) {
+        match = *it;
+        return true;
+    }
+
+    if (!complete) {
+        // Past the indexed region, scan the buffer directly
+        int startLine = std::max(line, scanLine);
+        for (int y = startLine; y < buffer.lineCount(); ++y) {
+            size_t from = (y == line) ? column + 1 : 0;
+            size_t pos = findText(buffer.line(y), currentQuery, from, caseSensitive);
+            if (pos != std::string_view::npos) {
+                match = {y, (int)pos};
+                return true;
+            }
+        }
+    }
+
+    if (found.empty()) return false;
+    match = found.front();
+    return true;
+}
+
+bool IncrementalSearch::previousMatch(const TextBuffer &buffer, int line, int column, SearchMatch &match) {
+    if (currentQuery.empty()) return false;
+
+    auto lastBefore = [&](int y, size_t limit, SearchMatch &out) {
+        std::string_view text = buffer.line(y);
+        bool hit = false;
+        size_t pos = findText(text, currentQuery, 0, caseSensitive);
+        while (pos != std::string_view::npos && pos < limit) {
+            out = {y, (int)pos};
+            hit = true;
+            pos = findText(text, currentQuery, pos + 1, caseSensitive);
+        }
+        return hit;
+    };
+
+    if (!complete && line >= scanLine) {
+        for (int y = std::min(line, buffer.lineCount() - 1); y >= scanLine; --y) {
+            size_t limit = (y == line) ? column : std::string_view::npos;
+            if (lastBefore(y, limit, match)) return true;
+        }
+    }
+
+    auto it = std::lower_bound(found.begin(), found.end(), SearchMatch{line, column});
+    if (it != found.begin()) {
+        match = *(it - 1);
+        return true;
+    }
+
+    if (!complete) {
+        for (int y = buffer.lineCount() - 1; y >= scanLine; --y) {
+            if (lastBefore(y, std::string_view::npos, match)) return true;
+        }
+    }
+
+    if (found.empty()) return false;
+    match = found.back();
+    return true;
+}
+
+size_t IncrementalSearch::firstMatchFrom(int line) const {
+    return std::lower_bound(found.begin(), found.end(), SearchMatch{line, 0}) - found.begin();
+}
@@ -0,0 +1,64 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+
+struct SearchMatch {
+    int line;
+    int column;
+};
+
+inline bool operator<(const SearchMatch &a, const SearchMatch &b) {
+    return a.line < b.line || (a.line == b.line && a.column < b.column);
+}
+
+// Offset of the first occurrence of needle in haystack at or after from,
+// or std::string_view::npos. Candidates are filtered 16 bytes at a time on
+// the first and last needle byte before being verified.
+size_t findText(std::string_view haystack, std::string_view needle,
+                size_t from = 0, bool caseSensitive = true);
+
+// Smart case: a query is searched case sensitively only if it has capitals
+bool hasUppercase(std::string_view query);
+
+// Find-as-you-type state for one buffer. When the query grows by a suffix the
+// previous matches are refined instead of rescanning the buffer.
+class IncrementalSearch {
+public:
+    IncrementalSearch();
+
+    void setQuery(const TextBuffer &buffer, const std::string &newQuery, bool caseSensitive);
+    void clear();
+    // Call after the buffer changes, the next query update rescans
+    void invalidate() { stale = true; }
+    bool isStale() const { return stale; }
+
+    const std::string& query() const { return currentQuery; }
+    bool isCaseSensitive() const { return caseSensitive; }
+    const std::vector<SearchMatch>& matches() const { return found; }
+    // False when the match limit was hit and only the top of the buffer is indexed
+    bool isComplete() const { return complete; }
+
+    // First match strictly after / before (line, column), wrapping around
+    bool nextMatch(const TextBuffer &buffer, int line, int column, SearchMatch &match);
+    bool previousMatch(const TextBuffer &buffer, int line, int column, SearchMatch &match);
+
+    // Index of the first stored match on or after the given line
+    size_t firstMatchFrom(int line) const;
+
+private:
+    void scanFrom(const TextBuffer &buffer, int line);
+    bool matchesAt(const TextBuffer &buffer, const SearchMatch &match) const;
+
+    std::string currentQuery;
+    bool caseSensitive;
+    bool stale;
+    bool complete;
+    int scanLine; // first unscanned line when incomplete
+    std::vector<SearchMatch> found;
+};
+
+#endif // SEARCH_H
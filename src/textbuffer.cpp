@@ -0,0 +1,517 @@
+#include "textbuffer.h"
+#include "textclip.h"
+#include "memorybudget.h"
+#include <algorithm>
+#include <iterator>
+
+static const size_t MAX_JOURNAL = 4096;
+// Batches touching more lines than this are journaled as one range
+static const size_t MAX_BATCH_ENTRIES = 64;
+
+TextBuffer::TextBuffer() : currentVersion(0), journalStart(0) {
+    lines.emplace_back();
+}
+
+size_t TextBuffer::memoryUsage() const {
+    size_t bytes = lines.capacity() * sizeof(Line);
+    for (const Line &line : lines) bytes += line.ownedBytes();
+    for (const auto &arena : arenas) bytes += arena->residentBytes();
+    return bytes;
+}
+
+void TextBuffer::addMemoryUsage(MemoryUsage &usage) const {
+    for (const Line &line : lines) usage.text += line.ownedBytes();
+    for (const auto &arena : arenas) usage.text += arena->residentBytes();
+    usage.lineIndex += lines.capacity() * sizeof(Line) + journal.capacity() * sizeof(JournalEntry);
+    usage.undo += undoMemory();
+}
+
+void TextBuffer::setLines(LineArena newLines) {
+    lines = std::move(newLines.lines);
+    if (lines.empty()) lines.emplace_back();
+    arenas.assign(1, std::move(newLines.storage));
+    resetJournal();
+    history = UndoHistory();
+}
+
+void TextBuffer::clear() {
+    lines.assign(1, Line());
+    arenas.clear();
+    resetJournal();
+    history = UndoHistory();
+}
+
+std::shared_ptr<const TextBuffer> TextBuffer::snapshot() const {
+    for (const auto &arena : arenas) arena->readers.fetch_add(1, std::memory_order_relaxed);
+    return std::shared_ptr<const TextBuffer>(new TextBuffer(*this), [](const TextBuffer *copy) {
+        for (const auto &arena : copy->arenas) arena->readers.fetch_sub(1, std::memory_order_release);
+        delete copy;
+    });
+}
+
+bool TextBuffer::compressColdText(size_t minBytes, size_t workBytes) {
+    if (minBytes == 0 || loadedBytes() < minBytes) return false;
+    return LineArena::compressCold(arenas, workBytes);
+}
+
+size_t TextBuffer::loadedBytes() const {
+    size_t bytes = 0;
+    for (const auto &arena : arenas) bytes += arena->bytes;
+    return bytes;
+}
+
+void TextBuffer::keepArenas(const LineArena::StorageList &more) {
+    for (const auto &arena : more) {
+        if (std::find(arenas.begin(), arenas.end(), arena) == arenas.end()) arenas.push_back(arena);
+    }
+}
+
+void TextBuffer::insertText(int y, int x, std::string_view text) {
+    saveForUndo(y, 1);
+    lines[y].edit().insert(x, text.data(), text.size());
+    recordChange(y, 1, 1);
+}
+
+void TextBuffer::eraseText(int y, int x, int count) {
+    saveForUndo(y, 1);
+    lines[y].edit().erase(x, count);
+    recordChange(y, 1, 1);
+}
+
+void TextBuffer::splitLine(int y, int x) {
+    saveForUndo(y, 1);
+    Line tail(std::string(lines[y].text().substr(x)));
+    lines[y].edit().erase(x);
+    lines.insert(lines.begin() + y + 1, std::move(tail));
+    recordChange(y, 1, 2);
+}
+
+void TextBuffer::joinLines(int y) {
+    saveForUndo(y, 2);
+    Line next = std::move(lines[y + 1]);
+    lines[y].edit() += next.text();
+    lines.erase(lines.begin() + y + 1);
+    recordChange(y, 2, 1);
+}
+
+void TextBuffer::replaceLines(int first, int count, const LineArena &source, int sourceFirst, int sourceCount) {
+    saveForUndo(first, count);
+    keepArenas({source.storage});
+    int added = sourceCount;
+    lines.erase(lines.begin() + first, lines.begin() + first + count);
+    lines.insert(lines.begin() + first, source.lines.begin() + sourceFirst,
+                 source.lines.begin() + sourceFirst + sourceCount);
+    if (lines.empty()) {
+        lines.emplace_back();
+        added = 1;
+    }
+    recordChange(first, count, added);
+}
+
+TextClip TextBuffer::copyRange(TextPosition start, TextPosition end) const {
+    TextClip clip;
+    clip.lines.clear();
+    clip.arenas = arenas;
+    // Whole lines are shared with the clip; only the cut ends are copied
+    auto piece = [&](int y, int from, int to) {
+        if (from == 0 && to == lineLength(y)) {
+            clip.lines.push_back(lines[y]);
+        } else {
+            clip.lines.emplace_back(std::string(line(y).substr(from, to - from)));
+        }
+        clip.bytes += to - from;
+    };
+    if (start.line == end.line) {
+        piece(start.line, start.column, end.column);
+        return clip;
+    }
+    piece(start.line, start.column, lineLength(start.line));
+    clip.lines.reserve(end.line - start.line + 1);
+    for (int y = start.line + 1; y < end.line; y++) {
+        clip.lines.push_back(lines[y]);
+        clip.bytes += lines[y].size();
+    }
+    piece(end.line, 0, end.column);
+    clip.bytes += end.line - start.line;
+    return clip;
+}
+
+TextPosition TextBuffer::insertClip(TextPosition at, const TextClip &clip) {
+    int count = clip.lineCount();
+    if (count == 1) {
+        insertText(at.line, at.column, clip.line(0));
+        return {at.line, at.column + (int)clip.line(0).size()};
+    }
+
+    // The text around the insertion point joins the clip's first and last
+    // lines; everything between is shared, not copied
+    saveForUndo(at.line, 1);
+    keepArenas(clip.arenas);
+    std::string_view target = line(at.line);
+    std::string head(target.substr(0, at.column));
+    std::string tail(target.substr(at.column));
+    const Line &firstPiece = clip.lines.front();
+    const Line &lastPiece = clip.lines.back();
+    int endColumn = (int)lastPiece.size();
+
+    Line first = head.empty() ? firstPiece : Line(head.append(firstPiece.text()));
+    Line last = tail.empty() ? lastPiece : Line(std::string(lastPiece.text()).append(tail));
+    lines[at.line] = std::move(first);
+    lines.insert(lines.begin() + at.line + 1, clip.lines.begin() + 1, clip.lines.end() - 1);
+    lines.insert(lines.begin() + at.line + count - 1, std::move(last));
+    recordChange(at.line, 1, count);
+    return {at.line + count - 1, endColumn};
+}
+
+void TextBuffer::applyEdits(const std::vector<TextEdit> &edits, std::vector<TextPosition> *ends) {
+    if (ends) ends->clear();
+    if (edits.empty()) return;
+
+    bool sameLines = std::all_of(edits.begin(), edits.end(), [](const TextEdit &edit) {
+        return edit.start.line == edit.end.line && edit.text.find('\n') == std::string::npos;
+    });
+
+    if (sameLines) {
+        // Every line is rebuilt once however many edits it has; the columns
+        // of later edits on a line move by what the earlier ones added
+        std::vector<int> touched;
+        std::vector<Line> old;
+        std::string rebuilt;
+        size_t i = 0;
+        while (i < edits.size()) {
+            int y = edits[i].start.line;
+            std::string_view text = line(y);
+            rebuilt.clear();
+            int copied = 0;
+            for (; i < edits.size() && edits[i].start.line == y; i++) {
+                const TextEdit &edit = edits[i];
+                rebuilt.append(text, copied, edit.start.column - copied);
+                rebuilt += edit.text;
+                if (ends) ends->push_back({y, (int)rebuilt.size()});
+                copied = edit.end.column;
+            }
+            rebuilt.append(text, copied, std::string::npos);
+            Line replaced(std::move(rebuilt));
+            old.push_back(std::move(lines[y]));
+            lines[y] = std::move(replaced);
+            rebuilt = std::string();
+            touched.push_back(y);
+        }
+        saveRewritesForUndo(touched, std::move(old));
+        recordRewrites(touched);
+        return;
+    }
+
+    saveForUndo(edits.front().start.line, edits.back().end.line - edits.front().start.line + 1);
+
+    // Edits chained on shared lines form a cluster; each cluster's new
+    // lines are built on the side from the few old lines it touches
+    struct Cluster {
+        int first;
+        int last;
+        std::vector<Line> lines;
+    };
+    std::vector<Cluster> clusters;
+    std::vector<size_t> endCluster;
+    std::string current;
+    for (size_t i = 0; i < edits.size(); i++) {
+        const TextEdit &edit = edits[i];
+        if (i == 0 || edit.start.line != edits[i - 1].end.line) {
+            clusters.push_back({edit.start.line, edit.start.line, {}});
+            current = std::string(line(edit.start.line).substr(0, edit.start.column));
+        }
+        Cluster &cluster = clusters.back();
+
+        size_t start = 0, newline;
+        while ((newline = edit.text.find('\n', start)) != std::string::npos) {
+            current.append(edit.text, start, newline - start);
+            cluster.lines.emplace_back(std::move(current));
+            current = std::string();
+            start = newline + 1;
+        }
+        current.append(edit.text, start, std::string::npos);
+        if (ends) {
+            ends->push_back({(int)cluster.lines.size(), (int)current.size()});
+            endCluster.push_back(clusters.size() - 1);
+        }
+
+        std::string_view endLine = line(edit.end.line);
+        if (i + 1 < edits.size() && edits[i + 1].start.line == edit.end.line) {
+            current.append(endLine, edit.end.column, edits[i + 1].start.column - edit.end.column);
+        } else {
+            current.append(endLine, edit.end.column, std::string::npos);
+            cluster.lines.emplace_back(std::move(current));
+            current = std::string();
+            cluster.last = edit.end.line;
+        }
+    }
+
+    // Then every line after the first cluster moves once, straight to its
+    // final place: back to front when the buffer only grows, front to back
+    // when it only shrinks
+    int oldCount = (int)lines.size();
+    int total = 0;
+    bool growing = true, shrinking = true;
+    std::vector<int> shiftAfter(clusters.size());
+    for (size_t k = 0; k < clusters.size(); k++) {
+        int delta = (int)clusters[k].lines.size() - (clusters[k].last - clusters[k].first + 1);
+        growing = growing && delta >= 0;
+        shrinking = shrinking && delta <= 0;
+        total += delta;
+        shiftAfter[k] = total;
+    }
+    auto blockEnd = [&](size_t k) { return k + 1 < clusters.size() ? clusters[k + 1].first : oldCount; };
+    auto shiftBefore = [&](size_t k) { return k > 0 ? shiftAfter[k - 1] : 0; };
+
+    if (growing) {
+        lines.resize(oldCount + total);
+        for (size_t k = clusters.size(); k-- > 0;) {
+            Cluster &cluster = clusters[k];
+            if (shiftAfter[k] != 0) {
+                std::move_backward(lines.begin() + cluster.last + 1, lines.begin() + blockEnd(k),
+                                   lines.begin() + blockEnd(k) + shiftAfter[k]);
+            }
+            std::move(cluster.lines.begin(), cluster.lines.end(), lines.begin() + cluster.first + shiftBefore(k));
+        }
+    } else if (shrinking) {
+        for (size_t k = 0; k < clusters.size(); k++) {
+            Cluster &cluster = clusters[k];
+            std::move(cluster.lines.begin(), cluster.lines.end(), lines.begin() + cluster.first + shiftBefore(k));
+            if (shiftAfter[k] != 0) {
+                std::move(lines.begin() + cluster.last + 1, lines.begin() + blockEnd(k),
+                          lines.begin() + cluster.last + 1 + shiftAfter[k]);
+            }
+        }
+        lines.resize(oldCount + total);
+    } else {
+        // Mixed: the tail is rebuilt on the side
+        std::vector<Line> tail;
+        tail.reserve(oldCount + total - clusters[0].first);
+        for (size_t k = 0; k < clusters.size(); k++) {
+            Cluster &cluster = clusters[k];
+            std::move(cluster.lines.begin(), cluster.lines.end(), std::back_inserter(tail));
+            std::move(lines.begin() + cluster.last + 1, lines.begin() + blockEnd(k), std::back_inserter(tail));
+        }
+        lines.resize(clusters[0].first);
+        lines.insert(lines.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+    }
+
+    if (ends) {
+        for (size_t i = 0; i < ends->size(); i++) {
+            size_t k = endCluster[i];
+            (*ends)[i].line += clusters[k].first + shiftBefore(k);
+        }
+    }
+
+    int first = clusters.front().first;
+    int removed = clusters.back().last - first + 1;
+    recordChange(first, removed, removed + total);
+}
+
+void TextBuffer::rewriteLines(std::vector<LineRewrite> rewrites) {
+    if (rewrites.empty()) return;
+    std::vector<int> touched;
+    std::vector<Line> old;
+    touched.reserve(rewrites.size());
+    old.reserve(rewrites.size());
+    for (LineRewrite &rewrite : rewrites) {
+        touched.push_back(rewrite.line);
+        old.push_back(std::move(lines[rewrite.line]));
+        lines[rewrite.line] = std::move(rewrite.text);
+    }
+    saveRewritesForUndo(touched, std::move(old));
+    recordRewrites(touched);
+}
+
+void TextBuffer::recordRewrites(const std::vector<int> &touched) {
+    if (touched.size() <= MAX_BATCH_ENTRIES) {
+        for (int y : touched) recordChange(y, 1, 1);
+    } else {
+        int span = touched.back() - touched.front() + 1;
+        recordChange(touched.front(), span, span);
+    }
+}
+
+void TextBuffer::beginUndoStep(TextPosition cursor) {
+    if (history.isOpen) return;
+    history.isOpen = true;
+    history.open.records.clear();
+    history.open.before = cursor;
+}
+
+void TextBuffer::closeUndoStep(TextPosition cursor) {
+    if (!history.isOpen) return;
+    history.isOpen = false;
+    if (history.open.records.empty()) return;
+    history.open.after = cursor;
+    history.done.push_back(std::move(history.open));
+    history.open = UndoStep();
+}
+
+void TextBuffer::saveForUndo(int first, int count) {
+    beginUndoStep({first, 0});
+    history.undone.clear();
+
+    // An edit inside the lines the last record already saved (more typing
+    // on the same line) only changes how many lines those became
+    std::vector<UndoRecord> &records = history.open.records;
+    if (!records.empty()) {
+        const UndoRecord &last = records.back();
+        if (last.rewritten.empty() && first >= last.first && first + count <= last.first + last.count) {
+            history.pending = true;
+            history.pendingRemoved = count;
+            return;
+        }
+    }
+    records.push_back({first, count, std::vector<Line>(lines.begin() + first, lines.begin() + first + count), {}});
+    history.pending = true;
+    history.pendingRemoved = count;
+}
+
+void TextBuffer::saveRewritesForUndo(const std::vector<int> &touched, std::vector<Line> old) {
+    beginUndoStep({touched.front(), 0});
+    history.undone.clear();
+
+    // The same lines rewritten again (every cursor typing) keep the text
+    // saved the first time
+    std::vector<UndoRecord> &records = history.open.records;
+    if (!records.empty() && records.back().rewritten == touched) return;
+    records.push_back({0, 0, std::move(old), touched});
+}
+
+void TextBuffer::applyUndoStep(UndoStep &step) {
+    // Each record swaps what it saved with what is there now, which turns
+    // it into the record that reverses it
+    std::vector<UndoRecord> &records = step.records;
+    for (auto record = records.rbegin(); record != records.rend(); ++record) {
+        if (!record->rewritten.empty()) {
+            for (size_t i = 0; i < record->rewritten.size(); i++) {
+                std::swap(lines[record->rewritten[i]], record->lines[i]);
+            }
+            recordRewrites(record->rewritten);
+            continue;
+        }
+        auto begin = lines.begin() + record->first;
+        int restored = (int)record->lines.size();
+        if (restored == record->count) {
+            std::swap_ranges(begin, begin + restored, record->lines.begin());
+        } else {
+            std::vector<Line> current(std::make_move_iterator(begin),
+                                            std::make_move_iterator(begin + record->count));
+            lines.erase(begin, begin + record->count);
+            lines.insert(lines.begin() + record->first, std::make_move_iterator(record->lines.begin()),
+                         std::make_move_iterator(record->lines.end()));
+            record->lines.swap(current);
+        }
+        recordChange(record->first, record->count, restored);
+        record->count = restored;
+    }
+    std::reverse(records.begin(), records.end());
+}
+
+bool TextBuffer::undo(TextPosition &cursor) {
+    closeUndoStep(cursor);
+    if (history.done.empty()) return false;
+    UndoStep step = std::move(history.done.back());
+    history.done.pop_back();
+    applyUndoStep(step);
+    cursor = step.before;
+    history.undone.push_back(std::move(step));
+    return true;
+}
+
+bool TextBuffer::redo(TextPosition &cursor) {
+    closeUndoStep(cursor);
+    if (history.undone.empty()) return false;
+    UndoStep step = std::move(history.undone.back());
+    history.undone.pop_back();
+    applyUndoStep(step);
+    cursor = step.after;
+    history.done.push_back(std::move(step));
+    return true;
+}
+
+size_t TextBuffer::stepMemory(const UndoStep &step) {
+    size_t bytes = sizeof(UndoStep) + step.records.capacity() * sizeof(UndoRecord);
+    for (const UndoRecord &record : step.records) {
+        bytes += record.lines.capacity() * sizeof(Line) + record.rewritten.capacity() * sizeof(int);
+        for (const Line &line : record.lines) bytes += line.ownedBytes();
+    }
+    return bytes;
+}
+
+// Both stacks end with the step nearest the present, so a trim drops
+// from the front; the open step is never dropped
+size_t TextBuffer::undoMemory(int keepSteps) const {
+    size_t bytes = keepSteps == 0 ? stepMemory(history.open) : 0;
+    for (const std::vector<UndoStep> *steps : {&history.done, &history.undone}) {
+        int drop = std::max(0, (int)steps->size() - keepSteps);
+        for (int i = 0; i < drop; i++) bytes += stepMemory((*steps)[i]);
+    }
+    return bytes;
+}
+
+size_t TextBuffer::trimUndo(int keepSteps) {
+    size_t freed = undoMemory(keepSteps) - (keepSteps == 0 ? stepMemory(history.open) : 0);
+    for (std::vector<UndoStep> *steps : {&history.done, &history.undone}) {
+        int drop = std::max(0, (int)steps->size() - keepSteps);
+        steps->erase(steps->begin(), steps->begin() + drop);
+        steps->shrink_to_fit();
+    }
+    return freed;
+}
+
+std::vector<std::string> TextBuffer::splitLines(std::string_view text, bool stripCarriageReturns) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+
+        size_t lineEnd = end;
+        if (stripCarriageReturns && lineEnd > start && text[lineEnd - 1] == '\r') lineEnd--;
+        result.emplace_back(text.substr(start, lineEnd - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+void TextBuffer::recordChange(int first, int removed, int added) {
+    currentVersion++;
+    if (history.pending) {
+        history.open.records.back().count += added - history.pendingRemoved;
+        history.pending = false;
+    }
+
+    // Typing on one line only needs one entry; replaying it for a reader
+    // that already saw it just marks the same line again
+    if (!journal.empty() && removed == 1 && added == 1) {
+        JournalEntry &last = journal.back();
+        if (last.change.first == first && last.change.removed == 1 && last.change.added == 1) {
+            last.version = currentVersion;
+            return;
+        }
+    }
+
+    if (journal.size() >= MAX_JOURNAL) {
+        journalStart = journal[MAX_JOURNAL / 2 - 1].version;
+        journal.erase(journal.begin(), journal.begin() + MAX_JOURNAL / 2);
+    }
+    journal.push_back({{first, removed, added}, currentVersion});
+}
+
+void TextBuffer::resetJournal() {
+    journal.clear();
+    currentVersion++;
+    journalStart = currentVersion;
+}
+
+bool TextBuffer::changesSince(uint64_t since, std::vector<LineChange> &changes) const {
+    if (since < journalStart || since > currentVersion) return false;
+    auto it = std::upper_bound(journal.begin(), journal.end(), since,
+                               [](uint64_t version, const JournalEntry &entry) { return version < entry.version; });
+    for (; it != journal.end(); ++it) {
+        changes.push_back(it->change);
+    }
+    return true;
+}
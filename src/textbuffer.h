@@ -0,0 +1,184 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "linearena.h"
+
+// Lines [first, first + removed) were replaced by `added` new lines
+struct LineChange {
+    int first;
+    int removed;
+    int added;
+};
+
+struct TextPosition {
+    int line;
+    int column;   // byte offset into the line
+};
+
+inline bool operator<(const TextPosition &a, const TextPosition &b) {
+    return a.line < b.line || (a.line == b.line && a.column < b.column);
+}
+
+inline bool operator==(const TextPosition &a, const TextPosition &b) {
+    return a.line == b.line && a.column == b.column;
+}
+
+// Replaces [start, end) with text, which may span lines
+struct TextEdit {
+    TextPosition start;
+    TextPosition end;
+    std::string text;
+};
+
+class TextClip;
+struct MemoryUsage;
+
+// New text for one line, built away from the buffer (on a worker, say)
+struct LineRewrite {
+    int line;
+    Line text;
+};
+
+// Line-based text storage shared by the terminal and GUI front ends.
+// Lines never contain '\n'; the buffer always holds at least one line.
+// Loaded lines stay in the arena they were read into and are shared
+// between the buffer, its snapshots and copied text; a line gets text of
+// its own when it is first edited.
+class TextBuffer {
+public:
+    TextBuffer();
+
+    int lineCount() const { return (int)lines.size(); }
+    std::string_view line(int index) const { return lines[index].text(); }
+    int lineLength(int index) const { return (int)lines[index].size(); }
+    // Heap bytes held by the lines and their arenas, counting shared ones
+    // in full
+    size_t memoryUsage() const;
+    // Adds the text, line index and undo history to usage. Walks every
+    // line and undo step, so callers measure only now and then.
+    void addMemoryUsage(MemoryUsage &usage) const;
+
+    void setLines(LineArena newLines);
+    void clear();
+
+    // A copy to read on another thread. While it lives its arenas stay
+    // as they are; copies made any other way are for this thread only.
+    std::shared_ptr<const TextBuffer> snapshot() const;
+    // Once the loaded text passes minBytes (0: never), keeps the arena
+    // blocks not read lately compressed, doing about workBytes of
+    // compression a call; true while there is more to do. Reading a line
+    // decompresses its block again. Views of lines taken before the call
+    // may dangle after it, so it belongs between events.
+    bool compressColdText(size_t minBytes, size_t workBytes);
+    // Text loaded into arenas, as read, compressed or not
+    size_t loadedBytes() const;
+
+    // Editing primitives, positions are (line, byte column)
+    void insertText(int y, int x, std::string_view text);
+    void eraseText(int y, int x, int count);
+    void splitLine(int y, int x);
+    void joinLines(int y); // appends line y + 1 to line y
+    // Replaces count lines starting at first (count may be 0 to insert)
+    // with sourceCount lines of source from sourceFirst, which stay in
+    // source's arena
+    void replaceLines(int first, int count, const LineArena &source, int sourceFirst, int sourceCount);
+    // Applies edits sorted by position and not overlapping in one pass, so
+    // many cursors cost one sweep instead of one shift of the buffer each.
+    // ends, if given, receives where each edit's text ends afterwards.
+    void applyEdits(const std::vector<TextEdit> &edits, std::vector<TextPosition> *ends = nullptr);
+
+    // Copying shares every whole line with the buffer; pasting splices the
+    // clip's lines in with one insert and returns where the text ends
+    TextClip copyRange(TextPosition start, TextPosition end) const;
+    TextPosition insertClip(TextPosition at, const TextClip &clip);
+    // Swaps in new text for lines (sorted, no line breaks) as one change
+    void rewriteLines(std::vector<LineRewrite> rewrites);
+
+    // Edits gather into an open undo step until it is closed, so a run of
+    // typing can be undone as one. cursor is where the caller's cursor was
+    // before the step and after it; undo and redo hand those back. Steps
+    // keep the replaced lines themselves, which are shared, so an edit
+    // costs a pointer per line it touched. setLines and clear forget the
+    // history; copies of the buffer start without one.
+    void beginUndoStep(TextPosition cursor);
+    void closeUndoStep(TextPosition cursor);
+    bool canUndo() const { return !history.done.empty() || !history.open.records.empty(); }
+    bool canRedo() const { return !history.undone.empty(); }
+    bool undo(TextPosition &cursor);
+    bool redo(TextPosition &cursor);
+    // Forgets all but the keepSteps undo (and redo) steps nearest the
+    // present and returns about how many bytes that freed. undoMemory says
+    // what it would free; with 0 it is the whole history.
+    size_t trimUndo(int keepSteps);
+    size_t undoMemory(int keepSteps = 0) const;
+
+    // Splits file content into lines like std::getline: a final '\n' does
+    // not start another line
+    static std::vector<std::string> splitLines(std::string_view text, bool stripCarriageReturns = false);
+
+    // Every edit bumps the version and is journaled so caches keyed by line
+    // (highlighting, folds, wrapping) can catch up without rescanning.
+    // changesSince() returns false when the journal no longer reaches back
+    // to `since` (after setLines/clear or a long run of edits); the caller
+    // then has to rebuild from scratch.
+    uint64_t version() const { return currentVersion; }
+    bool changesSince(uint64_t since, std::vector<LineChange> &changes) const;
+
+private:
+    void recordChange(int first, int removed, int added);
+    void resetJournal();
+    void keepArenas(const LineArena::StorageList &more);
+    void saveForUndo(int first, int count);
+    void saveRewritesForUndo(const std::vector<int> &touched, std::vector<Line> old);
+    void recordRewrites(const std::vector<int> &touched);
+
+    std::vector<Line> lines;
+    // Every arena a line, undo step or clip of ours may point into
+    LineArena::StorageList arenas;
+
+    // Lines [first, first + count) were `lines` before the edit; a rewrite
+    // instead swapped the text of the listed lines
+    struct UndoRecord {
+        int first;
+        int count;
+        std::vector<Line> lines;
+        std::vector<int> rewritten;
+    };
+    struct UndoStep {
+        std::vector<UndoRecord> records;
+        TextPosition before;
+        TextPosition after;
+    };
+    struct UndoHistory {
+        std::vector<UndoStep> done;
+        std::vector<UndoStep> undone;
+        UndoStep open;
+        bool isOpen = false;
+        bool pending = false;    // the last record waits for its new line count
+        int pendingRemoved = 0;
+
+        UndoHistory() = default;
+        UndoHistory(const UndoHistory &) {}
+        UndoHistory(UndoHistory &&) = default;
+        UndoHistory &operator=(const UndoHistory &) { return *this = UndoHistory(); }
+        UndoHistory &operator=(UndoHistory &&) = default;
+    };
+    void applyUndoStep(UndoStep &step);
+    static size_t stepMemory(const UndoStep &step);
+    UndoHistory history;
+    struct JournalEntry {
+        LineChange change;
+        uint64_t version;            // buffer version after the change
+    };
+
+    uint64_t currentVersion;
+    uint64_t journalStart;           // oldest version the journal reaches back to
+    std::vector<JournalEntry> journal;
+};
+
+#endif // TEXTBUFFER_H
@@ -0,0 +1,30 @@
+#include "textclip.h"
+
+TextClip::TextClip() : bytes(0) {
+    lines.emplace_back();
+}
+
+TextClip TextClip::fromText(std::string_view text) {
+    TextClip clip;
+    clip.lines.clear();
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+        clip.lines.emplace_back(std::string(text.substr(start, end - start)));
+        if (end == text.size()) break;
+        start = end + 1;
+    }
+    clip.bytes = text.size();
+    return clip;
+}
+
+std::string TextClip::toString() const {
+    std::string text;
+    text.reserve(bytes);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0) text += '\n';
+        text += lines[i].text();
+    }
+    return text;
+}
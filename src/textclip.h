@@ -0,0 +1,35 @@
+#ifndef TEXTCLIP_H
+#define TEXTCLIP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+
+// Copied text, held as lines shared with the buffer it came from, so a
+// copy costs a line reference instead of the bytes. Lines are joined by
+// '\n'; a clip always has at least one line.
+class TextClip {
+public:
+    TextClip();
+
+    static TextClip fromText(std::string_view text);
+
+    int lineCount() const { return (int)lines.size(); }
+    std::string_view line(int index) const { return lines[index].text(); }
+    // Bytes including the line breaks
+    size_t size() const { return bytes; }
+    bool isEmpty() const { return bytes == 0; }
+
+    // The text as one string; only built when another program asks for it
+    std::string toString() const;
+
+private:
+    friend class TextBuffer;
+
+    std::vector<Line> lines;
+    LineArena::StorageList arenas;   // keeps the shared lines' text alive
+    size_t bytes;
+};
+
+#endif // TEXTCLIP_H
@@ -0,0 +1,491 @@
+#include "textcodec.h"
+#include "utf8.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static const size_t BLOCK_SIZE = 64 * 1024;
+// Bytes looked at when guessing UTF-16 without a byte order mark
+static const size_t SNIFF_SIZE = 4096;
+static const char REPLACEMENT_UTF8[] = "\xEF\xBF\xBD";
+
+static void appendUtf8(std::string &out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += (char)codepoint;
+    } else if (codepoint < 0x800) {
+        out += (char)(0xC0 | (codepoint >> 6));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += (char)(0xE0 | (codepoint >> 12));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | (codepoint >> 18));
+        out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static void appendUtf16(std::string &out, uint32_t codepoint, bool bigEndian) {
+    auto unit = [&](uint32_t value) {
+        char low = (char)(value & 0xFF), high = (char)(value >> 8);
+        if (bigEndian) {
+            out += high;
+            out += low;
+        } else {
+            out += low;
+            out += high;
+        }
+    };
+    if (codepoint < 0x10000) {
+        unit(codepoint);
+    } else {
+        codepoint -= 0x10000;
+        unit(0xD800 | (codepoint >> 10));
+        unit(0xDC00 | (codepoint & 0x3FF));
+    }
+}
+
+static inline uint32_t readUnit(const unsigned char *data, size_t offset, bool bigEndian) {
+    return bigEndian ? (data[offset] << 8 | data[offset + 1]) : (data[offset] | data[offset + 1] << 8);
+}
+
+// Narrows runs of ASCII UTF-16 units to bytes, 8 units at a time; returns
+// where the run stopped
+static size_t narrowAscii(const unsigned char *data, size_t offset, size_t size, bool bigEndian,
+                          std::string &out) {
+#if defined(__SSE2__)
+    const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+    char packed[16];
+    for (; offset + 16 <= size; offset += 16) {
+        __m128i units = _mm_loadu_si128((const __m128i *)(data + offset));
+        if (bigEndian) units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+        __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), _mm_setzero_si128());
+        if (_mm_movemask_epi8(ascii) != 0xFFFF) break;
+        _mm_storel_epi64((__m128i *)packed, _mm_packus_epi16(units, units));
+        out.append(packed, 8);
+    }
+#elif defined(__ARM_NEON)
+    uint8_t packed[8];
+    for (; offset + 16 <= size; offset += 16) {
+        uint8x16_t bytes = vld1q_u8(data + offset);
+        if (bigEndian) bytes = vrev16q_u8(bytes);
+        uint16x8_t units = vreinterpretq_u16_u8(bytes);
+        uint8x8_t above = vmovn_u16(vcgtq_u16(units, vdupq_n_u16(0x7F)));
+        if (vget_lane_u64(vreinterpret_u64_u8(above), 0)) break;
+        vst1_u8(packed, vmovn_u16(units));
+        out.append((const char *)packed, 8);
+    }
+#else
+    (void)data;
+    (void)size;
+    (void)bigEndian;
+    (void)out;
+#endif
+    return offset;
+}
+
+// Widens runs of ASCII bytes to UTF-16 units, 16 bytes at a time
+static size_t widenAscii(const unsigned char *data, size_t offset, size_t size, bool bigEndian,
+                         std::string &out) {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    char wide[32];
+    for (; offset + 16 <= size; offset += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + offset));
+        if (_mm_movemask_epi8(bytes)) break;
+        __m128i low = bigEndian ? _mm_unpacklo_epi8(zero, bytes) : _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = bigEndian ? _mm_unpackhi_epi8(zero, bytes) : _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128((__m128i *)wide, low);
+        _mm_storeu_si128((__m128i *)(wide + 16), high);
+        out.append(wide, 32);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t highBit = vdupq_n_u8(0x80);
+    uint8_t wide[32];
+    for (; offset + 16 <= size; offset += 16) {
+        uint8x16_t bytes = vld1q_u8(data + offset);
+        uint8x16_t set = vtstq_u8(bytes, highBit);
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(set), 4)), 0)) break;
+        uint8x16x2_t pairs;
+        pairs.val[0] = bigEndian ? zero : bytes;
+        pairs.val[1] = bigEndian ? bytes : zero;
+        vst2q_u8(wide, pairs);
+        out.append((const char *)wide, 32);
+    }
+#else
+    (void)data;
+    (void)size;
+    (void)bigEndian;
+    (void)out;
+#endif
+    return offset;
+}
+
+// End of the block without a UTF-8 sequence the block boundary cut off
+static size_t wholeSequencesEnd(const unsigned char *data, size_t size) {
+    for (size_t back = 1; back <= 3 && back <= size; back++) {
+        unsigned char c = data[size - back];
+        if ((c & 0xC0) == 0x80) continue;
+        return c >= 0xC0 ? size - back : size;
+    }
+    return size;
+}
+
+static bool looksLikeUtf16(const unsigned char *data, size_t size, bool &bigEndian) {
+    size_t length = std::min(size, SNIFF_SIZE) & ~(size_t)1;
+    size_t units = length / 2;
+    if (units < 2) return false;
+
+    size_t evenZeros = 0, oddZeros = 0;
+    for (size_t i = 0; i < length; i += 2) {
+        evenZeros += data[i] == 0;
+        oddZeros += data[i + 1] == 0;
+    }
+    // Mostly-ASCII text has a zero in the high byte of nearly every unit
+    if (oddZeros * 2 >= units && evenZeros * 10 < oddZeros) {
+        bigEndian = false;
+        return true;
+    }
+    if (evenZeros * 2 >= units && oddZeros * 10 < evenZeros) {
+        bigEndian = true;
+        return true;
+    }
+    return false;
+}
+
+FileFormat detectFormat(std::string_view head, bool atEnd) {
+    const unsigned char *data = (const unsigned char *)head.data();
+    size_t size = head.size();
+    FileFormat format;
+    size_t start = 0;
+    bool bigEndian = false;
+
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        format.byteOrderMark = true;
+        start = 3;
+    } else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        format.encoding = TextEncoding::Utf16LE;
+        format.byteOrderMark = true;
+        start = 2;
+    } else if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        format.encoding = TextEncoding::Utf16BE;
+        format.byteOrderMark = true;
+        start = 2;
+    } else if (looksLikeUtf16(data, size, bigEndian)) {
+        format.encoding = bigEndian ? TextEncoding::Utf16BE : TextEncoding::Utf16LE;
+    } else {
+        size_t end = atEnd ? size : wholeSequencesEnd(data, size);
+        if (!isValidUtf8(head.substr(0, end))) format.encoding = TextEncoding::Latin1;
+    }
+
+    // The first line break decides how all of them are written back
+    if (format.encoding == TextEncoding::Utf16LE || format.encoding == TextEncoding::Utf16BE) {
+        bool big = format.encoding == TextEncoding::Utf16BE;
+        for (size_t i = start; i + 2 <= size; i += 2) {
+            if (readUnit(data, i, big) != '\n') continue;
+            if (i >= start + 2 && readUnit(data, i - 2, big) == '\r') format.lineEnding = LineEnding::CRLF;
+            break;
+        }
+    } else {
+        const void *newline = memchr(data + start, '\n', size - start);
+        if (newline) {
+            size_t at = (const unsigned char *)newline - data;
+            if (at > start && data[at - 1] == '\r') format.lineEnding = LineEnding::CRLF;
+        }
+    }
+    return format;
+}
+
+std::string formatDescription(const FileFormat &format) {
+    std::string description;
+    switch (format.encoding) {
+        case TextEncoding::Utf8:
+            if (format.byteOrderMark) description = "UTF-8 BOM";
+            break;
+        case TextEncoding::Utf16LE:
+            description = "UTF-16LE";
+            break;
+        case TextEncoding::Utf16BE:
+            description = "UTF-16BE";
+            break;
+        case TextEncoding::Latin1:
+            description = "Latin-1";
+            break;
+    }
+    if (format.lineEnding == LineEnding::CRLF) {
+        if (!description.empty()) description += ' ';
+        description += "CRLF";
+    }
+    return description;
+}
+
+TextDecoder::TextDecoder(const FileFormat &format)
+    : encoding(format.encoding), stripCR(format.lineEnding == LineEnding::CRLF),
+      lastWasNewline(false), anyLines(false) {
+}
+
+void TextDecoder::feed(std::string_view bytes, LineArena &lines) {
+    if (bytes.empty()) return;
+
+    switch (encoding) {
+        case TextEncoding::Utf8:
+            splitInto(bytes, lines);
+            return;
+
+        case TextEncoding::Latin1: {
+            decoded.clear();
+            decoded.reserve(bytes.size() * 2);
+            size_t offset = 0;
+            while (offset < bytes.size()) {
+                size_t run = asciiPrefix(bytes.substr(offset));
+                decoded.append(bytes.data() + offset, run);
+                offset += run;
+                if (offset < bytes.size()) appendUtf8(decoded, (unsigned char)bytes[offset++]);
+            }
+            splitInto(decoded, lines);
+            return;
+        }
+
+        case TextEncoding::Utf16LE:
+        case TextEncoding::Utf16BE: {
+            // A unit or surrogate pair split by the last block is finished first
+            std::string_view input = bytes;
+            if (!pending.empty()) {
+                pending.append(bytes.data(), bytes.size());
+                input = pending;
+            }
+            decoded.clear();
+            decoded.reserve(input.size());
+            size_t used = decodeUtf16((const unsigned char *)input.data(), input.size(), decoded);
+            pending = std::string(input.substr(used));
+            splitInto(decoded, lines);
+            return;
+        }
+    }
+}
+
+size_t TextDecoder::decodeUtf16(const unsigned char *data, size_t size, std::string &out) const {
+    bool bigEndian = encoding == TextEncoding::Utf16BE;
+    size_t offset = 0;
+    while (offset + 2 <= size) {
+        offset = narrowAscii(data, offset, size, bigEndian, out);
+        if (offset + 2 > size) break;
+
+        uint32_t unit = readUnit(data, offset, bigEndian);
+        if (unit < 0xD800 || unit > 0xDFFF) {
+            appendUtf8(out, unit);
+            offset += 2;
+        } else if (unit <= 0xDBFF) {
+            if (offset + 4 > size) break;   // the low half is in the next block
+            uint32_t low = readUnit(data, offset + 2, bigEndian);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                appendUtf8(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                offset += 4;
+            } else {
+                out += REPLACEMENT_UTF8;
+                offset += 2;
+            }
+        } else {
+            out += REPLACEMENT_UTF8;
+            offset += 2;
+        }
+    }
+    return offset;
+}
+
+void TextDecoder::splitInto(std::string_view text, LineArena &lines) {
+    size_t start = 0;
+    while (start < text.size()) {
+        const void *found = memchr(text.data() + start, '\n', text.size() - start);
+        if (!found) {
+            current.append(text.data() + start, text.size() - start);
+            lastWasNewline = false;
+            return;
+        }
+        size_t end = (const char *)found - text.data();
+        if (current.empty()) {
+            // A whole line in this block goes straight into the arena
+            size_t lineEnd = end;
+            if (stripCR && lineEnd > start && text[lineEnd - 1] == '\r') lineEnd--;
+            lines.append(text.substr(start, lineEnd - start));
+        } else {
+            current.append(text.data() + start, end - start);
+            if (stripCR && current.back() == '\r') current.pop_back();
+            lines.append(current);
+            current.clear();
+        }
+        anyLines = true;
+        lastWasNewline = true;
+        start = end + 1;
+    }
+}
+
+void TextDecoder::finish(LineArena &lines) {
+    if (!pending.empty()) {
+        // Half a unit or a lone high surrogate at the very end
+        current += REPLACEMENT_UTF8;
+        pending.clear();
+        lastWasNewline = false;
+    }
+    if (!current.empty() || !anyLines) lines.append(current);
+    current = std::string();
+    anyLines = true;
+}
+
+// Reads until the block is full or the file ends
+static ssize_t readBlock(int fd, std::string &block) {
+    block.resize(BLOCK_SIZE);
+    size_t done = 0;
+    while (done < BLOCK_SIZE) {
+        ssize_t n = read(fd, &block[done], BLOCK_SIZE - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += n;
+    }
+    block.resize(done);
+    return done;
+}
+
+bool readTextFile(const std::string &path, LineArena &lines, FileFormat &format) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    std::string block;
+    ssize_t n = readBlock(fd, block);
+    if (n < 0) {
+        close(fd);
+        return false;
+    }
+    format = detectFormat(block, (size_t)n < BLOCK_SIZE);
+
+    size_t bomLength = 0;
+    if (format.byteOrderMark) bomLength = format.encoding == TextEncoding::Utf8 ? 3 : 2;
+
+    lines = LineArena();
+    TextDecoder decoder(format);
+    decoder.feed(std::string_view(block).substr(bomLength), lines);
+    while ((size_t)n == BLOCK_SIZE) {
+        n = readBlock(fd, block);
+        if (n < 0) {
+            close(fd);
+            return false;
+        }
+        decoder.feed(block, lines);
+    }
+    close(fd);
+
+    decoder.finish(lines);
+    format.finalNewline = decoder.endedWithNewline();
+    return true;
+}
+
+static bool writeAll(int fd, const std::string &data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+static bool fitsLatin1(const TextBuffer &buffer) {
+    for (int i = 0; i < buffer.lineCount(); i++) {
+        std::string_view text = buffer.line(i);
+        size_t offset = asciiPrefix(text);
+        while (offset < text.size()) {
+            size_t length;
+            if (decodeUtf8(text, offset, length) > 0xFF) return false;
+            offset += length;
+            offset += asciiPrefix(text.substr(offset));
+        }
+    }
+    return true;
+}
+
+static void encodeText(std::string_view text, TextEncoding encoding, std::string &out) {
+    const unsigned char *data = (const unsigned char *)text.data();
+    size_t offset = 0;
+    switch (encoding) {
+        case TextEncoding::Utf8:
+            out.append(text.data(), text.size());
+            return;
+
+        case TextEncoding::Latin1:
+            while (offset < text.size()) {
+                size_t run = asciiPrefix(text.substr(offset));
+                out.append(text.data() + offset, run);
+                offset += run;
+                if (offset < text.size()) {
+                    size_t length;
+                    out += (char)decodeUtf8(text, offset, length);
+                    offset += length;
+                }
+            }
+            return;
+
+        case TextEncoding::Utf16LE:
+        case TextEncoding::Utf16BE: {
+            bool bigEndian = encoding == TextEncoding::Utf16BE;
+            while (offset < text.size()) {
+                offset = widenAscii(data, offset, text.size(), bigEndian, out);
+                if (offset >= text.size()) break;
+                size_t length;
+                appendUtf16(out, decodeUtf8(text, offset, length), bigEndian);
+                offset += length;
+            }
+            return;
+        }
+    }
+}
+
+bool writeTextFile(const std::string &path, const TextBuffer &buffer, FileFormat &format) {
+    if (format.encoding == TextEncoding::Latin1 && !fitsLatin1(buffer)) {
+        format.encoding = TextEncoding::Utf8;
+        format.byteOrderMark = false;
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    std::string out;
+    out.reserve(BLOCK_SIZE * 2);
+    if (format.byteOrderMark) {
+        switch (format.encoding) {
+            case TextEncoding::Utf8: out = "\xEF\xBB\xBF"; break;
+            case TextEncoding::Utf16LE: out = "\xFF\xFE"; break;
+            case TextEncoding::Utf16BE: out = "\xFE\xFF"; break;
+            case TextEncoding::Latin1: break;
+        }
+    }
+
+    std::string newline;
+    encodeText(format.lineEnding == LineEnding::CRLF ? "\r\n" : "\n", format.encoding, newline);
+
+    bool ok = true;
+    int count = buffer.lineCount();
+    for (int i = 0; i < count && ok; i++) {
+        encodeText(buffer.line(i), format.encoding, out);
+        if (i + 1 < count || format.finalNewline) out += newline;
+        if (out.size() >= BLOCK_SIZE) {
+            ok = writeAll(fd, out);
+            out.clear();
+        }
+    }
+    if (ok) ok = writeAll(fd, out);
+    if (close(fd) != 0) ok = false;
+    return ok;
+}
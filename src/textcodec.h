@@ -0,0 +1,68 @@
+#ifndef TEXTCODEC_H
+#define TEXTCODEC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+
+// Buffers always hold UTF-8. Files are read and written through these
+// helpers, which work in fixed-size blocks: a file is never held in memory
+// as a whole next to its lines, only one block at a time.
+
+enum class TextEncoding { Utf8, Utf16LE, Utf16BE, Latin1 };
+enum class LineEnding { LF, CRLF };
+
+// How a file was stored, so it can be written back the same way
+struct FileFormat {
+    TextEncoding encoding = TextEncoding::Utf8;
+    bool byteOrderMark = false;
+    LineEnding lineEnding = LineEnding::LF;
+    bool finalNewline = true;
+};
+
+// Guesses the format from the first block of a file: a byte order mark if
+// there is one, then UTF-16 by where its zero bytes fall, then UTF-8 if the
+// block is well-formed, else Latin-1. atEnd says the block is the whole
+// file, so a sequence cut off at its end is an error rather than the block
+// boundary.
+FileFormat detectFormat(std::string_view head, bool atEnd);
+
+// Short label for status bars, empty for plain UTF-8 with LF
+std::string formatDescription(const FileFormat &format);
+
+// Turns encoded bytes into UTF-8 lines in an arena a block at a time. Sequences split
+// between blocks are carried over; bytes that cannot be decoded become
+// U+FFFD. With CRLF line endings the \r before each \n is dropped.
+class TextDecoder {
+public:
+    explicit TextDecoder(const FileFormat &format);
+
+    // Appends the lines completed by bytes
+    void feed(std::string_view bytes, LineArena &lines);
+    // Ends the input; appends the unfinished last line (or an empty one if
+    // nothing was read)
+    void finish(LineArena &lines);
+    bool endedWithNewline() const { return lastWasNewline; }
+
+private:
+    void splitInto(std::string_view text, LineArena &lines);
+    size_t decodeUtf16(const unsigned char *data, size_t size, std::string &out) const;
+
+    TextEncoding encoding;
+    bool stripCR;
+    std::string pending;   // UTF-16 bytes of a unit or pair split across blocks
+    std::string current;   // the line being read
+    std::string decoded;   // scratch for one block
+    bool lastWasNewline;
+    bool anyLines;
+};
+
+// Reads a whole file into lines and reports how it was stored
+bool readTextFile(const std::string &path, LineArena &lines, FileFormat &format);
+
+// Writes the buffer in format. Text that Latin-1 cannot hold is written as
+// UTF-8 instead and format is updated to say so.
+bool writeTextFile(const std::string &path, const TextBuffer &buffer, FileFormat &format);
+
+#endif // TEXTCODEC_H
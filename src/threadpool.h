@@ -0,0 +1,52 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker owns a deque: tasks submitted from
+// a worker go to the back of its own deque and are popped LIFO, idle workers
+// steal from the front of the others. Tasks submitted from outside the pool
+// are spread round-robin.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task, including ones they spawned, is done
+    void wait();
+
+    int threadCount() const { return (int)workers.size(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(int index);
+    bool popTask(int index, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::atomic<long> pending;   // submitted but not finished
+    std::atomic<long> queued;    // sitting in a deque
+    std::atomic<unsigned> nextQueue;
+    bool stopping;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,92 @@
+#include "traceevents.h"
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unistd.h>
+
+std::atomic<bool> traceEventsOn(false);
+
+static std::mutex traceMutex;
+static FILE *traceFile = nullptr;
+static std::string pendingEvents;   // written out a megabyte at a time
+static bool firstEvent = true;
+static std::chrono::steady_clock::time_point traceStart;
+
+static std::atomic<int> nextThreadId(1);
+static thread_local int threadId = 0;
+static thread_local const char *threadName = nullptr;
+static thread_local bool threadNamed = false;
+
+static double microsSinceStart(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration<double, std::micro>(time - traceStart).count();
+}
+
+// Caller holds traceMutex
+static void appendEvent(const char *event) {
+    if (!traceFile) return;
+    if (!firstEvent) pendingEvents += ",\n";
+    pendingEvents += event;
+    firstEvent = false;
+    if (pendingEvents.size() >= (1 << 20)) {
+        fwrite(pendingEvents.data(), 1, pendingEvents.size(), traceFile);
+        pendingEvents.clear();
+    }
+}
+
+bool startTraceEvents(const std::string &path) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (traceFile) return true;
+    traceFile = fopen(path.c_str(), "w");
+    if (!traceFile) return false;
+    fputs("[\n", traceFile);
+    traceStart = std::chrono::steady_clock::now();
+    firstEvent = true;
+    static bool stopAtExit = false;
+    if (!stopAtExit) atexit(stopTraceEvents);
+    stopAtExit = true;
+    traceEventsOn = true;
+    return true;
+}
+
+void startTraceEventsFromEnvironment() {
+    const char *path = getenv("LEDITOR_TRACE_EVENTS");
+    if (path && *path) startTraceEvents(path);
+}
+
+void stopTraceEvents() {
+    traceEventsOn = false;
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceFile) return;
+    fwrite(pendingEvents.data(), 1, pendingEvents.size(), traceFile);
+    pendingEvents.clear();
+    fputs("\n]\n", traceFile);
+    fclose(traceFile);
+    traceFile = nullptr;
+}
+
+void setTraceThreadName(const char *name) {
+    threadName = name;
+    threadNamed = false;
+}
+
+void TraceScope::finish() {
+    auto end = std::chrono::steady_clock::now();
+    if (threadId == 0) threadId = nextThreadId++;
+
+    char event[256];
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!threadNamed) {
+        // Metadata event naming the thread's track
+        char label[64];
+        if (!threadName) snprintf(label, sizeof(label), "thread %d", threadId);
+        snprintf(event, sizeof(event),
+                 "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 (int)getpid(), threadId, threadName ? threadName : label);
+        appendEvent(event);
+        threadNamed = true;
+    }
+    snprintf(event, sizeof(event),
+             "{\"name\":\"%s\",\"cat\":\"leditor\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}", name,
+             microsSinceStart(start), microsSinceStart(end) - microsSinceStart(start), (int)getpid(), threadId);
+    appendEvent(event);
+}
@@ -0,0 +1,57 @@
+#ifndef TRACEEVENTS_H
+#define TRACEEVENTS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Timeline of a session as Chrome trace events (JSON; open it in
+// chrome://tracing or ui.perfetto.dev). Hot paths and worker jobs are
+// wrapped in TRACE_SCOPE probes. Building with -DLEDITOR_TRACING=0 compiles
+// them away; otherwise a probe costs one relaxed atomic load while tracing
+// is off.
+
+#ifndef LEDITOR_TRACING
+#define LEDITOR_TRACING 1
+#endif
+
+extern std::atomic<bool> traceEventsOn;
+
+// Writes events to path from now until stopTraceEvents() or exit
+bool startTraceEvents(const std::string &path);
+// Starts tracing when LEDITOR_TRACE_EVENTS names a file
+void startTraceEventsFromEnvironment();
+void stopTraceEvents();
+// How the calling thread is labelled in the trace; name must outlive it
+void setTraceThreadName(const char *name);
+
+// One complete event from construction to destruction
+class TraceScope {
+public:
+    explicit TraceScope(const char *eventName)
+        : name(traceEventsOn.load(std::memory_order_relaxed) ? eventName : nullptr) {
+        if (name) start = std::chrono::steady_clock::now();
+    }
+    ~TraceScope() {
+        if (name) finish();
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    void finish();
+
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#if LEDITOR_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#endif
+
+#endif // TRACEEVENTS_H
@@ -0,0 +1,335 @@
+#include "trigramindex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint64_t MAX_INDEXED_SIZE = 8 * 1024 * 1024;
+static const size_t BINARY_PROBE_SIZE = 8192;
+static const char FILE_MAGIC[8] = {'L', 'E', 'D', 'T', 'R', 'I', '0', '1'};
+
+static unsigned char foldTable[256];
+
+static const unsigned char *fold() {
+    static bool initialized = [] {
+        for (int c = 0; c < 256; c++) {
+            foldTable[c] = (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : (unsigned char)c;
+        }
+        return true;
+    }();
+    (void)initialized;
+    return foldTable;
+}
+
+static int64_t modifiedTime(const struct stat &st) {
+#ifdef __APPLE__
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+TrigramIndex::TrigramIndex() {
+}
+
+bool TrigramIndex::fileStamp(const std::string &absolutePath, uint64_t &size, int64_t &mtime) {
+    struct stat st;
+    if (stat(absolutePath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    size = st.st_size;
+    mtime = modifiedTime(st);
+    return true;
+}
+
+bool TrigramIndex::extract(const std::string &absolutePath, std::vector<uint32_t> &trigrams,
+                           uint64_t &size, int64_t &mtime) {
+    trigrams.clear();
+
+    int fd = open(absolutePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > MAX_INDEXED_SIZE) {
+        close(fd);
+        return false;
+    }
+    size = st.st_size;
+    mtime = modifiedTime(st);
+    if (size < 3) {
+        close(fd);
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const unsigned char *data = (const unsigned char *)mapping;
+    if (!memchr(data, 0, std::min<size_t>(size, BINARY_PROBE_SIZE))) {
+        // One bit per possible trigram; only the bits set here are cleared
+        thread_local std::vector<uint64_t> seen(1 << 18);
+        const unsigned char *table = fold();
+
+        uint32_t key = (table[data[0]] << 8) | table[data[1]];
+        for (size_t i = 2; i < size; i++) {
+            key = ((key << 8) | table[data[i]]) & 0xffffff;
+            uint64_t bit = 1ULL << (key & 63);
+            if (!(seen[key >> 6] & bit)) {
+                seen[key >> 6] |= bit;
+                trigrams.push_back(key);
+            }
+        }
+        for (uint32_t t : trigrams) {
+            seen[t >> 6] = 0;
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+    }
+
+    munmap(mapping, size);
+    return true;
+}
+
+void TrigramIndex::addFile(const std::string &relativePath, const std::vector<uint32_t> &trigrams,
+                           uint64_t size, int64_t mtime) {
+    removeFile(relativePath);
+
+    uint32_t id = (uint32_t)fileInfos.size();
+    fileInfos.push_back({relativePath, size, mtime, true});
+    fileIds[relativePath] = id;
+    for (uint32_t t : trigrams) {
+        postings[t].push_back(id);
+    }
+}
+
+void TrigramIndex::removeFile(const std::string &relativePath) {
+    auto it = fileIds.find(relativePath);
+    if (it == fileIds.end()) return;
+    fileInfos[it->second].alive = false;
+    fileIds.erase(it);
+}
+
+void TrigramIndex::removePrefix(const std::string &dir) {
+    std::string prefix = dir + "/";
+    for (auto it = fileIds.begin(); it != fileIds.end(); ) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            fileInfos[it->second].alive = false;
+            it = fileIds.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool TrigramIndex::isCurrent(const std::string &relativePath, uint64_t size, int64_t mtime) const {
+    auto it = fileIds.find(relativePath);
+    if (it == fileIds.end()) return false;
+    const FileInfo &info = fileInfos[it->second];
+    return info.size == size && info.mtime == mtime;
+}
+
+std::vector<std::string> TrigramIndex::files() const {
+    std::vector<std::string> result;
+    result.reserve(fileIds.size());
+    for (const auto &entry : fileIds) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+bool TrigramIndex::candidates(const std::string &query, std::vector<std::string> &paths) const {
+    if (query.size() < 3) return false;
+
+    const unsigned char *table = fold();
+    std::vector<uint32_t> keys;
+    for (size_t i = 0; i + 2 < query.size(); i++) {
+        keys.push_back((table[(unsigned char)query[i]] << 16) | (table[(unsigned char)query[i + 1]] << 8)
+                       | table[(unsigned char)query[i + 2]]);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (uint32_t key : keys) {
+        auto it = postings.find(key);
+        if (it == postings.end()) return true;
+        lists.push_back(&it->second);
+    }
+
+    // Intersect starting from the shortest list
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+        return a->size() < b->size();
+    });
+    std::vector<uint32_t> result = *lists[0];
+    std::vector<uint32_t> next;
+    for (size_t i = 1; i < lists.size() && !result.empty(); i++) {
+        next.clear();
+        std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(next));
+        result.swap(next);
+    }
+
+    for (uint32_t id : result) {
+        if (fileInfos[id].alive) paths.push_back(fileInfos[id].path);
+    }
+    return true;
+}
+
+void TrigramIndex::clear() {
+    fileInfos.clear();
+    fileIds.clear();
+    postings.clear();
+}
+
+static void writeU32(std::string &out, uint32_t value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+static void writeU64(std::string &out, uint64_t value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+static void writeVarint(std::string &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+bool TrigramIndex::save(const std::string &path) const {
+    // Dead files are dropped and live ones renumbered densely
+    std::vector<uint32_t> remap(fileInfos.size(), UINT32_MAX);
+    std::string out(FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeU32(out, (uint32_t)fileIds.size());
+    uint32_t next = 0;
+    for (uint32_t id = 0; id < fileInfos.size(); id++) {
+        const FileInfo &info = fileInfos[id];
+        if (!info.alive) continue;
+        remap[id] = next++;
+        writeU32(out, (uint32_t)info.path.size());
+        out += info.path;
+        writeU64(out, info.size);
+        writeU64(out, (uint64_t)info.mtime);
+    }
+
+    std::string lists;
+    uint32_t listCount = 0;
+    std::vector<uint32_t> ids;
+    for (const auto &entry : postings) {
+        ids.clear();
+        for (uint32_t id : entry.second) {
+            if (remap[id] != UINT32_MAX) ids.push_back(remap[id]);
+        }
+        if (ids.empty()) continue;
+
+        listCount++;
+        writeU32(lists, entry.first);
+        writeU32(lists, (uint32_t)ids.size());
+        uint32_t previous = 0;
+        for (uint32_t id : ids) {
+            writeVarint(lists, id - previous);
+            previous = id;
+        }
+    }
+    writeU32(out, listCount);
+    out += lists;
+
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(out.data(), out.size());
+        if (!file) return false;
+    }
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+namespace {
+struct Reader {
+    const char *pos;
+    const char *end;
+
+    bool u32(uint32_t &value) {
+        if (end - pos < 4) return false;
+        memcpy(&value, pos, 4);
+        pos += 4;
+        return true;
+    }
+    bool u64(uint64_t &value) {
+        if (end - pos < 8) return false;
+        memcpy(&value, pos, 8);
+        pos += 8;
+        return true;
+    }
+    bool varint(uint32_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (pos >= end) return false;
+            unsigned char byte = (unsigned char)*pos++;
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+};
+}
+
+bool TrigramIndex::load(const std::string &path) {
+    clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(FILE_MAGIC) || memcmp(data.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        return false;
+    }
+
+    Reader in = {data.data() + sizeof(FILE_MAGIC), data.data() + data.size()};
+    uint32_t fileCount;
+    if (!in.u32(fileCount)) return false;
+    for (uint32_t id = 0; id < fileCount; id++) {
+        uint32_t length;
+        uint64_t size, mtime;
+        if (!in.u32(length) || (size_t)(in.end - in.pos) < length) {
+            clear();
+            return false;
+        }
+        std::string relative(in.pos, length);
+        in.pos += length;
+        if (!in.u64(size) || !in.u64(mtime)) {
+            clear();
+            return false;
+        }
+        fileIds[relative] = id;
+        fileInfos.push_back({std::move(relative), size, (int64_t)mtime, true});
+    }
+
+    uint32_t listCount;
+    if (!in.u32(listCount)) {
+        clear();
+        return false;
+    }
+    for (uint32_t i = 0; i < listCount; i++) {
+        uint32_t key, count;
+        if (!in.u32(key) || !in.u32(count)) {
+            clear();
+            return false;
+        }
+        std::vector<uint32_t> &list = postings[key];
+        uint32_t id = 0;
+        for (uint32_t j = 0; j < count; j++) {
+            uint32_t delta;
+            if (!in.varint(delta) || (id += delta) >= fileCount) {
+                clear();
+                return false;
+            }
+            list.push_back(id);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Content index mapping every case-folded trigram to the sorted list of files
+// containing it. A literal query can then only match in files that contain
+// all of its trigrams. Re-indexing a file gives it a new id and leaves the old
+// one dead, so posting lists stay sorted by construction; dead ids are dropped
+// on save. Not thread-safe; callers serialize access.
+class TrigramIndex {
+public:
+    TrigramIndex();
+
+    // Reads a file and returns its sorted trigram set. Binary files yield an
+    // empty set; false means the file could not be read or is too large to
+    // index. Thread-safe.
+    static bool extract(const std::string &absolutePath, std::vector<uint32_t> &trigrams,
+                        uint64_t &size, int64_t &mtime);
+    static bool fileStamp(const std::string &absolutePath, uint64_t &size, int64_t &mtime);
+
+    void addFile(const std::string &relativePath, const std::vector<uint32_t> &trigrams,
+                 uint64_t size, int64_t mtime);
+    void removeFile(const std::string &relativePath);
+    void removePrefix(const std::string &dir);
+    bool isCurrent(const std::string &relativePath, uint64_t size, int64_t mtime) const;
+    std::vector<std::string> files() const;
+    size_t fileCount() const { return fileIds.size(); }
+
+    // Indexed files that may contain query (compared case-insensitively).
+    // Returns false when the query is too short to prune anything.
+    bool candidates(const std::string &query, std::vector<std::string> &paths) const;
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+    void clear();
+
+private:
+    struct FileInfo {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+        bool alive;
+    };
+
+    std::vector<FileInfo> fileInfos;
+    std::unordered_map<std::string, uint32_t> fileIds;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+};
+
+#endif // TRIGRAMINDEX_H
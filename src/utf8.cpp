@@ -0,0 +1,258 @@
+#include "utf8.h"
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static const uint32_t REPLACEMENT = 0xFFFD;
+static const uint32_t ZERO_WIDTH_JOINER = 0x200D;
+
+struct Range {
+    uint32_t first;
+    uint32_t last;
+};
+
+// Marks that attach to the character before them (Grapheme_Cluster_Break
+// Extend and SpacingMark for the common scripts)
+static const Range extendRanges[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2},
+    {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0670, 0x0670},
+    {0x06D6, 0x06DC}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0900, 0x0903},
+    {0x093A, 0x093C}, {0x093E, 0x094F}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0983},
+    {0x09BC, 0x09BC}, {0x09BE, 0x09CD}, {0x09D7, 0x09D7}, {0x0A01, 0x0A03}, {0x0A3C, 0x0A51},
+    {0x0A81, 0x0A83}, {0x0ABC, 0x0ABC}, {0x0ABE, 0x0ACD}, {0x0B01, 0x0B03}, {0x0B3C, 0x0B57},
+    {0x0BBE, 0x0BCD}, {0x0C00, 0x0C04}, {0x0C3E, 0x0C56}, {0x0C81, 0x0C83}, {0x0CBC, 0x0CD6},
+    {0x0D00, 0x0D03}, {0x0D3B, 0x0D4D}, {0x0D57, 0x0D57}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A},
+    {0x0E47, 0x0E4E}, {0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC}, {0x0EC8, 0x0ECD}, {0x0F71, 0x0F84},
+    {0x102B, 0x103E}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200C, 0x200C}, {0x20D0, 0x20FF},
+    {0x302A, 0x302F}, {0x3099, 0x309A}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFF9E, 0xFF9F},
+    {0x1F3FB, 0x1F3FF}, {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+// Characters two columns wide (East_Asian_Width W and F, emoji presentation)
+static const Range wideRanges[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC}, {0x23F0, 0x23F0},
+    {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267F, 0x267F},
+    {0x2693, 0x2693}, {0x26A1, 0x26A1}, {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F5}, {0x26FA, 0x26FD},
+    {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728}, {0x274C, 0x274C}, {0x2753, 0x2755},
+    {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF},
+    {0x4E00, 0x9FFF}, {0xA000, 0xA4CF}, {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF},
+    {0xFE10, 0xFE19}, {0xFE30, 0xFE6F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x18AFF},
+    {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E},
+    {0x1F191, 0x1F19A}, {0x1F1E6, 0x1F1FF}, {0x1F200, 0x1F251}, {0x1F300, 0x1F320}, {0x1F32D, 0x1F335},
+    {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393}, {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3},
+    {0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E}, {0x1F440, 0x1F440},
+    {0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E}, {0x1F550, 0x1F567},
+    {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596}, {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F},
+    {0x1F680, 0x1F6C5}, {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7},
+    {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F93A},
+    {0x1F93C, 0x1F945}, {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD},
+    {0x30000, 0x3FFFD},
+};
+
+template <size_t N>
+static bool inRanges(const Range (&ranges)[N], uint32_t codepoint) {
+    size_t low = 0, high = N;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (ranges[middle].last < codepoint) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < N && ranges[low].first <= codepoint;
+}
+
+static bool isExtend(uint32_t codepoint) {
+    return codepoint >= 0x0300 && (codepoint == ZERO_WIDTH_JOINER || inRanges(extendRanges, codepoint));
+}
+
+static bool isRegionalIndicator(uint32_t codepoint) {
+    return codepoint >= 0x1F1E6 && codepoint <= 0x1F1FF;
+}
+
+// Length of the ASCII prefix of [data + offset, data + size), 16 bytes at a time
+static size_t skipAscii(const unsigned char *data, size_t offset, size_t size) {
+#if defined(__SSE2__)
+    for (; offset + 16 <= size; offset += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(data + offset)));
+        if (mask) return offset + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    for (; offset + 16 <= size; offset += 16) {
+        uint8x16_t set = vtstq_u8(vld1q_u8(data + offset), high);
+        // Narrow to 4 bits per byte to get a scalar mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(set), 4)), 0);
+        if (mask) return offset + (__builtin_ctzll(mask) >> 2);
+    }
+#endif
+    while (offset < size && data[offset] < 0x80) offset++;
+    return offset;
+}
+
+bool isAsciiText(std::string_view text) {
+    return skipAscii((const unsigned char *)text.data(), 0, text.size()) == text.size();
+}
+
+size_t asciiPrefix(std::string_view text) {
+    return skipAscii((const unsigned char *)text.data(), 0, text.size());
+}
+
+// Length of the well-formed sequence at offset, or 0
+static size_t sequenceLength(const unsigned char *data, size_t offset, size_t size) {
+    unsigned char lead = data[offset];
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;   // allowed range of the second byte
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) low = 0xA0;        // overlong
+        if (lead == 0xED) high = 0x9F;       // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) low = 0x90;        // overlong
+        if (lead == 0xF4) high = 0x8F;       // past U+10FFFF
+    } else {
+        return 0;
+    }
+    if (size - offset < length) return 0;
+    if (data[offset + 1] < low || data[offset + 1] > high) return 0;
+    for (size_t i = 2; i < length; i++) {
+        if ((data[offset + i] & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+bool isValidUtf8(std::string_view text) {
+    const unsigned char *data = (const unsigned char *)text.data();
+    size_t size = text.size();
+    size_t offset = 0;
+    while ((offset = skipAscii(data, offset, size)) < size) {
+        size_t length = sequenceLength(data, offset, size);
+        if (length == 0) return false;
+        offset += length;
+    }
+    return true;
+}
+
+uint32_t decodeUtf8(std::string_view text, size_t offset, size_t &length) {
+    const unsigned char *data = (const unsigned char *)text.data();
+    length = sequenceLength(data, offset, text.size());
+    switch (length) {
+        case 1: return data[offset];
+        case 2: return ((data[offset] & 0x1F) << 6) | (data[offset + 1] & 0x3F);
+        case 3: return ((data[offset] & 0x0F) << 12) | ((data[offset + 1] & 0x3F) << 6) | (data[offset + 2] & 0x3F);
+        case 4:
+            return ((data[offset] & 0x07) << 18) | ((data[offset + 1] & 0x3F) << 12) |
+                   ((data[offset + 2] & 0x3F) << 6) | (data[offset + 3] & 0x3F);
+    }
+    length = 1;
+    return REPLACEMENT;
+}
+
+size_t nextGraphemeBoundary(std::string_view text, size_t offset) {
+    if (offset >= text.size()) return text.size();
+    size_t length;
+    uint32_t codepoint = decodeUtf8(text, offset, length);
+    offset += length;
+    if (codepoint < 0x80 && codepoint != '\r' && (offset >= text.size() || (unsigned char)text[offset] < 0x80)) {
+        return offset;   // ASCII followed by ASCII: nothing can attach
+    }
+
+    bool invalid = codepoint == REPLACEMENT && length == 1;
+    bool pairedIndicator = false;
+    while (!invalid && offset < text.size()) {
+        uint32_t next = decodeUtf8(text, offset, length);
+        bool attaches = isExtend(next)
+            || (codepoint == '\r' && next == '\n')
+            || (codepoint == ZERO_WIDTH_JOINER && next >= 0x2000)   // emoji ZWJ sequence
+            || (isRegionalIndicator(codepoint) && isRegionalIndicator(next) && !pairedIndicator);
+        if (!attaches || (next == REPLACEMENT && length == 1)) break;
+        pairedIndicator = isRegionalIndicator(next);
+        codepoint = next;
+        offset += length;
+    }
+    return offset;
+}
+
+// Start of the code point (or invalid byte) ending at offset
+static size_t previousCodepoint(std::string_view text, size_t offset) {
+    size_t start = offset - 1;
+    while (start > 0 && offset - start < 4 && ((unsigned char)text[start] & 0xC0) == 0x80) start--;
+    size_t length;
+    decodeUtf8(text, start, length);
+    return start + length == offset ? start : offset - 1;
+}
+
+size_t previousGraphemeBoundary(std::string_view text, size_t offset) {
+    if (offset == 0) return 0;
+    offset = std::min(offset, text.size());
+
+    // Back up to a code point that cannot continue an earlier cluster, then
+    // walk forward; runs of flag halves are walked from their first one
+    size_t start = previousCodepoint(text, offset);
+    for (size_t lead = offset - 1; lead + 4 > offset; lead--) {
+        // offset may be inside a code point, which then is the one to start from
+        if (((unsigned char)text[lead] & 0xC0) != 0x80) {
+            size_t length;
+            decodeUtf8(text, lead, length);
+            if (lead + length > offset) start = lead;
+            break;
+        }
+        if (lead == 0) break;
+    }
+    while (start > 0) {
+        size_t length;
+        uint32_t codepoint = decodeUtf8(text, start, length);
+        size_t before = previousCodepoint(text, start);
+        uint32_t previous = decodeUtf8(text, before, length);
+        bool continues = isExtend(codepoint) || previous == ZERO_WIDTH_JOINER ||
+                         (isRegionalIndicator(codepoint) && isRegionalIndicator(previous)) ||
+                         (codepoint == '\n' && previous == '\r');
+        if (!continues) break;
+        start = before;
+    }
+
+    size_t boundary = start;
+    while (true) {
+        size_t next = nextGraphemeBoundary(text, boundary);
+        if (next >= offset) return boundary;
+        boundary = next;
+    }
+}
+
+int codepointWidth(uint32_t codepoint) {
+    if (codepoint < 0x300) return 1;
+    if (isExtend(codepoint)) return 0;
+    if (codepoint >= 0x1100 && inRanges(wideRanges, codepoint)) return 2;
+    return 1;
+}
+
+int graphemeWidth(std::string_view text, size_t start, size_t end) {
+    if (end <= start) return 0;
+    if ((unsigned char)text[start] < 0x80) return 1;
+    size_t length;
+    int width = codepointWidth(decodeUtf8(text, start, length));
+    return width > 0 ? width : 1;
+}
+
+int displayWidth(std::string_view text) {
+    if (isAsciiText(text)) return (int)text.size();
+    int width = 0;
+    for (size_t offset = 0; offset < text.size();) {
+        size_t next = nextGraphemeBoundary(text, offset);
+        width += graphemeWidth(text, offset, next);
+        offset = next;
+    }
+    return width;
+}
@@ -0,0 +1,38 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Text is kept as UTF-8 bytes and positions are byte offsets. These helpers
+// find where characters and grapheme clusters (what the user sees as one
+// character: a base letter with its accents, an emoji sequence, a flag)
+// begin and how many terminal columns they take. Invalid bytes are treated
+// as one-column characters of their own so nothing is lost or skipped.
+
+// True if text has no byte >= 0x80; checked 16 bytes at a time
+bool isAsciiText(std::string_view text);
+// Length of the leading run of ASCII bytes, found the same way
+size_t asciiPrefix(std::string_view text);
+// True if text is well-formed UTF-8 (no overlongs, surrogates or values past
+// U+10FFFF). ASCII runs are skipped 16 bytes at a time.
+bool isValidUtf8(std::string_view text);
+
+// Code point at offset and its length in bytes (1 for an invalid byte,
+// which decodes as U+FFFD)
+uint32_t decodeUtf8(std::string_view text, size_t offset, size_t &length);
+
+// Offset of the next / previous grapheme cluster boundary
+size_t nextGraphemeBoundary(std::string_view text, size_t offset);
+size_t previousGraphemeBoundary(std::string_view text, size_t offset);
+
+// Columns a code point takes on a terminal: 0 for combining marks, 2 for
+// East Asian wide characters and emoji, otherwise 1
+int codepointWidth(uint32_t codepoint);
+// Columns of the cluster in [start, end); never 0
+int graphemeWidth(std::string_view text, size_t start, size_t end);
+// Columns of a whole string
+int displayWidth(std::string_view text);
+
+#endif // UTF8_H
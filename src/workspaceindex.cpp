@@ -0,0 +1,290 @@
+#include "workspaceindex.h"
+#include "traceevents.h"
+#include "threadpool.h"
+#include "workspacewalker.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+WorkspaceIndex::WorkspaceIndex(const std::string &rootPath, bool contents, ChangeCallback onChanged)
+    : root(rootPath)
+    , indexContents(contents)
+    , changeCallback(std::move(onChanged))
+    , contentsDirty(false)
+    , cancelled(false)
+    , pathsReady(false)
+    , contentsReady(false)
+    , rescanNeeded(false)
+{
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    watcher.reset(new FileWatcher([this](const std::vector<FileEvent> &events) { onFileEvents(events); }));
+    builder = std::thread(&WorkspaceIndex::build, this);
+}
+
+WorkspaceIndex::~WorkspaceIndex() {
+    cancelled = true;
+    watcher.reset();
+    if (builder.joinable()) {
+        builder.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (contentsReady && contentsDirty) {
+        trigrams.save(cachePath());
+    }
+}
+
+size_t WorkspaceIndex::pathCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return paths.size();
+}
+
+std::string WorkspaceIndex::cachePath() const {
+    std::string dir;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg) {
+        dir = xdg;
+    } else if (home && *home) {
+        dir = std::string(home) + "/.cache";
+    } else {
+        dir = "/tmp";
+    }
+    mkdir(dir.c_str(), 0755);
+    dir += "/leditor";
+    mkdir(dir.c_str(), 0755);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/trigrams-%016zx.idx", std::hash<std::string>()(root));
+    return dir + name;
+}
+
+void WorkspaceIndex::notifyChanged() {
+    if (changeCallback && !cancelled) {
+        changeCallback();
+    }
+}
+
+void WorkspaceIndex::walk(const std::string &relative, std::shared_ptr<const IgnoreRules> rules,
+                          std::vector<std::string> &found) {
+    ThreadPool pool;
+    WorkspaceWalker walker(root, pool, cancelled);
+    walker.setDirectoryCallback([this, &walker](const std::string &dir,
+                                                const std::shared_ptr<const IgnoreRules> &dirRules) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            directoryRules[dir] = dirRules;
+        }
+        if (watcher) {
+            watcher->addWatch(walker.absolutePath(dir));
+        }
+    });
+    walker.setFileCallback([this, &found](const std::string &file) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.add(file);
+        found.push_back(file);
+        if (indexContents) {
+            unindexed.insert(file);
+        }
+    });
+    walker.start(relative, rules);
+    pool.wait();
+}
+
+void WorkspaceIndex::build() {
+    setTraceThreadName("workspace index");
+    TRACE_SCOPE("WorkspaceIndex build");
+    if (indexContents) {
+        TrigramIndex loaded;
+        loaded.load(cachePath());
+        std::lock_guard<std::mutex> lock(mutex);
+        trigrams = std::move(loaded);
+    }
+
+    std::vector<std::string> found;
+    walk("", nullptr, found);
+    if (cancelled) return;
+    pathsReady = true;
+    notifyChanged();
+
+    if (!indexContents) return;
+
+    // Keep what the saved index still has right and re-read the rest
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string &file : trigrams.files()) {
+            if (!paths.contains(file)) trigrams.removeFile(file);
+        }
+    }
+
+    ThreadPool pool;
+    for (const std::string &file : found) {
+        pool.submit([this, file] {
+            if (cancelled) return;
+            TRACE_SCOPE("index file");
+            uint64_t size;
+            int64_t mtime;
+            if (TrigramIndex::fileStamp(root + "/" + file, size, mtime)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (trigrams.isCurrent(file, size, mtime)) {
+                    unindexed.erase(file);
+                    return;
+                }
+            }
+            reindexFile(file);
+        });
+    }
+    pool.wait();
+    if (cancelled) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        trigrams.save(cachePath());
+        contentsDirty = false;
+    }
+    contentsReady = true;
+    notifyChanged();
+}
+
+void WorkspaceIndex::reindexFile(const std::string &relative) {
+    std::vector<uint32_t> fileTrigrams;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool indexed = TrigramIndex::extract(root + "/" + relative, fileTrigrams, size, mtime);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!paths.contains(relative)) return;
+
+    if (indexed) {
+        trigrams.addFile(relative, fileTrigrams, size, mtime);
+        unindexed.erase(relative);
+    } else {
+        // Too large or unreadable: always searched
+        trigrams.removeFile(relative);
+        unindexed.insert(relative);
+    }
+    contentsDirty = true;
+}
+
+bool WorkspaceIndex::isIgnored(const std::string &relative, bool isDir) const {
+    size_t slash = relative.rfind('/');
+    std::string parent = (slash == std::string::npos) ? "" : relative.substr(0, slash);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = directoryRules.find(parent);
+    // Directories that were never walked are ignored ones
+    if (it == directoryRules.end()) return true;
+    return it->second->isIgnored(relative, isDir);
+}
+
+void WorkspaceIndex::onFileEvents(const std::vector<FileEvent> &events) {
+    bool changed = false;
+    std::string prefix = root + "/";
+
+    for (const FileEvent &event : events) {
+        if (cancelled) return;
+        if (event.type == FileEvent::Overflow) {
+            rescanNeeded = true;
+            continue;
+        }
+        if (event.path.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string relative = event.path.substr(prefix.size());
+
+        if (event.type == FileEvent::Deleted) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string below = relative + "/";
+            paths.remove(relative);
+            trigrams.removeFile(relative);
+            unindexed.erase(relative);
+            if (event.isDirectory) {
+                paths.removePrefix(relative);
+                trigrams.removePrefix(relative);
+                for (auto it = unindexed.begin(); it != unindexed.end(); ) {
+                    it = it->compare(0, below.size(), below) == 0 ? unindexed.erase(it) : std::next(it);
+                }
+                for (auto it = directoryRules.begin(); it != directoryRules.end(); ) {
+                    bool inside = it->first == relative || it->first.compare(0, below.size(), below) == 0;
+                    it = inside ? directoryRules.erase(it) : std::next(it);
+                }
+            }
+            contentsDirty = true;
+            changed = true;
+        } else if (event.isDirectory) {
+            if (event.type != FileEvent::Created || isIgnored(relative, true)) continue;
+
+            std::shared_ptr<const IgnoreRules> rules;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t slash = relative.rfind('/');
+                rules = directoryRules[slash == std::string::npos ? "" : relative.substr(0, slash)];
+            }
+            std::vector<std::string> found;
+            walk(relative, rules, found);
+            if (indexContents) {
+                for (const std::string &file : found) reindexFile(file);
+            }
+            changed = true;
+        } else if (!isIgnored(relative, false)) {
+            // .gitignore edits take effect on the next full scan
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                paths.add(relative);
+            }
+            if (indexContents) {
+                reindexFile(relative);
+            }
+            changed = true;
+        }
+    }
+
+    if (rescanNeeded.exchange(false)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            paths.clear();
+        }
+        std::vector<std::string> found;
+        walk("", nullptr, found);
+        if (indexContents) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const std::string &file : trigrams.files()) {
+                    if (!paths.contains(file)) trigrams.removeFile(file);
+                }
+            }
+            for (const std::string &file : found) {
+                uint64_t size;
+                int64_t mtime;
+                bool current = false;
+                if (TrigramIndex::fileStamp(root + "/" + file, size, mtime)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    current = trigrams.isCurrent(file, size, mtime);
+                    if (current) unindexed.erase(file);
+                }
+                if (!current) reindexFile(file);
+            }
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        notifyChanged();
+    }
+}
+
+std::vector<FileMatch> WorkspaceIndex::findFiles(const std::string &query, size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<FileMatch> results;
+    for (const PathMatch &match : paths.find(query, limit)) {
+        results.push_back({std::string(paths.path(match.id)), match.score});
+    }
+    return results;
+}
+
+bool WorkspaceIndex::contentCandidates(const std::string &query, std::vector<std::string> &relativePaths) {
+    if (!indexContents || !contentsReady) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!trigrams.candidates(query, relativePaths)) return false;
+    relativePaths.insert(relativePaths.end(), unindexed.begin(), unindexed.end());
+    return true;
+}
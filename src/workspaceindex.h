@@ -0,0 +1,80 @@
+#ifndef WORKSPACEINDEX_H
+#define WORKSPACEINDEX_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "filewatcher.h"
+#include "ignorerules.h"
+#include "pathindex.h"
+#include "trigramindex.h"
+
+struct FileMatch {
+    std::string relativePath;
+    int score;
+};
+
+// Background index of one workspace: every non-ignored path for fuzzy
+// quick-open and, optionally, a trigram index of file contents that is saved
+// under the user cache directory between runs. Both are built on a thread
+// pool after construction and kept fresh from inotify events. Queries are
+// safe from any thread; the change callback runs on a worker thread.
+class WorkspaceIndex {
+public:
+    using ChangeCallback = std::function<void()>;
+
+    WorkspaceIndex(const std::string &root, bool indexContents, ChangeCallback onChanged = nullptr);
+    ~WorkspaceIndex();
+
+    WorkspaceIndex(const WorkspaceIndex &) = delete;
+    WorkspaceIndex &operator=(const WorkspaceIndex &) = delete;
+
+    const std::string &rootPath() const { return root; }
+    bool isPathIndexReady() const { return pathsReady; }
+    bool isContentIndexReady() const { return contentsReady; }
+    size_t pathCount() const;
+
+    std::vector<FileMatch> findFiles(const std::string &query, size_t limit);
+
+    // Files a literal search for query has to look at: the trigram candidates
+    // plus every file not (yet) in the content index. Returns false when the
+    // index cannot prune this query and the whole tree must be searched.
+    bool contentCandidates(const std::string &query, std::vector<std::string> &relativePaths);
+
+private:
+    void build();
+    void walk(const std::string &relative, std::shared_ptr<const IgnoreRules> rules,
+              std::vector<std::string> &found);
+    void reindexFile(const std::string &relative);
+    void onFileEvents(const std::vector<FileEvent> &events);
+    bool isIgnored(const std::string &relative, bool isDir) const;
+    void notifyChanged();
+    std::string cachePath() const;
+
+    std::string root;
+    bool indexContents;
+    ChangeCallback changeCallback;
+
+    mutable std::mutex mutex;
+    PathIndex paths;
+    TrigramIndex trigrams;
+    std::unordered_set<std::string> unindexed;   // content not in trigrams
+    std::unordered_map<std::string, std::shared_ptr<const IgnoreRules>> directoryRules;
+    bool contentsDirty;
+
+    std::atomic<bool> cancelled;
+    std::atomic<bool> pathsReady;
+    std::atomic<bool> contentsReady;
+    std::atomic<bool> rescanNeeded;
+
+    std::unique_ptr<FileWatcher> watcher;
+    std::thread builder;
+};
+
+#endif // WORKSPACEINDEX_H
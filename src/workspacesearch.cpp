@@ -0,0 +1,166 @@
+#include "workspacesearch.h"
+#include "traceevents.h"
+#include "workspacewalker.h"
+#include "search.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t MAX_RESULTS = 20000;
+static const size_t MAX_MATCHES_PER_FILE = 500;
+static const size_t MAX_LINE_TEXT = 300;
+static const size_t BINARY_PROBE_SIZE = 8192;
+static const size_t BATCH_SIZE = 256;
+static const auto BATCH_INTERVAL = std::chrono::milliseconds(16);
+
+WorkspaceSearch::WorkspaceSearch(const std::string &rootPath, const std::string &text, bool matchCase,
+                                 BatchCallback batchCallback)
+    : root(rootPath)
+    , query(text)
+    , caseSensitive(matchCase)
+    , callback(std::move(batchCallback))
+    , useCandidates(false)
+    , cancelled(false)
+    , fileCount(0)
+    , matchCount(0)
+    , sentFirst(false)
+{
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    driver = std::thread(&WorkspaceSearch::run, this);
+}
+
+WorkspaceSearch::WorkspaceSearch(const std::string &rootPath, const std::string &text, bool matchCase,
+                                 std::vector<std::string> candidateFiles, BatchCallback batchCallback)
+    : root(rootPath)
+    , query(text)
+    , caseSensitive(matchCase)
+    , callback(std::move(batchCallback))
+    , useCandidates(true)
+    , candidates(std::move(candidateFiles))
+    , cancelled(false)
+    , fileCount(0)
+    , matchCount(0)
+    , sentFirst(false)
+{
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    driver = std::thread(&WorkspaceSearch::run, this);
+}
+
+WorkspaceSearch::~WorkspaceSearch() {
+    cancel();
+    if (driver.joinable()) {
+        driver.join();
+    }
+}
+
+std::string WorkspaceSearch::absolutePath(const std::string &relative) const {
+    return relative.empty() ? root : root + "/" + relative;
+}
+
+void WorkspaceSearch::run() {
+    setTraceThreadName("workspace search");
+    TRACE_SCOPE("WorkspaceSearch");
+    lastFlush = std::chrono::steady_clock::now();
+
+    if (!query.empty()) {
+        pool.reset(new ThreadPool());
+        if (useCandidates) {
+            for (const std::string &relative : candidates) {
+                pool->submit([this, relative] { searchFile(relative); });
+            }
+            pool->wait();
+        } else {
+            WorkspaceWalker walker(root, *pool, cancelled);
+            walker.setFileCallback([this](const std::string &relative) {
+                pool->submit([this, relative] { searchFile(relative); });
+            });
+            walker.start();
+            pool->wait();
+        }
+        pool.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!cancelled) {
+        callback(std::move(pendingResults), true);
+    }
+    pendingResults.clear();
+}
+
+void WorkspaceSearch::searchFile(const std::string &relative) {
+    if (cancelled || matchCount >= MAX_RESULTS) return;
+    TRACE_SCOPE("search file");
+
+    std::string path = absolutePath(relative);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    size_t size = st.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    fileCount++;
+
+    const char *data = (const char *)mapping;
+    std::string_view text(data, size);
+    std::vector<WorkspaceMatch> found;
+
+    if (!memchr(data, 0, std::min(size, BINARY_PROBE_SIZE))) {
+        // One result per matching line, like grep
+        int line = 0;
+        size_t countedTo = 0;
+        size_t pos = findText(text, query, 0, caseSensitive);
+        while (pos != std::string_view::npos && found.size() < MAX_MATCHES_PER_FILE) {
+            line += (int)std::count(data + countedTo, data + pos, '\n');
+
+            size_t lineStart = text.rfind('\n', pos);
+            lineStart = (lineStart == std::string_view::npos) ? 0 : lineStart + 1;
+            size_t lineEnd = text.find('\n', pos);
+            if (lineEnd == std::string_view::npos) lineEnd = size;
+
+            size_t textEnd = lineEnd;
+            if (textEnd > lineStart && data[textEnd - 1] == '\r') textEnd--;
+            found.push_back({path, relative, line, (int)(pos - lineStart),
+                             std::string(data + lineStart, std::min(textEnd - lineStart, MAX_LINE_TEXT))});
+
+            if (lineEnd >= size) break;
+            line++;
+            countedTo = lineEnd + 1;
+            pos = findText(text, query, lineEnd + 1, caseSensitive);
+        }
+    }
+
+    munmap(mapping, size);
+
+    if (!found.empty()) {
+        publish(found);
+    }
+}
+
+void WorkspaceSearch::publish(std::vector<WorkspaceMatch> &matches) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (cancelled) return;
+
+    matchCount += matches.size();
+    for (auto &match : matches) {
+        pendingResults.push_back(std::move(match));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!sentFirst || pendingResults.size() >= BATCH_SIZE || now - lastFlush >= BATCH_INTERVAL) {
+        callback(std::move(pendingResults), false);
+        pendingResults.clear();
+        sentFirst = true;
+        lastFlush = now;
+    }
+}
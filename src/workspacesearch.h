@@ -0,0 +1,68 @@
+#ifndef WORKSPACESEARCH_H
+#define WORKSPACESEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "threadpool.h"
+
+struct WorkspaceMatch {
+    std::string path;         // absolute
+    std::string relativePath; // relative to the workspace root
+    int line;                 // 0-based
+    int column;
+    std::string lineText;
+};
+
+// Searches every file under a workspace root for a literal string. The tree
+// is walked in parallel on a work-stealing pool, .gitignore files are honored,
+// files are mmap'ed and binary files (a NUL in the first block) are skipped.
+// Matches stream to the callback in batches from the worker threads; the
+// callback is serialized. Destroying the search cancels it and waits.
+// Given a candidate list (e.g. from a trigram index) only those files are
+// searched and the tree is not walked.
+class WorkspaceSearch {
+public:
+    using BatchCallback = std::function<void(std::vector<WorkspaceMatch> batch, bool finished)>;
+
+    WorkspaceSearch(const std::string &root, const std::string &query, bool caseSensitive,
+                    BatchCallback callback);
+    WorkspaceSearch(const std::string &root, const std::string &query, bool caseSensitive,
+                    std::vector<std::string> candidates, BatchCallback callback);
+    ~WorkspaceSearch();
+
+    void cancel() { cancelled = true; }
+    size_t filesSearched() const { return fileCount; }
+
+private:
+    void run();
+    void searchFile(const std::string &relative);
+    void publish(std::vector<WorkspaceMatch> &matches);
+    std::string absolutePath(const std::string &relative) const;
+
+    std::string root;
+    std::string query;
+    bool caseSensitive;
+    BatchCallback callback;
+    bool useCandidates;
+    std::vector<std::string> candidates;
+
+    std::atomic<bool> cancelled;
+    std::atomic<size_t> fileCount;
+    std::atomic<size_t> matchCount;
+
+    std::mutex resultMutex;
+    std::vector<WorkspaceMatch> pendingResults;
+    bool sentFirst;
+    std::chrono::steady_clock::time_point lastFlush;
+
+    std::unique_ptr<ThreadPool> pool;
+    std::thread driver;
+};
+
+#endif // WORKSPACESEARCH_H
@@ -0,0 +1,91 @@
+#include "workspacewalker.h"
+#include "traceevents.h"
+#include "dirreader.h"
+
+WorkspaceWalker::WorkspaceWalker(const std::string &rootPath, ThreadPool &threadPool,
+                                 const std::atomic<bool> &cancelFlag)
+    : root(rootPath), pool(threadPool), cancelled(cancelFlag) {
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+}
+
+std::string WorkspaceWalker::absolutePath(const std::string &relative) const {
+    return relative.empty() ? root : root + "/" + relative;
+}
+
+void WorkspaceWalker::start(const std::string &relative, std::shared_ptr<const IgnoreRules> rules) {
+    // The walk itself picks up the directory's own .gitignore
+    if (!rules && relative.empty()) {
+        rules = IgnoreRules::defaults();
+    } else if (!rules) {
+        size_t slash = relative.rfind('/');
+        rules = rulesFor(root, slash == std::string::npos ? "" : relative.substr(0, slash));
+    }
+    pool.submit([this, relative, rules] { walkDirectory(relative, rules); });
+}
+
+std::shared_ptr<const IgnoreRules> WorkspaceWalker::rulesFor(const std::string &root, const std::string &relativeDir) {
+    std::shared_ptr<const IgnoreRules> rules = IgnoreRules::defaults();
+    std::string dir;
+    size_t pos = 0;
+    while (true) {
+        auto own = std::make_shared<IgnoreRules>(rules, dir);
+        std::string path = dir.empty() ? root + "/.gitignore" : root + "/" + dir + "/.gitignore";
+        if (own->addFile(path) && !own->isEmpty()) {
+            rules = own;
+        }
+        if (pos >= relativeDir.size()) break;
+
+        size_t slash = relativeDir.find('/', pos);
+        if (slash == std::string::npos) slash = relativeDir.size();
+        dir = relativeDir.substr(0, slash);
+        pos = slash + 1;
+    }
+    return rules;
+}
+
+void WorkspaceWalker::walkDirectory(const std::string &relative, std::shared_ptr<const IgnoreRules> rules) {
+    if (cancelled) return;
+    TRACE_SCOPE("walk directory");
+
+    std::string dirPath = absolutePath(relative);
+    DirReader reader(dirPath);
+    if (!reader.isOpen()) return;
+
+    std::vector<DirEntry> entries;
+    while (reader.readBatch(entries, 4096)) {
+    }
+
+    // A .gitignore applies to this directory and everything below it
+    for (const DirEntry &entry : entries) {
+        if (entry.name == ".gitignore" && entry.type != DirEntry::Directory) {
+            auto own = std::make_shared<IgnoreRules>(rules, relative);
+            if (own->addFile(dirPath + "/.gitignore") && !own->isEmpty()) {
+                rules = own;
+            }
+            break;
+        }
+    }
+
+    if (directoryCallback) {
+        directoryCallback(relative, rules);
+    }
+
+    for (const DirEntry &entry : entries) {
+        std::string childRelative = relative.empty() ? entry.name : relative + "/" + entry.name;
+        DirEntry::Type type = entry.type;
+        if (type == DirEntry::Unknown) {
+            type = DirReader::resolveType(absolutePath(childRelative));
+        }
+
+        // Symlinks are not followed, so the walk cannot loop
+        if (type == DirEntry::Directory) {
+            if (!rules->isIgnored(childRelative, true)) {
+                pool.submit([this, childRelative, rules] { walkDirectory(childRelative, rules); });
+            }
+        } else if (type == DirEntry::File) {
+            if (fileCallback && !rules->isIgnored(childRelative, false)) {
+                fileCallback(childRelative);
+            }
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef WORKSPACEWALKER_H
+#define WORKSPACEWALKER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include "ignorerules.h"
+#include "threadpool.h"
+
+// Walks a workspace tree in parallel on a thread pool, one task per
+// directory. .gitignore files are honored and symlinks are not followed.
+// Callbacks run on the pool's threads; the walker must outlive pool.wait().
+class WorkspaceWalker {
+public:
+    using FileCallback = std::function<void(const std::string &relativePath)>;
+    using DirectoryCallback = std::function<void(const std::string &relativePath,
+                                                 const std::shared_ptr<const IgnoreRules> &rules)>;
+
+    WorkspaceWalker(const std::string &root, ThreadPool &pool, const std::atomic<bool> &cancelled);
+
+    void setFileCallback(FileCallback callback) { fileCallback = std::move(callback); }
+    void setDirectoryCallback(DirectoryCallback callback) { directoryCallback = std::move(callback); }
+
+    // Queues a walk of relative ("" = the root). rules defaults to the rules
+    // in effect in its parent directory.
+    void start(const std::string &relative = "", std::shared_ptr<const IgnoreRules> rules = nullptr);
+
+    std::string absolutePath(const std::string &relative) const;
+
+    // Rules in effect inside relativeDir, reading every .gitignore from the
+    // root down
+    static std::shared_ptr<const IgnoreRules> rulesFor(const std::string &root, const std::string &relativeDir);
+
+private:
+    void walkDirectory(const std::string &relative, std::shared_ptr<const IgnoreRules> rules);
+
+    std::string root;
+    ThreadPool &pool;
+    const std::atomic<bool> &cancelled;
+    FileCallback fileCallback;
+    DirectoryCallback directoryCallback;
+};
+
+#endif // WORKSPACEWALKER_H
@@ -0,0 +1,265 @@
+#include "wraplayout.h"
+#include <algorithm>
+#include "utf8.h"
+
+WrapLayout::WrapLayout() : wrapWidth(0), seenVersion(0), synced(false), unmeasured(0), measureCursor(0) {
+}
+
+size_t WrapLayout::memoryUsage() const {
+    return (rows.capacity() + tree.capacity() + starts.capacity() + prefix.capacity()) * sizeof(int) +
+           estimated.capacity() + hidden.capacity() * sizeof(FoldRange) + changes.capacity() * sizeof(LineChange);
+}
+
+void WrapLayout::setWidth(int columns) {
+    columns = std::max(columns, 0);
+    if (columns == wrapWidth) return;
+    wrapWidth = columns;
+    synced = false;     // every line is estimated again on the next sync
+}
+
+void WrapLayout::wrapLine(std::string_view text, int width, std::vector<int> &starts) {
+    starts.clear();
+    starts.push_back(0);
+    if (width <= 0 || text.size() <= (size_t)width) return;
+
+    if (isAsciiText(text)) {
+        size_t position = 0;
+        while (text.size() - position > (size_t)width) {
+            // Break after the last space that fits, or mid-word if there is none
+            size_t space = text.rfind(' ', position + width - 1);
+            size_t next = (space != std::string_view::npos && space > position) ? space + 1 : position + width;
+            starts.push_back((int)next);
+            position = next;
+        }
+        return;
+    }
+
+    // Same rule counting display columns of whole grapheme clusters
+    size_t rowStart = 0;
+    size_t spaceBreak = 0;      // offset after the row's last space, 0 if none
+    int columns = 0, spaceColumns = 0;
+    for (size_t offset = 0; offset < text.size();) {
+        size_t next = nextGraphemeBoundary(text, offset);
+        int clusterWidth = graphemeWidth(text, offset, next);
+        if (columns + clusterWidth > width && offset > rowStart) {
+            if (spaceBreak > rowStart + 1) {
+                rowStart = spaceBreak;
+                columns -= spaceColumns;
+            } else {
+                rowStart = offset;
+                columns = 0;
+            }
+            starts.push_back((int)rowStart);
+            spaceBreak = 0;
+            continue;
+        }
+        columns += clusterWidth;
+        if (text[offset] == ' ') {
+            spaceBreak = next;
+            spaceColumns = columns;
+        }
+        offset = next;
+    }
+}
+
+int WrapLayout::estimateRows(int length) const {
+    if (wrapWidth <= 0 || length <= wrapWidth) return 1;
+    return (length + wrapWidth - 1) / wrapWidth;
+}
+
+int WrapLayout::effectiveRows(int line) const {
+    auto it = std::upper_bound(hidden.begin(), hidden.end(), line,
+                               [](int value, const FoldRange &range) { return value < range.first; });
+    if (it != hidden.begin() && line <= (it - 1)->last) return 0;
+    return rows[line];
+}
+
+void WrapLayout::addRows(int line, int delta) {
+    for (int i = line + 1; i < (int)tree.size(); i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+int WrapLayout::prefixRows(int count) const {
+    int sum = 0;
+    for (int i = std::min(count, (int)tree.size() - 1); i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+void WrapLayout::resetLines(const TextBuffer &buffer) {
+    int count = buffer.lineCount();
+    rows.assign(count, 1);
+    estimated.assign(count, 1);
+    unmeasured = count;
+    measureCursor = 0;
+    tree.assign(count + 1, 0);
+    rebuildFrom(buffer, 0);
+}
+
+void WrapLayout::rebuildFrom(const TextBuffer &buffer, int line) {
+    // Re-estimates changed lines from line on and recomputes every tree node
+    // covering them. Nodes below line only cover lines before it and are
+    // still right, which gives prefix sums up to line in O(log n).
+    int count = (int)rows.size();
+    line = std::min(line, count);
+    tree.resize(count + 1);
+
+    // prefix[k] = visible rows in lines [0, line + k)
+    prefix.resize(count - line + 1);
+    prefix[0] = prefixRows(line);
+    size_t fold = std::lower_bound(hidden.begin(), hidden.end(), line,
+                                   [](const FoldRange &range, int value) { return range.last < value; }) -
+                  hidden.begin();
+    for (int k = line; k < count; k++) {
+        if (estimated[k]) {
+            // Placeholders from edits; lines that fit are exact right away
+            int length = buffer.lineLength(k);
+            rows[k] = estimateRows(length);
+            if (wrapWidth <= 0 || length <= wrapWidth) {
+                estimated[k] = 0;
+                unmeasured--;
+            }
+        }
+        while (fold < hidden.size() && hidden[fold].last < k) fold++;
+        bool isHidden = fold < hidden.size() && hidden[fold].first <= k;
+        prefix[k - line + 1] = prefix[k - line] + (isHidden ? 0 : rows[k]);
+    }
+
+    for (int i = line + 1; i <= count; i++) {
+        int low = i - (i & -i);
+        int lowSum = low >= line ? prefix[low - line] : prefixRows(low);
+        tree[i] = prefix[i - line] - lowSum;
+    }
+}
+
+void WrapLayout::applyChange(const LineChange &change) {
+    // Replaced lines become placeholders, estimated once the replay is done
+    for (int k = change.first; k < change.first + change.removed; k++) {
+        if (estimated[k]) unmeasured--;
+    }
+    rows.erase(rows.begin() + change.first, rows.begin() + change.first + change.removed);
+    estimated.erase(estimated.begin() + change.first, estimated.begin() + change.first + change.removed);
+    rows.insert(rows.begin() + change.first, change.added, 1);
+    estimated.insert(estimated.begin() + change.first, change.added, 1);
+    unmeasured += change.added;
+}
+
+void WrapLayout::sync(const TextBuffer &buffer, const FoldSet &folds) {
+    changes.clear();
+    if (!synced || !buffer.changesSince(seenVersion, changes)) {
+        hidden = folds.ranges();
+        resetLines(buffer);
+        seenVersion = buffer.version();
+        synced = true;
+        return;
+    }
+    if (changes.empty() && hidden.size() == folds.ranges().size() &&
+        std::equal(hidden.begin(), hidden.end(), folds.ranges().begin(),
+                   [](const FoldRange &a, const FoldRange &b) { return a.first == b.first && a.last == b.last; })) {
+        return;
+    }
+
+    // Lowest line whose rows may differ: the first edited one, or the start
+    // of the first fold that was added, removed or moved
+    int lowest = buffer.lineCount();
+    bool structural = false;
+    for (const LineChange &change : changes) {
+        lowest = std::min(lowest, change.first);
+        structural = structural || change.removed != change.added;
+    }
+    const std::vector<FoldRange> &current = folds.ranges();
+    size_t common = 0;
+    while (common < hidden.size() && common < current.size() && hidden[common].first == current[common].first &&
+           hidden[common].last == current[common].last) {
+        common++;
+    }
+    if (common < hidden.size()) lowest = std::min(lowest, hidden[common].first);
+    if (common < current.size()) lowest = std::min(lowest, current[common].first);
+    bool foldsChanged = common < hidden.size() || common < current.size();
+
+    if (!structural && !foldsChanged) {
+        // Typing: the line count is the same, only the edited lines change
+        for (const LineChange &change : changes) {
+            for (int k = change.first; k < change.first + change.removed; k++) {
+                int length = buffer.lineLength(k);
+                int updated = estimateRows(length);
+                bool guess = wrapWidth > 0 && length > wrapWidth;
+                unmeasured += (int)guess - (int)estimated[k];
+                estimated[k] = guess;
+                if (effectiveRows(k) > 0) addRows(k, updated - rows[k]);
+                rows[k] = updated;
+            }
+        }
+    } else {
+        for (const LineChange &change : changes) {
+            applyChange(change);
+        }
+        hidden = current;
+        rebuildFrom(buffer, lowest);
+    }
+    seenVersion = buffer.version();
+}
+
+void WrapLayout::measure(const TextBuffer &buffer, int first, int last) {
+    first = std::max(first, 0);
+    last = std::min(last, (int)rows.size() - 1);
+    for (int k = first; k <= last; k++) {
+        if (!estimated[k]) continue;
+        wrapLine(buffer.line(k), wrapWidth, starts);
+        int updated = (int)starts.size();
+        if (effectiveRows(k) > 0) addRows(k, updated - rows[k]);
+        rows[k] = updated;
+        estimated[k] = 0;
+        unmeasured--;
+    }
+}
+
+bool WrapLayout::measureSome(const TextBuffer &buffer, int maxLines) {
+    int count = (int)rows.size();
+    for (int scanned = 0; unmeasured > 0 && maxLines > 0 && scanned < count; scanned++) {
+        if (measureCursor >= count) measureCursor = 0;
+        if (estimated[measureCursor]) {
+            measure(buffer, measureCursor, measureCursor);
+            maxLines--;
+        }
+        measureCursor++;
+    }
+    return unmeasured == 0;
+}
+
+int WrapLayout::rowCount() const {
+    return prefixRows((int)rows.size());
+}
+
+int WrapLayout::lineRows(int line) const {
+    return effectiveRows(line);
+}
+
+int WrapLayout::lineToRow(int line) const {
+    auto it = std::upper_bound(hidden.begin(), hidden.end(), line,
+                               [](int value, const FoldRange &range) { return value < range.first; });
+    if (it != hidden.begin() && line <= (it - 1)->last) {
+        line = (it - 1)->first - 1;
+    }
+    return prefixRows(line);
+}
+
+int WrapLayout::rowToLine(int row, int *subRow) const {
+    // Largest line whose preceding rows are <= row; lines with no rows
+    // (folded) are stepped over by the descent itself
+    int count = (int)rows.size();
+    int line = 0;
+    int remaining = std::max(row, 0);
+    int step = 1;
+    while (step * 2 <= count) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (line + step <= count && tree[line + step] <= remaining) {
+            line += step;
+            remaining -= tree[line];
+        }
+    }
+    if (subRow) *subRow = remaining;
+    return line;
+}
@@ -0,0 +1,78 @@
+#ifndef WRAPLAYOUT_H
+#define WRAPLAYOUT_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "textbuffer.h"
+#include "foldset.h"
+
+// Maps buffer lines to the screen rows they take when long lines are
+// soft-wrapped. Rows per line sit in a Fenwick tree, so row <-> line lookups
+// are O(log n) and the row total stays exact for scrollbars. Lines hidden by
+// folds take no rows.
+//
+// Lines with no more bytes than the width fit in one row (a column takes at
+// least one byte) and are never scanned. Longer lines start with an estimate
+// from their length; the exact wrap is worked out when they are shown
+// (measure) or in idle time (measureSome), so a resize only costs a pass over
+// line lengths.
+class WrapLayout {
+public:
+    WrapLayout();
+
+    // Display columns per row; 0 turns wrapping off (every line is one row)
+    void setWidth(int columns);
+    int width() const { return wrapWidth; }
+
+    // Follows edits to buffer and folding changes since the last call
+    void sync(const TextBuffer &buffer, const FoldSet &folds);
+
+    // Wraps lines [first, last] exactly
+    void measure(const TextBuffer &buffer, int first, int last);
+    // Wraps up to maxLines estimated lines; true once every line is exact
+    bool measureSome(const TextBuffer &buffer, int maxLines);
+    bool isExact() const { return unmeasured == 0; }
+    // Heap bytes of the row counts and the tree over them
+    size_t memoryUsage() const;
+
+    int rowCount() const;
+    int lineRows(int line) const;
+    // First row of line (of its fold header if it is hidden)
+    int lineToRow(int line) const;
+    // Line shown at row, and which of its rows it is; past the last row
+    // this is the line count
+    int rowToLine(int row, int *subRow = nullptr) const;
+
+    // Byte offsets where each row of text starts; always begins with 0. Rows
+    // hold up to width display columns and break after the last space that
+    // fits, or mid-word (between grapheme clusters) if there is none.
+    static void wrapLine(std::string_view text, int width, std::vector<int> &starts);
+
+private:
+    int estimateRows(int length) const;
+    void resetLines(const TextBuffer &buffer);
+    void applyChange(const LineChange &change);
+    void rebuildFrom(const TextBuffer &buffer, int line);
+    void addRows(int line, int delta);
+    int prefixRows(int count) const;
+    int effectiveRows(int line) const;
+
+    int wrapWidth;
+    uint64_t seenVersion;
+    bool synced;
+
+    std::vector<int> rows;          // wrapped rows of every line, hidden or not
+    std::vector<uint8_t> estimated; // rows[i] is a guess from the length
+    int unmeasured;
+    int measureCursor;              // where measureSome carries on
+
+    std::vector<FoldRange> hidden;  // folds as last applied
+    std::vector<int> tree;          // Fenwick tree of visible rows, 1-based
+
+    std::vector<LineChange> changes;
+    std::vector<int> starts;
+    std::vector<int> prefix;
+};
+
+#endif // WRAPLAYOUT_H